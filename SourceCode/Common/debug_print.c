@@ -51,6 +51,19 @@ void DebugPrintString(const char *MessageText)
 }
 
 
+#ifndef NABU_H
+/*******************************************************************************
+ * Host computer version of the NABU's fast_utoa() from l_fast_utoa.asm.  Write
+ * unsigned decimal integer to ascii buffer.  Returns one past the last digit
+ * written.  Also writes a NUL at the end of the string.
+ */
+char * fast_utoa(uint16_t number, char *buffer)
+{
+  return buffer + sprintf(buffer, "%u", (unsigned int) number);
+}
+#endif /* NABU_H */
+
+
 /*******************************************************************************
  * Utility function to append a readable ASCII version of the given 16 bit
  * unsigned integer, to the g_TempBuffer.  Assume it doesn't overflow.  Returns
@@ -24,8 +24,11 @@ fx gfx_Constant_MinusOne;
 fx gfx_Constant_Eighth;
 fx gfx_Constant_MinusEighth;
 
+/* The assembler functions below are left out when FX_ASM_EMULATED is defined,
+   for fixed_point_emulator_test.c which runs them in a Z80 emulator instead. */
 
-#ifdef NABU_H
+
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Negate, done by subtracting from 0 and overwriting the value. */
 void NEGATE_FX_ASM(pfx x)
 {
@@ -54,7 +57,7 @@ void NEGATE_FX_ASM(pfx x)
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Negate and copy in one step.  Y is set to -X. */
 void COPY_NEGATE_FX_ASM(pfx x, pfx y)
 {
@@ -90,7 +93,7 @@ void COPY_NEGATE_FX_ASM(pfx x, pfx y)
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Add fx values x and y and put the result in fx value z (which can safely
    overwrite x or y if it is the same address as them). */
 void ADD_FX_ASM(pfx x, pfx y, pfx z)
@@ -134,7 +137,7 @@ void ADD_FX_ASM(pfx x, pfx y, pfx z)
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Put fx value x - y into z (which can safely overwrite x or y even if they
    have the same address as z). */
 void SUBTRACT_FX_ASM(pfx x, pfx y, pfx z)
@@ -178,7 +181,7 @@ void SUBTRACT_FX_ASM(pfx x, pfx y, pfx z)
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Compare two values X & Y, return a small integer (so it can be returned in
    a register rather than on the stack) which is -1 if X < Y, zero if X = Y,
    +1 if X > Y. */
@@ -230,7 +233,7 @@ ZeroCompare:
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Compare value X against zero and return a small integer which
    is -1 if X < 0, zero if X == 0, +1 if X > 0. */
 int8_t TEST_FX_ASM(pfx x)
@@ -264,7 +267,7 @@ ZeroTest:
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Divide the FX by two.  Same as shifting the given value arithmetic right
    (sign bit extended, so works with negative numbers too) by one bit.  1 bit
    is extra efficient on the Z80 in that we can shift directly in memory.
@@ -290,7 +293,7 @@ void DIV2_FX_ASM(pfx x)
 #endif
 
 
-#ifdef NABU_H
+#if defined(NABU_H) && !defined(FX_ASM_EMULATED)
 /* Divide the FX by two to the Nth.  Same as shifting the given value arithmetic
    right by N bits (sign bit extended, so works with negative numbers too).
    Load 32 bits in to bc and de registers to do shifts, A counts down from N.
@@ -347,194 +350,218 @@ Div2nthDone:
      4  -x o +x  0
        3  +y   1
            2
+
+   Rather than a tree of tests, we look up the answer in a table.  The index
+   is the quadrant (from the sign bits) times 8 plus a class: 0 if |X| > |Y|,
+   1 if |X| == |Y|, 2 if |X| < |Y|, 3 if on the X axis, 4 if on the Y axis, 5
+   for a zero length vector.  |X| - |Y| is X - Y or X + Y depending on whether
+   the signs are the same, negated if X is negative, and can't overflow.  So
+   it takes one addition or subtraction, the rest is testing bits.
 */
+#define OCTANT_QUADRANT_NEGATIVE_X 16
+#define OCTANT_QUADRANT_NEGATIVE_Y 8
+#define OCTANT_CLASS_X_AXIS 3
+#define OCTANT_CLASS_Y_AXIS 4
+#define OCTANT_CLASS_ZERO 5
+
+static const uint8_t kOctantTable[32] = {
+  0, 0x81, 1, 0x80, 0x82, 0, 0, 0, /* +X, +Y */
+  7, 0x87, 6, 0x80, 0x86, 0, 0, 0, /* +X, -Y */
+  3, 0x83, 2, 0x84, 0x82, 0, 0, 0, /* -X, +Y */
+  4, 0x85, 5, 0x84, 0x86, 0, 0, 0  /* -X, -Y */
+};
+
 uint8_t VECTOR_FX_TO_OCTANT(pfx vector_x, pfx vector_y)
 {
-  int8_t xDir, yDir;
-  uint8_t octantLower = 0xFF; /* An invalid value you should never see. */
-  bool rightOnOctant = false; /* If velocity is exactly in octant direction. */
+  uint8_t index = 0;
+  bool xNegative;
+  fx delta;
+
+  if (IS_NEGATIVE_FX(*vector_y))
+    index = OCTANT_QUADRANT_NEGATIVE_Y;
+  xNegative = (IS_NEGATIVE_FX(*vector_x) != 0);
+  if (xNegative)
+    index += OCTANT_QUADRANT_NEGATIVE_X;
+
+  if (IS_ZERO_FX(*vector_y))
+    index += IS_ZERO_FX(*vector_x) ? OCTANT_CLASS_ZERO : OCTANT_CLASS_X_AXIS;
+  else if (IS_ZERO_FX(*vector_x))
+    index += OCTANT_CLASS_Y_AXIS;
+  else
+  {
+    if (index == OCTANT_QUADRANT_NEGATIVE_X ||
+    index == OCTANT_QUADRANT_NEGATIVE_Y)
+      ADD_FX(*vector_x, *vector_y, delta)
+    else
+      SUBTRACT_FX(*vector_x, *vector_y, delta);
+    if (IS_ZERO_FX(delta))
+      index += 1;
+    else if ((IS_NEGATIVE_FX(delta) != 0) != xNegative)
+      index += 2; /* |X| < |Y| */
+  }
+  return kOctantTable[index];
+}
+
+
+/* Same function, but with int16_t pixel values as the vector coordinates. */
+uint8_t INT16_TO_OCTANT(int16_t vector_x, int16_t vector_y)
+{
+  uint8_t index = 0;
+  int16_t delta;
 
-  xDir = TEST_FX(*vector_x);
-  yDir = TEST_FX(*vector_y);
+  if (vector_y < 0)
+    index = OCTANT_QUADRANT_NEGATIVE_Y;
+  if (vector_x < 0)
+    index += OCTANT_QUADRANT_NEGATIVE_X;
 
-  if (xDir == 0) /* X == 0 */
+  if (vector_y == 0)
+    index += (vector_x == 0) ? OCTANT_CLASS_ZERO : OCTANT_CLASS_X_AXIS;
+  else if (vector_x == 0)
+    index += OCTANT_CLASS_Y_AXIS;
+  else
   {
-    if (yDir == 0) /* Y == 0 */
-      octantLower = 0; /* Actually undefined, zero length vector. */
-    else if (yDir >= 0) /* Y > 0, using >= test since it's faster. */
-    {
-      octantLower = 2;
-      rightOnOctant = true;
-    }
-    else /* Y < 0 */
-    {
-      octantLower = 6;
-      rightOnOctant = true;
-    }
+    if (index == OCTANT_QUADRANT_NEGATIVE_X ||
+    index == OCTANT_QUADRANT_NEGATIVE_Y)
+      delta = vector_x + vector_y;
+    else
+      delta = vector_x - vector_y;
+    if (index >= OCTANT_QUADRANT_NEGATIVE_X)
+      delta = -delta;
+    index += (delta > 0) ? 0 : (delta == 0) ? 1 : 2;
   }
-  else if (xDir >= 0) /* X > 0 */
+  return kOctantTable[index];
+}
+
+
+/* Square root of a 16 bit unsigned integer, rounded down.  kSqrtTable[i] is
+   the square root of i times 16 (so 4.4 fixed point), rounded down.  Small
+   numbers get their answer straight from the table.  Bigger ones look up
+   their top 8 bits (or a middle 8 bits, shifted to suit) which gives an
+   answer at most 2 too small, then count up to the exact one. */
+static const uint8_t kSqrtTable[256] = {
+  0, 16, 22, 27, 32, 35, 39, 42, 45, 48, 50, 53, 55, 57, 59, 61,
+  64, 65, 67, 69, 71, 73, 75, 76, 78, 80, 81, 83, 84, 86, 87, 89,
+  90, 91, 93, 94, 96, 97, 98, 99, 101, 102, 103, 104, 106, 107, 108, 109,
+  110, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126,
+  128, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142,
+  143, 144, 144, 145, 146, 147, 148, 149, 150, 150, 151, 152, 153, 154, 155, 155,
+  156, 157, 158, 159, 160, 160, 161, 162, 163, 163, 164, 165, 166, 167, 167, 168,
+  169, 170, 170, 171, 172, 173, 173, 174, 175, 176, 176, 177, 178, 178, 179, 180,
+  181, 181, 182, 183, 183, 184, 185, 185, 186, 187, 187, 188, 189, 189, 190, 191,
+  192, 192, 193, 193, 194, 195, 195, 196, 197, 197, 198, 199, 199, 200, 201, 201,
+  202, 203, 203, 204, 204, 205, 206, 206, 207, 208, 208, 209, 209, 210, 211, 211,
+  212, 212, 213, 214, 214, 215, 215, 216, 217, 217, 218, 218, 219, 219, 220, 221,
+  221, 222, 222, 223, 224, 224, 225, 225, 226, 226, 227, 227, 228, 229, 229, 230,
+  230, 231, 231, 232, 232, 233, 234, 234, 235, 235, 236, 236, 237, 237, 238, 238,
+  239, 240, 240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 245, 246, 246, 247,
+  247, 248, 248, 249, 249, 250, 250, 251, 251, 252, 252, 253, 253, 254, 254, 255
+};
+
+uint8_t SQRT_UINT16(uint16_t number)
+{
+  uint8_t root;
+  uint16_t square;
+  uint16_t nextSquare;
+
+  if (number < 256)
+    return kSqrtTable[number] >> 4;
+  if (number < 4096)
+    root = kSqrtTable[number >> 4] >> 2;
+  else
+    root = kSqrtTable[number >> 8];
+
+  square = (uint16_t) root * root;
+  while (root < 255)
   {
-    if (yDir == 0) /* X > 0, Y == 0 */
-    {
-      octantLower = 0;
-      rightOnOctant = true;
-    }
-    else if (yDir >= 0) /* X > 0, Y > 0 */
-    {
-      int8_t xyDelta;
-      xyDelta = COMPARE_FX(*vector_x, *vector_y);
-      if (xyDelta > 0) /* |X| > |Y| */
-        octantLower = 0;
-      else /* |X| <= |Y| */
-      {
-        octantLower = 1;
-        rightOnOctant = (xyDelta == 0);
-      }
-    }
-    else /* X > 0, Y < 0 */
-    {
-      int8_t xyDelta;
-      fx negativeY;
-      COPY_NEGATE_FX(*vector_y, negativeY);
-      xyDelta = COMPARE_FX(*vector_x, negativeY);
-      if (xyDelta >= 0) /* |X| >= |Y| */
-      {
-        octantLower = 7;
-        rightOnOctant = (xyDelta == 0);
-      }
-      else /* |X| < |Y| */
-        octantLower = 6;
-    }
+    nextSquare = square + root + root + 1;
+    if (nextSquare > number)
+      break;
+    square = nextSquare;
+    root++;
   }
-  else /* X < 0 */
+  return root;
+}
+
+
+/* Approximate length of a vector.  If both components are under 128, the
+   sum of the squares fits in 16 bits and the exact square root (rounded down)
+   is returned.  Otherwise uses the larger of max and 7/8 max + 1/2 min
+   (alpha max plus beta min), which is within 3.5% of the true length
+   (a bit short near the diagonals) and only needs shifts and adds. */
+uint16_t INT16_VECTOR_LENGTH(int16_t vector_x, int16_t vector_y)
+{
+  uint16_t big, small, length;
+
+  big = (vector_x < 0) ? -vector_x : vector_x;
+  small = (vector_y < 0) ? -vector_y : vector_y;
+  if (small > big)
   {
-    if (yDir == 0) /* X < 0, Y == 0 */
-    {
-      octantLower = 4;
-      rightOnOctant = true;
-    }
-    else if (yDir >= 0) /* X < 0, Y >= 0 */
-    {
-      int8_t xyDelta;
-      fx negativeX;
-      COPY_NEGATE_FX(*vector_x, negativeX);
-      xyDelta = COMPARE_FX(negativeX, *vector_y);
-      if (xyDelta >= 0) /* |X| >= |Y| */
-      {
-        octantLower = 3;
-        rightOnOctant = (xyDelta == 0);
-      }
-      else /* |X| < |Y| */
-        octantLower = 2;
-    }
-    else /* X < 0, Y < 0 */
-    {
-      int8_t xyDelta;
-      xyDelta = COMPARE_FX(*vector_x, *vector_y);
-      if (xyDelta < 0) /* |X| > |Y| */
-        octantLower = 4;
-      else /* |X| <= |Y| */
-      {
-        octantLower = 5;
-        rightOnOctant = (xyDelta == 0);
-      }
-    }
+    length = big;
+    big = small;
+    small = length;
   }
 
-  if (rightOnOctant)
-    octantLower |= 0x80;
-  return octantLower;
+  if (big < 128)
+    return SQRT_UINT16((uint16_t) ((uint8_t) big * (uint8_t) big) +
+      (uint16_t) ((uint8_t) small * (uint8_t) small));
+
+  length = big - (big >> 3) + (small >> 1);
+  return (length > big) ? length : big;
 }
 
 
-/* Same function, but with int16_t pixel values as the vector coordinates. */
-uint8_t INT16_TO_OCTANT(int16_t vector_x, int16_t vector_y)
+/* Scale a vector to have a length of about VECTOR_UNIT_LENGTH, keeping the
+   direction.  The components are shifted so the bigger one is 64 to 127,
+   where INT16_VECTOR_LENGTH() is exact, then doubled if needed to put the
+   length in the 128 to 255 range.  kReciprocalTable[i] is 16384 / (i + 128),
+   which is multiplied with each component rather than dividing by the
+   length, since the Z80 doesn't do division. */
+static const uint8_t kReciprocalTable[128] = {
+  128, 127, 126, 125, 124, 123, 122, 121, 120, 120, 119, 118, 117, 116, 115, 115,
+  114, 113, 112, 111, 111, 110, 109, 109, 108, 107, 106, 106, 105, 104, 104, 103,
+  102, 102, 101, 101, 100, 99, 99, 98, 98, 97, 96, 96, 95, 95, 94, 94,
+  93, 93, 92, 92, 91, 91, 90, 90, 89, 89, 88, 88, 87, 87, 86, 86,
+  85, 85, 84, 84, 84, 83, 83, 82, 82, 82, 81, 81, 80, 80, 80, 79,
+  79, 78, 78, 78, 77, 77, 77, 76, 76, 76, 75, 75, 74, 74, 74, 73,
+  73, 73, 72, 72, 72, 72, 71, 71, 71, 70, 70, 70, 69, 69, 69, 69,
+  68, 68, 68, 67, 67, 67, 67, 66, 66, 66, 66, 65, 65, 65, 65, 64
+};
+
+uint16_t INT16_VECTOR_NORMALISE(int16_t *pVector_x, int16_t *pVector_y)
 {
-  uint8_t octantLower = 0xFF; /* An invalid value you should never see. */
-  bool rightOnOctant = false; /* If velocity is exactly in octant direction. */
+  uint16_t length, scaledLength;
+  uint16_t absX, absY;
+  uint8_t reciprocal;
 
-  if (vector_x == 0) /* X == 0 */
+  length = INT16_VECTOR_LENGTH(*pVector_x, *pVector_y);
+  if (length == 0)
+    return 0;
+
+  absX = (*pVector_x < 0) ? -*pVector_x : *pVector_x;
+  absY = (*pVector_y < 0) ? -*pVector_y : *pVector_y;
+  while ((absX | absY) >= 128)
   {
-    if (vector_y == 0) /* Y == 0 */
-      octantLower = 0; /* Actually undefined, zero length vector. */
-    else if (vector_y >= 0) /* Y > 0, using >= test since it's faster. */
-    {
-      octantLower = 2;
-      rightOnOctant = true;
-    }
-    else /* Y < 0 */
-    {
-      octantLower = 6;
-      rightOnOctant = true;
-    }
+    absX >>= 1;
+    absY >>= 1;
   }
-  else if (vector_x >= 0) /* X > 0 */
+  while ((absX | absY) < 64)
   {
-    if (vector_y == 0) /* X > 0, Y == 0 */
-    {
-      octantLower = 0;
-      rightOnOctant = true;
-    }
-    else if (vector_y >= 0) /* X > 0, Y > 0 */
-    {
-      int16_t xyDelta;
-      xyDelta = vector_x - vector_y;
-      if (xyDelta > 0) /* |X| > |Y| */
-        octantLower = 0;
-      else /* |X| <= |Y| */
-      {
-        octantLower = 1;
-        rightOnOctant = (xyDelta == 0);
-      }
-    }
-    else /* X > 0, Y < 0 */
-    {
-      int16_t xyDelta;
-      xyDelta = vector_x + vector_y;
-      if (xyDelta >= 0) /* |X| >= |Y| */
-      {
-        octantLower = 7;
-        rightOnOctant = (xyDelta == 0);
-      }
-      else /* |X| < |Y| */
-        octantLower = 6;
-    }
+    absX <<= 1;
+    absY <<= 1;
   }
-  else /* X < 0 */
+  scaledLength = INT16_VECTOR_LENGTH(absX, absY);
+  if (scaledLength < 128)
   {
-    if (vector_y == 0) /* X < 0, Y == 0 */
-    {
-      octantLower = 4;
-      rightOnOctant = true;
-    }
-    else if (vector_y >= 0) /* X < 0, Y >= 0 */
-    {
-      int16_t xyDelta;
-      xyDelta = -vector_x - vector_y;
-      if (xyDelta >= 0) /* |X| >= |Y| */
-      {
-        octantLower = 3;
-        rightOnOctant = (xyDelta == 0);
-      }
-      else /* |X| < |Y| */
-        octantLower = 2;
-    }
-    else /* X < 0, Y < 0 */
-    {
-      int16_t xyDelta;
-      xyDelta = vector_x - vector_y;
-      if (xyDelta < 0) /* |X| > |Y| */
-        octantLower = 4;
-      else /* |X| <= |Y| */
-      {
-        octantLower = 5;
-        rightOnOctant = (xyDelta == 0);
-      }
-    }
+    scaledLength <<= 1;
+    absX <<= 1;
+    absY <<= 1;
   }
+  reciprocal = kReciprocalTable[scaledLength - 128];
 
-  if (rightOnOctant)
-    octantLower |= 0x80;
-  return octantLower;
+  /* Components are at most 255, so the products fit in 16 bits unsigned. */
+  absX = (absX * reciprocal) >> 8;
+  absY = (absY * reciprocal) >> 8;
+  *pVector_x = (*pVector_x < 0) ? -(int16_t) absX : (int16_t) absX;
+  *pVector_y = (*pVector_y < 0) ? -(int16_t) absY : (int16_t) absY;
+  return length;
 }
-
@@ -108,6 +108,25 @@ typedef union fx_union {
   fx_bits portions;
 } fx, *pfx;
 
+/* Set FX_INLINE to 1 to have the NABU expand the most common operations
+   (ADD_FX, SUBTRACT_FX, NEGATE_FX, COPY_NEGATE_FX, COMPARE_FX, TEST_FX) into
+   inline C code working on the fraction and integer parts, rather than calling
+   the assembler functions.  That avoids pushing pointers, calling, fetching
+   the pointers off the stack, returning and cleaning up the stack.  With
+   global arguments, fixed_point_emulator_test.c counts that as 221 of the 320
+   T-states an ADD_FX or SUBTRACT_FX takes, 111 of 173 for NEGATE_FX, 168 of
+   242 for COPY_NEGATE_FX, 160 of 276 for COMPARE_FX and 103 of 171 for
+   TEST_FX.  The inline code also lets the compiler use fixed addresses for
+   globals and IY offsets for player fields.  But each use costs more code
+   space, and what SDCC makes of the C for the remaining work hasn't been
+   timed, so it's off until someone times a game frame both ways with Z88DK.
+   Note that the inline versions use their arguments more than once, unlike
+   the function calls (and the generic ADD_FX), so don't use arguments with
+   side effects. */
+#ifndef FX_INLINE
+#define FX_INLINE 0
+#endif
+
 /* Related constants. */
 extern fx gfx_Constant_Zero;
 extern fx gfx_Constant_One;
@@ -171,7 +190,16 @@ extern fx gfx_Constant_MinusEighth;
 /* NEGATE_FX(x) - Done by subtracting from 0 and overwriting the value. */
 #ifdef NABU_H
 extern void NEGATE_FX_ASM(pfx x);
+#if FX_INLINE /* -(I + F/256) is -I - 1 + (256 - F)/256 when F isn't zero. */
+#define NEGATE_FX(x) { \
+  fx_type_for_integer_part fxInlineInteger = -(x).portions.integer; \
+  if ((x).portions.fraction != 0) { \
+    (x).portions.fraction = -(x).portions.fraction; \
+    fxInlineInteger--; } \
+  (x).portions.integer = fxInlineInteger; }
+#else
 #define NEGATE_FX(x) { NEGATE_FX_ASM(&(x)); }
+#endif /* FX_INLINE */
 #else /* Generic version. */
 #define NEGATE_FX(x) { (x).as_int = -(x).as_int; }
 #endif
@@ -179,7 +207,17 @@ extern void NEGATE_FX_ASM(pfx x);
 /* COPY_NEGATE_FX(x, y) - Negate and copy in one step.  Y is set to -X. */
 #ifdef NABU_H
 extern void COPY_NEGATE_FX_ASM(pfx x, pfx y);
+#if FX_INLINE
+#define COPY_NEGATE_FX(x, y) { \
+  fx_type_for_integer_part fxInlineInteger = -(x).portions.integer; \
+  fx_type_for_fraction_part fxInlineFraction = -(x).portions.fraction; \
+  if (fxInlineFraction != 0) \
+    fxInlineInteger--; \
+  (y).portions.fraction = fxInlineFraction; \
+  (y).portions.integer = fxInlineInteger; }
+#else
 #define COPY_NEGATE_FX(x, y) { COPY_NEGATE_FX_ASM(&(x), &(y)); }
+#endif /* FX_INLINE */
 #else /* Generic version. */
 #define COPY_NEGATE_FX(x, y) { (y).as_int = -(x).as_int; }
 #endif
@@ -188,7 +226,17 @@ extern void COPY_NEGATE_FX_ASM(pfx x, pfx y);
    (which can safely overwrite x or y if it is the same address as them). */
 #ifdef NABU_H
 extern void ADD_FX_ASM(pfx x, pfx y, pfx z);
+#if FX_INLINE /* Carry out of the fractions is the high byte of their sum. */
+#define ADD_FX(x, y, z) { \
+  uint16_t fxInlineSum = (uint16_t) (x).portions.fraction + \
+    (y).portions.fraction; \
+  fx_type_for_integer_part fxInlineInteger = (x).portions.integer + \
+    (y).portions.integer + (uint8_t) (fxInlineSum >> 8); \
+  (z).portions.fraction = (fx_type_for_fraction_part) fxInlineSum; \
+  (z).portions.integer = fxInlineInteger; }
+#else
 #define ADD_FX(x, y, z) { ADD_FX_ASM(&(x), &(y), &(z)); }
+#endif /* FX_INLINE */
 #else /* Generic version. */
 #define ADD_FX(x, y, z) { (z).as_int = (x).as_int + (y).as_int; }
 #endif
@@ -197,7 +245,17 @@ extern void ADD_FX_ASM(pfx x, pfx y, pfx z);
    x or y even if they have the same address as z). */
 #ifdef NABU_H
 extern void SUBTRACT_FX_ASM(pfx x, pfx y, pfx z);
+#if FX_INLINE /* Borrow sets the low bit of the difference's high byte. */
+#define SUBTRACT_FX(x, y, z) { \
+  uint16_t fxInlineSum = (uint16_t) (x).portions.fraction - \
+    (y).portions.fraction; \
+  fx_type_for_integer_part fxInlineInteger = (x).portions.integer - \
+    (y).portions.integer - (uint8_t) ((fxInlineSum >> 8) & 1); \
+  (z).portions.fraction = (fx_type_for_fraction_part) fxInlineSum; \
+  (z).portions.integer = fxInlineInteger; }
+#else
 #define SUBTRACT_FX(x, y, z) { SUBTRACT_FX_ASM(&(x), &(y), &(z)); }
+#endif /* FX_INLINE */
 #else /* Generic version. */
 #define SUBTRACT_FX(x, y, z) { (z).as_int = (x).as_int - (y).as_int; }
 #endif
@@ -209,6 +267,10 @@ extern void SUBTRACT_FX_ASM(pfx x, pfx y, pfx z);
   #define IS_NEGATIVE_FX(x) (((x).as_bytes[0]) & 0x80)
 #endif
 
+/* IS_ZERO_FX(x) returns TRUE if the number is zero, without a function call
+   on the NABU. */
+#define IS_ZERO_FX(x) ((x).portions.integer == 0 && (x).portions.fraction == 0)
+
 /* ABS_FX(x) - Put fx absolute value of x into x. */
 #define ABS_FX(x) { if (IS_NEGATIVE_FX(x)) NEGATE_FX(x); }
 
@@ -221,7 +283,17 @@ extern void SUBTRACT_FX_ASM(pfx x, pfx y, pfx z);
    zero if X = Y, +1 if X > Y. */
 #ifdef NABU_H
 extern int8_t COMPARE_FX_ASM(pfx x, pfx y);
+#if FX_INLINE /* Signed integer parts decide it, unless equal. */
+#define COMPARE_FX(x, y) ( \
+  ((x).portions.integer != (y).portions.integer) ? \
+    (((x).portions.integer < (y).portions.integer) ? (int8_t) -1 : \
+    (int8_t) 1) : \
+  ((x).portions.fraction < (y).portions.fraction) ? (int8_t) -1 : \
+  ((x).portions.fraction != (y).portions.fraction) ? (int8_t) 1 : \
+  (int8_t) 0 )
+#else
 #define COMPARE_FX(x, y) ( COMPARE_FX_ASM(&(x), &(y)) )
+#endif /* FX_INLINE */
 #else /* Generic version. */
 #define COMPARE_FX(x, y) ( ((x).as_int < (y).as_int) ? (int8_t) -1 : \
   ((x).as_int == (y).as_int) ? (int8_t) 0 : (int8_t) 1 )
@@ -231,7 +303,13 @@ extern int8_t COMPARE_FX_ASM(pfx x, pfx y);
    is -1 if X < 0, zero if X == 0, +1 if X > 0. */
 #ifdef NABU_H
 extern int8_t TEST_FX_ASM(pfx x);
+#if FX_INLINE
+#define TEST_FX(x)  ( IS_NEGATIVE_FX(x) ? (int8_t) -1 : \
+  ((x).portions.integer != 0 || (x).portions.fraction != 0) ? (int8_t) 1 : \
+  (int8_t) 0 )
+#else
 #define TEST_FX(x)  ( TEST_FX_ASM(&(x)) )
+#endif /* FX_INLINE */
 #else /* Generic version. */
 #define TEST_FX(x)  ( ((x).as_int < 0) ? (int8_t) -1 : \
   ((x).as_int == 0) ? (int8_t) 0 : (int8_t) 1 )
@@ -287,5 +365,22 @@ extern void DIV2Nth_FX_ASM(pfx x, uint8_t n);
 extern uint8_t VECTOR_FX_TO_OCTANT(pfx vector_x, pfx vector_y);
 extern uint8_t INT16_TO_OCTANT(int16_t vector_x, int16_t vector_y);
 
+extern uint8_t SQRT_UINT16(uint16_t number);
+/* Square root of a 16 bit number, rounded down.  Uses a 256 byte table and
+   a couple of steps of counting up, no division or looping over bits. */
+
+extern uint16_t INT16_VECTOR_LENGTH(int16_t vector_x, int16_t vector_y);
+/* Euclidean length of a pixel vector.  Exact (rounded down) when both
+   components are smaller than 128, otherwise an approximation within
+   3.5% using shifts and adds.  Components need to be more than -32768. */
+
+#define VECTOR_UNIT_LENGTH 64
+extern uint16_t INT16_VECTOR_NORMALISE(int16_t *pVector_x,
+  int16_t *pVector_y);
+/* Scales the vector to be VECTOR_UNIT_LENGTH long (give or take a couple),
+   pointing in the same direction, using a reciprocal table rather than a
+   division.  Returns the original length, from INT16_VECTOR_LENGTH().  A zero
+   length vector is left as zero. */
+
 #endif /* _FIXED_POINT_H */
 
@@ -0,0 +1,1626 @@
+/* Cross-check of the Z80 FX fixed point assembler routines, on Linux.
+ * Copyright © 2026 by Alexander G. M. Smith.
+ *
+ * fixed_point_test.c only runs on the NABU and prints a few hand picked
+ * values.  This one runs on the development machine instead.  It reads the
+ * assembler out of the *_ASM functions in fixed_point.c, runs it in a small
+ * Z80 emulator with the same stack layout as Z88DK's SDCC calls, and compares
+ * the results with what the generic 16.16 versions of the macros do (done
+ * here on 24 bit integers, which is the same thing scaled to 16.8).  The
+ * single argument routines get every possible 24 bit input, the others edge
+ * cases and lots of random ones.  VECTOR_FX_TO_OCTANT() is compiled from
+ * fixed_point.c in NABU mode, so it calls the emulated routines (or the inline
+ * macros if compiled with -DFX_INLINE=1).  It also prints how many T-states
+ * each routine took, not counting the call and argument pushing, then how
+ * much of a whole call (including the caller's pushing) is just the overhead
+ * of calling, which FX_INLINE would get rid of.  And it compares the math
+ * done by VECTOR_FX_TO_OCTANT() with the older tree of tests version of it.
+ * SQRT_UINT16(), INT16_VECTOR_LENGTH() and INT16_VECTOR_NORMALISE()
+ * are plain C, but get checked here too.  So you can rewrite the assembler to
+ * be faster and check it still works.  The emulator only knows the common
+ * Z80 instructions, it will complain if you use others.
+ *
+ * Compile and run in the Common directory with:
+ *
+ * gcc -g -O2 -Wall -o fixed_point_emulator_test fixed_point_emulator_test.c -lm && ./fixed_point_emulator_test
+ *
+ * Options are -n Count for the number of random cases (default 1000000),
+ * -s Seed for the random numbers, and a path to fixed_point.c if it isn't
+ * in the same directory as this file.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "cverify.h"
+
+/* Use the NABU's 16.8 number layout and *_ASM functions, which are supplied
+   further down by running the assembler from fixed_point.c in the emulator.
+   Packed since the NABU version of fx is 3 bytes with no padding. */
+#define NABU_H 1
+#define FX_ASM_EMULATED 1
+#pragma pack(push, 1)
+#include "fixed_point.c"
+#pragma pack(pop)
+
+COMPILER_VERIFY(sizeof(fx) == FX_BYTES_WHOLE);
+
+
+/*******************************************************************************
+ * The Z80 emulator.  Works on the assembler text rather than machine code,
+ * decoding each line into an instruction once when fixed_point.c is read.
+ */
+
+typedef enum OpcodeEnum {
+  OP_LD = 0, OP_PUSH, OP_POP, OP_EX_DE_HL, OP_EX_SP_HL,
+  OP_ADD, OP_ADC, OP_SUB, OP_SBC, OP_AND, OP_XOR, OP_OR, OP_CP,
+  OP_INC, OP_DEC, OP_ADD16, OP_ADC16, OP_SBC16,
+  OP_RLC, OP_RRC, OP_RL, OP_RR, OP_SLA, OP_SRA, OP_SRL,
+  OP_RLCA, OP_RRCA, OP_RLA, OP_RRA, OP_NEG, OP_CPL, OP_SCF, OP_CCF, OP_NOP,
+  OP_JP, OP_JR, OP_DJNZ, OP_RET, OP_MAX
+} OpcodeType;
+
+static const char *kOpcodeNames[OP_MAX] = {
+  "ld", "push", "pop", "ex", "ex",
+  "add", "adc", "sub", "sbc", "and", "xor", "or", "cp",
+  "inc", "dec", "add", "adc", "sbc",
+  "rlc", "rrc", "rl", "rr", "sla", "sra", "srl",
+  "rlca", "rrca", "rla", "rra", "neg", "cpl", "scf", "ccf", "nop",
+  "jp", "jr", "djnz", "ret"
+};
+
+typedef enum ArgumentEnum {
+  ARG_NONE = 0,
+  ARG_R8, /* B, C, D, E, H, L, (HL), A numbered 0 to 7, same as the Z80. */
+  ARG_MEM_BC, /* (BC) */
+  ARG_MEM_DE, /* (DE) */
+  ARG_MEM_HL16, /* (HL) as a jump destination. */
+  ARG_R16, /* BC, DE, HL, SP, AF numbered 0 to 4. */
+  ARG_MEM_SP, /* (SP) for ex (sp),hl */
+  ARG_IMMEDIATE,
+  ARG_CONDITION, /* NZ, Z, NC, C, PO, PE, P, M numbered 0 to 7. */
+  ARG_LABEL /* Value is the instruction index. */
+} ArgumentType;
+
+#define REG_B 0
+#define REG_C 1
+#define REG_D 2
+#define REG_E 3
+#define REG_H 4
+#define REG_L 5
+#define REG_MEM_HL 6
+#define REG_A 7
+
+#define RP_BC 0
+#define RP_DE 1
+#define RP_HL 2
+#define RP_SP 3
+#define RP_AF 4
+
+#define FLAG_S 0x80
+#define FLAG_Z 0x40
+#define FLAG_H 0x10
+#define FLAG_PV 0x04
+#define FLAG_N 0x02
+#define FLAG_C 0x01
+
+typedef struct InstructionStruct {
+  OpcodeType opcode;
+  ArgumentType kind[2];
+  int value[2];
+  int lineNumber;
+} *InstructionPointer;
+
+#define MAX_ROUTINES 16
+#define MAX_ROUTINE_NAME 32
+#define MAX_INSTRUCTIONS 128
+#define MAX_LABELS 16
+
+typedef struct RoutineStruct {
+  char name[MAX_ROUTINE_NAME];
+  bool returnsZero; /* C "return 0;" after the assembler, else void. */
+  int instructionCount;
+  struct InstructionStruct instructions[MAX_INSTRUCTIONS];
+  char labelNames[MAX_LABELS][MAX_ROUTINE_NAME];
+  int labelTargets[MAX_LABELS];
+  int labelCount;
+  long callCount;
+  long minTStates;
+  long maxTStates;
+  double totalTStates;
+  double totalOverheadTStates; /* Getting the arguments and returning. */
+  int pointerCount; /* Arguments the caller pushed, as seen in the last call. */
+  bool byteArgument;
+} *RoutinePointer;
+
+static struct RoutineStruct s_Routines[MAX_ROUTINES];
+static int s_RoutineCount;
+static const char *s_SourcePath;
+
+/* Emulated machine state. */
+static uint8_t s_Memory[65536];
+static uint8_t s_Reg[8]; /* Index REG_MEM_HL isn't used, see ReadR8(). */
+static uint8_t s_Flags;
+static uint16_t s_SP;
+static long s_TStates;
+static long s_ArgumentTStates; /* Time before touching fx data, -1 if not yet. */
+static long s_ReturnTStates; /* Time taken by the instruction that returned. */
+static double s_AllTStates; /* Total for all routines run so far. */
+static long s_AllCalls;
+
+#define STACK_TOP 0xF000
+#define RETURN_ADDRESS 0xBEEF /* Fake caller, returning to it ends a run. */
+#define FX_DATA_ADDRESS 0x8000 /* Where the fx arguments get copied to. */
+#define MAX_RUN_INSTRUCTIONS 100000 /* Catches infinite loops. */
+
+
+/*******************************************************************************
+ * Print an error about the assembler source and exit, since there's no point
+ * testing code we can't run.
+ */
+static void SourceError(int lineNumber, const char *message, const char *text)
+{
+  fprintf(stderr, "%s:%d: %s \"%s\".\n", s_SourcePath, lineNumber, message,
+    text);
+  exit(2);
+}
+
+
+/*******************************************************************************
+ * Decode one operand, in lower case with spaces removed.  Conditions are only
+ * allowed where the instruction takes them, to tell C the condition from C
+ * the register.
+ */
+static void DecodeArgument(RoutinePointer pRoutine, char *text,
+  bool conditionAllowed, ArgumentType *pKind, int *pValue, int lineNumber)
+{
+  static const char *kR8Names[8] = {"b", "c", "d", "e", "h", "l", "(hl)", "a"};
+  static const char *kR16Names[5] = {"bc", "de", "hl", "sp", "af"};
+  static const char *kConditionNames[8] =
+    {"nz", "z", "nc", "c", "po", "pe", "p", "m"};
+  char lowerText[MAX_ROUTINE_NAME];
+  char *pEnd;
+  long number;
+  int i;
+
+  for (i = 0; text[i] != 0 && i < MAX_ROUTINE_NAME - 1; i++)
+    lowerText[i] = tolower(text[i]);
+  lowerText[i] = 0;
+
+  if (conditionAllowed)
+  {
+    for (i = 0; i < 8; i++)
+    {
+      if (strcmp(lowerText, kConditionNames[i]) == 0)
+      {
+        *pKind = ARG_CONDITION;
+        *pValue = i;
+        return;
+      }
+    }
+  }
+  for (i = 0; i < 8; i++)
+  {
+    if (strcmp(lowerText, kR8Names[i]) == 0)
+    {
+      *pKind = ARG_R8;
+      *pValue = i;
+      return;
+    }
+  }
+  for (i = 0; i < 5; i++)
+  {
+    if (strcmp(lowerText, kR16Names[i]) == 0)
+    {
+      *pKind = ARG_R16;
+      *pValue = i;
+      return;
+    }
+  }
+  if (strcmp(lowerText, "(bc)") == 0)
+  {
+    *pKind = ARG_MEM_BC;
+    return;
+  }
+  if (strcmp(lowerText, "(de)") == 0)
+  {
+    *pKind = ARG_MEM_DE;
+    return;
+  }
+  if (strcmp(lowerText, "(sp)") == 0)
+  {
+    *pKind = ARG_MEM_SP;
+    return;
+  }
+
+  /* Numbers can be decimal, 0x hex, $ or # hex, or hex with a trailing h. */
+  pEnd = NULL;
+  if (lowerText[0] == '$')
+    number = strtol(lowerText + 1, &pEnd, 16);
+  else if (lowerText[0] == '#')
+    number = strtol(lowerText + 1, &pEnd, 0);
+  else if (isdigit(lowerText[0]) || lowerText[0] == '-')
+  {
+    number = strtol(lowerText, &pEnd, 0);
+    if (*pEnd != 0 && lowerText[strlen(lowerText) - 1] == 'h')
+    {
+      number = strtol(lowerText, &pEnd, 16);
+      if (*pEnd == 'h')
+        pEnd++;
+    }
+  }
+  if (pEnd != NULL)
+  {
+    if (*pEnd != 0)
+      SourceError(lineNumber, "Bad number", text);
+    *pKind = ARG_IMMEDIATE;
+    *pValue = number & 0xFFFF;
+    return;
+  }
+
+  /* Anything else had better be a label, resolved after reading them all. */
+  for (i = 0; i < pRoutine->labelCount; i++)
+  {
+    if (strcmp(pRoutine->labelNames[i], text) == 0)
+      break;
+  }
+  if (i >= pRoutine->labelCount)
+  {
+    if (i >= MAX_LABELS || strlen(text) >= MAX_ROUTINE_NAME)
+      SourceError(lineNumber, "Too many or too long labels at", text);
+    strcpy(pRoutine->labelNames[i], text);
+    pRoutine->labelTargets[i] = -1;
+    pRoutine->labelCount++;
+  }
+  *pKind = ARG_LABEL;
+  *pValue = i; /* Label number for now, instruction index later. */
+}
+
+
+/*******************************************************************************
+ * Decode one line of assembler into the next instruction of the routine.
+ */
+static void DecodeLine(RoutinePointer pRoutine, char *line, int lineNumber)
+{
+  InstructionPointer pInstruction;
+  char *pChar;
+  char *pComment;
+  char *pColon;
+  char *arguments[2];
+  char mnemonic[8];
+  ArgumentType labelKind;
+  int argumentCount = 0;
+  int opcode;
+  int i;
+
+  /* Remove comments and all spaces. */
+  while ((pComment = strstr(line, "/*")) != NULL)
+  {
+    pChar = strstr(pComment, "*/");
+    if (pChar == NULL)
+      SourceError(lineNumber, "Comment needs to end on the same line", line);
+    memmove(pComment, pChar + 2, strlen(pChar + 2) + 1);
+  }
+  pComment = strchr(line, ';');
+  if (pComment != NULL)
+    *pComment = 0;
+
+  /* Labels end with a colon, and can be followed by an instruction. */
+  pColon = strchr(line, ':');
+  if (pColon != NULL)
+  {
+    *pColon = 0;
+    for (pChar = line; isspace(*pChar); pChar++)
+      ;
+    DecodeArgument(pRoutine, pChar, false, &labelKind, &i, lineNumber);
+    if (labelKind != ARG_LABEL)
+      SourceError(lineNumber, "Bad label", pChar);
+    pRoutine->labelTargets[i] = pRoutine->instructionCount;
+    line = pColon + 1;
+  }
+
+  /* Split off the mnemonic, then squeeze out spaces from the arguments. */
+  while (isspace(*line))
+    line++;
+  if (*line == 0)
+    return;
+  for (i = 0; *line != 0 && !isspace(*line); line++)
+  {
+    if (i < (int) sizeof(mnemonic) - 1)
+      mnemonic[i++] = tolower(*line);
+  }
+  mnemonic[i] = 0;
+  for (pChar = line, i = 0; line[i] != 0; i++)
+  {
+    if (!isspace(line[i]))
+      *pChar++ = line[i];
+  }
+  *pChar = 0;
+  if (*line != 0)
+  {
+    arguments[argumentCount++] = line;
+    pChar = strchr(line, ',');
+    if (pChar != NULL)
+    {
+      *pChar = 0;
+      arguments[argumentCount++] = pChar + 1;
+      if (strchr(pChar + 1, ',') != NULL)
+        SourceError(lineNumber, "Too many arguments", mnemonic);
+    }
+  }
+
+  for (opcode = 0; opcode < OP_MAX; opcode++)
+  {
+    if (strcmp(mnemonic, kOpcodeNames[opcode]) == 0)
+      break;
+  }
+  if (opcode >= OP_MAX)
+    SourceError(lineNumber, "Emulator doesn't know instruction", mnemonic);
+  if (pRoutine->instructionCount >= MAX_INSTRUCTIONS)
+    SourceError(lineNumber, "Too many instructions in", pRoutine->name);
+
+  pInstruction = pRoutine->instructions + pRoutine->instructionCount++;
+  memset(pInstruction, 0, sizeof(*pInstruction));
+  pInstruction->opcode = opcode;
+  pInstruction->lineNumber = lineNumber;
+  for (i = 0; i < argumentCount; i++)
+  {
+    DecodeArgument(pRoutine, arguments[i],
+      i == 0 && (opcode == OP_JP || opcode == OP_JR || opcode == OP_RET) &&
+      (argumentCount == 2 || opcode == OP_RET),
+      pInstruction->kind + i, pInstruction->value + i, lineNumber);
+    if (strcmp(arguments[i], "(hl)") == 0 && opcode == OP_JP)
+      pInstruction->kind[i] = ARG_MEM_HL16;
+  }
+
+  /* Sort out the instructions that share a mnemonic, and the optional A
+     in "sub a,(hl)" style arithmetic. */
+  if (opcode == OP_EX_DE_HL && pInstruction->kind[0] == ARG_MEM_SP)
+    pInstruction->opcode = OP_EX_SP_HL;
+  else if ((opcode == OP_ADD || opcode == OP_ADC || opcode == OP_SBC) &&
+  pInstruction->kind[0] == ARG_R16)
+    pInstruction->opcode = (opcode == OP_ADD) ? OP_ADD16 :
+      (opcode == OP_ADC) ? OP_ADC16 : OP_SBC16;
+  else if (opcode >= OP_ADD && opcode <= OP_CP && argumentCount == 2)
+  {
+    if (pInstruction->kind[0] != ARG_R8 || pInstruction->value[0] != REG_A)
+      SourceError(lineNumber, "Arithmetic has to be on A for", mnemonic);
+    pInstruction->kind[0] = pInstruction->kind[1];
+    pInstruction->value[0] = pInstruction->value[1];
+    pInstruction->kind[1] = ARG_NONE;
+  }
+}
+
+
+/*******************************************************************************
+ * Read the *_ASM routines out of fixed_point.c.  Each one is the function
+ * name line, the assembler between __asm and __endasm, and maybe a return 0.
+ */
+static void ReadRoutines(const char *sourcePath)
+{
+  char line[256];
+  char *pName;
+  char *pEnd;
+  int lineNumber = 0;
+  bool inAssembler = false;
+  RoutinePointer pRoutine = NULL;
+  FILE *sourceFile;
+  int i;
+
+  s_SourcePath = sourcePath;
+  sourceFile = fopen(sourcePath, "r");
+  if (sourceFile == NULL)
+  {
+    perror(sourcePath);
+    exit(2);
+  }
+
+  while (fgets(line, sizeof(line), sourceFile) != NULL)
+  {
+    lineNumber++;
+    line[strcspn(line, "\r\n")] = 0;
+    for (pName = line; isspace(*pName); pName++)
+      ;
+
+    if (inAssembler)
+    {
+      if (strncmp(pName, "__endasm", 8) == 0)
+        inAssembler = false;
+      else
+        DecodeLine(pRoutine, line, lineNumber);
+    }
+    else if (strcmp(pName, "__asm") == 0 && pRoutine != NULL)
+      inAssembler = true;
+    else if (strncmp(pName, "return 0;", 9) == 0 && pRoutine != NULL)
+      pRoutine->returnsZero = true;
+    else if (isalpha(line[0]) && strstr(line, "_ASM(") != NULL &&
+    strchr(line, ';') == NULL)
+    {
+      pEnd = strstr(line, "_ASM(") + 4;
+      for (pName = pEnd; pName > line && !isspace(pName[-1]); pName--)
+        ;
+      if (s_RoutineCount >= MAX_ROUTINES || pEnd - pName >= MAX_ROUTINE_NAME)
+        SourceError(lineNumber, "Too many or too long routines at", line);
+      pRoutine = s_Routines + s_RoutineCount++;
+      memcpy(pRoutine->name, pName, pEnd - pName);
+      pRoutine->name[pEnd - pName] = 0;
+      pRoutine->minTStates = 0x7FFFFFFF;
+    }
+    else if (line[0] == '}')
+      pRoutine = NULL;
+  }
+  fclose(sourceFile);
+
+  /* Turn label numbers into instruction indices. */
+  for (pRoutine = s_Routines; pRoutine < s_Routines + s_RoutineCount;
+  pRoutine++)
+  {
+    for (i = 0; i < pRoutine->instructionCount; i++)
+    {
+      InstructionPointer pInstruction = pRoutine->instructions + i;
+      int argument;
+      for (argument = 0; argument < 2; argument++)
+      {
+        if (pInstruction->kind[argument] != ARG_LABEL)
+          continue;
+        if (pRoutine->labelTargets[pInstruction->value[argument]] < 0)
+          SourceError(pInstruction->lineNumber, "Undefined label",
+            pRoutine->labelNames[pInstruction->value[argument]]);
+        pInstruction->value[argument] =
+          pRoutine->labelTargets[pInstruction->value[argument]];
+      }
+    }
+  }
+}
+
+
+/*******************************************************************************
+ * Find a routine by name, exits if it isn't there.
+ */
+static RoutinePointer FindRoutine(const char *name)
+{
+  int i;
+
+  for (i = 0; i < s_RoutineCount; i++)
+  {
+    if (strcmp(s_Routines[i].name, name) == 0)
+      return s_Routines + i;
+  }
+  fprintf(stderr, "Can't find %s in %s.\n", name, s_SourcePath);
+  exit(2);
+}
+
+
+/*******************************************************************************
+ * Register and flag helpers.
+ */
+static uint16_t GetPair(int pair)
+{
+  switch (pair)
+  {
+    case RP_BC: return (s_Reg[REG_B] << 8) | s_Reg[REG_C];
+    case RP_DE: return (s_Reg[REG_D] << 8) | s_Reg[REG_E];
+    case RP_HL: return (s_Reg[REG_H] << 8) | s_Reg[REG_L];
+    case RP_SP: return s_SP;
+    default: return (s_Reg[REG_A] << 8) | s_Flags;
+  }
+}
+
+static void SetPair(int pair, uint16_t value)
+{
+  switch (pair)
+  {
+    case RP_BC: s_Reg[REG_B] = value >> 8; s_Reg[REG_C] = value; break;
+    case RP_DE: s_Reg[REG_D] = value >> 8; s_Reg[REG_E] = value; break;
+    case RP_HL: s_Reg[REG_H] = value >> 8; s_Reg[REG_L] = value; break;
+    case RP_SP: s_SP = value; break;
+    default: s_Reg[REG_A] = value >> 8; s_Flags = value; break;
+  }
+}
+
+static void PushWord(uint16_t value)
+{
+  s_Memory[--s_SP] = value >> 8;
+  s_Memory[--s_SP] = value;
+}
+
+static uint16_t PopWord(void)
+{
+  uint16_t value = s_Memory[s_SP++];
+  return value | (s_Memory[s_SP++] << 8);
+}
+
+/* Memory address used by an instruction, noting when the routine is done
+   with fetching its arguments and first uses the fx data. */
+static uint16_t DataAddress(uint16_t address)
+{
+  if (s_ArgumentTStates < 0 && address >= FX_DATA_ADDRESS &&
+  address < FX_DATA_ADDRESS + 3 * 4)
+    s_ArgumentTStates = s_TStates;
+  return address;
+}
+
+static uint8_t ReadR8(ArgumentType kind, int value)
+{
+  switch (kind)
+  {
+    case ARG_R8:
+      return (value == REG_MEM_HL) ?
+        s_Memory[DataAddress(GetPair(RP_HL))] : s_Reg[value];
+    case ARG_MEM_BC: return s_Memory[DataAddress(GetPair(RP_BC))];
+    case ARG_MEM_DE: return s_Memory[DataAddress(GetPair(RP_DE))];
+    default: return value; /* Immediate. */
+  }
+}
+
+static void WriteR8(ArgumentType kind, int value, uint8_t data)
+{
+  switch (kind)
+  {
+    case ARG_R8:
+      if (value == REG_MEM_HL)
+        s_Memory[DataAddress(GetPair(RP_HL))] = data;
+      else
+        s_Reg[value] = data;
+      break;
+    case ARG_MEM_BC: s_Memory[DataAddress(GetPair(RP_BC))] = data; break;
+    case ARG_MEM_DE: s_Memory[DataAddress(GetPair(RP_DE))] = data; break;
+    default: break;
+  }
+}
+
+/* Sign, zero and parity flags for a logical or shift result. */
+static uint8_t LogicFlags(uint8_t result)
+{
+  uint8_t flags = result & FLAG_S;
+  uint8_t parity = result;
+
+  if (result == 0)
+    flags |= FLAG_Z;
+  parity ^= parity >> 4;
+  parity ^= parity >> 2;
+  parity ^= parity >> 1;
+  if ((parity & 1) == 0)
+    flags |= FLAG_PV;
+  return flags;
+}
+
+/* Eight bit add or subtract with carry, setting all the flags. */
+static uint8_t AddSub8(uint8_t a, uint8_t b, int carry, bool subtract)
+{
+  int result;
+  uint8_t flags;
+
+  if (subtract)
+  {
+    result = a - b - carry;
+    flags = FLAG_N;
+    if (result < 0)
+      flags |= FLAG_C;
+    if ((a & 0x0F) - (b & 0x0F) - carry < 0)
+      flags |= FLAG_H;
+    if ((a ^ b) & (a ^ result) & 0x80)
+      flags |= FLAG_PV;
+  }
+  else
+  {
+    result = a + b + carry;
+    flags = 0;
+    if (result > 0xFF)
+      flags |= FLAG_C;
+    if ((a & 0x0F) + (b & 0x0F) + carry > 0x0F)
+      flags |= FLAG_H;
+    if (~(a ^ b) & (a ^ result) & 0x80)
+      flags |= FLAG_PV;
+  }
+  flags |= result & FLAG_S;
+  if ((result & 0xFF) == 0)
+    flags |= FLAG_Z;
+  s_Flags = flags;
+  return result;
+}
+
+static bool ConditionTrue(int condition)
+{
+  static const uint8_t kConditionFlags[4] = {FLAG_Z, FLAG_C, FLAG_PV, FLAG_S};
+  bool flagSet = (s_Flags & kConditionFlags[condition >> 1]) != 0;
+  return (condition & 1) ? flagSet : !flagSet;
+}
+
+
+/*******************************************************************************
+ * Run a routine until it returns to RETURN_ADDRESS, adding up the T-states.
+ */
+static void RunRoutine(RoutinePointer pRoutine)
+{
+  InstructionPointer pInstruction;
+  ArgumentType kind0, kind1;
+  int value0, value1;
+  int pc = 0;
+  long runCount = 0;
+  uint8_t data;
+  uint8_t carry;
+  uint16_t word;
+  int result;
+
+  s_TStates = 0;
+  s_ArgumentTStates = -1;
+  while (true)
+  {
+    if (++runCount > MAX_RUN_INSTRUCTIONS)
+    {
+      fprintf(stderr, "%s seems to be stuck in a loop.\n", pRoutine->name);
+      exit(2);
+    }
+
+    if (pc >= pRoutine->instructionCount)
+    { /* Fell off the end into the C compiler's code, return 0 or void. */
+      if (pRoutine->returnsZero)
+      {
+        s_Reg[REG_L] = 0;
+        s_TStates += 7;
+      }
+      word = PopWord();
+      s_ReturnTStates = 10;
+      s_TStates += 10;
+      goto Returned;
+    }
+
+    pInstruction = pRoutine->instructions + pc++;
+    kind0 = pInstruction->kind[0];
+    kind1 = pInstruction->kind[1];
+    value0 = pInstruction->value[0];
+    value1 = pInstruction->value[1];
+    switch (pInstruction->opcode)
+    {
+      case OP_LD:
+        if (kind0 == ARG_R16)
+        {
+          if (kind1 == ARG_IMMEDIATE)
+          {
+            SetPair(value0, value1);
+            s_TStates += 10;
+          }
+          else
+          { /* ld sp,hl */
+            SetPair(value0, GetPair(value1));
+            s_TStates += 6;
+          }
+          break;
+        }
+        WriteR8(kind0, value0, ReadR8(kind1, value1));
+        if (kind0 == ARG_R8 && kind1 == ARG_R8 &&
+        value0 != REG_MEM_HL && value1 != REG_MEM_HL)
+          s_TStates += 4;
+        else if (kind0 == ARG_R8 && value0 == REG_MEM_HL &&
+        kind1 == ARG_IMMEDIATE)
+          s_TStates += 10;
+        else
+          s_TStates += 7;
+        break;
+
+      case OP_PUSH:
+        PushWord(GetPair(value0));
+        s_TStates += 11;
+        break;
+
+      case OP_POP:
+        SetPair(value0, PopWord());
+        s_TStates += 10;
+        break;
+
+      case OP_EX_DE_HL:
+        word = GetPair(RP_DE);
+        SetPair(RP_DE, GetPair(RP_HL));
+        SetPair(RP_HL, word);
+        s_TStates += 4;
+        break;
+
+      case OP_EX_SP_HL:
+        word = s_Memory[s_SP] | (s_Memory[(uint16_t) (s_SP + 1)] << 8);
+        s_Memory[s_SP] = s_Reg[REG_L];
+        s_Memory[(uint16_t) (s_SP + 1)] = s_Reg[REG_H];
+        SetPair(RP_HL, word);
+        s_TStates += 19;
+        break;
+
+      case OP_ADD:
+      case OP_ADC:
+      case OP_SUB:
+      case OP_SBC:
+      case OP_CP:
+        data = ReadR8(kind0, value0);
+        carry = (pInstruction->opcode == OP_ADC ||
+          pInstruction->opcode == OP_SBC) ? (s_Flags & FLAG_C) : 0;
+        result = AddSub8(s_Reg[REG_A], data, carry,
+          pInstruction->opcode != OP_ADD && pInstruction->opcode != OP_ADC);
+        if (pInstruction->opcode != OP_CP)
+          s_Reg[REG_A] = result;
+        s_TStates += (kind0 == ARG_R8 && value0 != REG_MEM_HL) ? 4 : 7;
+        break;
+
+      case OP_AND:
+      case OP_XOR:
+      case OP_OR:
+        data = ReadR8(kind0, value0);
+        if (pInstruction->opcode == OP_AND)
+          s_Reg[REG_A] &= data;
+        else if (pInstruction->opcode == OP_XOR)
+          s_Reg[REG_A] ^= data;
+        else
+          s_Reg[REG_A] |= data;
+        s_Flags = LogicFlags(s_Reg[REG_A]) |
+          ((pInstruction->opcode == OP_AND) ? FLAG_H : 0);
+        s_TStates += (kind0 == ARG_R8 && value0 != REG_MEM_HL) ? 4 : 7;
+        break;
+
+      case OP_INC:
+      case OP_DEC:
+        if (kind0 == ARG_R16)
+        {
+          SetPair(value0, GetPair(value0) +
+            ((pInstruction->opcode == OP_INC) ? 1 : -1));
+          s_TStates += 6;
+          break;
+        }
+        carry = s_Flags & FLAG_C;
+        data = AddSub8(ReadR8(kind0, value0), 1, 0,
+          pInstruction->opcode == OP_DEC);
+        s_Flags = (s_Flags & ~FLAG_C) | carry; /* Carry isn't changed. */
+        WriteR8(kind0, value0, data);
+        s_TStates += (value0 == REG_MEM_HL) ? 11 : 4;
+        break;
+
+      case OP_ADD16:
+      case OP_ADC16:
+      case OP_SBC16:
+        word = GetPair(value1);
+        carry = (pInstruction->opcode == OP_ADD16) ? 0 : (s_Flags & FLAG_C);
+        if (pInstruction->opcode == OP_SBC16)
+        {
+          result = GetPair(RP_HL) - word - carry;
+          s_Flags = FLAG_N | ((result < 0) ? FLAG_C : 0) |
+            ((result >> 8) & FLAG_S) | ((result & 0xFFFF) ? 0 : FLAG_Z) |
+            (((GetPair(RP_HL) ^ word) & (GetPair(RP_HL) ^ result) & 0x8000) ?
+            FLAG_PV : 0);
+        }
+        else
+        {
+          result = GetPair(RP_HL) + word + carry;
+          if (pInstruction->opcode == OP_ADD16) /* S, Z, PV unchanged. */
+            s_Flags = (s_Flags & (FLAG_S | FLAG_Z | FLAG_PV)) |
+              ((result > 0xFFFF) ? FLAG_C : 0);
+          else
+            s_Flags = ((result > 0xFFFF) ? FLAG_C : 0) |
+              ((result >> 8) & FLAG_S) | ((result & 0xFFFF) ? 0 : FLAG_Z) |
+              ((~(GetPair(RP_HL) ^ word) & (GetPair(RP_HL) ^ result) &
+              0x8000) ? FLAG_PV : 0);
+        }
+        SetPair(RP_HL, result);
+        s_TStates += (pInstruction->opcode == OP_ADD16) ? 11 : 15;
+        break;
+
+      case OP_RLC:
+      case OP_RRC:
+      case OP_RL:
+      case OP_RR:
+      case OP_SLA:
+      case OP_SRA:
+      case OP_SRL:
+      case OP_RLCA:
+      case OP_RRCA:
+      case OP_RLA:
+      case OP_RRA:
+        if (pInstruction->opcode >= OP_RLCA)
+        {
+          kind0 = ARG_R8;
+          value0 = REG_A;
+        }
+        data = ReadR8(kind0, value0);
+        carry = s_Flags & FLAG_C;
+        switch (pInstruction->opcode)
+        {
+          case OP_RLC: case OP_RLCA:
+            carry = data >> 7; data = (data << 1) | carry; break;
+          case OP_RRC: case OP_RRCA:
+            carry = data & 1; data = (data >> 1) | (carry << 7); break;
+          case OP_RL: case OP_RLA:
+            result = data >> 7; data = (data << 1) | carry; carry = result;
+            break;
+          case OP_RR: case OP_RRA:
+            result = data & 1; data = (data >> 1) | (carry << 7);
+            carry = result; break;
+          case OP_SLA: carry = data >> 7; data <<= 1; break;
+          case OP_SRA: carry = data & 1; data = (data >> 1) | (data & 0x80);
+            break;
+          default: carry = data & 1; data >>= 1; break; /* OP_SRL */
+        }
+        WriteR8(kind0, value0, data);
+        if (pInstruction->opcode >= OP_RLCA) /* Only carry changes. */
+        {
+          s_Flags = (s_Flags & (FLAG_S | FLAG_Z | FLAG_PV)) | carry;
+          s_TStates += 4;
+        }
+        else
+        {
+          s_Flags = LogicFlags(data) | carry;
+          s_TStates += (value0 == REG_MEM_HL) ? 15 : 8;
+        }
+        break;
+
+      case OP_NEG:
+        s_Reg[REG_A] = AddSub8(0, s_Reg[REG_A], 0, true);
+        s_TStates += 8;
+        break;
+
+      case OP_CPL:
+        s_Reg[REG_A] = ~s_Reg[REG_A];
+        s_Flags |= FLAG_H | FLAG_N;
+        s_TStates += 4;
+        break;
+
+      case OP_SCF:
+        s_Flags = (s_Flags & (FLAG_S | FLAG_Z | FLAG_PV)) | FLAG_C;
+        s_TStates += 4;
+        break;
+
+      case OP_CCF:
+        s_Flags = (s_Flags & (FLAG_S | FLAG_Z | FLAG_PV)) |
+          ((s_Flags & FLAG_C) ? FLAG_H : FLAG_C);
+        s_TStates += 4;
+        break;
+
+      case OP_NOP:
+        s_TStates += 4;
+        break;
+
+      case OP_JP:
+        if (kind0 == ARG_MEM_HL16)
+        {
+          word = GetPair(RP_HL);
+          s_ReturnTStates = 4;
+          s_TStates += 4;
+          goto Returned; /* Only used for returning, can't go elsewhere. */
+        }
+        if (kind0 == ARG_CONDITION)
+        {
+          if (ConditionTrue(value0))
+            pc = value1;
+        }
+        else
+          pc = value0;
+        s_TStates += 10;
+        break;
+
+      case OP_JR:
+        if (kind0 == ARG_CONDITION && !ConditionTrue(value0))
+          s_TStates += 7;
+        else
+        {
+          pc = (kind0 == ARG_CONDITION) ? value1 : value0;
+          s_TStates += 12;
+        }
+        break;
+
+      case OP_DJNZ:
+        if (--s_Reg[REG_B] != 0)
+        {
+          pc = value0;
+          s_TStates += 13;
+        }
+        else
+          s_TStates += 8;
+        break;
+
+      case OP_RET:
+        if (kind0 == ARG_CONDITION)
+        {
+          if (!ConditionTrue(value0))
+          {
+            s_TStates += 5;
+            break;
+          }
+          s_TStates += 1;
+        }
+        word = PopWord();
+        s_ReturnTStates = (kind0 == ARG_CONDITION) ? 11 : 10;
+        s_TStates += 10;
+        goto Returned;
+
+      default:
+        SourceError(pInstruction->lineNumber, "Can't run instruction",
+          "?");
+    }
+  }
+
+Returned:
+  if (word != RETURN_ADDRESS)
+  {
+    fprintf(stderr, "%s returned to $%04X rather than the caller.\n",
+      pRoutine->name, word);
+    exit(2);
+  }
+  pRoutine->callCount++;
+  pRoutine->totalTStates += s_TStates;
+  if (s_ArgumentTStates < 0)
+    s_ArgumentTStates = 0;
+  pRoutine->totalOverheadTStates += s_ArgumentTStates + s_ReturnTStates;
+  s_AllCalls++;
+  s_AllTStates += s_TStates;
+  if (s_TStates < pRoutine->minTStates)
+    pRoutine->minTStates = s_TStates;
+  if (s_TStates > pRoutine->maxTStates)
+    pRoutine->maxTStates = s_TStates;
+}
+
+
+/*******************************************************************************
+ * Call a routine the way SDCC does: arguments pushed right to left (a byte
+ * argument takes one byte of stack), then the return address.  The fx
+ * arguments get copied into emulated memory, at the same address if they are
+ * the same variable, and copied back afterwards.  Returns register L.
+ */
+static pfx s_MappedPointers[3];
+static int s_MappedCount;
+static uint64_t s_Junk;
+
+static uint16_t MapFx(pfx pHost)
+{
+  int i;
+
+  for (i = 0; i < s_MappedCount; i++)
+  {
+    if (s_MappedPointers[i] == pHost)
+      return FX_DATA_ADDRESS + i * 4;
+  }
+  s_MappedPointers[s_MappedCount] = pHost;
+  memcpy(s_Memory + FX_DATA_ADDRESS + s_MappedCount * 4, pHost, sizeof(fx));
+  return FX_DATA_ADDRESS + s_MappedCount++ * 4;
+}
+
+static uint8_t CallRoutine(RoutinePointer pRoutine, pfx x, pfx y, pfx z,
+  int byteArgument)
+{
+  uint16_t arguments[3];
+  int argumentCount = 0;
+  uint16_t stackAfterCall;
+  int i;
+
+  s_MappedCount = 0;
+  arguments[argumentCount++] = MapFx(x);
+  if (y != NULL)
+    arguments[argumentCount++] = MapFx(y);
+  if (z != NULL)
+    arguments[argumentCount++] = MapFx(z);
+
+  /* Junk in the registers, so the routine can't depend on leftovers. */
+  s_Junk = s_Junk * 1103515245 + 12345;
+  memcpy(s_Reg, &s_Junk, sizeof(s_Junk));
+  s_Flags = s_Junk >> 37;
+
+  s_SP = STACK_TOP;
+  if (byteArgument >= 0)
+    s_Memory[--s_SP] = byteArgument;
+  for (i = argumentCount - 1; i >= 0; i--)
+    PushWord(arguments[i]);
+  stackAfterCall = s_SP;
+  PushWord(RETURN_ADDRESS);
+
+  pRoutine->pointerCount = argumentCount;
+  pRoutine->byteArgument = (byteArgument >= 0);
+  RunRoutine(pRoutine);
+
+  if (s_SP != stackAfterCall)
+  {
+    fprintf(stderr, "%s left the stack unbalanced by %d bytes.\n",
+      pRoutine->name, s_SP - stackAfterCall);
+    exit(2);
+  }
+  for (i = 0; i < s_MappedCount; i++)
+    memcpy(s_MappedPointers[i], s_Memory + FX_DATA_ADDRESS + i * 4,
+      sizeof(fx));
+  return s_Reg[REG_L];
+}
+
+
+/*******************************************************************************
+ * T-states the caller spends on a call, the way SDCC does it with global fx
+ * variables: load each address and push it, call, then pop the arguments off
+ * the stack.  Pointers that have to be calculated (player fields) cost more.
+ * The emulator doesn't do CALL, so the snippet runs off its end instead,
+ * which counts as a 10 T-state RET, and a CALL is 17.
+ */
+static long CallerTStates(int pointerCount, bool byteArgument)
+{
+  static struct RoutineStruct caller;
+  char line[32];
+  int i;
+
+  memset(&caller, 0, sizeof(caller));
+  strcpy(caller.name, "Caller");
+  caller.minTStates = 0x7FFFFFFF;
+  if (byteArgument)
+  {
+    strcpy(line, "ld a,1"); DecodeLine(&caller, line, 0);
+    strcpy(line, "push af"); DecodeLine(&caller, line, 0);
+    strcpy(line, "inc sp"); DecodeLine(&caller, line, 0);
+  }
+  for (i = 0; i < pointerCount; i++)
+  {
+    sprintf(line, "ld hl,%d", FX_DATA_ADDRESS + i * 4);
+    DecodeLine(&caller, line, 0);
+    strcpy(line, "push hl"); DecodeLine(&caller, line, 0);
+  }
+  for (i = 0; i < pointerCount; i++)
+  {
+    strcpy(line, "pop af"); DecodeLine(&caller, line, 0);
+  }
+  if (byteArgument)
+  {
+    strcpy(line, "inc sp"); DecodeLine(&caller, line, 0);
+  }
+
+  s_SP = STACK_TOP;
+  PushWord(RETURN_ADDRESS);
+  RunRoutine(&caller);
+  return s_TStates - 10 + 17;
+}
+
+
+/*******************************************************************************
+ * The *_ASM functions that fixed_point.h declares, run in the emulator.
+ */
+static RoutinePointer s_NegateRoutine;
+static RoutinePointer s_CopyNegateRoutine;
+static RoutinePointer s_AddRoutine;
+static RoutinePointer s_SubtractRoutine;
+static RoutinePointer s_CompareRoutine;
+static RoutinePointer s_TestRoutine;
+static RoutinePointer s_Div2Routine;
+static RoutinePointer s_Div2NthRoutine;
+
+void NEGATE_FX_ASM(pfx x)
+{
+  CallRoutine(s_NegateRoutine, x, NULL, NULL, -1);
+}
+
+void COPY_NEGATE_FX_ASM(pfx x, pfx y)
+{
+  CallRoutine(s_CopyNegateRoutine, x, y, NULL, -1);
+}
+
+void ADD_FX_ASM(pfx x, pfx y, pfx z)
+{
+  CallRoutine(s_AddRoutine, x, y, z, -1);
+}
+
+void SUBTRACT_FX_ASM(pfx x, pfx y, pfx z)
+{
+  CallRoutine(s_SubtractRoutine, x, y, z, -1);
+}
+
+int8_t COMPARE_FX_ASM(pfx x, pfx y)
+{
+  return CallRoutine(s_CompareRoutine, x, y, NULL, -1);
+}
+
+int8_t TEST_FX_ASM(pfx x)
+{
+  return CallRoutine(s_TestRoutine, x, NULL, NULL, -1);
+}
+
+void DIV2_FX_ASM(pfx x)
+{
+  CallRoutine(s_Div2Routine, x, NULL, NULL, -1);
+}
+
+void DIV2Nth_FX_ASM(pfx x, uint8_t n)
+{
+  CallRoutine(s_Div2NthRoutine, x, NULL, NULL, n);
+}
+
+
+/*******************************************************************************
+ * The expected answers, same as the generic 16.16 versions of the macros in
+ * fixed_point.h would give, but done on 24 bit (16.8) values held in a plain
+ * integer, including the wrap around at the ends of the range.
+ */
+#define FX24_MIN (-0x800000)
+#define FX24_MAX 0x7FFFFF
+
+static int32_t Wrap24(int32_t value)
+{
+  value &= 0xFFFFFF;
+  return (value & 0x800000) ? value - 0x1000000 : value;
+}
+
+static int32_t FxToInt(fx value)
+{
+  return value.portions.integer * 256 + value.portions.fraction;
+}
+
+static fx IntToFx(int32_t value)
+{
+  fx result;
+  INT_FRACTION_TO_FX((int16_t) (value >> 8), value & 0xFF, result);
+  return result;
+}
+
+static int8_t Sign(int32_t value)
+{
+  return (value < 0) ? -1 : (value == 0) ? 0 : 1;
+}
+
+/* Octant of a vector, working from the exact absolute values. */
+static uint8_t ExpectedOctant(int32_t x, int32_t y)
+{
+  int8_t delta;
+
+  if (x == 0)
+    return (y == 0) ? 0 : (y > 0) ? 0x82 : 0x86;
+  if (y == 0)
+    return (x > 0) ? 0x80 : 0x84;
+  delta = Sign(labs(x) - labs(y));
+  if (x > 0 && y > 0)
+    return (delta > 0) ? 0 : (delta == 0) ? 0x81 : 1;
+  if (x > 0)
+    return (delta > 0) ? 7 : (delta == 0) ? 0x87 : 6;
+  if (y > 0)
+    return (delta > 0) ? 3 : (delta == 0) ? 0x83 : 2;
+  return (delta > 0) ? 4 : (delta == 0) ? 0x85 : 5;
+}
+
+
+/* The previous version of VECTOR_FX_TO_OCTANT(), a tree of tests rather
+   than a table, to compare how much math it does.  It gets the most negative
+   number wrong since negating it overflows, so only use it for benchmarks. */
+static uint8_t TreeVectorFxToOctant(pfx vector_x, pfx vector_y)
+{
+  int8_t xDir, yDir;
+  int8_t xyDelta;
+  fx negative;
+
+  xDir = TEST_FX(*vector_x);
+  yDir = TEST_FX(*vector_y);
+  if (xDir == 0)
+    return (yDir == 0) ? 0 : (yDir >= 0) ? 0x82 : 0x86;
+  if (xDir >= 0)
+  {
+    if (yDir == 0)
+      return 0x80;
+    if (yDir >= 0)
+    {
+      xyDelta = COMPARE_FX(*vector_x, *vector_y);
+      return (xyDelta > 0) ? 0 : (xyDelta == 0) ? 0x81 : 1;
+    }
+    COPY_NEGATE_FX(*vector_y, negative);
+    xyDelta = COMPARE_FX(*vector_x, negative);
+    return (xyDelta > 0) ? 7 : (xyDelta == 0) ? 0x87 : 6;
+  }
+  if (yDir == 0)
+    return 0x84;
+  if (yDir >= 0)
+  {
+    COPY_NEGATE_FX(*vector_x, negative);
+    xyDelta = COMPARE_FX(negative, *vector_y);
+    return (xyDelta > 0) ? 3 : (xyDelta == 0) ? 0x83 : 2;
+  }
+  xyDelta = COMPARE_FX(*vector_x, *vector_y);
+  return (xyDelta < 0) ? 4 : (xyDelta == 0) ? 0x85 : 5;
+}
+
+
+/*******************************************************************************
+ * Test values.  Random ones come from a repeatable generator, and are mostly
+ * small since that's where velocities and positions live, with some over the
+ * whole range to catch carries out of the top.
+ */
+static uint32_t s_RandomState = 20260523;
+static long s_FailureCount;
+
+static uint32_t NextRandom(void)
+{
+  s_RandomState ^= s_RandomState << 13;
+  s_RandomState ^= s_RandomState >> 17;
+  s_RandomState ^= s_RandomState << 5;
+  return s_RandomState;
+}
+
+static int32_t RandomFx(void)
+{
+  uint32_t random = NextRandom();
+  int32_t value = (random & 0xFFFFFF) >> ((random >> 24) % 24);
+  return Wrap24((random & 0x80000000) ? -value : value);
+}
+
+static const int32_t kEdgeValues[] = {
+  0, 1, -1, 2, -2, 0x7F, 0x80, 0xFF, 0x100, 0x101, -0x7F, -0x80, -0xFF,
+  -0x100, -0x101, 0x1FF, -0x1FF, 0x7FFF, 0x8000, 0xFFFF, 0x10000, -0x8000,
+  -0xFFFF, -0x10000, 0x12345, -0x12345, 0x7FFF00, 0x7FFFFF, 0x7FFFFE,
+  FX24_MIN, FX24_MIN + 1, FX24_MIN + 0xFF, FX24_MIN + 0x100
+};
+#define EDGE_COUNT ((int) (sizeof(kEdgeValues) / sizeof(kEdgeValues[0])))
+
+static void Failed(const char *what, int32_t x, int32_t y, int32_t result,
+  int32_t expected)
+{
+  if (++s_FailureCount <= 20)
+    printf("FAILED %s with x = %d ($%06X), y = %d ($%06X), got %d ($%06X), "
+      "expected %d ($%06X).\n", what, x, x & 0xFFFFFF, y, y & 0xFFFFFF,
+      result, result & 0xFFFFFF, expected, expected & 0xFFFFFF);
+}
+
+
+/*******************************************************************************
+ * Check the single argument routines with one input value.
+ */
+static void TestOneValue(int32_t a)
+{
+  fx x, y;
+  int8_t sign;
+
+  x = IntToFx(a);
+  NEGATE_FX_ASM(&x);
+  if (FxToInt(x) != Wrap24(-a))
+    Failed("NEGATE_FX_ASM", a, 0, FxToInt(x), Wrap24(-a));
+
+#if FX_INLINE /* Otherwise the macros are the same as the calls above. */
+  x = IntToFx(a);
+  NEGATE_FX(x);
+  if (FxToInt(x) != Wrap24(-a))
+    Failed("NEGATE_FX", a, 0, FxToInt(x), Wrap24(-a));
+#endif
+
+  x = IntToFx(a);
+  y = IntToFx(~a);
+  COPY_NEGATE_FX_ASM(&x, &y);
+  if (FxToInt(y) != Wrap24(-a) || FxToInt(x) != a)
+    Failed("COPY_NEGATE_FX_ASM", a, 0, FxToInt(y), Wrap24(-a));
+
+  COPY_NEGATE_FX_ASM(&x, &x);
+  if (FxToInt(x) != Wrap24(-a))
+    Failed("COPY_NEGATE_FX_ASM onto itself", a, 0, FxToInt(x), Wrap24(-a));
+
+#if FX_INLINE
+  x = IntToFx(a);
+  COPY_NEGATE_FX(x, y);
+  if (FxToInt(y) != Wrap24(-a))
+    Failed("COPY_NEGATE_FX", a, 0, FxToInt(y), Wrap24(-a));
+#endif
+
+  x = IntToFx(a);
+  sign = TEST_FX_ASM(&x);
+  if (sign != Sign(a) || FxToInt(x) != a)
+    Failed("TEST_FX_ASM", a, 0, sign, Sign(a));
+#if FX_INLINE
+  sign = TEST_FX(x);
+  if (sign != Sign(a))
+    Failed("TEST_FX", a, 0, sign, Sign(a));
+#endif
+
+  DIV2_FX_ASM(&x);
+  if (FxToInt(x) != a >> 1)
+    Failed("DIV2_FX_ASM", a, 0, FxToInt(x), a >> 1);
+}
+
+
+/*******************************************************************************
+ * Check shifting by N bits, more than 23 bits leaves just the sign.
+ */
+static void TestShift(int32_t a, uint8_t n)
+{
+  fx x;
+
+  x = IntToFx(a);
+  DIV2Nth_FX_ASM(&x, n);
+  if (FxToInt(x) != a >> ((n > 23) ? 23 : n))
+    Failed("DIV2Nth_FX_ASM", a, n, FxToInt(x), a >> ((n > 23) ? 23 : n));
+}
+
+
+/*******************************************************************************
+ * Check the two argument routines with a pair of input values, with the
+ * result in a separate variable and on top of each of the inputs.
+ */
+static void TestTwoValues(int32_t a, int32_t b)
+{
+  fx x, y, z;
+  int8_t sign;
+  uint8_t octant;
+
+  x = IntToFx(a); y = IntToFx(b); z = IntToFx(~a);
+  ADD_FX_ASM(&x, &y, &z);
+  if (FxToInt(z) != Wrap24(a + b) || FxToInt(x) != a || FxToInt(y) != b)
+    Failed("ADD_FX_ASM", a, b, FxToInt(z), Wrap24(a + b));
+  ADD_FX_ASM(&x, &y, &x);
+  if (FxToInt(x) != Wrap24(a + b))
+    Failed("ADD_FX_ASM into x", a, b, FxToInt(x), Wrap24(a + b));
+  x = IntToFx(a);
+  ADD_FX_ASM(&x, &y, &y);
+  if (FxToInt(y) != Wrap24(a + b))
+    Failed("ADD_FX_ASM into y", a, b, FxToInt(y), Wrap24(a + b));
+  x = IntToFx(a);
+  ADD_FX_ASM(&x, &x, &x);
+  if (FxToInt(x) != Wrap24(a + a))
+    Failed("ADD_FX_ASM doubling", a, a, FxToInt(x), Wrap24(a + a));
+  x = IntToFx(a); y = IntToFx(b);
+  ADD_FX(x, y, x);
+  if (FxToInt(x) != Wrap24(a + b))
+    Failed("ADD_FX into x", a, b, FxToInt(x), Wrap24(a + b));
+
+  x = IntToFx(a); y = IntToFx(b); z = IntToFx(~a);
+  SUBTRACT_FX_ASM(&x, &y, &z);
+  if (FxToInt(z) != Wrap24(a - b) || FxToInt(x) != a || FxToInt(y) != b)
+    Failed("SUBTRACT_FX_ASM", a, b, FxToInt(z), Wrap24(a - b));
+  SUBTRACT_FX_ASM(&x, &y, &x);
+  if (FxToInt(x) != Wrap24(a - b))
+    Failed("SUBTRACT_FX_ASM into x", a, b, FxToInt(x), Wrap24(a - b));
+  x = IntToFx(a);
+  SUBTRACT_FX_ASM(&x, &y, &y);
+  if (FxToInt(y) != Wrap24(a - b))
+    Failed("SUBTRACT_FX_ASM into y", a, b, FxToInt(y), Wrap24(a - b));
+  x = IntToFx(a); y = IntToFx(b);
+  SUBTRACT_FX(x, y, y);
+  if (FxToInt(y) != Wrap24(a - b))
+    Failed("SUBTRACT_FX into y", a, b, FxToInt(y), Wrap24(a - b));
+
+  x = IntToFx(a); y = IntToFx(b);
+  sign = COMPARE_FX_ASM(&x, &y);
+  if (sign != Sign(a - b) || FxToInt(x) != a || FxToInt(y) != b)
+    Failed("COMPARE_FX_ASM", a, b, sign, Sign(a - b));
+  sign = COMPARE_FX(x, y);
+  if (sign != Sign(a - b))
+    Failed("COMPARE_FX", a, b, sign, Sign(a - b));
+
+  octant = VECTOR_FX_TO_OCTANT(&x, &y);
+  if (octant != ExpectedOctant(a, b))
+    Failed("VECTOR_FX_TO_OCTANT", a, b, octant, ExpectedOctant(a, b));
+
+  octant = INT16_TO_OCTANT(a >> 8, b >> 8);
+  if (octant != ExpectedOctant(a >> 8, b >> 8))
+    Failed("INT16_TO_OCTANT", a >> 8, b >> 8, octant,
+      ExpectedOctant(a >> 8, b >> 8));
+}
+
+
+/*******************************************************************************
+ * Compare the table driven VECTOR_FX_TO_OCTANT() with the old tree of tests,
+ * counting the assembler routines they call on the same random vectors.  The
+ * C code around the calls isn't counted, it's small in comparison.
+ */
+static void BenchmarkOctants(long count)
+{
+  fx x, y;
+  long i;
+  double tStates;
+  long calls;
+  double tableTStates = 0, treeTStates = 0;
+  long tableCalls = 0, treeCalls = 0;
+
+  for (i = 0; i < count; i++)
+  {
+    x = IntToFx(RandomFx());
+    y = IntToFx(RandomFx());
+
+    tStates = s_AllTStates;
+    calls = s_AllCalls;
+    VECTOR_FX_TO_OCTANT(&x, &y);
+    tableTStates += s_AllTStates - tStates;
+    tableCalls += s_AllCalls - calls;
+
+    tStates = s_AllTStates;
+    calls = s_AllCalls;
+    TreeVectorFxToOctant(&x, &y);
+    treeTStates += s_AllTStates - tStates;
+    treeCalls += s_AllCalls - calls;
+  }
+
+  if (count == 0)
+    return;
+  printf("\nVECTOR_FX_TO_OCTANT on random vectors, average math per call:\n"
+    "  Table:        %6.1f T-states in %4.2f routine calls.\n"
+    "  Tree of tests: %6.1f T-states in %4.2f routine calls.\n",
+    tableTStates / count, (double) tableCalls / count,
+    treeTStates / count, (double) treeCalls / count);
+}
+
+
+/*******************************************************************************
+ * Check SQRT_UINT16() for every input, and INT16_VECTOR_LENGTH() and
+ * INT16_VECTOR_NORMALISE() over a grid of vectors, printing the worst errors.
+ */
+static void TestVectorMath(int16_t range)
+{
+  int32_t n;
+  uint8_t root;
+  int16_t x, y, normalX, normalY;
+  uint16_t length;
+  double trueLength, error, normalLength, sine;
+  double worstLength = 0, worstNormal = 0, worstSine = 0;
+
+  for (n = 0; n <= 0xFFFF; n++)
+  {
+    root = SQRT_UINT16(n);
+    if ((int32_t) root * root > n || (int32_t) (root + 1) * (root + 1) <= n)
+      Failed("SQRT_UINT16", n, 0, root, 0);
+  }
+
+  for (x = -range; x <= range; x++)
+  {
+    for (y = -range; y <= range; y++)
+    {
+      trueLength = sqrt((double) x * x + (double) y * y);
+      length = INT16_VECTOR_LENGTH(x, y);
+      if (abs(x) < 128 && abs(y) < 128)
+      {
+        if (length != (uint16_t) trueLength)
+          Failed("INT16_VECTOR_LENGTH exact", x, y, length, trueLength);
+      }
+      else
+      {
+        error = fabs(length - trueLength) / trueLength;
+        if (error > worstLength)
+          worstLength = error;
+        if (error > 0.035)
+          Failed("INT16_VECTOR_LENGTH approximate", x, y, length, trueLength);
+      }
+
+      normalX = x;
+      normalY = y;
+      if (INT16_VECTOR_NORMALISE(&normalX, &normalY) != length)
+        Failed("INT16_VECTOR_NORMALISE length", x, y, normalX, normalY);
+      if (length == 0)
+        continue;
+      normalLength = sqrt((double) normalX * normalX +
+        (double) normalY * normalY);
+      error = fabs(normalLength - VECTOR_UNIT_LENGTH);
+      if (error > worstNormal)
+        worstNormal = error;
+      sine = fabs(normalX * (double) y - normalY * (double) x) /
+        (normalLength * trueLength);
+      if (sine > worstSine)
+        worstSine = sine;
+      if (error > 2 || sine > 0.05 ||
+      normalX * (int32_t) x < 0 || normalY * (int32_t) y < 0)
+        Failed("INT16_VECTOR_NORMALISE", x, y, normalX, normalY);
+    }
+  }
+
+  printf("Vector lengths up to %d are within %.1f%%, unit vectors are %.1f "
+    "long give or take %.1f, off by %.1f degrees at worst.\n", range,
+    worstLength * 100, (double) VECTOR_UNIT_LENGTH, worstNormal,
+    asin(worstSine) * 180 / M_PI);
+}
+
+
+/*******************************************************************************
+ * Main program, reads the assembler and runs all the tests.
+ */
+int main(int argc, char *argv[])
+{
+  char sourcePath[1024];
+  const char *pSlash;
+  long randomCount = 1000000;
+  long i;
+  int32_t a;
+  int j, k;
+  int option;
+  RoutinePointer pRoutine;
+
+  while ((option = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (option)
+    {
+      case 'n': randomCount = atol(optarg); break;
+      case 's': s_RandomState = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-n RandomCount] [-s Seed] "
+          "[path/fixed_point.c]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind < argc)
+    snprintf(sourcePath, sizeof(sourcePath), "%s", argv[optind]);
+  else
+  { /* Same directory as this source file. */
+    pSlash = strrchr(__FILE__, '/');
+    snprintf(sourcePath, sizeof(sourcePath), "%.*sfixed_point.c",
+      (pSlash == NULL) ? 0 : (int) (pSlash - __FILE__ + 1), __FILE__);
+  }
+
+  ReadRoutines(sourcePath);
+  s_NegateRoutine = FindRoutine("NEGATE_FX_ASM");
+  s_CopyNegateRoutine = FindRoutine("COPY_NEGATE_FX_ASM");
+  s_AddRoutine = FindRoutine("ADD_FX_ASM");
+  s_SubtractRoutine = FindRoutine("SUBTRACT_FX_ASM");
+  s_CompareRoutine = FindRoutine("COMPARE_FX_ASM");
+  s_TestRoutine = FindRoutine("TEST_FX_ASM");
+  s_Div2Routine = FindRoutine("DIV2_FX_ASM");
+  s_Div2NthRoutine = FindRoutine("DIV2Nth_FX_ASM");
+
+  printf("Testing the Z80 fixed point routines from %s, %s macros.\n",
+    sourcePath, FX_INLINE ? "inline" : "function call");
+
+  printf("Every 24 bit value for the single argument routines...\n");
+  for (a = FX24_MIN; a <= FX24_MAX; a++)
+    TestOneValue(a);
+
+  printf("Edge cases for the two argument routines...\n");
+  for (j = 0; j < EDGE_COUNT; j++)
+  {
+    for (k = 0; k < EDGE_COUNT; k++)
+      TestTwoValues(kEdgeValues[j], kEdgeValues[k]);
+    for (k = 0; k < 28; k++)
+      TestShift(kEdgeValues[j], k);
+  }
+
+  printf("%ld random pairs, and as many on and near the diagonals...\n",
+    randomCount);
+  for (i = 0; i < randomCount; i++)
+  {
+    a = RandomFx();
+    TestShift(a, NextRandom() % 28);
+    TestTwoValues(a, RandomFx());
+    TestTwoValues(a, Wrap24(((NextRandom() & 1) ? a : -a) +
+      (int32_t) (NextRandom() % 3) - 1));
+  }
+
+  printf("Square roots and vector lengths...\n");
+  TestVectorMath(600);
+
+  BenchmarkOctants(randomCount);
+
+  printf("\nT-states in each routine, not counting the call and arguments:\n");
+  for (pRoutine = s_Routines; pRoutine < s_Routines + s_RoutineCount;
+  pRoutine++)
+  {
+    if (pRoutine->callCount == 0)
+      continue;
+    printf("  %-20s min %3ld, max %3ld, average %6.1f, %d instructions.\n",
+      pRoutine->name, pRoutine->minTStates, pRoutine->maxTStates,
+      pRoutine->totalTStates / pRoutine->callCount,
+      pRoutine->instructionCount);
+  }
+
+  printf("\nCall overhead, which inline code wouldn't have, for global "
+    "arguments:\n");
+  for (pRoutine = s_Routines; pRoutine < s_Routines + s_RoutineCount;
+  pRoutine++)
+  {
+    long callerTStates;
+    double calleeTStates;
+
+    if (pRoutine->callCount == 0)
+      continue;
+    callerTStates =
+      CallerTStates(pRoutine->pointerCount, pRoutine->byteArgument);
+    calleeTStates = pRoutine->totalOverheadTStates / pRoutine->callCount;
+    printf("  %-20s caller %3ld, arguments and return %5.1f, "
+      "total %5.1f of %6.1f.\n", pRoutine->name, callerTStates,
+      calleeTStates, callerTStates + calleeTStates,
+      callerTStates + pRoutine->totalTStates / pRoutine->callCount);
+  }
+
+  printf("\n%ld failures.\n", s_FailureCount);
+  return s_FailureCount != 0;
+}
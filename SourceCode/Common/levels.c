@@ -56,7 +56,8 @@ static int16_t sNumericArgumentsDecoded[MAX_NUMERIC_ARGUMENTS];
 bool VictoryConditionTest(void)
 {
   uint8_t winningPlayer = MAX_PLAYERS + 2;
-  /* 0 to 3 are players, 4 is Fire button, 5 is Timeout, 6 is invalid. */
+  /* 0 to MAX_PLAYERS-1 are players, MAX_PLAYERS is Fire button, MAX_PLAYERS+1
+     is Timeout, MAX_PLAYERS+2 is invalid. */
 
   uint8_t i;
   player_pointer pPlayer = g_player_array;
@@ -82,12 +83,12 @@ bool VictoryConditionTest(void)
     if (gVictoryModeJoystickPress)
     {
       /* Make sure the joystick bits are contiguous, since we shift them around
-         assuming that they are.  And that shifting the fire button gets us to
-         MAX_PLAYERS.  Otherwise this joystick to player number code needs to
-         be redone. */
+         assuming that they are.  And that there are at least 4 players for
+         the directions.  Otherwise this joystick to player number code needs
+         to be redone. */
       COMPILER_VERIFY(JOYSTICK_DIRECTION_MASK == 0b00001111);
       COMPILER_VERIFY(Joy_Button == 0b00010000);
-      COMPILER_VERIFY(MAX_PLAYERS == 4);
+      COMPILER_VERIFY(MAX_PLAYERS >= 4);
 
       uint8_t buttonBits = pPlayer->joystick_inputs; /* Unused bits already 0 */
       if (buttonBits != 0)
@@ -99,6 +100,10 @@ bool VictoryConditionTest(void)
           bitCount++;
         }
         winningPlayer = bitCount; /* Will be from 0 to 4 (MAX_PLAYER == 4). */
+#if MAX_PLAYERS > 4
+        if (bitCount == 4) /* Fire button goes after all the players. */
+          winningPlayer = MAX_PLAYERS;
+#endif
         break;
       }
     }
@@ -121,9 +126,9 @@ bool VictoryConditionTest(void)
   (winningPlayer >= MAX_PLAYERS + 2))
     winningPlayer = MAX_PLAYERS + 1; /* Timeout "player" is the winner. */
 
-  /* If we have a winner (or MAX_PLAYERS = 4 for fire button pressed in
-     joystick mode or MAX_PLAYERS+1 == 5 for timeout), use their next level as
-     the one we want to load next. */
+  /* If we have a winner (or MAX_PLAYERS for fire button pressed in joystick
+     mode or MAX_PLAYERS+1 for timeout), use their next level as the one we
+     want to load next. */
 
   if (winningPlayer < MAX_PLAYERS + 2)
   {
@@ -154,6 +159,46 @@ static FileHandleType sLevelFileHandle;
 static uint8_t sLevelReadPosition;
 static uint8_t sLevelWritePosition;
 static char *sLevelBuffer; /* Points to a temporary on-stack buffer. */
+static bool sLevelEndOfFile; /* Set when a read hits the end of the file. */
+static bool sLevelBinary; /* TRUE if reading a compiled level file. */
+
+#if LEVEL_PREFETCH_SIZE
+/* The next level file, read ahead of time by LevelPrefetchUpdate().  If
+   sLevelFromPrefetch is set, the level is being loaded from here rather than
+   from sLevelFileHandle. */
+#define PREFETCH_IDLE 0 /* Nothing done yet for the current level. */
+#define PREFETCH_READING 1 /* File is open, reading a chunk at a time. */
+#define PREFETCH_DONE 2 /* Whole file is in the buffer. */
+#define PREFETCH_NONE 3 /* No likely next level or it was too big. */
+static uint8_t sPrefetchState = PREFETCH_IDLE;
+static char sPrefetchBuffer[LEVEL_PREFETCH_SIZE];
+static char sPrefetchName[MAX_LEVEL_NAME_LENGTH];
+static uint16_t sPrefetchLength; /* Amount of the file in the buffer. */
+static uint16_t sPrefetchReadPosition; /* Next byte to give to the loader. */
+static FileHandleType sPrefetchFileHandle = BAD_FILE_HANDLE;
+static bool sLevelFromPrefetch;
+#endif /* LEVEL_PREFETCH_SIZE */
+
+
+/* Read the next chunk of the level file into the given buffer, from the file
+   or from the prefetched copy of it.  Returns the amount read, zero at the end
+   of the file.
+*/
+static uint16_t LevelReadFileData(char *pBuffer, uint16_t amountToRead)
+{
+#if LEVEL_PREFETCH_SIZE
+  if (sLevelFromPrefetch)
+  {
+    uint16_t amountRemaining = sPrefetchLength - sPrefetchReadPosition;
+    if (amountToRead > amountRemaining)
+      amountToRead = amountRemaining;
+    memcpy(pBuffer, sPrefetchBuffer + sPrefetchReadPosition, amountToRead);
+    sPrefetchReadPosition += amountToRead;
+    return amountToRead;
+  }
+#endif /* LEVEL_PREFETCH_SIZE */
+  return ReadDataFile(sLevelFileHandle, pBuffer, amountToRead);
+}
 
 /* Read the next byte, refill the buffer if needed, returns 0 on end of file.
 */
@@ -172,10 +217,13 @@ static char LevelReadByte(void)
     /* Read at least one byte.  Happens when on the last byte in the buffer. */
     amountToRead = 1;
   }
-  uint16_t amountRead = rn_fileHandleReadSeq(sLevelFileHandle,
-    sLevelBuffer + sLevelWritePosition, 0 /* buffer offset */, amountToRead);
+  uint16_t amountRead = LevelReadFileData(sLevelBuffer + sLevelWritePosition,
+    amountToRead);
   if (amountRead == 0)
+  {
+    sLevelEndOfFile = true;
     return NUL; /* End of file or error, return zero character. */
+  }
   sLevelWritePosition += amountRead;
   return sLevelBuffer[sLevelReadPosition++];
 }
@@ -203,6 +251,74 @@ static char LevelPeekNextByte(void)
 }
 
 
+/* Compiled level files (made by Unix/LevelCompiler.c) start with a NUL, which
+   never appears in a text file, then "NLB" and a version number.  After that
+   comes a keyword number (index into kKeywordFunctionTable plus one, zero for
+   the end) followed by that keyword's arguments already decoded, one token
+   for each call the keyword function makes to LevelReadWord(),
+   LevelReadAndTrimLine() or LevelReadNumericArguments().  A string token is a
+   length byte then the text.  A number token is a count byte then that many
+   16 bit little endian numbers.  BoardTileData has rows of tile owner numbers,
+   each a length byte then the owners, ending with a zero length row.  So the
+   keyword functions work the same for both kinds of file, they just don't
+   have to do any parsing when it's compiled.
+*/
+#define LEVEL_BINARY_VERSION 1
+static const char kLevelBinaryMagic[] = {'N', 'L', 'B', LEVEL_BINARY_VERSION};
+
+
+/* Read a little endian 16 bit number from a compiled level file.
+*/
+static uint16_t LevelBinaryReadUInt16(void)
+{
+  uint8_t lowByte = LevelReadByte();
+  return lowByte | ((uint16_t) (uint8_t) LevelReadByte() << 8);
+}
+
+
+/* Read a string token from a compiled level file into the Buffer, same
+   semantics as LevelReadWord(): truncates to fit and returns FALSE if end of
+   file was hit.
+*/
+static bool LevelBinaryReadString(char *Buffer, uint8_t BufferSize)
+{
+  uint8_t length = LevelReadByte();
+  uint8_t i;
+
+  for (i = 0; i < length; i++)
+  {
+    char letter = LevelReadByte();
+    if (i < BufferSize - 1)
+      Buffer[i] = letter;
+  }
+  if (length > BufferSize - 1)
+    length = BufferSize - 1;
+  Buffer[length] = NUL;
+  return !sLevelEndOfFile;
+}
+
+
+/* Read a number token from a compiled level file into
+   sNumericArgumentsDecoded[], keeping at most NumberOfArguments of them.
+   Returns FALSE if there weren't any, same as LevelReadNumericArguments().
+*/
+static bool LevelBinaryReadNumbers(uint8_t NumberOfArguments)
+{
+  uint8_t count = LevelReadByte();
+  uint8_t i;
+  int16_t number;
+
+  bzero(sNumericArgumentsDecoded, sizeof(sNumericArgumentsDecoded));
+  for (i = 0; i < count; i++)
+  {
+    number = LevelBinaryReadUInt16();
+    if (i < NumberOfArguments && i < MAX_NUMERIC_ARGUMENTS)
+      sNumericArgumentsDecoded[i] = number;
+  }
+  return count > 0 && !sLevelEndOfFile;
+}
+
+
 /* Skip spaces and tabs until a non-blank character or end of file.  Returns
    FALSE when it hits end of file, TRUE otherwise.
 */
@@ -285,6 +401,9 @@ static bool LevelReadLine(char *Buffer, uint8_t BufferSize)
    of a line that you don't want to process. */
 static bool LevelReadToStartOfNextLine(void)
 {
+  if (sLevelBinary)
+    return true; /* Compiled files don't have the rest of the line. */
+
   char Buffer[10];
   return LevelReadLine(Buffer, sizeof(Buffer));
 }
@@ -301,6 +420,9 @@ static bool LevelReadToStartOfNextLine(void)
 static bool LevelReadWord(
   char *Buffer, uint8_t BufferSize, char Delimiter)
 {
+  if (sLevelBinary)
+    return LevelBinaryReadString(Buffer, BufferSize);
+
   char *pDest = Buffer;
   uint8_t dataSize = BufferSize - 1; /* Save space for final NUL character. */
   uint8_t sizeSoFar = 0;
@@ -335,6 +457,9 @@ static bool LevelReadWord(
 */
 bool LevelReadAndTrimLine(char *Buffer, uint8_t BufferSize)
 {
+  if (sLevelBinary)
+    return LevelBinaryReadString(Buffer, BufferSize);
+
   if (!LevelSkipSpaces())
     return false;
   if (!LevelReadLine(Buffer, BufferSize))
@@ -367,6 +492,10 @@ bool LevelReadNumericArguments(uint8_t NumberOfArguments)
 {
   uint8_t i, maxCount;
   char numberText[10];
+
+  if (sLevelBinary)
+    return LevelBinaryReadNumbers(NumberOfArguments);
+
   bzero(sNumericArgumentsDecoded, sizeof(sNumericArgumentsDecoded));
 
   maxCount = MAX_NUMERIC_ARGUMENTS;
@@ -427,9 +556,11 @@ bool KeywordTextOnScreen(void)
   if (!LevelReadNumericArguments(4))
     return false;
 
+#ifdef NABU_H
   /* Yes, vdp_setCursor2() has input sanity checking. */
   vdp_setCursor2(sNumericArgumentsDecoded[1] /* column */,
     sNumericArgumentsDecoded[0] /* row */);
+#endif /* NABU_H */
 
   /* Read the line of text from the level file and print it. */
 
@@ -438,8 +569,10 @@ bool KeywordTextOnScreen(void)
     return false;
 
   SoundUpdateIfNeeded();
+#ifdef NABU_H
   vdp_printJustified((char *) StockTextMessages(g_TempBuffer),
     sNumericArgumentsDecoded[2], sNumericArgumentsDecoded[3]);
+#endif /* NABU_H */
 
   return true;
 }
@@ -457,12 +590,32 @@ bool KeywordBackgroundMusic(void)
 }
 
 
+/* This keyword opens a bundle file (*.BUNDLE) holding the level, screen and
+   music files for a sequence of levels, so later loads come from it rather
+   than opening each file separately.  Best put first in the first level of the
+   sequence.  An empty name closes the bundle.
+*/
+bool KeywordBundle(void)
+{
+  char bundleFileName[MAX_FILE_NAME_LENGTH];
+  if (!LevelReadAndTrimLine(bundleFileName, sizeof(bundleFileName)) ||
+  bundleFileName[0] == NUL)
+  {
+    CloseBundle();
+    return true;
+  }
+  OpenBundle(bundleFileName); /* Files get opened separately if it fails. */
+  return true;
+}
+
+
 /* Make the current level end after a given number of seconds. */
 bool KeywordPlayTimeout(void)
 {
   if (!LevelReadNumericArguments(1))
     return false;
-  sVictoryTimeoutFrame = sNumericArgumentsDecoded[0] * 20 /* Assume 20hz */;
+  sVictoryTimeoutFrame =
+    sNumericArgumentsDecoded[0] * FIXED_TICKS_PER_SECOND; /* Assume 20hz. */
 
   if (sVictoryTimeoutFrame != 0)
   { /* User wants a timeout, we need a global frame number to trigger it. */
@@ -475,6 +628,55 @@ bool KeywordPlayTimeout(void)
 }
 
 
+/* Case insensitive hash of a word, for looking up keywords without searching
+   through a whole table of them.  Each table has its own seed, picked so that
+   none of the words in the table land in the same slot of a power of two
+   sized hash index (a perfect hash), which then holds the table position plus
+   one, or zero for an unused slot.  So finding a word takes one hash and one
+   strcasecmp() to confirm it, no matter how long the table is.  If you change
+   a table, run the Unix/LevelCompiler.c with -H to get new seeds and indices.
+   Host programs check the indices before loading a level (see
+   LevelWordHashesValid()), so forgetting to do that fails the host tests.
+*/
+static uint8_t LevelWordHash(const char *word, uint8_t seed)
+{
+  uint16_t hash = 0;
+  char letter;
+
+  while ((letter = *word++) != NUL)
+    hash = (hash << 5) + hash + ((letter & 0xDF) ^ seed);
+  return (uint8_t) (hash ^ (hash >> 8));
+}
+
+
+/* The player identifications for KeywordLevelNext(), and their hash index. */
+typedef struct LevelOptionStruct {
+  const char *optionWord;
+  uint8_t playerNumber;
+} *LevelOptionPointer;
+
+static struct LevelOptionStruct kLevelNextOptions[] = {
+  {"All", MAX_PLAYERS + 2},
+  {"P0", 0},
+  {"P1", 1},
+  {"P2", 2},
+  {"P3", 3},
+  {"Left", 0},
+  {"Down", 1},
+  {"Right", 2},
+  {"Up", 3},
+  {"Fire", MAX_PLAYERS},
+  {"Timeout", MAX_PLAYERS + 1},
+  {NULL, MAX_PLAYERS + 3}
+};
+
+#define LEVEL_NEXT_OPTIONS_HASH_SEED 0
+#define LEVEL_NEXT_OPTIONS_HASH_SIZE 16
+static const uint8_t kLevelNextOptionsHash[LEVEL_NEXT_OPTIONS_HASH_SIZE] = {
+  6, 0, 11, 0, 0, 10, 8, 1, 4, 5, 2, 3, 0, 7, 9, 0
+};
+
+
 /* This keyword specifies the base level name for the next level.  It is
    followed by a player identification, either "All" or "P0", "P1", "P2",
    "P3" or a joystick direction + Fire + Timeout to identify which next level
@@ -487,45 +689,23 @@ bool KeywordLevelNext(void)
   char playerName[8]; /* Longest is "Timeout" */
 
   uint8_t iPlayer = MAX_PLAYERS + 3;
-  /* 0 to 3 are players, 4 is Fire button, 5 is Timeout, 6 is All, 7 is none. */
-
-  static struct LevelOptionStruct {
-    const char *optionWord;
-    uint8_t playerNumber;
-  } sLevelNextOptions[] = {
-    {"All", MAX_PLAYERS + 2},
-    {"P0", 0},
-    {"P1", 1},
-    {"P2", 2},
-    {"P3", 3},
-    {"Left", 0},
-    {"Down", 1},
-    {"Right", 2},
-    {"Up", 3},
-    {"Fire", 4},
-    {"Timeout", 5},
-    {NULL, MAX_PLAYERS + 3}
-  };
-
-  /* Get the player number, 0 to 3 for normal players, or 4 for Fire button,
-     or 5 for Timeout, or 6 to signify all players.  MAX_PLAYERS+3 == 7 for
-     invalid. */
+  /* 0 to 3 are players, MAX_PLAYERS is Fire button, MAX_PLAYERS+1 is Timeout,
+     MAX_PLAYERS+2 is All, MAX_PLAYERS+3 is none. */
+
+  /* Get the player number, 0 to 3 for normal players, or MAX_PLAYERS (4 on
+     the NABU) for Fire button, or MAX_PLAYERS+1 for Timeout, or MAX_PLAYERS+2
+     to signify all players.  MAX_PLAYERS+3 for invalid. */
 
   if (!LevelReadWord(playerName, sizeof(playerName), ','))
     goto ErrorExit;
 
-  struct LevelOptionStruct *pOption;
-  pOption = sLevelNextOptions;
-  const char *optionWord;
-  while ((optionWord = pOption->optionWord) != NULL)
-  {
-    if (strcasecmp(playerName, optionWord) == 0)
-    {
-      iPlayer = pOption->playerNumber;
-      break;
-    }
-    pOption++;
-  }
+  uint8_t optionIndex;
+  optionIndex = kLevelNextOptionsHash[
+    LevelWordHash(playerName, LEVEL_NEXT_OPTIONS_HASH_SEED) &
+    (LEVEL_NEXT_OPTIONS_HASH_SIZE - 1)];
+  if (optionIndex != 0 && strcasecmp(playerName,
+  kLevelNextOptions[optionIndex - 1].optionWord) == 0)
+    iPlayer = kLevelNextOptions[optionIndex - 1].playerNumber;
   if (iPlayer >= MAX_PLAYERS + 3)
     goto ErrorExit; /* No recognised option found. */
 
@@ -535,7 +715,17 @@ bool KeywordLevelNext(void)
   /* Copy the name to the appropriate player's NextLevel file name. */
 
   if (iPlayer < MAX_PLAYERS + 2)
+  {
     strcpy(gWinnerNextLevelName[iPlayer], levelName);
+#if MAX_PLAYERS > 4
+    if (iPlayer < 4) /* Extra players share the level of one of the first 4. */
+    {
+      uint8_t i;
+      for (i = iPlayer + 4; i < MAX_PLAYERS; i += 4)
+        strcpy(gWinnerNextLevelName[i], levelName);
+    }
+#endif
+  }
   else /* All players picked.  iPlayer == MAX_PLAYERS + 2 */
   {
     uint8_t i;
@@ -585,16 +775,19 @@ bool KeywordDesiredPlayers(void)
 
 
 /* Set the starting point of each AI player's code.  That will set the program
-   they are using and thus their behaviour.
+   they are using and thus their behaviour.  Level files list 4 players, extra
+   players in big host games use the entry for their player number masked by
+   PLAYER_GROUP_MASK.
 */
 bool KeywordAIPlayerCodeStart(void)
 {
-  if (!LevelReadNumericArguments(MAX_PLAYERS))
+  if (!LevelReadNumericArguments(PLAYER_GROUP_MASK + 1))
     return false;
 
   uint8_t iPlayer;
   for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++)
-    g_target_start_indices[iPlayer] = sNumericArgumentsDecoded[iPlayer];
+    g_target_start_indices[iPlayer] =
+      sNumericArgumentsDecoded[iPlayer & PLAYER_GROUP_MASK];
 
   return true;
 }
@@ -716,11 +909,88 @@ bool KeywordBoardScreen(void)
 }
 
 
+/* Set one tile from the level's board data.  If it is a player coloured tile,
+   the player starts there.  Returns FALSE if there is no such tile.
+*/
+static bool LevelSetBoardTile(uint8_t column, uint8_t row, tile_owner tileType)
+{
+  tile_pointer pTile = TileForColumnAndRow(column, row);
+  if (pTile == NULL)
+    return false;
+  SetTileOwner(pTile, tileType);
+
+  /* If it is a player coloured tile, move the player there.  And upgrade
+     the tile to fully aged. */
+
+  uint8_t iPlayer = tileType - OWNER_PLAYER_1;
+  if (iPlayer < MAX_PLAYERS)
+  {
+    player_pointer pPlayer = g_player_array + iPlayer;
+    pPlayer->starting_level_pixel_x = pTile->pixel_center_x;
+    pPlayer->starting_level_pixel_y = pTile->pixel_center_y;
+
+    /* Also make it a fully aged / solid tile.  Mostly useful for the
+       classic Pong Wars look. */
+    pTile->age = 7;
+  }
+  return true;
+}
+
+
+/* Compiled level version of KeywordBoardTileData(), the tiles are already
+   converted to owner numbers so it's just a matter of setting them.
+*/
+static bool LevelBinaryBoardTileData(void)
+{
+  uint8_t row = 0;
+  uint8_t column;
+  uint8_t length;
+  tile_owner tileType;
+
+  while ((length = LevelReadByte()) != 0)
+  {
+    SoundUpdateIfNeeded();
+
+    for (column = 0; column < length; column++)
+    {
+      tileType = LevelReadByte();
+      if (tileType >= OWNER_MAX)
+        tileType = OWNER_EMPTY;
+      if (!LevelSetBoardTile(column, row, tileType))
+      {
+        while (++column < length) /* Skip the rest of the row. */
+          LevelReadByte();
+      }
+    }
+    row++;
+  }
+
+  return row > 0 && !sLevelEndOfFile;
+}
+
+
+/* Convert a level file letter to a tile type, or OWNER_MAX if unknown.
+*/
+static tile_owner LevelLetterToTileOwner(char letter)
+{
+  tile_owner tileType;
+  for (tileType = 0; tileType < OWNER_MAX; tileType++)
+  {
+    if (g_TileOwnerLetters[tileType] == letter)
+      break;
+  }
+  return tileType;
+}
+
+
 /* Read tile data from the level file and set tiles and initial player
    positions.  Stops on a line with "END".  Ignores spaces and comment lines.
 */
 bool KeywordBoardTileData(void)
 {
+  if (sLevelBinary)
+    return LevelBinaryBoardTileData();
+
   uint8_t row = 0;
   while (LevelReadAndTrimLine(g_TempBuffer, 255))
   {
@@ -741,37 +1011,14 @@ bool KeywordBoardTileData(void)
       if (isblank(letter))
         continue; /* Skip blanks between tile codes. */
 
-      /* Convert the level file letter to a tile type. */
-      tile_owner tileType;
-      for (tileType = 0; tileType < OWNER_MAX; tileType++)
-      {
-        if (g_TileOwnerLetters[tileType] == letter)
-          break;
-      }
-
-      /* Default unknown tile types to empty tiles. */
+      /* Convert the level file letter to a tile type.  Default unknown tile
+         types to empty tiles. */
+      tile_owner tileType = LevelLetterToTileOwner(letter);
       if (tileType >= OWNER_MAX)
         tileType = OWNER_EMPTY;
 
-      tile_pointer pTile = TileForColumnAndRow(column, row);
-      if (pTile == NULL)
+      if (!LevelSetBoardTile(column, row, tileType))
         break; /* Ignore the rest of this line, no tiles here. */
-      SetTileOwner(pTile, tileType);
-
-      /* If it is a player coloured tile, move the player there.  And upgrade
-         the tile to fully aged. */
-
-      uint8_t iPlayer = tileType - OWNER_PLAYER_1;
-      if (iPlayer < MAX_PLAYERS)
-      {
-        player_pointer pPlayer = g_player_array + iPlayer;
-        pPlayer->starting_level_pixel_x = pTile->pixel_center_x;
-        pPlayer->starting_level_pixel_y = pTile->pixel_center_y;
-
-        /* Also make it a fully aged / solid tile.  Mostly useful for the
-           classic Pong Wars look. */
-        pTile->age = 7;
-      }
 
       /* Successfully set one tile, advance to the next column. */
       column++;
@@ -803,12 +1050,7 @@ bool KeywordTileQuota(void)
 
   /* Convert the level file letter to a tile type.  Do nothing fatal for
      unknown possibly future level codes. */
-  tile_owner tileType;
-  for (tileType = 0; tileType < OWNER_MAX; tileType++)
-  {
-    if (g_TileOwnerLetters[tileType] == g_TempBuffer[0])
-      break;
-  }
+  tile_owner tileType = LevelLetterToTileOwner(g_TempBuffer[0]);
 
   /* Read the quota number. */
 
@@ -867,16 +1109,26 @@ bool KeywordPhysicsSeparatePlayersSpeed(void)
 
 
 /*  If the player is moving at or faster than this many quarter pixels per
-    physics step, add more steps.
+    physics step, add more steps.  The optional second number is the most the
+    physics governor can raise it to when the frame rate drops, zero (the
+    default) to not govern.
 */
 bool KeywordPhysicsMoreStepsSpeed(void)
 {
-  if (!LevelReadNumericArguments(1))
+  if (!LevelReadNumericArguments(2))
     return false;
 
   g_PhysicsStepSizeLimit = sNumericArgumentsDecoded[0];
   if (g_PhysicsStepSizeLimit <= 0)
     g_PhysicsStepSizeLimit = 1;
+
+  /* Out of byte range maximums get clamped rather than wrapping around. */
+  if (sNumericArgumentsDecoded[1] < 0)
+    g_PhysicsStepSizeLimitMax = 0;
+  else if (sNumericArgumentsDecoded[1] > 255)
+    g_PhysicsStepSizeLimitMax = 255;
+  else
+    g_PhysicsStepSizeLimitMax = sNumericArgumentsDecoded[1];
   return true;
 }
 
@@ -922,7 +1174,7 @@ bool KeywordAutoBoardScrollFeature(void)
 
 /******************************************************************************
  * Handle all level keywords.  We have a table of the word and the
- * corresponding function to call (in order of most frequent first).
+ * corresponding function to call, found with a hash of the word.
  */
 
 typedef bool (*KeywordFunctionPointer)(void);
@@ -931,44 +1183,129 @@ typedef bool (*KeywordFunctionPointer)(void);
 typedef struct KeyWordCallStruct {
   const char *keyword;
   KeywordFunctionPointer function;
+#ifndef NABU_H
+  const char *arguments;
+  /* What the keyword function reads, for the level compiler.  A digit is
+     LevelReadNumericArguments() of that many numbers, 'w' is LevelReadWord()
+     up to a comma, 'l' is LevelReadAndTrimLine(), 't' is tile data.  Nothing
+     at all if it just skips the rest of the line.  Not needed on the NABU. */
+#endif /* NABU_H */
 } *KeyWordCallPointer;
 
+#ifdef NABU_H
+  #define KEYWORD_ENTRY(word, function, arguments) {word, function}
+#else
+  #define KEYWORD_ENTRY(word, function, arguments) {word, function, arguments}
+#endif /* NABU_H */
+
 static struct KeyWordCallStruct kKeywordFunctionTable[] = {
-  {"LevelNext", KeywordLevelNext},
-  {"ScreenText", KeywordTextOnScreen},
-  {"TileQuota", KeywordTileQuota},
-  {"Music", KeywordBackgroundMusic},
-  {"Screen", KeywordScreen},
-  {"LevelBookmark", KeywordLevelBookmark},
-  {"PlayTimeout", KeywordPlayTimeout},
-  {"DesiredPlayerCount", KeywordDesiredPlayers},
-  {"AIPlayerCodeStart", KeywordAIPlayerCodeStart},
-  {"InitialCount", KeywordCountdownStart},
-  {"GameMode", KeywordGameMode},
-  {"BoardSize", KeywordBoardSize},
-  {"BoardScreen", KeywordBoardScreen},
-  {"BoardTileData", KeywordBoardTileData},
-  {"BoardScroll", KeywordAutoBoardScrollFeature},
-  {"PhysicsFrictionSpeed", KeywordPhysicsFrictionSpeed},
-  {"PhysicsFrictionShift", KeywordPhysicsFrictionShift},
-  {"PhysicsSeparatePlayersSpeed", KeywordPhysicsSeparatePlayersSpeed},
-  {"PhysicsMoreStepsSpeed", KeywordPhysicsMoreStepsSpeed},
-  {"PhysicsTurnRate", KeywordPhysicsTurnRate},
-  {"TileAgeFeature", KeywordTileAgeFeature},
-  {"RemovePlayers", KeywordRemovePlayers},
-  {NULL, NULL}
+  KEYWORD_ENTRY("LevelNext", KeywordLevelNext, "wl"),
+  KEYWORD_ENTRY("ScreenText", KeywordTextOnScreen, "4l"),
+  KEYWORD_ENTRY("TileQuota", KeywordTileQuota, "w1"),
+  KEYWORD_ENTRY("Music", KeywordBackgroundMusic, "l"),
+  KEYWORD_ENTRY("Screen", KeywordScreen, "l"),
+  KEYWORD_ENTRY("LevelBookmark", KeywordLevelBookmark, "l"),
+  KEYWORD_ENTRY("PlayTimeout", KeywordPlayTimeout, "1"),
+  KEYWORD_ENTRY("DesiredPlayerCount", KeywordDesiredPlayers, "1"),
+  KEYWORD_ENTRY("AIPlayerCodeStart", KeywordAIPlayerCodeStart, "6"),
+  KEYWORD_ENTRY("InitialCount", KeywordCountdownStart, "1"),
+  KEYWORD_ENTRY("GameMode", KeywordGameMode, "l"),
+  KEYWORD_ENTRY("BoardSize", KeywordBoardSize, "2"),
+  KEYWORD_ENTRY("BoardScreen", KeywordBoardScreen, "6"),
+  KEYWORD_ENTRY("BoardTileData", KeywordBoardTileData, "t"),
+  KEYWORD_ENTRY("BoardScroll", KeywordAutoBoardScrollFeature, "1"),
+  KEYWORD_ENTRY("PhysicsFrictionSpeed", KeywordPhysicsFrictionSpeed, "1"),
+  KEYWORD_ENTRY("PhysicsFrictionShift", KeywordPhysicsFrictionShift, "1"),
+  KEYWORD_ENTRY("PhysicsSeparatePlayersSpeed",
+    KeywordPhysicsSeparatePlayersSpeed, "1"),
+  KEYWORD_ENTRY("PhysicsMoreStepsSpeed", KeywordPhysicsMoreStepsSpeed, "2"),
+  KEYWORD_ENTRY("PhysicsTurnRate", KeywordPhysicsTurnRate, "1"),
+  KEYWORD_ENTRY("TileAgeFeature", KeywordTileAgeFeature, "1"),
+  KEYWORD_ENTRY("RemovePlayers", KeywordRemovePlayers, ""),
+  KEYWORD_ENTRY("Bundle", KeywordBundle, "l"),
+  KEYWORD_ENTRY(NULL, NULL, NULL)
 };
 
-/* Read the level file keyword by keyword.  Returns FALSE on abort, usually
-   something wrong about the level file, like bad tile map syntax.
+/* Perfect hash index into kKeywordFunctionTable, see LevelWordHash().  Keep
+   the table order the same when adding keywords, since compiled binary level
+   files use the table position as the keyword number. */
+#define KEYWORD_HASH_SEED 18
+#define KEYWORD_HASH_SIZE 64
+static const uint8_t kKeywordHash[KEYWORD_HASH_SIZE] = {
+  0, 0, 0, 0, 0, 19, 0, 1, 0, 14, 7, 0, 6, 0, 0, 0,
+  11, 0, 22, 17, 0, 23, 0, 0, 0, 0, 0, 13, 0, 0, 0, 0,
+  0, 18, 15, 0, 16, 0, 0, 0, 0, 9, 0, 3, 0, 21, 10, 0,
+  0, 20, 0, 0, 4, 8, 0, 0, 0, 0, 0, 5, 12, 2, 0, 0
+};
+
+#ifndef NABU_H
+/* Check that a perfect hash index matches its list of words, so a table
+   changed without making a new index gets noticed.  Returns FALSE and prints
+   a debug message if some word isn't where the index says it is.
 */
-static bool ProcessLevelKeywords(void)
+static bool LevelCheckWordHash(const char *tableName, const char **words,
+  uint8_t wordCount, uint8_t seed, const uint8_t *hashIndex, uint8_t hashSize)
+{
+  uint8_t slot;
+  uint8_t i;
+  uint8_t usedSlots = 0;
+
+  for (slot = 0; slot < hashSize; slot++)
+  {
+    if (hashIndex[slot] != 0)
+      usedSlots++;
+  }
+  for (i = 0; i < wordCount; i++)
+  {
+    slot = LevelWordHash(words[i], seed) & (hashSize - 1);
+    if (hashIndex[slot] != i + 1)
+      break;
+  }
+  if (i >= wordCount && usedSlots == wordCount)
+    return true;
+
+  DebugPrintString("Hash index for ");
+  DebugPrintString(tableName);
+  DebugPrintString(" is out of date, run Unix/LevelCompiler -H to make a new "
+    "one and paste it into levels.c.\n");
+  return false;
+}
+
+
+/* Check all the hash indices against their tables.  Host programs do this
+   before loading a level, so a stale index fails the host tests and tools
+   rather than quietly finding the wrong keywords on the NABU.
+*/
+static bool LevelWordHashesValid(void)
+{
+  const char *words[256];
+  uint8_t wordCount;
+
+  for (wordCount = 0; kKeywordFunctionTable[wordCount].keyword != NULL;
+  wordCount++)
+    words[wordCount] = kKeywordFunctionTable[wordCount].keyword;
+  if (!LevelCheckWordHash("kKeywordFunctionTable", words, wordCount,
+  KEYWORD_HASH_SEED, kKeywordHash, KEYWORD_HASH_SIZE))
+    return false;
+
+  for (wordCount = 0; kLevelNextOptions[wordCount].optionWord != NULL;
+  wordCount++)
+    words[wordCount] = kLevelNextOptions[wordCount].optionWord;
+  return LevelCheckWordHash("kLevelNextOptions", words, wordCount,
+    LEVEL_NEXT_OPTIONS_HASH_SEED, kLevelNextOptionsHash,
+    LEVEL_NEXT_OPTIONS_HASH_SIZE);
+}
+#endif /* NABU_H */
+
+/* Read the next keyword from a text level file, skipping comments, blank
+   lines and unknown keywords, and the spaces after the colon.  Returns the
+   table entry for the keyword, or NULL at the end of the file.
+*/
+static KeyWordCallPointer LevelReadNextKeyword(void)
 {
   #define MAX_LEVEL_KEYWORD_LENGTH 32
   char keyWord[MAX_LEVEL_KEYWORD_LENGTH];
 
-  sFirstTileQuotaKeywordClears = true;
-
   while (true)
   {
     SoundUpdateIfNeeded();
@@ -1004,33 +1341,192 @@ static bool ProcessLevelKeywords(void)
     if (!LevelSkipSpaces()) /* For convenience, skip spaces after the colon. */
       break; /* Hit end of file, always need a value after the keyword. */
 
-    /* Got the keyword, do special processing for each one. */
+    /* Got the keyword, find it in the table. */
 
-    KeyWordCallPointer pKeywordCall = kKeywordFunctionTable;
-    while (pKeywordCall->keyword != NULL)
+    uint8_t keywordIndex;
+    keywordIndex = kKeywordHash[LevelWordHash(keyWord, KEYWORD_HASH_SEED) &
+      (KEYWORD_HASH_SIZE - 1)];
+    if (keywordIndex != 0 && strcasecmp(keyWord,
+    kKeywordFunctionTable[keywordIndex - 1].keyword) == 0)
+      return kKeywordFunctionTable + keywordIndex - 1;
+
+    /* Unknown keyword, print a debug message and discard the rest. */
+    strcpy(g_TempBuffer, "Unknown keyword \"");
+    strcat(g_TempBuffer, keyWord);
+    strcat(g_TempBuffer, "\".\n");
+    DebugPrintString(g_TempBuffer);
+    if (!LevelReadAndTrimLine(keyWord, sizeof(keyWord)))
+      break; /* End of file while discarding the rest of the line. */
+  }
+  return NULL;
+}
+
+
+/* Read the level file keyword by keyword.  Returns FALSE on abort, usually
+   something wrong about the level file, like bad tile map syntax.
+*/
+static bool ProcessLevelKeywords(void)
+{
+  KeyWordCallPointer pKeywordCall;
+
+  sFirstTileQuotaKeywordClears = true;
+
+  while ((pKeywordCall = LevelReadNextKeyword()) != NULL)
+  {
+    if (!pKeywordCall->function())
+      return false; /* Abort, abort! */
+  }
+  return true;
+}
+
+
+/* Read a compiled level file, with keywords as numbers.  Call after the
+   leading NUL has been read.  Returns FALSE on abort, including when it's a
+   version we don't know about.
+*/
+static bool ProcessLevelBinary(void)
+{
+  uint8_t keywordNumber;
+  uint8_t i;
+
+  for (i = 0; i < sizeof(kLevelBinaryMagic); i++)
+  {
+    if (LevelReadByte() != kLevelBinaryMagic[i])
     {
-      if (strcasecmp(pKeywordCall->keyword, keyWord) == 0)
-      {
-        if (!pKeywordCall->function())
-          return false; /* Abort, abort! */
-        break; /* Processed this keyword, don't bother searching further. */
-      }
-      pKeywordCall++;
+      DebugPrintString("Compiled level file is the wrong version.\n");
+      return false;
     }
-    if (pKeywordCall->keyword == NULL)
-    { /* Unknown keyword, print a debug message and discard the rest. */
-      strcpy(g_TempBuffer, "Unknown keyword \"");
-      strcat(g_TempBuffer, keyWord);
-      strcat(g_TempBuffer, "\".\n");
-      DebugPrintString(g_TempBuffer);
-      if (!LevelReadAndTrimLine(keyWord, sizeof(keyWord)))
-        break; /* End of file while discarding the rest of the line. */
+  }
+
+  sFirstTileQuotaKeywordClears = true;
+
+  while (true)
+  {
+    SoundUpdateIfNeeded();
+
+    keywordNumber = LevelReadByte();
+    if (keywordNumber == 0)
+      break; /* End marker or end of file. */
+    if (keywordNumber >=
+    sizeof(kKeywordFunctionTable) / sizeof(kKeywordFunctionTable[0]))
+    {
+      DebugPrintString("Compiled level file has an unknown keyword.\n");
+      return false;
     }
+
+    KeyWordCallPointer pKeywordCall = kKeywordFunctionTable + keywordNumber - 1;
+#if 0 /* Same debug output as for text level files. */
+    strcpy(g_TempBuffer, "Now doing level keyword \"");
+    strcat(g_TempBuffer, pKeywordCall->keyword);
+    strcat(g_TempBuffer, "\".\n");
+    DebugPrintString(g_TempBuffer);
+#endif
+    if (!pKeywordCall->function())
+      return false;
   }
   return true;
 }
 
 
+#if LEVEL_PREFETCH_SIZE
+/* Stop any prefetching in progress and forget what was prefetched, so the
+   next level after this one can be prefetched.  Leaves the buffer contents
+   alone, in case it's being used for loading.
+*/
+static void LevelPrefetchReset(void)
+{
+  CloseDataFile(sPrefetchFileHandle);
+  sPrefetchFileHandle = BAD_FILE_HANDLE;
+  sPrefetchState = PREFETCH_IDLE;
+}
+
+
+/* Does a bit more of reading the likely next level file into memory, so the
+   next LoadLevelFile() doesn't have to wait for the file to be found and
+   read.  The likely level is the most popular one in gWinnerNextLevelName[].
+   Call it once in a while, when there is spare time in a frame.  Each call
+   either opens the file or reads LEVEL_PREFETCH_CHUNK_SIZE bytes of it, and
+   does nothing once the file has been read or if it is too big.  Only opens
+   files in a bundle or the local store, since waiting for a web site would
+   stall the game, levels from there get loaded the usual way.
+*/
+void LevelPrefetchUpdate(void)
+{
+  uint16_t amountToRead;
+  uint16_t amountRead;
+
+  if (sPrefetchState == PREFETCH_IDLE)
+  {
+    /* Pick the name used by the most winners, usually they're all the same.
+       Trivia levels have a different one for each answer, any will do. */
+
+    uint8_t bestCount = 0;
+    uint8_t i, j, count;
+    const char *pName;
+
+    sPrefetchState = PREFETCH_NONE;
+    for (i = 0; i < MAX_PLAYERS + 2; i++)
+    {
+      pName = gWinnerNextLevelName[i];
+      if (pName[0] == NUL)
+        continue; /* Not set by the level file. */
+      count = 0;
+      for (j = i; j < MAX_PLAYERS + 2; j++)
+      {
+        if (strcasecmp(pName, gWinnerNextLevelName[j]) == 0)
+          count++;
+      }
+      if (count > bestCount)
+      {
+        bestCount = count;
+        strcpy(sPrefetchName, pName);
+      }
+    }
+
+    if (strcasecmp(sPrefetchName, "Bookmark") == 0)
+      strcpy(sPrefetchName, gBookmarkedLevelName);
+    if (bestCount == 0 || strcasecmp(sPrefetchName, "Quit") == 0)
+      return;
+
+    sPrefetchFileHandle = OpenLocalDataFile(sPrefetchName, "LEVEL");
+    if (sPrefetchFileHandle == BAD_FILE_HANDLE)
+      return;
+    sPrefetchLength = 0;
+    sPrefetchState = PREFETCH_READING;
+    return;
+  }
+
+  if (sPrefetchState != PREFETCH_READING)
+    return;
+
+  amountToRead = LEVEL_PREFETCH_SIZE - sPrefetchLength;
+  if (amountToRead > LEVEL_PREFETCH_CHUNK_SIZE)
+    amountToRead = LEVEL_PREFETCH_CHUNK_SIZE;
+  if (amountToRead == 0)
+  {
+    /* Buffer is full, only done if there's no more in the file. */
+    char extraByte;
+    sPrefetchState = (ReadDataFile(sPrefetchFileHandle, &extraByte, 1) == 0) ?
+      PREFETCH_DONE : PREFETCH_NONE;
+  }
+  else
+  {
+    amountRead = ReadDataFile(sPrefetchFileHandle,
+      sPrefetchBuffer + sPrefetchLength, amountToRead);
+    sPrefetchLength += amountRead;
+    if (amountRead == 0) /* End of file, or an error which looks the same. */
+      sPrefetchState = PREFETCH_DONE;
+  }
+
+  if (sPrefetchState != PREFETCH_READING)
+  {
+    CloseDataFile(sPrefetchFileHandle);
+    sPrefetchFileHandle = BAD_FILE_HANDLE;
+  }
+}
+#endif /* LEVEL_PREFETCH_SIZE */
+
+
 /* Loads the named level file, with the base name in gLevelName.  Will be
    converted to a full file name and searched for locally, on the Nabu server
    and on Alex's web site.  Returns FALSE if it couldn't find the file, or if
@@ -1058,17 +1554,43 @@ bool LoadLevelFile(void)
     return false;
   }
 
+#ifndef NABU_H
+  if (!LevelWordHashesValid())
+    return false; /* Would load levels differently than the NABU does. */
+#endif /* NABU_H */
+
   /* Some things that need to be reset at the start of a level. */
   gVictoryWinningPlayer = MAX_PLAYERS + 2;
   sVictoryTimeoutFrame = 0;
   gLevelDesiredNumberOfPlayers = MAX_PLAYERS;
-
-  sLevelFileHandle = OpenDataFile(gLevelName, "LEVEL", NULL /* No size */);
-  if (sLevelFileHandle == BAD_FILE_HANDLE)
-    return false; /* OpenDataFile will have printed an error message. */
-  DebugPrintString("Now loading level file \"");
-  DebugPrintString(g_TempBuffer);
-  DebugPrintString("\".\n");
+  OpenCacheAgeMissing();
+  PhysicsGovernorReset();
+
+  /* Use the prefetched copy of the level if we have it, otherwise go find the
+     file.  Either way, stop prefetching since it's the wrong level or done. */
+
+#if LEVEL_PREFETCH_SIZE
+  sLevelFromPrefetch = (sPrefetchState == PREFETCH_DONE &&
+    strcasecmp(gLevelName, sPrefetchName) == 0);
+  sPrefetchReadPosition = 0;
+  LevelPrefetchReset();
+  if (sLevelFromPrefetch)
+  {
+    sLevelFileHandle = BAD_FILE_HANDLE;
+    DebugPrintString("Now loading prefetched level \"");
+    DebugPrintString(gLevelName);
+    DebugPrintString("\".\n");
+  }
+  else
+#endif /* LEVEL_PREFETCH_SIZE */
+  {
+    sLevelFileHandle = OpenDataFile(gLevelName, "LEVEL", NULL /* No size */);
+    if (sLevelFileHandle == BAD_FILE_HANDLE)
+      return false; /* OpenDataFile will have printed an error message. */
+    DebugPrintString("Now loading level file \"");
+    DebugPrintString(g_TempBuffer);
+    DebugPrintString("\".\n");
+  }
 
   char levelBuffer[LEVEL_READ_BUFFER_SIZE];
   sLevelBuffer = levelBuffer; /* Save a pointer to the start of the buffer. */
@@ -1076,13 +1598,30 @@ bool LoadLevelFile(void)
   /* Reinitialise our local file buffering system to be empty. */
   sLevelReadPosition = 0;
   sLevelWritePosition = 0;
+  sLevelEndOfFile = false;
 
-  /* Load the level! */
-  bool returnCode = ProcessLevelKeywords();
+  /* Load the level!  A leading NUL means it's a compiled one. */
+  bool returnCode = true;
+  char firstByte = LevelReadByte();
+  if (!sLevelEndOfFile) /* Empty files are valid but do nothing. */
+  {
+    sLevelBinary = (firstByte == NUL);
+    if (sLevelBinary)
+      returnCode = ProcessLevelBinary();
+    else
+    {
+      LevelUndoReadByte();
+      returnCode = ProcessLevelKeywords();
+    }
+    sLevelBinary = false;
+  }
 
   CloseDataFile(sLevelFileHandle);
   sLevelFileHandle = BAD_FILE_HANDLE;
   sLevelBuffer = NULL;
+#if LEVEL_PREFETCH_SIZE
+  sLevelFromPrefetch = false;
+#endif /* LEVEL_PREFETCH_SIZE */
 
   /* Force redraw of all tiles, and in the possibly moved on-screen window.
      Lets you see the tiles, rather than whatever leftover graphics are on
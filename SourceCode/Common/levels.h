@@ -27,6 +27,19 @@
 #define MAX_FILE_NAME_LENGTH 64 /* Maximum for the Nabu Internet Adapter. */
 #define MAX_LEVEL_NAME_LENGTH 32 /* Short names take less memory. */
 
+/* Size of the buffer for reading the likely next level file ahead of time,
+   while the current level is running.  Most level files fit in 2K, bigger
+   ones just get loaded the usual way.  The memory comes out of the space for
+   game tiles, use -DLEVEL_PREFETCH_SIZE=0 on the compiler command line to turn
+   prefetching off and get it back. */
+#ifndef LEVEL_PREFETCH_SIZE
+#define LEVEL_PREFETCH_SIZE 2048
+#endif
+
+/* Amount of the next level file to read on each quiet frame, small enough to
+   not take too much time away from the game. */
+#define LEVEL_PREFETCH_CHUNK_SIZE 128
+
 extern const char kMagicWordCopyright[]; /* Contains "Copyright". */
 extern const char kMagicWordVersion[]; /* Contains "Version". */
 
@@ -64,7 +77,8 @@ extern char gWinnerNextLevelName[MAX_PLAYERS+2][MAX_LEVEL_NAME_LENGTH];
 /* Whoever wins the level has a custom next level base file name.  Mostly
    useful for doing trivia contests.  Though for ordinary use these are all set
    to the same level name.  0 to MAX_PLAYERS-1 are for players.  In button modes
-   0 is left, 1 is down, 2 is right, 3 is up, 4 is fire, 5 is for timeout. */
+   0 is left, 1 is down, 2 is right, 3 is up, MAX_PLAYERS (4 on the NABU) is
+   fire, MAX_PLAYERS+1 is for timeout. */
 
 extern char gBookmarkedLevelName [MAX_LEVEL_NAME_LENGTH];
 /* A level name saved for later use.  Possibly many levels later. */
@@ -85,6 +99,19 @@ extern bool LoadLevelFile(void);
    successfully load garbage without doing anything (you'll end up playing
    the previous level again). */
 
+#if LEVEL_PREFETCH_SIZE
+extern void LevelPrefetchUpdate(void);
+/* Does a bit more of reading the likely next level file into memory, so the
+   next LoadLevelFile() doesn't have to wait for the file to be found and
+   read.  The likely level is the most popular one in gWinnerNextLevelName[].
+   Call it once in a while, when there is spare time in a frame.  Each call
+   either opens the file (only from a bundle or the local store, web sites are
+   too slow) or reads LEVEL_PREFETCH_CHUNK_SIZE bytes of it, and does nothing
+   once the file has been read or if it is too big or not local. */
+#else /* No prefetching, make the hook do nothing. */
+#define LevelPrefetchUpdate()
+#endif /* LEVEL_PREFETCH_SIZE */
+
 extern const char *StockTextMessages(const char *MagicWord);
 /* Returns one of several stock text messages when given a keyword.  May use
    g_TempBuffer or maybe not.  Returns your MagicWord if it doesn't know
@@ -23,6 +23,7 @@
 #include "scores.h"
 #include "soundscreen.h"
 #include "levels.h"
+#include "rollback.h"
 
 #ifdef NABU_H
 #include "Art/NthPong1.h" /* Artwork data definitions for player sprites. */
@@ -66,6 +67,9 @@ fx g_SeparationVelocityFxAdd;
 fx g_SeparationVelocityFxStepAdd;
 
 uint8_t g_PhysicsStepSizeLimit = 16;
+uint8_t g_PhysicsStepSizeLimitMax = 0;
+uint8_t g_PhysicsGovernorStepExtra = 0;
+uint8_t g_PhysicsGovernorFrictionExtra = 0;
 
 uint8_t g_PhysicsTurnRate = 6;
 fx g_TurnRateFx;
@@ -185,6 +189,10 @@ target_list_item_record g_target_list[] = {
 uint8_t g_target_start_indices[MAX_PLAYERS] =
 {30, 40, 0, 30};
 
+/* Extra players borrow the settings of the first 4, and their tile owners
+   have to fit in a byte along with the walls and power-ups. */
+COMPILER_VERIFY(MAX_PLAYERS >= 4 && MAX_PLAYERS <= 64);
+
 
 /* Set up the initial player data at the beginning of a game (series of levels),
    mostly colours and animations, and score counters. */
@@ -218,6 +226,13 @@ void InitialisePlayers(void)
     pPlayer->starting_level_pixel_x = pixelCoord;
     pPlayer->starting_level_pixel_y = pixelCoord;
     pixelCoord += 32;
+#if MAX_PLAYERS > 4
+    if (iPlayer >= 4) /* Extra players in a grid that fits the NABU screen. */
+    {
+      pPlayer->starting_level_pixel_x = 16 + 24 * (iPlayer & 7);
+      pPlayer->starting_level_pixel_y = 16 + 24 * (iPlayer >> 3);
+    }
+#endif
 
     /* Make them all inactive players.  AI players get added later while the
        game runs. */
@@ -229,7 +244,7 @@ void InitialisePlayers(void)
 #ifdef NABU_H
       k_PLAYER_COLOURS[iPlayer].main;
 #else /* ncurses uses 1 to 4.  init_pair() sets it up, 0 for B&W text. */
-      iPlayer + 1;
+      (iPlayer & PLAYER_GROUP_MASK) + 1;
 #endif
 
 #ifdef NABU_H
@@ -304,6 +319,7 @@ void InitialisePlayersForNewLevel(void)
 }
 
 
+#ifdef NABU_H
 static void UpdateOneAnimation(SpriteAnimPointer pAnim)
 {
   if (pAnim->current_delay == 0)
@@ -318,6 +334,7 @@ static void UpdateOneAnimation(SpriteAnimPointer pAnim)
     pAnim->current_delay--;
   }
 }
+#endif /* NABU_H */
 
 
 /* Update animations for the next frame.  Also convert location of the player
@@ -326,21 +343,23 @@ void UpdatePlayerAnimations(void)
 {
   uint8_t iPlayer;
   player_pointer pPlayer;
+#ifdef NABU_H
   int16_t screenX;
   int16_t screenY;
+#endif /* NABU_H */
 
   pPlayer = g_player_array;
   for (iPlayer = MAX_PLAYERS; iPlayer-- != 0; pPlayer++)
   {
     if (pPlayer->brain != ((player_brain) BRAIN_INACTIVE))
     {
+#ifdef NABU_H
       /* Update player's animation to show which direction they are pointing
          towards, rather than just animating by time. */
 
       pPlayer->main_anim.current_name = pPlayer->main_anim.first_name +
         pPlayer->velocity_octant * 4 /* 4 characters per 16x16 sprite. */;
 
-#ifdef NABU_H
       if (pPlayer->sparkle_anim.type != ((SpriteAnimationType) SPRITE_ANIM_NONE))
         UpdateOneAnimation(&pPlayer->sparkle_anim);
 
@@ -438,6 +457,39 @@ static uint8_t JoystickForOctant(uint8_t desired_octant)
 }
 
 
+/* How TurnVelocityTowardsOctant() moves the velocity towards an octant,
+   indexed by the octant number times two, plus one if turning clockwise.  The
+   velocity component being reduced (the one from the octant we're leaving)
+   is X or Y, and the sign it has in that part of the circle says whether
+   reducing it means adding or subtracting.  Same for the other component,
+   which grows.  The odd octants are the diagonals, where we stop turning once
+   both components have the same magnitude, rather than at zero. */
+#define TURN_FROM_Y 1 /* Reduce Y and grow X, otherwise reduce X, grow Y. */
+#define TURN_FROM_NEGATIVE 2 /* The reduced component is negative. */
+#define TURN_TO_NEGATIVE 4 /* The growing component is negative. */
+#define TURN_DIAGONAL 8 /* Heading for a diagonal octant, not an axis. */
+
+static const uint8_t kTurnTowardsOctant[16] = {
+  TURN_FROM_Y, /* Octant 0 counterclockwise, from +Y towards +X. */
+  TURN_FROM_Y | TURN_FROM_NEGATIVE, /* 0 clockwise, -Y to +X. */
+  TURN_DIAGONAL | TURN_FROM_Y, /* 1 counterclockwise, +Y to +X. */
+  TURN_DIAGONAL, /* 1 clockwise, +X to +Y. */
+  TURN_FROM_NEGATIVE, /* 2 counterclockwise, -X to +Y. */
+  0, /* 2 clockwise, +X to +Y. */
+  TURN_DIAGONAL | TURN_FROM_NEGATIVE, /* 3 counterclockwise, -X to +Y. */
+  TURN_DIAGONAL | TURN_FROM_Y | TURN_TO_NEGATIVE, /* 3 clockwise, +Y to -X. */
+  TURN_FROM_Y | TURN_FROM_NEGATIVE | TURN_TO_NEGATIVE, /* 4 ccw, -Y to -X. */
+  TURN_FROM_Y | TURN_TO_NEGATIVE, /* 4 clockwise, +Y to -X. */
+  TURN_DIAGONAL | TURN_FROM_Y | TURN_FROM_NEGATIVE |
+    TURN_TO_NEGATIVE, /* 5 counterclockwise, -Y to -X. */
+  TURN_DIAGONAL | TURN_FROM_NEGATIVE | TURN_TO_NEGATIVE, /* 5 cw, -X to -Y. */
+  TURN_TO_NEGATIVE, /* 6 counterclockwise, +X to -Y. */
+  TURN_FROM_NEGATIVE | TURN_TO_NEGATIVE, /* 6 clockwise, -X to -Y. */
+  TURN_DIAGONAL | TURN_TO_NEGATIVE, /* 7 counterclockwise, +X to -Y. */
+  TURN_DIAGONAL | TURN_FROM_Y | TURN_FROM_NEGATIVE, /* 7 clockwise, -Y to +X. */
+};
+
+
 /* Rotate the player's velocity values towards an octant angle direction.
    Prerequisite: player's velocity_octant is up to date.
 */
@@ -540,232 +592,92 @@ head_towards_octant, head_clockwise);
     COPY_FX(g_TurnRateFx, turnAmount);
   }
 
-  switch (head_towards_octant)
-  {
-    case 0:
-      if (head_clockwise)
-      { /* Reduce negative Y towards 0, add to positive X. */
-        fx positiveY;
-        COPY_NEGATE_FX(pPlayer->velocity_y, positiveY);
-        if (COMPARE_FX(positiveY, turnAmount) < 0)
-          COPY_FX(positiveY, turnAmount); /* Limited by available Y. */
-        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-      }
-      else
-      { /* Reduce positive Y towards 0, add to positive X. */
-        if (COMPARE_FX(pPlayer->velocity_y, turnAmount) < 0)
-          COPY_FX(pPlayer->velocity_y, turnAmount);
-        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-      }
-      break;
+  /* Look up how to turn towards that octant, then do it with the one bit of
+     code for all cases.  The reduced component is moved towards zero, or
+     towards having the same magnitude as the other component if heading for a
+     diagonal octant, and the other component grows by the same amount. */
 
-    case 1:
-      if (head_clockwise)
-      { /* Reduce positive X, add to positive Y until equal balance. */
-        fx balance;
-        SUBTRACT_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y|
-             Note that we can't just subtract/add the half balance from both,
-             since there could be rounding errors in the last bit. */
-          DIV2_FX(balance);
-          SUBTRACT_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
-          COPY_FX(pPlayer->velocity_x, pPlayer->velocity_y);
-        }
-        else
-        {
-          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        }
-      }
-      else
-      { /* Reduce positive Y, add to positive X until equal balance. */
-        fx balance;
-        SUBTRACT_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          SUBTRACT_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
-          COPY_FX(pPlayer->velocity_y, pPlayer->velocity_x);
-        }
-        else
-        {
-          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        }
-      }
-      break;
+  static fx available; /* How far we can turn before overshooting. */
+  pfx pFrom, pTo;
+  uint8_t turnFlags;
 
-    case 2:
-      if (head_clockwise)
-      { /* Reduce positive X towards 0, add to positive Y. */
-        if (COMPARE_FX(pPlayer->velocity_x, turnAmount) < 0)
-          COPY_FX(pPlayer->velocity_x, turnAmount);
-        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-      }
-      else
-      { /* Reduce negative X towards 0, add to positive Y. */
-        fx positiveX;
-        COPY_NEGATE_FX(pPlayer->velocity_x, positiveX);
-        if (COMPARE_FX(positiveX, turnAmount) < 0)
-          COPY_FX(positiveX, turnAmount);
-        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-      }
-      break;
-
-    case 3:
-      if (head_clockwise)
-      { /* Reduce positive Y, increase negative X until equal balance. */
-        fx balance;
-        ADD_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          SUBTRACT_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
-          COPY_NEGATE_FX(pPlayer->velocity_y, pPlayer->velocity_x);
-        }
-        else
-        {
-          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        }
-      }
-      else
-      { /* Reduce negative X, increase positive Y until equal balance. */
-        fx balance;
-        ADD_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
-        NEGATE_FX(balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          ADD_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
-          COPY_NEGATE_FX(pPlayer->velocity_x, pPlayer->velocity_y);
-        }
-        else
-        {
-          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        }
-      }
-      break;
-
-    case 4:
-      if (head_clockwise)
-      { /* Reduce positive Y towards 0, increase negative X. */
-        if (COMPARE_FX(pPlayer->velocity_y, turnAmount) < 0)
-          COPY_FX(pPlayer->velocity_y, turnAmount);
-        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-      }
-      else
-      { /* Reduce negative Y towards 0, increase negative X. */
-        fx positiveY;
-        COPY_NEGATE_FX(pPlayer->velocity_y, positiveY);
-        if (COMPARE_FX(positiveY, turnAmount) < 0)
-          COPY_FX(positiveY, turnAmount);
-        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-      }
-      break;
+  turnFlags = kTurnTowardsOctant[(head_towards_octant & 7) * 2 +
+    (head_clockwise ? 1 : 0)];
+  if (turnFlags & TURN_FROM_Y)
+  {
+    pFrom = &pPlayer->velocity_y;
+    pTo = &pPlayer->velocity_x;
+  }
+  else
+  {
+    pFrom = &pPlayer->velocity_x;
+    pTo = &pPlayer->velocity_y;
+  }
 
-    case 5:
-      if (head_clockwise)
-      { /* Reduce negative X, increase negative Y until equal balance. */
-        fx balance;
-        SUBTRACT_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
-        NEGATE_FX(balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          ADD_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
-          COPY_FX(pPlayer->velocity_x, pPlayer->velocity_y);
-        }
-        else
-        {
-          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        }
-      }
-      else
-      { /* Reduce negative Y, increase negative X until equal balance. */
-        fx balance;
-        SUBTRACT_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
-        NEGATE_FX(balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          ADD_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
-          COPY_FX(pPlayer->velocity_y, pPlayer->velocity_x);
-        }
-        else
-        {
-          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        }
-      }
-      break;
+  if (turnFlags & TURN_FROM_NEGATIVE)
+  {
+    COPY_NEGATE_FX(*pFrom, available);
+  }
+  else
+  {
+    COPY_FX(*pFrom, available);
+  }
+  if (turnFlags & TURN_DIAGONAL)
+  { /* Subtract the other magnitude, leaving the balance between them. */
+    if (turnFlags & TURN_TO_NEGATIVE)
+    {
+      ADD_FX(available, *pTo, available);
+    }
+    else
+    {
+      SUBTRACT_FX(available, *pTo, available);
+    }
+  }
 
-    case 6:
-      if (head_clockwise)
-      { /* Reduce negative X towards 0, increase negative Y. */
-        fx positiveX;
-        COPY_NEGATE_FX(pPlayer->velocity_x, positiveX);
-        if (COMPARE_FX(positiveX, turnAmount) < 0)
-          COPY_FX(positiveX, turnAmount);
-        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+  if (COMPARE_FX(available, turnAmount) < 0)
+  {
+    if (turnFlags & TURN_DIAGONAL)
+    { /* Make it be exactly on the octant diagonal line, with |X|==|Y|
+         Note that we can't just subtract/add the half balance from both,
+         since there could be rounding errors in the last bit. */
+      DIV2_FX(available);
+      if (turnFlags & TURN_FROM_NEGATIVE)
+      {
+        ADD_FX(*pFrom, available, *pFrom);
       }
       else
-      { /* Reduce positive X towards 0, increase negative Y. */
-        if (COMPARE_FX(pPlayer->velocity_x, turnAmount) < 0)
-          COPY_FX(pPlayer->velocity_x, turnAmount);
-        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+      {
+        SUBTRACT_FX(*pFrom, available, *pFrom);
       }
-      break;
-
-    case 7:
-      if (head_clockwise)
-      { /* Reduce negative Y, increase positive X until equal balance. */
-        fx balance;
-        ADD_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
-        NEGATE_FX(balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          ADD_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
-          COPY_NEGATE_FX(pPlayer->velocity_y, pPlayer->velocity_x);
-        }
-        else
-        {
-          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-        }
+      if (((turnFlags & TURN_FROM_NEGATIVE) != 0) ==
+      ((turnFlags & TURN_TO_NEGATIVE) != 0))
+      {
+        COPY_FX(*pFrom, *pTo);
       }
       else
-      { /* Reduce positive X, increase negative Y until equal balance. */
-        fx balance;
-        ADD_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
-        if (COMPARE_FX(balance, turnAmount) < 0)
-        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
-          DIV2_FX(balance);
-          SUBTRACT_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
-          COPY_NEGATE_FX(pPlayer->velocity_x, pPlayer->velocity_y);
-        }
-        else
-        {
-          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
-          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
-        }
+      {
+        COPY_NEGATE_FX(*pFrom, *pTo);
       }
-      break;
+      return;
+    }
+    COPY_FX(available, turnAmount); /* Limited by what's left to reduce. */
+  }
 
-    default:
-      break;
+  if (turnFlags & TURN_FROM_NEGATIVE)
+  {
+    ADD_FX(*pFrom, turnAmount, *pFrom);
+  }
+  else
+  {
+    SUBTRACT_FX(*pFrom, turnAmount, *pFrom);
+  }
+  if (turnFlags & TURN_TO_NEGATIVE)
+  {
+    SUBTRACT_FX(*pTo, turnAmount, *pTo);
+  }
+  else
+  {
+    ADD_FX(*pTo, turnAmount, *pTo);
   }
 }
 
@@ -1052,7 +964,7 @@ static void BrainUpdateJoystick(player_pointer pPlayer)
         enough for a diversion.  Bad ones we ignore, no avoidance behaviour
         yet. */
 
-      int16_t bestDistance = 0x7FFF; /* Maximum positive value of int16. */
+      int16_t bestDistance = powerUpMaxPixelDistance + 1; /* Too far. */
       tile_pointer bestTile = NULL;
 
       tile_owner powerup_type;
@@ -1067,7 +979,10 @@ static void BrainUpdateJoystick(player_pointer pPlayer)
           if (pTile == NULL)
             break; /* End of this list. */
 
-          /* Find the distance to the powerup. */
+          /* Find the distance to the powerup.  The true distance is at
+             least 0.707 of the sum of the absolute deltas (a bit less when
+             approximated), so skip working it out if 0.625 of that sum is
+             already too far. */
 
           int16_t deltaX = pTile->pixel_center_x - playerX;
           int16_t deltaY = pTile->pixel_center_y - playerY;
@@ -1083,6 +998,10 @@ static void BrainUpdateJoystick(player_pointer pPlayer)
           else
             distance += deltaY;
 
+          if ((distance >> 1) + (distance >> 3) >= bestDistance)
+            continue;
+          distance = INT16_VECTOR_LENGTH(deltaX, deltaY);
+
           if (distance < bestDistance)
           {
             bestDistance = distance;
@@ -1137,22 +1056,24 @@ static void BrainUpdateJoystick(player_pointer pPlayer)
     int16_t deltaX = pPlayer->brain_info.algo.target_pixel_x - playerX;
     int16_t deltaY = pPlayer->brain_info.algo.target_pixel_y - playerY;
 
-    /* Get sum of absolute values of deltas to find distance. */
+    /* Use the true distance.  The sum of absolute values of the deltas made
+       diagonal approaches look 1.4 times as far as they are, so the AI had
+       to get closer to count as arriving, and often overshot instead. */
 
-    int16_t targetDistance;
-    if (deltaX < 0)
-      targetDistance = -deltaX;
-    else
-      targetDistance = deltaX;
-    if (deltaY < 0)
-      targetDistance -= deltaY;
-    else
-      targetDistance += deltaY;
-    pPlayer->brain_info.algo.target_distance = targetDistance;
+    pPlayer->brain_info.algo.target_distance =
+      INT16_VECTOR_NORMALISE(&deltaX, &deltaY);
 
-    /* Steer in the desired direction.  Don't steer (no joystick input) if
+    /* Steer in the desired direction, less the current direction of motion
+       (both as unit vectors), so that sideways drift gets cancelled rather
+       than carrying us past the target.  Don't steer (no joystick input) if
        already going in that direction to save on CPU. */
 
+    int16_t velocityX = MUL4INT_FX(pPlayer->velocity_x);
+    int16_t velocityY = MUL4INT_FX(pPlayer->velocity_y);
+    INT16_VECTOR_NORMALISE(&velocityX, &velocityY);
+    deltaX += deltaX - velocityX;
+    deltaY += deltaY - velocityY;
+
     uint8_t steerDirection = (INT16_TO_OCTANT(deltaX, deltaY) & 7);
     if (pPlayer->velocity_octant != steerDirection)
       joystickOutput |= JoystickForOctant(steerDirection);
@@ -1230,6 +1151,19 @@ void UpdatePlayerInputs(void)
     if (pPlayer->brain == ((player_brain) BRAIN_INACTIVE))
       continue;
 
+#if ROLLBACK_NETCODE
+    /* Remote players use the real input if it has arrived, else a guess.
+       When replaying frames after a rollback, everybody except the AIs uses
+       the recorded inputs, rather than what the devices are doing now. */
+    if (pPlayer->brain == ((player_brain) BRAIN_NETWORK) ||
+    (g_RollbackResimulating &&
+    pPlayer->brain != ((player_brain) BRAIN_ALGORITHM)))
+    {
+      pPlayer->joystick_inputs = RollbackInputForPlayer(iPlayer);
+      continue;
+    }
+#endif /* ROLLBACK_NETCODE */
+
     if (pPlayer->brain == ((player_brain) BRAIN_KEYBOARD))
     {
       pPlayer->joystick_inputs = g_KeyboardFakeJoystickStatus;
@@ -1254,14 +1188,21 @@ void UpdatePlayerInputs(void)
     }
 
     /* One of the fancier brains, do algorithmic joystick simulation.  But only
-       update one AI each frame to save on CPU time. */
+       update one AI each frame (one per group of 4 players in big games) to
+       save on CPU time. */
     if (pPlayer->brain == ((player_brain) BRAIN_ALGORITHM))
     {
-      if (iPlayer == (g_FrameCounter & MAX_PLAYERS_MASK))
+      if ((iPlayer & PLAYER_GROUP_MASK) ==
+      ((uint8_t) g_FrameCounter & PLAYER_GROUP_MASK))
         BrainUpdateJoystick(pPlayer);
       continue;
     }
 
+    /* Remote players have their joystick_inputs set directly by the network
+       code, whenever a message arrives. */
+    if (pPlayer->brain == ((player_brain) BRAIN_NETWORK))
+      continue;
+
     /* Unimplemented type of user input source, do nothing. */
     pPlayer->joystick_inputs = 0;
   }
@@ -1275,6 +1216,9 @@ void UpdatePlayerInputs(void)
     if (input_consumed[iInput])
       continue; /* Input already used up by an assigned player. */
 
+    if (g_RollbackResimulating)
+      break; /* Live inputs don't apply to frames being replayed. */
+
     if (iInput < 4)
       joyStickData = g_JoystickStatus[iInput];
     else
@@ -1507,19 +1451,31 @@ void UpdatePlayerInputs(void)
       if (pPlayer->speed >= g_FrictionSpeed)
       {
         static fx portionOfVelocity;
+        uint8_t frictionShift;
+
+        frictionShift = g_FrictionShift;
+        if (frictionShift > PHYSICS_GOVERNOR_MIN_FRICTION_SHIFT)
+        {
+          if (frictionShift - PHYSICS_GOVERNOR_MIN_FRICTION_SHIFT >
+          g_PhysicsGovernorFrictionExtra)
+            frictionShift -= g_PhysicsGovernorFrictionExtra;
+          else
+            frictionShift = PHYSICS_GOVERNOR_MIN_FRICTION_SHIFT;
+        }
 
         COPY_FX(pPlayer->velocity_x, portionOfVelocity);
-        DIV2Nth_FX(portionOfVelocity, g_FrictionShift);
+        DIV2Nth_FX(portionOfVelocity, frictionShift);
         SUBTRACT_FX(pPlayer->velocity_x, portionOfVelocity,
           pPlayer->velocity_x);
 
         COPY_FX(pPlayer->velocity_y, portionOfVelocity);
-        DIV2Nth_FX(portionOfVelocity, g_FrictionShift);
+        DIV2Nth_FX(portionOfVelocity, frictionShift);
         SUBTRACT_FX(pPlayer->velocity_y, portionOfVelocity,
           pPlayer->velocity_y);
       }
   #endif
 
+#ifdef NABU_H
       /* Update special effect animations, mostly for feedback to the player.
          Note the priority order implied, though in future we could have more
          sparkle animations active simultaneously. */
@@ -1553,6 +1509,7 @@ void UpdatePlayerInputs(void)
          pPlayer->sparkle_anim.current_name =
           SPRITE_ANIM_BALL_EFFECT_THRUST_BOLD_FRAME;
       }
+#endif /* NABU_H */
     }
   }
 }
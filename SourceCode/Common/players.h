@@ -35,14 +35,13 @@
 
 #include "fixed_point.h"
 
-/* The maximum number of players allowed.  On the NABU, it's limited to 4 due to
-   colour palette limits and the maximum number of visible sprites (4 visible,
-   more per scan line don't get drawn, and we use sprites for balls).  For bit
-   masking reasons, should be a power of two. */
-#define MAX_PLAYERS 4
-
-/* Bits for masking off a counter to have values from 0 to MAX_PLAYERS-1. */
-#define MAX_PLAYERS_MASK 3
+/* Players take turns at things done every few frames (AI updates, power-up
+   timers) in groups of 4, using the player number masked with this, so each
+   player gets a turn every 4th frame no matter how many players there are.
+   Extra players also use it to pick which of the first 4 players they copy
+   level file settings from.  MAX_PLAYERS itself is defined in tiles.h, since
+   the tile owners need it. */
+#define PLAYER_GROUP_MASK 3
 
 /* Variable sized balls are problematic.  Having in-between sizes doesn't add
    much to the game, just a few ones are great for sweeping out large areas.
@@ -476,6 +475,21 @@ extern fx g_SeparationVelocityFxStepAdd;
    impenetrable should keep this at 16.  Minimum value is 1. */
 extern uint8_t g_PhysicsStepSizeLimit;
 
+/* The physics governor (see PhysicsGovernorUpdate() in simulate.c) can raise
+   the step size limit actually used, up to g_PhysicsStepSizeLimitMax, when
+   updates are taking longer than a game tick.  That trades some collision
+   accuracy for frame rate, rather than going into slow bullet time.  If that
+   isn't enough, it adds friction by lowering the friction shift.  Both extras
+   go back to zero when there is time to spare.  A maximum of zero (or not
+   more than g_PhysicsStepSizeLimit) turns the governor off, the default.
+   Set by the optional second number of the PhysicsMoreStepsSpeed keyword.
+   The extra friction never takes the shift below
+   PHYSICS_GOVERNOR_MIN_FRICTION_SHIFT, or the level's shift if that's lower. */
+extern uint8_t g_PhysicsStepSizeLimitMax;
+extern uint8_t g_PhysicsGovernorStepExtra;
+extern uint8_t g_PhysicsGovernorFrictionExtra;
+#define PHYSICS_GOVERNOR_MIN_FRICTION_SHIFT 4 /* Velocity/16 per frame. */
+
 /* How fast can the players turn?  Measured in quarter pixels per frame.  If
    you're moving too fast, you have a wider turn.  If your speed is less than
    this, you have a sharp turn.  Set to zero to have decent but not super sharp
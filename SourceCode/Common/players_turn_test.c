@@ -0,0 +1,503 @@
+/* Checks the table driven TurnVelocityTowardsOctant() against the old one.
+ * Copyright © 2026 by Alexander G. M. Smith.
+ *
+ * TurnVelocityTowardsOctant() in players.c used to be a switch with a case for
+ * each octant and turn direction, 16 nearly identical bits of code.  Now it
+ * looks up the signs and which component to reduce in a table, and runs one
+ * bit of code.  This runs both versions on the development machine for every
+ * current octant, right on flag, desired octant and turn rate setting, with
+ * lots of velocities (edge cases, diagonals and random ones) and random
+ * turn amounts, and complains if the resulting velocities differ at all.
+ *
+ * Compile and run in the Common directory with:
+ *
+ * gcc -g -O2 -Wall -o players_turn_test players_turn_test.c && ./players_turn_test
+ *
+ * Options are -n Count for the number of random velocities (default 20000)
+ * and -s Seed for the random numbers.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code, so the static functions can be called. */
+#include "cverify.h"
+#include "fixed_point.c"
+#include "debug_print.c"
+#include "tiles.c"
+#include "players.c"
+#include "simulate.c"
+#include "scores.c"
+#include "soundscreen.c"
+#include "levels.c"
+
+/* Velocities are kept within this many pixels per update, plenty more than
+   the game ever reaches, so the math doesn't overflow. */
+#define TEST_MAX_SPEED 64
+
+static unsigned long s_Cases;
+static unsigned long s_Failures;
+
+
+/*******************************************************************************
+ * The switch statement version of TurnVelocityTowardsOctant(), as it was
+ * before the table driven rewrite, minus the debug printfs.
+ */
+static void OldTurnVelocityTowardsOctant(player_pointer pPlayer,
+  uint8_t desired_octant)
+{
+  uint8_t head_towards_octant = 0;
+  bool head_clockwise = false;
+  bool heading_found = false;
+  uint8_t currentLowerOctant, currentUpperOctant;
+  currentLowerOctant = pPlayer->velocity_octant;
+  currentUpperOctant = ((currentLowerOctant + 1) & 0x07);
+
+
+  if (desired_octant == currentUpperOctant)
+  {
+    head_towards_octant = desired_octant;
+    head_clockwise = true;
+    heading_found = true;
+  }
+  else if (desired_octant == currentLowerOctant)
+  {
+    head_towards_octant = desired_octant;
+    head_clockwise = false;
+    heading_found = true;
+  }
+  else if (pPlayer->velocity_octant_right_on)
+  {
+    /* Widen the angles being considered, since we're exactly on
+       currentLowerOctant and want to go past it to the next lower octant. */
+
+    currentLowerOctant = ((currentLowerOctant - 1) & 0x07);
+    if (desired_octant == currentLowerOctant)
+    {
+      head_towards_octant = currentLowerOctant;
+      head_clockwise = false;
+      heading_found = true;
+    }
+  }
+
+  /* Not currently near the desired octant, pick closest one. */
+
+  if (!heading_found)
+  {
+    uint8_t lowerDelta, upperDelta;
+
+    /* Counterclockwise distance from current lower to desired octant. */
+    lowerDelta = ((currentLowerOctant - desired_octant) & 7);
+
+    /* Clockwise rotation amount from current upper to desired octant. */
+    upperDelta = ((desired_octant - currentUpperOctant) & 7);
+    if (lowerDelta < upperDelta)
+    {
+      head_towards_octant = currentLowerOctant;
+      head_clockwise = false;
+    }
+    else
+    {
+      head_towards_octant = currentUpperOctant;
+      head_clockwise = true;
+    }
+  }
+
+
+  /* Set the maximum amount to move between axis (turnAmount), larger
+     makes for faster rotations. */
+
+  static fx turnAmount; /* Static faster code than having it on the stack. */
+
+  if (g_PhysicsTurnRate == 0) /* Means calculate it based on velocity. */
+  {
+    COPY_FX(pPlayer->velocity_x, turnAmount);
+    ABS_FX(turnAmount);
+    if (IS_NEGATIVE_FX(pPlayer->velocity_y))
+    { /* Macro for SUBTRACT_FX can be { stuff }, so use extra {} around it. */
+      SUBTRACT_FX(turnAmount, pPlayer->velocity_y, turnAmount);
+    }
+    else
+    {
+      ADD_FX(turnAmount, pPlayer->velocity_y, turnAmount);
+    }
+    DIV2_FX(turnAmount); /* Don't make turns too boringly sharp. */
+  }
+  else /* Using a constant turn rate limit. */
+  {
+    COPY_FX(g_TurnRateFx, turnAmount);
+  }
+
+  switch (head_towards_octant)
+  {
+    case 0:
+      if (head_clockwise)
+      { /* Reduce negative Y towards 0, add to positive X. */
+        fx positiveY;
+        COPY_NEGATE_FX(pPlayer->velocity_y, positiveY);
+        if (COMPARE_FX(positiveY, turnAmount) < 0)
+          COPY_FX(positiveY, turnAmount); /* Limited by available Y. */
+        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+      }
+      else
+      { /* Reduce positive Y towards 0, add to positive X. */
+        if (COMPARE_FX(pPlayer->velocity_y, turnAmount) < 0)
+          COPY_FX(pPlayer->velocity_y, turnAmount);
+        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+      }
+      break;
+
+    case 1:
+      if (head_clockwise)
+      { /* Reduce positive X, add to positive Y until equal balance. */
+        fx balance;
+        SUBTRACT_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y|
+             Note that we can't just subtract/add the half balance from both,
+             since there could be rounding errors in the last bit. */
+          DIV2_FX(balance);
+          SUBTRACT_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
+          COPY_FX(pPlayer->velocity_x, pPlayer->velocity_y);
+        }
+        else
+        {
+          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        }
+      }
+      else
+      { /* Reduce positive Y, add to positive X until equal balance. */
+        fx balance;
+        SUBTRACT_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          SUBTRACT_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
+          COPY_FX(pPlayer->velocity_y, pPlayer->velocity_x);
+        }
+        else
+        {
+          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        }
+      }
+      break;
+
+    case 2:
+      if (head_clockwise)
+      { /* Reduce positive X towards 0, add to positive Y. */
+        if (COMPARE_FX(pPlayer->velocity_x, turnAmount) < 0)
+          COPY_FX(pPlayer->velocity_x, turnAmount);
+        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+      }
+      else
+      { /* Reduce negative X towards 0, add to positive Y. */
+        fx positiveX;
+        COPY_NEGATE_FX(pPlayer->velocity_x, positiveX);
+        if (COMPARE_FX(positiveX, turnAmount) < 0)
+          COPY_FX(positiveX, turnAmount);
+        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+      }
+      break;
+
+    case 3:
+      if (head_clockwise)
+      { /* Reduce positive Y, increase negative X until equal balance. */
+        fx balance;
+        ADD_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          SUBTRACT_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
+          COPY_NEGATE_FX(pPlayer->velocity_y, pPlayer->velocity_x);
+        }
+        else
+        {
+          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        }
+      }
+      else
+      { /* Reduce negative X, increase positive Y until equal balance. */
+        fx balance;
+        ADD_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
+        NEGATE_FX(balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          ADD_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
+          COPY_NEGATE_FX(pPlayer->velocity_x, pPlayer->velocity_y);
+        }
+        else
+        {
+          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        }
+      }
+      break;
+
+    case 4:
+      if (head_clockwise)
+      { /* Reduce positive Y towards 0, increase negative X. */
+        if (COMPARE_FX(pPlayer->velocity_y, turnAmount) < 0)
+          COPY_FX(pPlayer->velocity_y, turnAmount);
+        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+      }
+      else
+      { /* Reduce negative Y towards 0, increase negative X. */
+        fx positiveY;
+        COPY_NEGATE_FX(pPlayer->velocity_y, positiveY);
+        if (COMPARE_FX(positiveY, turnAmount) < 0)
+          COPY_FX(positiveY, turnAmount);
+        ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+      }
+      break;
+
+    case 5:
+      if (head_clockwise)
+      { /* Reduce negative X, increase negative Y until equal balance. */
+        fx balance;
+        SUBTRACT_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
+        NEGATE_FX(balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          ADD_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
+          COPY_FX(pPlayer->velocity_x, pPlayer->velocity_y);
+        }
+        else
+        {
+          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        }
+      }
+      else
+      { /* Reduce negative Y, increase negative X until equal balance. */
+        fx balance;
+        SUBTRACT_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
+        NEGATE_FX(balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          ADD_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
+          COPY_FX(pPlayer->velocity_y, pPlayer->velocity_x);
+        }
+        else
+        {
+          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        }
+      }
+      break;
+
+    case 6:
+      if (head_clockwise)
+      { /* Reduce negative X towards 0, increase negative Y. */
+        fx positiveX;
+        COPY_NEGATE_FX(pPlayer->velocity_x, positiveX);
+        if (COMPARE_FX(positiveX, turnAmount) < 0)
+          COPY_FX(positiveX, turnAmount);
+        ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+      }
+      else
+      { /* Reduce positive X towards 0, increase negative Y. */
+        if (COMPARE_FX(pPlayer->velocity_x, turnAmount) < 0)
+          COPY_FX(pPlayer->velocity_x, turnAmount);
+        SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+      }
+      break;
+
+    case 7:
+      if (head_clockwise)
+      { /* Reduce negative Y, increase positive X until equal balance. */
+        fx balance;
+        ADD_FX(pPlayer->velocity_y, pPlayer->velocity_x, balance);
+        NEGATE_FX(balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          ADD_FX(pPlayer->velocity_y, balance, pPlayer->velocity_y);
+          COPY_NEGATE_FX(pPlayer->velocity_y, pPlayer->velocity_x);
+        }
+        else
+        {
+          ADD_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+          ADD_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+        }
+      }
+      else
+      { /* Reduce positive X, increase negative Y until equal balance. */
+        fx balance;
+        ADD_FX(pPlayer->velocity_x, pPlayer->velocity_y, balance);
+        if (COMPARE_FX(balance, turnAmount) < 0)
+        { /* Make it be exactly on the octant diagonal line, with |X|==|Y| */
+          DIV2_FX(balance);
+          SUBTRACT_FX(pPlayer->velocity_x, balance, pPlayer->velocity_x);
+          COPY_NEGATE_FX(pPlayer->velocity_x, pPlayer->velocity_y);
+        }
+        else
+        {
+          SUBTRACT_FX(pPlayer->velocity_y, turnAmount, pPlayer->velocity_y);
+          SUBTRACT_FX(pPlayer->velocity_x, turnAmount, pPlayer->velocity_x);
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/*******************************************************************************
+ * Returns a random number, with a random number of pixels (some small, some
+ * large) and a random fraction, either sign.
+ */
+static int32_t RandomFx(void)
+{
+  int32_t value;
+
+  value = ((int32_t) (rand() & 0xFFFF) << 16) | (rand() & 0xFFFF);
+  value >>= rand() % 32; /* Mostly small numbers, with a few big ones. */
+  value %= (int32_t) TEST_MAX_SPEED << FX_BITS_FRACTION;
+  return value;
+}
+
+
+/*******************************************************************************
+ * Try one velocity with every octant, right on flag, desired octant and turn
+ * rate setting.  The turn amount is used when the turn rate is not zero.
+ */
+static void TestVelocity(int32_t velocityX, int32_t velocityY,
+  int32_t turnAmount)
+{
+  player_pointer pPlayer = g_player_array;
+  uint8_t currentOctant, desiredOctant;
+  uint8_t rightOn, turnRate;
+  fx oldX, oldY;
+
+  for (turnRate = 0; turnRate < 2; turnRate++)
+  for (currentOctant = 0; currentOctant < 8; currentOctant++)
+  for (rightOn = 0; rightOn < 2; rightOn++)
+  for (desiredOctant = 0; desiredOctant < 8; desiredOctant++)
+  {
+    g_PhysicsTurnRate = turnRate;
+    g_TurnRateFx.as_int = turnAmount;
+    pPlayer->velocity_octant = currentOctant;
+    pPlayer->velocity_octant_right_on = rightOn;
+
+    pPlayer->velocity_x.as_int = velocityX;
+    pPlayer->velocity_y.as_int = velocityY;
+    OldTurnVelocityTowardsOctant(pPlayer, desiredOctant);
+    COPY_FX(pPlayer->velocity_x, oldX);
+    COPY_FX(pPlayer->velocity_y, oldY);
+
+    pPlayer->velocity_x.as_int = velocityX;
+    pPlayer->velocity_y.as_int = velocityY;
+    TurnVelocityTowardsOctant(pPlayer, desiredOctant);
+
+    s_Cases++;
+    if (pPlayer->velocity_x.as_int != oldX.as_int ||
+    pPlayer->velocity_y.as_int != oldY.as_int)
+    {
+      if (s_Failures++ < 20)
+        printf("Velocity (%f, %f) octant %d right on %d desired %d turn rate "
+          "%d amount %f gave (%f, %f), should be (%f, %f).\n",
+          velocityX / FX_UNITY_FLOAT, velocityY / FX_UNITY_FLOAT,
+          currentOctant, rightOn, desiredOctant, turnRate,
+          turnAmount / FX_UNITY_FLOAT,
+          GET_FX_FLOAT(pPlayer->velocity_x), GET_FX_FLOAT(pPlayer->velocity_y),
+          GET_FX_FLOAT(oldX), GET_FX_FLOAT(oldY));
+    }
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  static const int32_t kEdgeValues[] = {
+    0, 1, 2, 3, 0x7FFF, 0x8000, 0x10000, 0x18000, 0x30000, 0xFFFFF };
+  const int numEdges = sizeof(kEdgeValues) / sizeof(kEdgeValues[0]);
+  long count = 20000;
+  int option;
+  int32_t x, y;
+  long i;
+  int j, k;
+
+  srand(12345);
+  while ((option = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (option)
+    {
+      case 'n': count = atol(optarg); break;
+      case 's': srand(atoi(optarg)); break;
+      default:
+        fprintf(stderr, "Usage: %s [-n Count] [-s Seed]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  /* Small and boundary values in all sign combinations, including exactly
+     diagonal and one bit off diagonal, with a few turn amounts. */
+
+  for (j = 0; j < numEdges * 2; j++)
+  {
+    for (k = 0; k < numEdges * 2; k++)
+    {
+      x = (j & 1) ? -kEdgeValues[j / 2] : kEdgeValues[j / 2];
+      y = (k & 1) ? -kEdgeValues[k / 2] : kEdgeValues[k / 2];
+      TestVelocity(x, y, 0x4000);
+      TestVelocity(x, y, kEdgeValues[k / 2]);
+      TestVelocity(x, y, -kEdgeValues[j / 2]);
+      TestVelocity(x, x + y % 4, 0x18000);
+      TestVelocity(x, -x - y % 4, 0x18000);
+    }
+  }
+
+  /* Random ones, some near the diagonals. */
+
+  for (i = 0; i < count; i++)
+  {
+    x = RandomFx();
+    y = (i & 3) ? RandomFx() : ((i & 4) ? x : -x) + (rand() % 5 - 2);
+    TestVelocity(x, y, RandomFx());
+  }
+
+  printf("%lu cases, %lu failures.\n", s_Cases, s_Failures);
+  return (s_Failures == 0) ? 0 : 1;
+}
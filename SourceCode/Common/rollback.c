@@ -0,0 +1,439 @@
+/******************************************************************************
+ * Nth Pong Wars, rollback.c for hiding network latency with rollback.
+ * Definitive comments are in rollback.h, rather than copied here.
+ *
+ * AGMS20261018 - Started this code file.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rollback.h"
+
+#if ROLLBACK_NETCODE
+
+#define DEBUG_PRINT_ROLLBACK 0 /* Turn on debug output. */
+
+/* Just the parts of a player which the simulation changes.  Sprite and score
+   display things get recalculated from these after a rollback, so they don't
+   need saving. */
+typedef struct rollback_player_struct {
+  fx pixel_center_x;
+  fx pixel_center_y;
+  fx velocity_x;
+  fx velocity_y;
+  uint8_t pixel_flying_height;
+  uint8_t speed;
+  bool velocity_octant_invalid;
+  uint8_t velocity_octant;
+  bool velocity_octant_right_on;
+  uint8_t player_collision_count;
+  bool thrust_active;
+  uint8_t thrust_harvested;
+  uint8_t power_up_timers[OWNER_MAX];
+  uint8_t joystick_inputs;
+  player_brain brain;
+  uint16_t last_brain_activity_time;
+  player_algo_record algo;
+#ifdef NABU_H
+  uint8_t main_colour; /* Changes when flying high. */
+#endif
+} rollback_player_record, *rollback_player_pointer;
+
+/* The state of the game at the start of a frame.  Tiles aren't in here, see
+   the journal instead. */
+typedef struct rollback_snapshot_struct {
+  uint16_t frame; /* g_FrameCounter at the start of this frame. */
+  uint16_t journal_total; /* sJournalTotal at the start of this frame. */
+  uint16_t score_goal;
+  uint8_t harvest_sound_threshold;
+  tile_owner tile_quota_next_index;
+  uint8_t tile_quota_next_column;
+  uint8_t tile_quota_next_row;
+  rollback_player_record players[MAX_PLAYERS];
+} rollback_snapshot_record, *rollback_snapshot_pointer;
+
+/* The inputs used in a frame, and which of them are the real ones received
+   from remote players, rather than guesses. */
+typedef struct rollback_inputs_struct {
+  uint16_t frame; /* Which frame this is for, to detect stale entries. */
+  uint8_t confirmed_mask; /* Bit N set if player N's input is known good. */
+  uint8_t joystick_inputs[MAX_PLAYERS];
+} rollback_inputs_record, *rollback_inputs_pointer;
+
+/* One undoable tile change, the tile's state before the change. */
+typedef struct rollback_journal_struct {
+  tile_pointer pTile;
+  tile_owner owner;
+  uint8_t age;
+} rollback_journal_record, *rollback_journal_pointer;
+
+bool g_RollbackResimulating = false;
+uint16_t g_RollbackCount = 0;
+uint16_t g_RollbackFramesResimulated = 0;
+uint16_t g_RollbackFailures = 0;
+
+static rollback_snapshot_record sSnapshots[ROLLBACK_MAX_FRAMES];
+static rollback_inputs_record sInputs[ROLLBACK_MAX_INPUT_FRAMES];
+static rollback_journal_record sJournal[ROLLBACK_JOURNAL_SIZE];
+
+static uint16_t sJournalTotal;
+/* Number of tile changes ever recorded, wraps around.  The low byte is the
+   index of the next free journal entry. */
+
+static bool sJournalUndoing;
+/* Set while undoing tile changes, so the undo itself doesn't get recorded. */
+
+static uint16_t sOldestSnapshotFrame;
+/* Frame number of the oldest valid snapshot.  Snapshots older than this are
+   from before the level started, or have been overwritten. */
+
+static bool sMispredicted;
+static uint16_t sMispredictedFrame;
+/* Earliest frame which used a wrong guess for a remote player's input.  Only
+   valid if sMispredicted is TRUE. */
+
+
+/* Discard all history.
+*/
+void RollbackReset(void)
+{
+  bzero(sInputs, sizeof(sInputs));
+  sJournalTotal = 0;
+  sJournalUndoing = false;
+  sOldestSnapshotFrame = g_FrameCounter;
+  sMispredicted = false;
+  g_RollbackResimulating = false;
+}
+
+
+/* Returns the input history record for the given frame, clearing it out if it
+   was for some older frame.
+*/
+static rollback_inputs_pointer InputsForFrame(uint16_t frame)
+{
+  rollback_inputs_pointer pInputs;
+
+  pInputs = sInputs + (frame & (ROLLBACK_MAX_INPUT_FRAMES - 1));
+  if (pInputs->frame != frame)
+  {
+    pInputs->frame = frame;
+    pInputs->confirmed_mask = 0;
+  }
+  return pInputs;
+}
+
+
+/* Remember a tile's state before it gets changed.
+*/
+void RollbackJournalTile(tile_pointer pTile)
+{
+  rollback_journal_pointer pEntry;
+
+  if (sJournalUndoing)
+    return;
+
+  pEntry = sJournal + (uint8_t) sJournalTotal;
+  pEntry->pTile = pTile;
+  pEntry->owner = pTile->owner;
+  pEntry->age = pTile->age;
+  sJournalTotal++;
+}
+
+
+/* Save the game state at the start of a frame.
+*/
+void RollbackStartFrame(void)
+{
+  rollback_snapshot_pointer pSnapshot;
+  rollback_player_pointer pSaved;
+  player_pointer pPlayer;
+  uint8_t iPlayer;
+
+  pSnapshot = sSnapshots + (g_FrameCounter & (ROLLBACK_MAX_FRAMES - 1));
+  pSnapshot->frame = g_FrameCounter;
+  pSnapshot->journal_total = sJournalTotal;
+  pSnapshot->score_goal = g_ScoreGoal;
+  pSnapshot->harvest_sound_threshold = g_harvest_sound_threshold;
+  /* These are statics in tiles.c, visible here since main.c includes all the
+     source files into one compilation unit. */
+  pSnapshot->tile_quota_next_index = s_TileQuotaNextIndex;
+  pSnapshot->tile_quota_next_column = s_TileQuotaNextColumn;
+  pSnapshot->tile_quota_next_row = s_TileQuotaNextRow;
+
+  pSaved = pSnapshot->players;
+  pPlayer = g_player_array;
+  for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++, pSaved++)
+  {
+    COPY_FX(pPlayer->pixel_center_x, pSaved->pixel_center_x);
+    COPY_FX(pPlayer->pixel_center_y, pSaved->pixel_center_y);
+    COPY_FX(pPlayer->velocity_x, pSaved->velocity_x);
+    COPY_FX(pPlayer->velocity_y, pSaved->velocity_y);
+    pSaved->pixel_flying_height = pPlayer->pixel_flying_height;
+    pSaved->speed = pPlayer->speed;
+    pSaved->velocity_octant_invalid = pPlayer->velocity_octant_invalid;
+    pSaved->velocity_octant = pPlayer->velocity_octant;
+    pSaved->velocity_octant_right_on = pPlayer->velocity_octant_right_on;
+    pSaved->player_collision_count = pPlayer->player_collision_count;
+    pSaved->thrust_active = pPlayer->thrust_active;
+    pSaved->thrust_harvested = pPlayer->thrust_harvested;
+    memcpy(pSaved->power_up_timers, pPlayer->power_up_timers,
+      sizeof(pSaved->power_up_timers));
+    pSaved->joystick_inputs = pPlayer->joystick_inputs;
+    pSaved->brain = pPlayer->brain;
+    pSaved->last_brain_activity_time = pPlayer->last_brain_activity_time;
+    pSaved->algo = pPlayer->brain_info.algo;
+#ifdef NABU_H
+    pSaved->main_colour = pPlayer->main_colour;
+#endif
+  }
+
+  /* Overwrote the oldest snapshot when the ring is full. */
+
+  if ((uint16_t) (g_FrameCounter - sOldestSnapshotFrame) >=
+  ROLLBACK_MAX_FRAMES)
+    sOldestSnapshotFrame = g_FrameCounter - (ROLLBACK_MAX_FRAMES - 1);
+}
+
+
+/* Put the game back the way it was at the start of the given frame.  Returns
+   FALSE if we don't have the history to do that.
+*/
+static bool RestoreSnapshot(uint16_t frame)
+{
+  rollback_snapshot_pointer pSnapshot;
+  rollback_player_pointer pSaved;
+  rollback_journal_pointer pEntry;
+  player_pointer pPlayer;
+  uint8_t iPlayer;
+
+  if ((uint16_t) (frame - sOldestSnapshotFrame) >= ROLLBACK_MAX_FRAMES)
+    return false; /* Too old, or before the level started. */
+
+  pSnapshot = sSnapshots + (frame & (ROLLBACK_MAX_FRAMES - 1));
+  if (pSnapshot->frame != frame)
+    return false;
+  if ((uint16_t) (sJournalTotal - pSnapshot->journal_total) >
+  ROLLBACK_JOURNAL_SIZE)
+    return false; /* Too many tile changes, older ones overwritten. */
+
+  /* Undo the tile changes, most recent first.  SetTileOwner() keeps the score
+     counts and power-up caches up to date and requests a redraw. */
+
+  sJournalUndoing = true;
+  while (sJournalTotal != pSnapshot->journal_total)
+  {
+    sJournalTotal--;
+    pEntry = sJournal + (uint8_t) sJournalTotal;
+    SetTileOwner(pEntry->pTile, pEntry->owner);
+    if (pEntry->pTile->age != pEntry->age)
+    {
+      pEntry->pTile->age = pEntry->age;
+      RequestTileRedraw(pEntry->pTile);
+    }
+  }
+  sJournalUndoing = false;
+
+  g_FrameCounter = pSnapshot->frame;
+  g_ScoreGoal = pSnapshot->score_goal;
+  g_harvest_sound_threshold = pSnapshot->harvest_sound_threshold;
+  s_TileQuotaNextIndex = pSnapshot->tile_quota_next_index;
+  s_TileQuotaNextColumn = pSnapshot->tile_quota_next_column;
+  s_TileQuotaNextRow = pSnapshot->tile_quota_next_row;
+
+  pSaved = pSnapshot->players;
+  pPlayer = g_player_array;
+  for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++, pSaved++)
+  {
+    COPY_FX(pSaved->pixel_center_x, pPlayer->pixel_center_x);
+    COPY_FX(pSaved->pixel_center_y, pPlayer->pixel_center_y);
+    COPY_FX(pSaved->velocity_x, pPlayer->velocity_x);
+    COPY_FX(pSaved->velocity_y, pPlayer->velocity_y);
+    pPlayer->pixel_flying_height = pSaved->pixel_flying_height;
+    pPlayer->speed = pSaved->speed;
+    pPlayer->velocity_octant_invalid = pSaved->velocity_octant_invalid;
+    pPlayer->velocity_octant = pSaved->velocity_octant;
+    pPlayer->velocity_octant_right_on = pSaved->velocity_octant_right_on;
+    pPlayer->player_collision_count = pSaved->player_collision_count;
+    pPlayer->thrust_active = pSaved->thrust_active;
+    pPlayer->thrust_harvested = pSaved->thrust_harvested;
+    memcpy(pPlayer->power_up_timers, pSaved->power_up_timers,
+      sizeof(pPlayer->power_up_timers));
+    pPlayer->joystick_inputs = pSaved->joystick_inputs;
+    pPlayer->brain = pSaved->brain;
+    pPlayer->last_brain_activity_time = pSaved->last_brain_activity_time;
+    pPlayer->brain_info.algo = pSaved->algo;
+#ifdef NABU_H
+    pPlayer->main_colour = pSaved->main_colour;
+#endif
+  }
+
+  return true;
+}
+
+
+/* Record the inputs used by all players this frame.
+*/
+void RollbackEndInputs(void)
+{
+  rollback_inputs_pointer pInputs;
+  player_pointer pPlayer;
+  uint8_t iPlayer;
+
+  pInputs = InputsForFrame(g_FrameCounter);
+  pPlayer = g_player_array;
+  for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
+  {
+    pInputs->joystick_inputs[iPlayer] = pPlayer->joystick_inputs;
+    if (pPlayer->brain != BRAIN_NETWORK)
+      pInputs->confirmed_mask |= (1 << iPlayer); /* Local inputs are known. */
+  }
+}
+
+
+/* Returns the real input for a network player if it has arrived, else guess
+   they are still doing what they did last frame.  During a resimulation, the
+   recorded inputs are used for everybody, which includes any corrections.
+*/
+uint8_t RollbackInputForPlayer(uint8_t iPlayer)
+{
+  rollback_inputs_pointer pInputs;
+  uint8_t playerBit = (1 << iPlayer);
+
+  pInputs = InputsForFrame(g_FrameCounter);
+  if (pInputs->confirmed_mask & playerBit)
+    return pInputs->joystick_inputs[iPlayer];
+
+  if (g_RollbackResimulating)
+  {
+    /* Still a guess.  Use the previous frame's input, which may have been
+       corrected since the first time this frame was simulated. */
+    rollback_inputs_pointer pPrevious;
+    pPrevious = InputsForFrame(g_FrameCounter - 1);
+    return pPrevious->joystick_inputs[iPlayer];
+  }
+
+  return g_player_array[iPlayer].joystick_inputs;
+}
+
+
+/* Accept an input message from a remote player.
+*/
+void RollbackReceiveRemoteInput(rollback_input_message_pointer pMessage)
+{
+  rollback_inputs_pointer pInputs;
+  uint8_t iPlayer;
+  uint8_t playerBit;
+  uint16_t frame;
+  uint16_t framesAgo;
+
+  iPlayer = pMessage->player_index;
+  if (iPlayer >= MAX_PLAYERS)
+    return;
+  playerBit = (1 << iPlayer);
+  frame = pMessage->frame;
+
+  /* Inputs from the future (the remote machine is running ahead) just get
+     saved for later.  Too far in the future or past are unusable.  The ring
+     holds ROLLBACK_MAX_INPUT_FRAMES frames, so a future frame that far ahead
+     of the oldest one we could roll back to would overwrite its inputs. */
+
+  framesAgo = g_FrameCounter - frame;
+  if ((int16_t) framesAgo <= -(ROLLBACK_MAX_INPUT_FRAMES / 2) ||
+  (int16_t) framesAgo > (int16_t) ROLLBACK_MAX_FRAMES)
+  {
+    g_RollbackFailures++;
+    return;
+  }
+
+  pInputs = InputsForFrame(frame);
+  if (pInputs->confirmed_mask & playerBit)
+    return; /* Duplicate message. */
+
+  /* If that frame has already been simulated with a wrong guess, we'll need
+     to go back and redo it.  Frames in the future or the current one haven't
+     been simulated yet. */
+
+  if ((int16_t) framesAgo > 0 &&
+  pInputs->joystick_inputs[iPlayer] != pMessage->joystick_inputs)
+  {
+    if (!sMispredicted ||
+    (int16_t) (frame - sMispredictedFrame) < 0)
+      sMispredictedFrame = frame;
+    sMispredicted = true;
+  }
+
+  pInputs->joystick_inputs[iPlayer] = pMessage->joystick_inputs;
+  pInputs->confirmed_mask |= playerBit;
+}
+
+
+/* Go back to the earliest mispredicted frame and simulate up to the present.
+   The same game updates as in the main loop, minus the drawing, sound and
+   victory tests (done for the current frame as usual).
+*/
+void RollbackResimulateIfNeeded(void)
+{
+  uint16_t presentFrame;
+
+  if (!sMispredicted)
+    return;
+  sMispredicted = false;
+
+  presentFrame = g_FrameCounter;
+  if (!RestoreSnapshot(sMispredictedFrame))
+  {
+    g_RollbackFailures++;
+#if DEBUG_PRINT_ROLLBACK
+    strcpy(g_TempBuffer, "Rollback to frame ");
+    AppendDecimalUInt16(sMispredictedFrame);
+    strcat(g_TempBuffer, " failed, no history.\n");
+    DebugPrintString(g_TempBuffer);
+#endif
+    return;
+  }
+  g_RollbackCount++;
+
+  g_RollbackResimulating = true;
+  while (g_FrameCounter != presentFrame)
+  {
+    RollbackStartFrame(); /* Replace the snapshot with the corrected one. */
+    UpdatePlayerInputs();
+    RollbackEndInputs();
+    if (gVictoryModeHighestTileCount)
+    {
+      Simulate();
+      if ((g_FrameCounter & 0x3F) == 0)
+        AddNextPowerUpTile();
+    }
+    g_FrameCounter++;
+    if ((g_FrameCounter & 0x1F) == 0)
+    {
+      if (g_ScoreGoal-- == 0)
+        g_ScoreGoal = 5;
+    }
+    g_RollbackFramesResimulated++;
+  }
+  g_RollbackResimulating = false;
+
+#if DEBUG_PRINT_ROLLBACK
+  strcpy(g_TempBuffer, "Rolled back to frame ");
+  AppendDecimalUInt16(sMispredictedFrame);
+  strcat(g_TempBuffer, ", now at ");
+  AppendDecimalUInt16(g_FrameCounter);
+  strcat(g_TempBuffer, ".\n");
+  DebugPrintString(g_TempBuffer);
+#endif
+}
+
+#endif /* ROLLBACK_NETCODE */
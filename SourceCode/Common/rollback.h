@@ -0,0 +1,131 @@
+/******************************************************************************
+ * Nth Pong Wars, rollback.h for hiding network latency with rollback.
+ *
+ * Rather than waiting for remote players' joystick inputs to arrive before
+ * simulating a frame (lockstep, which adds input delay equal to the network
+ * latency), we guess that a remote player is still pressing whatever they
+ * pressed last frame, and carry on.  A short ring of compact game state
+ * snapshots is kept.  When the real inputs arrive and they differ from the
+ * guess, the game state is restored to the snapshot for that frame and the
+ * missed frames are simulated again (quickly, with no drawing or sound) using
+ * the corrected inputs.
+ *
+ * Tiles are too big to snapshot every frame on the NABU (768 tiles or more), so
+ * instead the changes to tiles are recorded in a journal as they happen, and
+ * undone in reverse order to get back to an older frame.
+ *
+ * The actual transport of inputs (NABU Internet Adapter TCP, or a UDP socket
+ * on Linux) is up to the caller.  See Unix/LoopbackRelay.c for a relay that
+ * adds latency for testing, Unix/RollbackPeer.c for a pair of game instances
+ * to run with it, and Common/rollback_test.c for a check that rolling back
+ * gives the same game as having the inputs on time.
+ *
+ * AGMS20261018 - Start this header file.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _ROLLBACK_H
+#define _ROLLBACK_H 1
+
+/* Compile time option to include the rollback code.  It costs a couple of
+   kilobytes of memory for the snapshots, which would otherwise go to the tile
+   array, so it's off unless you are building a networked game.  Use
+   -DROLLBACK_NETCODE=1 on the compiler command line to turn it on. */
+#ifndef ROLLBACK_NETCODE
+#define ROLLBACK_NETCODE 0
+#endif
+
+/* Number of frames of history kept, so that's the largest latency we can hide.
+   At 20hz, 8 frames is 400ms.  Needs to be a power of two for masking. */
+#define ROLLBACK_MAX_FRAMES 8
+
+/* Inputs can arrive from a remote player that is running ahead of us, so
+   keep twice as many frames of inputs as snapshots.  Power of two. */
+#define ROLLBACK_MAX_INPUT_FRAMES (ROLLBACK_MAX_FRAMES * 2)
+
+/* Number of tile changes remembered, for undoing tile changes when rolling
+   back.  If more changes than this happen in ROLLBACK_MAX_FRAMES frames, we
+   can't roll back that far.  256 so a byte index wraps around by itself. */
+#define ROLLBACK_JOURNAL_SIZE 256
+
+/* A remote input message, as sent over the network.  Four bytes, frame number
+   is little endian, same as the Z80 and most Linux machines, so it can be
+   copied directly. */
+typedef struct rollback_input_message_struct {
+  uint8_t player_index; /* Which player these inputs are for. */
+  uint8_t joystick_inputs; /* See joystick_enum for the bits. */
+  uint16_t frame; /* Value of g_FrameCounter that the inputs are used in. */
+} rollback_input_message_record, *rollback_input_message_pointer;
+
+#if ROLLBACK_NETCODE
+
+extern bool g_RollbackResimulating;
+/* TRUE while missed frames are being simulated again.  Drawing and sound
+   code should do nothing while this is set, and UpdatePlayerInputs() takes
+   inputs from the recorded history rather than the live devices. */
+
+extern uint16_t g_RollbackCount;
+extern uint16_t g_RollbackFramesResimulated;
+extern uint16_t g_RollbackFailures;
+/* Statistics, for debugging and tuning the amount of history kept.  Failures
+   happen when the inputs are older than the history, or the tile journal has
+   overflowed, and mean the remote machines are out of sync. */
+
+extern void RollbackReset(void);
+/* Discard all history.  Call after loading a level, since the old snapshots
+   refer to a different game board. */
+
+extern void RollbackStartFrame(void);
+/* Save a snapshot of the game state at the start of a frame, before the
+   inputs are read.  Call at the top of the main loop. */
+
+extern void RollbackEndInputs(void);
+/* Record the joystick inputs all players used in this frame, so they can be
+   replayed if we need to simulate this frame again.  Call right after
+   UpdatePlayerInputs(). */
+
+extern uint8_t RollbackInputForPlayer(uint8_t iPlayer);
+/* Returns the joystick inputs to use for a BRAIN_NETWORK player in the current
+   frame.  If the real inputs for this frame have arrived they are used,
+   otherwise it predicts that the player is doing what they did last frame. */
+
+extern void RollbackReceiveRemoteInput(rollback_input_message_pointer pMessage);
+/* Give a remote player's input message (from the network) to the rollback
+   system.  If it contradicts an earlier prediction, the next call to
+   RollbackResimulateIfNeeded() will redo the affected frames. */
+
+extern void RollbackResimulateIfNeeded(void);
+/* If a misprediction has been detected, restore the game to the snapshot for
+   the earliest wrong frame and simulate forward to the current frame again,
+   with drawing and sound suppressed.  Call at the top of the main loop, before
+   RollbackStartFrame(). */
+
+extern void RollbackJournalTile(tile_pointer pTile);
+/* Remember the owner and age of a tile before they get changed, so the change
+   can be undone.  Does nothing while undoing. */
+
+#define ROLLBACK_JOURNAL_TILE(pTile) RollbackJournalTile(pTile)
+
+#else /* No rollback code, make the hooks do nothing. */
+
+#define g_RollbackResimulating false
+#define RollbackReset()
+#define RollbackStartFrame()
+#define RollbackEndInputs()
+#define RollbackResimulateIfNeeded()
+#define ROLLBACK_JOURNAL_TILE(pTile)
+
+#endif /* ROLLBACK_NETCODE */
+
+#endif /* _ROLLBACK_H */
@@ -0,0 +1,419 @@
+/* Checks that a rollback ends up with the same game as no rollback at all.
+ * Copyright © 2026 by Alexander G. M. Smith.
+ *
+ * Players 0 and 1 are remote network players, following a scripted sequence of
+ * joystick inputs which both ends can generate, and the rest are AI players.
+ * The game is forked so both copies start from the same state.  The child
+ * gets each remote input before the frame it is used in, so it never has to
+ * guess.  The parent gets them some frames late, so it guesses (repeating the
+ * previous input), and rolls back and simulates again when the real input
+ * turns out to be different.  Every so often the parent is given all the late
+ * inputs, which should bring it back to exactly the child's game, and the
+ * tile and player arrays are compared.  Victory conditions aren't tested, so
+ * it stays on the one level.
+ *
+ * Compile and run in the Common directory with:
+ *
+ * gcc -g -O2 -Wall -DROLLBACK_NETCODE=1 -o rollback_test rollback_test.c && ./rollback_test
+ *
+ * Options are -n Frames to run (default 5000), -d DataDirectory/ (default
+ * ../Nabu/Art/), -l Level (default GAMEDEMO), -t Delay in frames for the
+ * remote inputs (default 5, at most ROLLBACK_MAX_FRAMES - 1) and -s Frames
+ * between comparisons (default 50).
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code. */
+#include "cverify.h"
+#include "fixed_point.c"
+#include "debug_print.c"
+#include "tiles.c"
+#include "players.c"
+#include "simulate.c"
+#include "scores.c"
+#include "soundscreen.c"
+#include "levels.c"
+#include "rollback.c"
+
+#if !ROLLBACK_NETCODE
+#error "Compile with -DROLLBACK_NETCODE=1 so there is something to test."
+#endif
+
+#define MAX_TEST_TILES 2048
+#define REMOTE_PLAYERS 2
+
+static uint16_t s_Delay = 5;
+
+/* The parts of the game which the simulation changes, sent from the child to
+   the parent for comparing.  Display things like animation frames aren't
+   included, they get redone after a rollback. */
+typedef struct compared_player_struct {
+  fx pixel_center_x;
+  fx pixel_center_y;
+  fx velocity_x;
+  fx velocity_y;
+  uint8_t pixel_flying_height;
+  uint8_t speed;
+  uint8_t joystick_inputs;
+  uint8_t brain;
+  uint8_t power_up_timers[OWNER_MAX];
+} compared_player_record, *compared_player_pointer;
+
+typedef struct compared_state_struct {
+  uint16_t frame;
+  uint16_t score_goal;
+  compared_player_record players[MAX_PLAYERS];
+  uint8_t tile_owners[MAX_TEST_TILES];
+  uint8_t tile_ages[MAX_TEST_TILES];
+} compared_state_record, *compared_state_pointer;
+
+static compared_state_record s_State;
+static compared_state_record s_OtherState;
+
+
+/*******************************************************************************
+ * The scripted joystick inputs for a remote player, a new direction and maybe
+ * the fire button every 16 frames.  Both processes get the same ones.
+ */
+static uint8_t ScriptedInput(uint16_t frame, uint8_t iPlayer)
+{
+  uint32_t hash;
+
+  hash = ((frame >> 4) + 1) * 2654435761u ^ (iPlayer + 1) * 40503u;
+  hash ^= hash >> 13;
+  hash *= 2246822519u;
+  hash ^= hash >> 16;
+  return hash & 0x1F;
+}
+
+
+/*******************************************************************************
+ * Give the rollback code the remote players' inputs for the given frame, the
+ * same way a network message would arrive.
+ */
+static void DeliverInputs(uint16_t frame)
+{
+  rollback_input_message_record message;
+  uint8_t iPlayer;
+
+  for (iPlayer = 0; iPlayer < REMOTE_PLAYERS; iPlayer++)
+  {
+    message.player_index = iPlayer;
+    message.joystick_inputs = ScriptedInput(frame, iPlayer);
+    message.frame = frame;
+    RollbackReceiveRemoteInput(&message);
+  }
+}
+
+
+/*******************************************************************************
+ * Copy the game state into s_State for comparing.
+ */
+static void CollectState(void)
+{
+  compared_player_pointer pCompared;
+  player_pointer pPlayer;
+  uint16_t iTile;
+  uint8_t iPlayer;
+
+  memset(&s_State, 0, sizeof(s_State));
+  s_State.frame = g_FrameCounter;
+  s_State.score_goal = g_ScoreGoal;
+  for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++)
+  {
+    pPlayer = g_player_array + iPlayer;
+    pCompared = s_State.players + iPlayer;
+    COPY_FX(pPlayer->pixel_center_x, pCompared->pixel_center_x);
+    COPY_FX(pPlayer->pixel_center_y, pCompared->pixel_center_y);
+    COPY_FX(pPlayer->velocity_x, pCompared->velocity_x);
+    COPY_FX(pPlayer->velocity_y, pCompared->velocity_y);
+    pCompared->pixel_flying_height = pPlayer->pixel_flying_height;
+    pCompared->speed = pPlayer->speed;
+    pCompared->joystick_inputs = pPlayer->joystick_inputs;
+    pCompared->brain = pPlayer->brain;
+    memcpy(pCompared->power_up_timers, pPlayer->power_up_timers,
+      sizeof(pCompared->power_up_timers));
+  }
+  for (iTile = 0; iTile < MAX_TEST_TILES; iTile++)
+  {
+    s_State.tile_owners[iTile] = g_tile_array[iTile].owner;
+    s_State.tile_ages[iTile] = g_tile_array[iTile].age;
+  }
+}
+
+
+/*******************************************************************************
+ * Print what's different between our state and the other process's state.
+ */
+static void PrintDifferences(void)
+{
+  compared_player_pointer pOurs;
+  compared_player_pointer pTheirs;
+  uint16_t iTile;
+  uint16_t tileCount = 0;
+  uint8_t iPlayer;
+
+  printf("Frame %d is different (theirs %d), score goal %d (theirs %d):\n",
+    s_State.frame, s_OtherState.frame, s_State.score_goal,
+    s_OtherState.score_goal);
+  for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++)
+  {
+    pOurs = s_State.players + iPlayer;
+    pTheirs = s_OtherState.players + iPlayer;
+    if (memcmp(pOurs, pTheirs, sizeof(compared_player_record)) == 0)
+      continue;
+    printf("  Player %d at (%f, %f) velocity (%f, %f), should be "
+      "(%f, %f) velocity (%f, %f).\n", iPlayer,
+      GET_FX_FLOAT(pOurs->pixel_center_x), GET_FX_FLOAT(pOurs->pixel_center_y),
+      GET_FX_FLOAT(pOurs->velocity_x), GET_FX_FLOAT(pOurs->velocity_y),
+      GET_FX_FLOAT(pTheirs->pixel_center_x),
+      GET_FX_FLOAT(pTheirs->pixel_center_y),
+      GET_FX_FLOAT(pTheirs->velocity_x), GET_FX_FLOAT(pTheirs->velocity_y));
+  }
+  for (iTile = 0; iTile < MAX_TEST_TILES; iTile++)
+  {
+    if (s_State.tile_owners[iTile] != s_OtherState.tile_owners[iTile] ||
+    s_State.tile_ages[iTile] != s_OtherState.tile_ages[iTile])
+      tileCount++;
+  }
+  printf("  %d tiles are different.\n", tileCount);
+}
+
+
+/*******************************************************************************
+ * Read exactly the given amount from the pipe, FALSE if it ended early.
+ */
+static bool ReadAll(int fileDescriptor, void *pBuffer, size_t amount)
+{
+  ssize_t amountRead;
+
+  while (amount > 0)
+  {
+    amountRead = read(fileDescriptor, pBuffer, amount);
+    if (amountRead <= 0)
+      return false;
+    pBuffer = (uint8_t *) pBuffer + amountRead;
+    amount -= amountRead;
+  }
+  return true;
+}
+
+
+/*******************************************************************************
+ * Run the game for a number of frames, with the same rollback calls as the
+ * NABU main loop.  The child gets the remote inputs on time and writes its
+ * state to the pipe every compareFrames, the parent gets them s_Delay frames
+ * late, catches up on all of them every compareFrames, then compares.
+ * Returns the number of comparisons which were different (parent only), or
+ * -1 on errors.
+ */
+static long RunFrames(long frameCount, long compareFrames, int pipeFd,
+  bool isChild)
+{
+  long differentCount = 0;
+  long iFrame;
+  uint16_t startFrame = g_FrameCounter;
+  uint16_t iLate;
+
+  for (iFrame = 0; iFrame < frameCount; iFrame++)
+  {
+    if (isChild)
+      DeliverInputs(g_FrameCounter);
+    else if (iFrame >= s_Delay)
+      DeliverInputs(g_FrameCounter - s_Delay);
+
+    if (iFrame != 0 && iFrame % compareFrames == 0)
+    {
+      if (!isChild)
+      { /* Everything up to the previous frame arrives, the rest is known. */
+        for (iLate = g_FrameCounter - s_Delay; iLate != g_FrameCounter;
+        iLate++)
+        {
+          if ((uint16_t) (iLate - startFrame) < (uint16_t) iFrame)
+            DeliverInputs(iLate);
+        }
+      }
+      RollbackResimulateIfNeeded();
+      CollectState();
+      if (isChild)
+      {
+        if (write(pipeFd, &s_State, sizeof(s_State)) != sizeof(s_State))
+          return -1;
+      }
+      else
+      {
+        if (!ReadAll(pipeFd, &s_OtherState, sizeof(s_OtherState)))
+        {
+          fprintf(stderr, "Lost contact with the child process.\n");
+          return -1;
+        }
+        if (memcmp(&s_State, &s_OtherState, sizeof(s_State)) != 0)
+        {
+          if (differentCount++ == 0)
+            PrintDifferences();
+        }
+      }
+    }
+    else
+      RollbackResimulateIfNeeded();
+
+    RollbackStartFrame();
+    UpdatePlayerInputs();
+    RollbackEndInputs();
+    if (gVictoryModeHighestTileCount)
+    {
+      Simulate();
+      if ((g_FrameCounter & 0x3F) == 0)
+        AddNextPowerUpTile();
+      UpdateScores();
+    }
+    g_ScoreFramesPerUpdate = 1;
+
+    g_FrameCounter++;
+    if ((g_FrameCounter & 0x1F) == 0)
+    {
+      if (g_ScoreGoal-- == 0)
+        g_ScoreGoal = 5;
+    }
+  }
+  return differentCount;
+}
+
+
+int main(int argc, char **argv)
+{
+  long frameCount = 5000;
+  long compareFrames = 50;
+  int option;
+  int pipeFds[2];
+  pid_t childPid;
+  int childStatus;
+  long differentCount;
+  uint8_t iPlayer;
+
+  g_HostDataPath = "../Nabu/Art/";
+  strcpy(gLevelName, "GAMEDEMO");
+  while ((option = getopt(argc, argv, "n:d:l:t:s:")) != -1)
+  {
+    switch (option)
+    {
+      case 'n': frameCount = atol(optarg); break;
+      case 'd': g_HostDataPath = optarg; break;
+      case 'l':
+        snprintf(gLevelName, sizeof(gLevelName), "%s", optarg);
+        break;
+      case 't': s_Delay = atoi(optarg); break;
+      case 's': compareFrames = atol(optarg); break;
+      default:
+        frameCount = -1;
+        break;
+    }
+  }
+  if (frameCount < 0 || compareFrames < 1 || s_Delay < 1 ||
+  s_Delay >= ROLLBACK_MAX_FRAMES)
+  {
+    fprintf(stderr, "Usage: %s [-n Frames] [-d DataDirectory/] [-l Level] "
+      "[-t Delay (1 to %d)] [-s CompareFrames]\n", argv[0],
+      ROLLBACK_MAX_FRAMES - 1);
+    return 2;
+  }
+
+  /* Initialise some fixed point number constants, like the NABU does. */
+  ZERO_FX(gfx_Constant_Zero);
+  INT_TO_FX(1, gfx_Constant_One);
+  COPY_NEGATE_FX(gfx_Constant_One, gfx_Constant_MinusOne);
+  INT_FRACTION_TO_FX(0 /* int */, MAX_FX_FRACTION / 8 + 1 /* fraction */,
+    gfx_Constant_Eighth);
+  COPY_NEGATE_FX(gfx_Constant_Eighth, gfx_Constant_MinusEighth);
+
+  g_tile_array = calloc(MAX_TEST_TILES, sizeof(tile_record));
+  gTileArraySize = MAX_TEST_TILES;
+  g_play_area_height_tiles = 23;
+  g_play_area_width_tiles = 32;
+  if (g_tile_array == NULL || !InitTileArray())
+  {
+    fprintf(stderr, "Failed to set up play area tiles.\n");
+    return 2;
+  }
+  InitialisePlayers();
+  if (!LoadLevelFile())
+  {
+    fprintf(stderr, "Unable to load level %s from %s.\n", gLevelName,
+      g_HostDataPath);
+    return 2;
+  }
+
+  /* Remote players first, everybody else is an AI. */
+
+  for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++)
+  {
+    ReinitialisePlayer(g_player_array + iPlayer);
+    g_player_array[iPlayer].brain = (iPlayer < REMOTE_PLAYERS) ?
+      BRAIN_NETWORK : BRAIN_ALGORITHM;
+  }
+  RollbackReset();
+
+  if (pipe(pipeFds) != 0)
+    return 2;
+  fflush(stdout);
+  childPid = fork();
+  if (childPid < 0)
+    return 2;
+  if (childPid == 0)
+  { /* Child gets the inputs on time, never has to guess. */
+    close(pipeFds[0]);
+    if (RunFrames(frameCount, compareFrames, pipeFds[1], true) < 0)
+      return 1;
+    if (g_RollbackCount != 0 || g_RollbackFailures != 0)
+    {
+      printf("Child rolled back %d times with %d failures, should be none.\n",
+        g_RollbackCount, g_RollbackFailures);
+      return 1;
+    }
+    return 0;
+  }
+
+  close(pipeFds[1]);
+  differentCount = RunFrames(frameCount, compareFrames, pipeFds[0], false);
+  close(pipeFds[0]);
+  waitpid(childPid, &childStatus, 0);
+  if (differentCount < 0 || !WIFEXITED(childStatus) ||
+  WEXITSTATUS(childStatus) != 0)
+    return 2;
+  printf("%ld frames, inputs %d frames late, %d rollbacks redid %d frames "
+    "with %d failures.\n", frameCount, s_Delay, g_RollbackCount,
+    g_RollbackFramesResimulated, g_RollbackFailures);
+  printf("%ld comparisons, %ld different.\n", frameCount / compareFrames -
+    (frameCount % compareFrames == 0), differentCount);
+  return differentCount != 0 || g_RollbackCount == 0 ||
+    g_RollbackFailures != 0;
+}
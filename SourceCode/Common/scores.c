@@ -114,6 +114,10 @@ void UpdateScores(void)
       pPlayer->score_getting_close_mask = 0;
 
     fontOffset += 11; /* Next batch of colourful digits and % sign. */
+#if MAX_PLAYERS > 4
+    if (iPlayer >= 3) /* Only 4 colours in the font, rest get plain digits. */
+      fontOffset = 0;
+#endif
   }
 
   if (s_ScoreGoalDisplayed != g_ScoreGoal)
@@ -125,6 +129,7 @@ void UpdateScores(void)
    of the screen, snowing each player's score in their colour, followed by the
    goal score to win.
 */
+#ifdef NABU_H
 void CopyScoresToScreen(void)
 {
   uint8_t iPlayer;
@@ -214,4 +219,9 @@ void CopyScoresToScreen(void)
   }
 #endif
 }
+#else /* Host programs have no screen, clients draw their own scores. */
+void CopyScoresToScreen(void)
+{
+}
+#endif /* NABU_H */
 
@@ -23,9 +23,24 @@
    used as a general timer for things like aging tiles.  Will run at best at
    60hz, but typically 30hz or even 20hz if a lot is happening on screen.  Score
    displays only last 4 digits, but it's a 16 bit counter, which is allowed to
-   wrap around so that differences work. */
+   wrap around so that differences work.  With FIXED_TIMESTEP it counts game
+   ticks instead, always FIXED_TICKS_PER_SECOND of them. */
 extern uint16_t g_FrameCounter;
 
+#ifndef FIXED_TIMESTEP
+#define FIXED_TIMESTEP 0
+#endif
+/* Set to 1 to run the game on a fixed tick rather than one update per drawn
+   frame.  Each tick is VBLANKS_PER_TICK video frames long, and the NABU skips
+   drawing (up to MAX_SKIPPED_DRAWS in a row) when the updates fall behind,
+   such as when Simulate() needs lots of substeps, or shows the same frame a
+   bit longer when it is ahead.  So the game speed and level timeouts stay
+   the same no matter how busy things are.  Host programs, like the
+   GameServer, already run on a fixed tick. */
+#define FIXED_TICKS_PER_SECOND 20
+#define VBLANKS_PER_TICK 3 /* NABU video is 60hz. */
+#define MAX_SKIPPED_DRAWS 2
+
 /* The current number of points needed to win the game.  Decreases over time. */
 extern uint16_t g_ScoreGoal;
 
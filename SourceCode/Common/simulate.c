@@ -26,6 +26,244 @@
 #define DEBUG_PRINT_SIM 0 /* Turn on debug output. */
 
 #include "soundscreen.h"
+#include "rollback.h"
+
+#ifndef SIMULATE_SOA
+#define SIMULATE_SOA 0
+#endif
+/* Set to 1 (with -DSIMULATE_SOA=1) on host builds to move the players and
+   bounce them off the walls using a structure of arrays copy of their
+   positions and velocities, in plain loops which the compiler can vectorise
+   (gcc -O3 does).  The results are identical to the one player at a time
+   code, which the NABU always uses since it has no vector instructions and
+   the copying would just cost time.  Only worthwhile with lots of players. */
+#ifdef NABU_H
+#undef SIMULATE_SOA
+#define SIMULATE_SOA 0
+#endif
+
+#if SIMULATE_SOA
+bool g_SimulateSoA = true;
+/* Set to FALSE to use the one player at a time code, for testing. */
+
+/* The structure of arrays copy, whole fixed point numbers as 32 bit integers
+   (host fx is 16.16), indexed by player. */
+static int32_t s_SoaPositionX[MAX_PLAYERS];
+static int32_t s_SoaPositionY[MAX_PLAYERS];
+static int32_t s_SoaVelocityX[MAX_PLAYERS];
+static int32_t s_SoaVelocityY[MAX_PLAYERS];
+static int32_t s_SoaStepVelocityX[MAX_PLAYERS];
+static int32_t s_SoaStepVelocityY[MAX_PLAYERS];
+static int32_t s_SoaWallHits[MAX_PLAYERS]; /* Number of walls hit. */
+
+
+/* Copy positions and velocities of all players into the arrays.  Inactive
+   ones too, it's simpler than skipping them, they don't get copied back. */
+static void SoaGatherPlayers(void)
+{
+  player_pointer pPlayer = g_player_array;
+  uint8_t iPlayer;
+
+  for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
+  {
+    s_SoaPositionX[iPlayer] = pPlayer->pixel_center_x.as_int;
+    s_SoaPositionY[iPlayer] = pPlayer->pixel_center_y.as_int;
+    s_SoaVelocityX[iPlayer] = pPlayer->velocity_x.as_int;
+    s_SoaVelocityY[iPlayer] = pPlayer->velocity_y.as_int;
+    s_SoaStepVelocityX[iPlayer] = pPlayer->step_velocity_x.as_int;
+    s_SoaStepVelocityY[iPlayer] = pPlayer->step_velocity_y.as_int;
+  }
+}
+
+
+/* Copy the arrays back to the active players.  Velocities are optional, they
+   don't change when just moving. */
+static void SoaScatterPlayers(bool includeVelocities)
+{
+  player_pointer pPlayer = g_player_array;
+  uint8_t iPlayer;
+
+  for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
+  {
+    if (pPlayer->brain == BRAIN_INACTIVE)
+      continue;
+    pPlayer->pixel_center_x.as_int = s_SoaPositionX[iPlayer];
+    pPlayer->pixel_center_y.as_int = s_SoaPositionY[iPlayer];
+    if (!includeVelocities)
+      continue;
+    pPlayer->velocity_x.as_int = s_SoaVelocityX[iPlayer];
+    pPlayer->velocity_y.as_int = s_SoaVelocityY[iPlayer];
+    pPlayer->step_velocity_x.as_int = s_SoaStepVelocityX[iPlayer];
+    pPlayer->step_velocity_y.as_int = s_SoaStepVelocityY[iPlayer];
+  }
+}
+
+
+/* Add the step velocity to the position, same as ADD_FX. */
+static void SoaMovePlayers(void)
+{
+  int i;
+
+  for (i = 0; i < MAX_PLAYERS; i++)
+  {
+    s_SoaPositionX[i] += s_SoaStepVelocityX[i];
+    s_SoaPositionY[i] += s_SoaStepVelocityY[i];
+  }
+}
+
+
+/* Same wall bouncing as the one player at a time code, in the same order
+   (left, right, bottom, top, so odd cases like a board narrower than a ball
+   come out the same), but with selects rather than branches.  The integer
+   part of the position is the top 16 bits, and INT_TO_FX() of a wall
+   coordinate is it times 65536.  Counts the walls hit for each player, so the
+   caller can play the sounds. */
+static void SoaBounceOffWalls(void)
+{
+  const int32_t left = g_play_area_wall_left_x;
+  const int32_t right = g_play_area_wall_right_x;
+  const int32_t bottom = g_play_area_wall_bottom_y;
+  const int32_t top = g_play_area_wall_top_y;
+  int32_t integer, position, velocity, stepVelocity, hits, flip;
+  int i;
+
+  for (i = 0; i < MAX_PLAYERS; i++)
+  {
+    position = s_SoaPositionX[i];
+    velocity = s_SoaVelocityX[i];
+    stepVelocity = s_SoaStepVelocityX[i];
+    integer = position >> 16;
+
+    flip = (integer < left) & (velocity < 0);
+    velocity = flip ? -velocity : velocity;
+    stepVelocity = flip ? -stepVelocity : stepVelocity;
+    position = (integer < left) ? left * 65536 : position;
+    hits = (integer < left);
+
+    flip = (integer > right) & (velocity >= 0);
+    velocity = flip ? -velocity : velocity;
+    stepVelocity = flip ? -stepVelocity : stepVelocity;
+    position = (integer > right) ? right * 65536 : position;
+    hits += (integer > right);
+
+    s_SoaPositionX[i] = position;
+    s_SoaVelocityX[i] = velocity;
+    s_SoaStepVelocityX[i] = stepVelocity;
+
+    position = s_SoaPositionY[i];
+    velocity = s_SoaVelocityY[i];
+    stepVelocity = s_SoaStepVelocityY[i];
+    integer = position >> 16;
+
+    flip = (integer > bottom) & (velocity >= 0);
+    velocity = flip ? -velocity : velocity;
+    stepVelocity = flip ? -stepVelocity : stepVelocity;
+    position = (integer > bottom) ? bottom * 65536 : position;
+    hits += (integer > bottom);
+
+    flip = (integer < top) & (velocity < 0);
+    velocity = flip ? -velocity : velocity;
+    stepVelocity = flip ? -stepVelocity : stepVelocity;
+    position = (integer < top) ? top * 65536 : position;
+    hits += (integer < top);
+
+    s_SoaPositionY[i] = position;
+    s_SoaVelocityY[i] = velocity;
+    s_SoaStepVelocityY[i] = stepVelocity;
+    s_SoaWallHits[i] = hits;
+  }
+}
+#endif /* SIMULATE_SOA */
+
+
+/*******************************************************************************
+ * Adjust the physics accuracy to hold the frame rate, called once per drawn
+ * frame with the number of vertical blanks the last update took.  Counts votes
+ * for being slower or faster than a game tick (VBLANKS_PER_TICK), so a single
+ * slow frame (loading a file, a burst of tile changes) doesn't do anything.
+ * Too slow, and the step size limit goes up a pixel (fewer physics steps), or
+ * if that's at the level's maximum, friction goes up to stop the speeds
+ * running away.  Time to spare, and they come back down, friction first.  Off
+ * for networked games, since every machine has to simulate the same way.
+ */
+#define PHYSICS_GOVERNOR_RAISE_VOTES 4
+#define PHYSICS_GOVERNOR_LOWER_VOTES 16 /* Slower to lower, avoids flip flops. */
+#define PHYSICS_GOVERNOR_STEP_CHANGE 4 /* Quarter pixels, so 1 pixel. */
+#define PHYSICS_GOVERNOR_MAX_FRICTION 3
+
+#if !ROLLBACK_NETCODE
+static int8_t s_PhysicsGovernorVotes = 0;
+#endif /* !ROLLBACK_NETCODE */
+
+
+/* Go back to the level's settings, done when a level is loaded since the
+   votes and extras were for the previous level's limits.
+*/
+void PhysicsGovernorReset(void)
+{
+#if !ROLLBACK_NETCODE
+  s_PhysicsGovernorVotes = 0;
+#endif /* !ROLLBACK_NETCODE */
+  g_PhysicsGovernorStepExtra = 0;
+  g_PhysicsGovernorFrictionExtra = 0;
+}
+
+
+void PhysicsGovernorUpdate(uint8_t framesPerUpdate)
+{
+#if !ROLLBACK_NETCODE
+  if (g_PhysicsStepSizeLimitMax > g_PhysicsStepSizeLimit)
+  {
+    uint8_t stepSizeHeadroom;
+
+    /* Level may have changed the limits since the last update. */
+
+    stepSizeHeadroom = g_PhysicsStepSizeLimitMax - g_PhysicsStepSizeLimit;
+    if (g_PhysicsGovernorStepExtra > stepSizeHeadroom)
+      g_PhysicsGovernorStepExtra = stepSizeHeadroom;
+    stepSizeHeadroom -= g_PhysicsGovernorStepExtra;
+
+    if (framesPerUpdate > VBLANKS_PER_TICK)
+      s_PhysicsGovernorVotes++;
+    else if (framesPerUpdate < VBLANKS_PER_TICK)
+      s_PhysicsGovernorVotes--;
+
+    if (s_PhysicsGovernorVotes >= PHYSICS_GOVERNOR_RAISE_VOTES)
+    {
+      s_PhysicsGovernorVotes = 0;
+      if (stepSizeHeadroom != 0)
+      {
+        g_PhysicsGovernorStepExtra += (stepSizeHeadroom <
+          PHYSICS_GOVERNOR_STEP_CHANGE) ?
+          stepSizeHeadroom : PHYSICS_GOVERNOR_STEP_CHANGE;
+      }
+      else if (g_PhysicsGovernorFrictionExtra < PHYSICS_GOVERNOR_MAX_FRICTION &&
+      g_FrictionShift - g_PhysicsGovernorFrictionExtra >
+      PHYSICS_GOVERNOR_MIN_FRICTION_SHIFT)
+      {
+        g_PhysicsGovernorFrictionExtra++;
+      }
+    }
+    else if (s_PhysicsGovernorVotes <= -PHYSICS_GOVERNOR_LOWER_VOTES)
+    {
+      s_PhysicsGovernorVotes = 0;
+      if (g_PhysicsGovernorFrictionExtra != 0)
+        g_PhysicsGovernorFrictionExtra--;
+      else if (g_PhysicsGovernorStepExtra > PHYSICS_GOVERNOR_STEP_CHANGE)
+        g_PhysicsGovernorStepExtra -= PHYSICS_GOVERNOR_STEP_CHANGE;
+      else
+        g_PhysicsGovernorStepExtra = 0;
+    }
+    return;
+  }
+#else /* Networked games all have to simulate the same way. */
+  (void) framesPerUpdate;
+#endif /* !ROLLBACK_NETCODE */
+
+  /* Governor is off, use the level's settings as they are. */
+
+  PhysicsGovernorReset();
+}
 
 
 /*******************************************************************************
@@ -71,6 +309,7 @@ void Simulate(void)
   uint8_t iPlayer;
   player_pointer pPlayer;
   uint8_t stepShiftCount;
+  uint8_t stepSizeLimit;
   static uint8_t s_PreviousStepShiftCount = 0; /* To tell when it changes. */
 
 #if DEBUG_PRINT_SIM
@@ -109,7 +348,8 @@ void Simulate(void)
     /* Decrement all active power-up timers.  But only every 4th frame (so 5hz)
        so we can get several seconds of power-up in a byte counter. */
 
-    if (((uint8_t) g_FrameCounter & 3) == iPlayer)
+    if (((uint8_t) g_FrameCounter & PLAYER_GROUP_MASK) ==
+    (iPlayer & PLAYER_GROUP_MASK))
     {
       uint8_t *pPowerUpTimer;
       uint8_t iPowerUp;
@@ -233,13 +473,14 @@ void Simulate(void)
      that the integer maxVelocity < TILE_PIXEL_WIDTH is true if the floating
      point version (which can be slightly larger) is also < TILE_PIXEL_WIDTH. */
 
+  stepSizeLimit = g_PhysicsStepSizeLimit + g_PhysicsGovernorStepExtra;
   for (numberOfSteps = 1, stepShiftCount = 0;
   (numberOfSteps & 0x80) == 0;
   numberOfSteps += numberOfSteps, stepShiftCount++)
   {
     /* See if the step size is less than half a tile width, or whatever the
        level file says is an acceptable simulation resolution. */
-    if (maxVelocity < g_PhysicsStepSizeLimit)
+    if (maxVelocity < stepSizeLimit)
       break; /* Step size is small enough now. */
     maxVelocity >>= 1;
   }
@@ -326,29 +567,41 @@ void Simulate(void)
        add step velocity to position.  Need to do this before checking for any
        collisions since we could have player hitting player. */
 
-    pPlayer = g_player_array;
-    for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
+#if SIMULATE_SOA
+    if (g_SimulateSoA)
+    { /* Arrays are still up to date from the previous step's walls. */
+      if (iStep == 0)
+        SoaGatherPlayers();
+      SoaMovePlayers();
+      SoaScatterPlayers(false);
+    }
+    else
+#endif /* SIMULATE_SOA */
     {
-      if (pPlayer->brain == BRAIN_INACTIVE)
-        continue;
-      ADD_FX(pPlayer->pixel_center_x, pPlayer->step_velocity_x,
-        pPlayer->pixel_center_x);
-      ADD_FX(pPlayer->pixel_center_y, pPlayer->step_velocity_y,
-        pPlayer->pixel_center_y);
+      pPlayer = g_player_array;
+      for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
+      {
+        if (pPlayer->brain == BRAIN_INACTIVE)
+          continue;
+        ADD_FX(pPlayer->pixel_center_x, pPlayer->step_velocity_x,
+          pPlayer->pixel_center_x);
+        ADD_FX(pPlayer->pixel_center_y, pPlayer->step_velocity_y,
+          pPlayer->pixel_center_y);
 #if DEBUG_PRINT_SIM
-      strcpy(g_TempBuffer, "Player #");
-      AppendDecimalUInt16(iPlayer);
-      strcat(g_TempBuffer, ": new pos (");
-      AppendDecimalInt16(GET_FX_INTEGER(pPlayer->pixel_center_x));
-      strcat(g_TempBuffer, ".");
-      AppendDecimalUInt16(GET_FX_FRACTION(pPlayer->pixel_center_x));
-      strcat(g_TempBuffer, ", ");
-      AppendDecimalInt16(GET_FX_INTEGER(pPlayer->pixel_center_y));
-      strcat(g_TempBuffer, ".");
-      AppendDecimalUInt16(GET_FX_FRACTION(pPlayer->pixel_center_y));
-      strcat(g_TempBuffer, ")\n");
-      DebugPrintString(g_TempBuffer);
+        strcpy(g_TempBuffer, "Player #");
+        AppendDecimalUInt16(iPlayer);
+        strcat(g_TempBuffer, ": new pos (");
+        AppendDecimalInt16(GET_FX_INTEGER(pPlayer->pixel_center_x));
+        strcat(g_TempBuffer, ".");
+        AppendDecimalUInt16(GET_FX_FRACTION(pPlayer->pixel_center_x));
+        strcat(g_TempBuffer, ", ");
+        AppendDecimalInt16(GET_FX_INTEGER(pPlayer->pixel_center_y));
+        strcat(g_TempBuffer, ".");
+        AppendDecimalUInt16(GET_FX_FRACTION(pPlayer->pixel_center_y));
+        strcat(g_TempBuffer, ")\n");
+        DebugPrintString(g_TempBuffer);
 #endif
+      }
     }
 
   /* Check for player to player collisions.  If they are close enough, do the
@@ -620,7 +873,7 @@ void Simulate(void)
           strcat(g_TempBuffer, ": touches tile ");
           strcat(g_TempBuffer, g_TileOwnerNames[previousOwner]);
           if (previousOwner >= (tile_owner) OWNER_PLAYER_1 &&
-          previousOwner <= (tile_owner) OWNER_PLAYER_4)
+          previousOwner <= (tile_owner) OWNER_PLAYER_LAST)
           {
             strcat(g_TempBuffer, "/");
             AppendDecimalUInt16(pTile->age);
@@ -685,6 +938,7 @@ void Simulate(void)
               (pPlayer->power_up_timers[OWNER_PUP_SOLID])))
               {
                 tileAge++;
+                ROLLBACK_JOURNAL_TILE(pTile);
                 pTile->age = tileAge;
                 RequestTileRedraw(pTile);
               }
@@ -698,7 +952,7 @@ void Simulate(void)
           strcat(g_TempBuffer, ": Hit tile ");
           strcat(g_TempBuffer, g_TileOwnerNames[previousOwner]);
           if (previousOwner >= (tile_owner) OWNER_PLAYER_1 &&
-          previousOwner <= (tile_owner) OWNER_PLAYER_4)
+          previousOwner <= (tile_owner) OWNER_PLAYER_LAST)
           {
             strcat(g_TempBuffer, "/");
             AppendDecimalUInt16(pTile->age);
@@ -718,7 +972,7 @@ void Simulate(void)
 
           bool takeOverTile = false;
           if (previousOwner >= (tile_owner) OWNER_PLAYER_1 &&
-          previousOwner <= (tile_owner) OWNER_PLAYER_4)
+          previousOwner <= (tile_owner) OWNER_PLAYER_LAST)
           {
             if (g_TileAgeFeature == 0 || tileAge == 0 ||
             pPlayer->power_up_timers[OWNER_PUP_BASH_WALL])
@@ -726,6 +980,7 @@ void Simulate(void)
             else /* Wear down the tile. */
             {
               tileAge--;
+              ROLLBACK_JOURNAL_TILE(pTile);
               pTile->age = tileAge;
               RequestTileRedraw(pTile);
             }
@@ -734,11 +989,12 @@ void Simulate(void)
           previousOwner <= (tile_owner) OWNER_WALL_DESTRUCTIBLE_P4)
           {
             /* Tile is indestructible, unless you are the player that can
-               destroy that kind of tile. */
+               destroy that kind of tile.  Extra players in big host games
+               share the walls of one of the first 4 players. */
 
             takeOverTile =
-              ((iPlayer + (tile_owner) OWNER_WALL_DESTRUCTIBLE_P1) ==
-              previousOwner);
+              (((iPlayer & PLAYER_GROUP_MASK) +
+              (tile_owner) OWNER_WALL_DESTRUCTIBLE_P1) == previousOwner);
           }
           else /* A power up tile. */
           {
@@ -1107,6 +1363,27 @@ void Simulate(void)
     /* Bounce the players off the walls.  Also forces their position to be on
        the board, so do this as the last simulation action. */
 
+#if SIMULATE_SOA
+    if (g_SimulateSoA)
+    {
+      SoaGatherPlayers(); /* Collisions may have changed things. */
+      SoaBounceOffWalls();
+      SoaScatterPlayers(true);
+
+      pPlayer = g_player_array;
+      for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
+      {
+        int32_t hits = s_SoaWallHits[iPlayer];
+        if (pPlayer->brain == BRAIN_INACTIVE || hits == 0)
+          continue;
+        pPlayer->velocity_octant_invalid = true; /* Moving in new direction. */
+        for (; hits != 0; hits--)
+          PlaySound(SOUND_WALL_HIT, pPlayer);
+      }
+      continue; /* Skip the one player at a time version, next step. */
+    }
+#endif /* SIMULATE_SOA */
+
     pPlayer = g_player_array;
     for (iPlayer = 0; iPlayer != MAX_PLAYERS; iPlayer++, pPlayer++)
     {
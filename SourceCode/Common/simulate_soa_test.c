@@ -0,0 +1,284 @@
+/* Checks the structure of arrays Simulate() code against the usual code.
+ * Copyright © 2026 by Alexander G. M. Smith.
+ *
+ * With SIMULATE_SOA, Simulate() moves the players and bounces them off the
+ * walls using arrays of positions and velocities rather than going through
+ * the player records one at a time.  The results are meant to be identical.
+ * This plays a level with AI players twice, forking so both copies start
+ * from the same state, one with g_SimulateSoA off and one with it on.  The
+ * child sends the player and tile arrays to the parent after every frame,
+ * and the parent compares them with its own, reporting the first difference.
+ * It also reports the time each spent in Simulate().  Try it with
+ * -DMAX_PLAYERS=64 too, for the big host games.
+ *
+ * Compile and run in the Common directory with:
+ *
+ * gcc -g -O3 -Wall -DSIMULATE_SOA=1 -o simulate_soa_test simulate_soa_test.c && ./simulate_soa_test
+ *
+ * Options are -n Frames to run (default 20000), -d DataDirectory/ (default
+ * ../Nabu/Art/), -l Level (default GAMEDEMO) and -p Players (default is
+ * MAX_PLAYERS, all added as AI players at the start rather than one every
+ * few seconds like the game does).  When a level finishes, the next one it
+ * names gets loaded, same as the game.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code. */
+#include "cverify.h"
+#include "fixed_point.c"
+#include "debug_print.c"
+#include "tiles.c"
+#include "players.c"
+#include "simulate.c"
+#include "scores.c"
+#include "soundscreen.c"
+#include "levels.c"
+
+#if !SIMULATE_SOA
+#error "Compile with -DSIMULATE_SOA=1 so there is something to test."
+#endif
+
+#define MAX_TEST_TILES 2048
+
+static uint8_t s_DesiredPlayers = MAX_PLAYERS;
+
+static player_record s_OtherPlayers[MAX_PLAYERS];
+static tile_record s_OtherTiles[MAX_TEST_TILES];
+
+
+/*******************************************************************************
+ * Read exactly the given amount from the pipe, FALSE if it ended early.
+ */
+static bool ReadAll(int fileDescriptor, void *pBuffer, size_t amount)
+{
+  ssize_t amountRead;
+
+  while (amount > 0)
+  {
+    amountRead = read(fileDescriptor, pBuffer, amount);
+    if (amountRead <= 0)
+      return false;
+    pBuffer = (uint8_t *) pBuffer + amountRead;
+    amount -= amountRead;
+  }
+  return true;
+}
+
+
+/*******************************************************************************
+ * Run the game for a number of frames, like the GameServer does but without
+ * any network players.  The child writes its state to the pipe after each
+ * frame, the parent reads it and compares.  Returns the number of frames where
+ * the state was different (parent only), or -1 on errors.
+ */
+static long RunFrames(long frameCount, int pipeFd, bool isChild,
+  double *pSimulateSeconds)
+{
+  struct timespec startTime, endTime;
+  long differentFrames = 0;
+  long iFrame;
+  int iPlayer;
+
+  *pSimulateSeconds = 0;
+  for (iFrame = 0; iFrame < frameCount; iFrame++)
+  {
+    /* Fill up with AI players right away, the game only adds one every few
+       seconds and levels usually ask for 4. */
+    gLevelDesiredNumberOfPlayers = s_DesiredPlayers;
+    for (iPlayer = 0; iPlayer < s_DesiredPlayers; iPlayer++)
+    {
+      if (g_player_array[iPlayer].brain == BRAIN_INACTIVE)
+      {
+        ReinitialisePlayer(g_player_array + iPlayer);
+        g_player_array[iPlayer].brain = BRAIN_ALGORITHM;
+      }
+    }
+    UpdatePlayerInputs();
+    if (gVictoryModeHighestTileCount)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &startTime);
+      Simulate();
+      clock_gettime(CLOCK_MONOTONIC, &endTime);
+      *pSimulateSeconds += (endTime.tv_sec - startTime.tv_sec) +
+        (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+      if ((g_FrameCounter & 0x3F) == 0)
+        AddNextPowerUpTile();
+      UpdateScores();
+    }
+    g_ScoreFramesPerUpdate = 1;
+
+    if (isChild)
+    {
+      if (write(pipeFd, g_player_array, sizeof(g_player_array)) !=
+      sizeof(g_player_array) ||
+      write(pipeFd, g_tile_array, MAX_TEST_TILES * sizeof(tile_record)) !=
+      MAX_TEST_TILES * sizeof(tile_record))
+        return -1;
+    }
+    else
+    {
+      if (!ReadAll(pipeFd, s_OtherPlayers, sizeof(s_OtherPlayers)) ||
+      !ReadAll(pipeFd, s_OtherTiles, sizeof(s_OtherTiles)))
+      {
+        fprintf(stderr, "Lost contact with the child process.\n");
+        return -1;
+      }
+      if (memcmp(s_OtherTiles, g_tile_array, sizeof(s_OtherTiles)) != 0 ||
+      memcmp(s_OtherPlayers, g_player_array, sizeof(s_OtherPlayers)) != 0)
+      {
+        if (differentFrames++ == 0)
+        {
+          printf("Frame %ld of level %s is different:\n", iFrame, gLevelName);
+          for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++)
+            printf("  Player %d at (%f, %f) velocity (%f, %f), should be "
+              "(%f, %f) velocity (%f, %f).\n", iPlayer,
+              GET_FX_FLOAT(g_player_array[iPlayer].pixel_center_x),
+              GET_FX_FLOAT(g_player_array[iPlayer].pixel_center_y),
+              GET_FX_FLOAT(g_player_array[iPlayer].velocity_x),
+              GET_FX_FLOAT(g_player_array[iPlayer].velocity_y),
+              GET_FX_FLOAT(s_OtherPlayers[iPlayer].pixel_center_x),
+              GET_FX_FLOAT(s_OtherPlayers[iPlayer].pixel_center_y),
+              GET_FX_FLOAT(s_OtherPlayers[iPlayer].velocity_x),
+              GET_FX_FLOAT(s_OtherPlayers[iPlayer].velocity_y));
+        }
+        /* Carry on from the usual code's state, to see if it happens again. */
+        memcpy(g_player_array, s_OtherPlayers, sizeof(s_OtherPlayers));
+        memcpy(g_tile_array, s_OtherTiles, sizeof(s_OtherTiles));
+      }
+    }
+
+    if (VictoryConditionTest())
+    {
+      if (!LoadLevelFile())
+        return -1;
+      continue;
+    }
+    g_FrameCounter++;
+    if ((g_FrameCounter & 0x1F) == 0)
+    {
+      if (g_ScoreGoal-- == 0)
+        g_ScoreGoal = 5;
+    }
+  }
+  return differentFrames;
+}
+
+
+int main(int argc, char **argv)
+{
+  long frameCount = 20000;
+  int option;
+  int pipeFds[2];
+  pid_t childPid;
+  int childStatus;
+  long differentFrames;
+  double soaSeconds, usualSeconds;
+
+  g_HostDataPath = "../Nabu/Art/";
+  strcpy(gLevelName, "GAMEDEMO");
+  while ((option = getopt(argc, argv, "n:d:l:p:")) != -1)
+  {
+    switch (option)
+    {
+      case 'n': frameCount = atol(optarg); break;
+      case 'd': g_HostDataPath = optarg; break;
+      case 'l':
+        snprintf(gLevelName, sizeof(gLevelName), "%s", optarg);
+        break;
+      case 'p':
+        s_DesiredPlayers = atoi(optarg);
+        if (s_DesiredPlayers > MAX_PLAYERS)
+          s_DesiredPlayers = MAX_PLAYERS;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n Frames] [-d DataDirectory/] "
+          "[-l Level] [-p Players]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  /* Initialise some fixed point number constants, like the NABU does. */
+  ZERO_FX(gfx_Constant_Zero);
+  INT_TO_FX(1, gfx_Constant_One);
+  COPY_NEGATE_FX(gfx_Constant_One, gfx_Constant_MinusOne);
+  INT_FRACTION_TO_FX(0 /* int */, MAX_FX_FRACTION / 8 + 1 /* fraction */,
+    gfx_Constant_Eighth);
+  COPY_NEGATE_FX(gfx_Constant_Eighth, gfx_Constant_MinusEighth);
+
+  g_tile_array = calloc(MAX_TEST_TILES, sizeof(tile_record));
+  gTileArraySize = MAX_TEST_TILES;
+  g_play_area_height_tiles = 23;
+  g_play_area_width_tiles = 32;
+  if (g_tile_array == NULL || !InitTileArray())
+  {
+    fprintf(stderr, "Failed to set up play area tiles.\n");
+    return 2;
+  }
+  InitialisePlayers();
+  if (!LoadLevelFile())
+  {
+    fprintf(stderr, "Unable to load level %s from %s.\n", gLevelName,
+      g_HostDataPath);
+    return 2;
+  }
+
+  if (pipe(pipeFds) != 0)
+    return 2;
+  fflush(stdout);
+  childPid = fork();
+  if (childPid < 0)
+    return 2;
+  if (childPid == 0)
+  { /* Child runs the usual one player at a time code. */
+    close(pipeFds[0]);
+    g_SimulateSoA = false;
+    if (RunFrames(frameCount, pipeFds[1], true, &usualSeconds) < 0)
+      return 1;
+    printf("Usual code spent %.3f seconds in Simulate().\n", usualSeconds);
+    return 0;
+  }
+
+  close(pipeFds[1]);
+  g_SimulateSoA = true;
+  differentFrames = RunFrames(frameCount, pipeFds[0], false, &soaSeconds);
+  close(pipeFds[0]);
+  waitpid(childPid, &childStatus, 0);
+  printf("Structure of arrays code spent %.3f seconds in Simulate().\n",
+    soaSeconds);
+  if (differentFrames < 0 || !WIFEXITED(childStatus) ||
+  WEXITSTATUS(childStatus) != 0)
+    return 2;
+  printf("%ld frames with %d players, %ld different.\n", frameCount,
+    s_DesiredPlayers, differentFrames);
+  return differentFrames != 0;
+}
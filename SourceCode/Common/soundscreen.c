@@ -16,6 +16,7 @@
  */
 
 #include "soundscreen.h"
+#include "rollback.h"
 
 #ifdef NABU_H
 #define MAX_SOUND_CHANNELS 3 /* Just the sound effects ones, 0 to 2. */
@@ -56,6 +57,7 @@ static void *k_SoundTrackPointers[SOUND_MAX] = {
   NthEffectsPUPNormal,
   NthEffectsBallOnBall,
 };
+#endif /* NABU_H */
 
 const uint8_t g_TileOwnerToSoundID[OWNER_MAX] =
 {
@@ -64,6 +66,9 @@ const uint8_t g_TileOwnerToSoundID[OWNER_MAX] =
   SOUND_NULL, /* OWNER_PLAYER_2 */
   SOUND_NULL, /* OWNER_PLAYER_3 */
   SOUND_NULL, /* OWNER_PLAYER_4 */
+#if MAX_PLAYERS > 4
+  [OWNER_WALL_INDESTRUCTIBLE] =
+#endif
   SOUND_NULL, /* OWNER_WALL_INDESTRUCTIBLE */
   SOUND_NULL, /* OWNER_WALL_DESTRUCTIBLE_P1 */
   SOUND_NULL, /* OWNER_WALL_DESTRUCTIBLE_P2 */
@@ -76,9 +81,12 @@ const uint8_t g_TileOwnerToSoundID[OWNER_MAX] =
   SOUND_PUP_BASH, /* OWNER_PUP_BASH_WALL */
   SOUND_PUP_SOLID, /* OWNER_PUP_SOLID */
 };
-#endif /* NABU_H */
 
 
+#ifndef NABU_H
+const char *g_HostDataPath = "NTHPONG/";
+#endif /* NABU_H */
+
 uint8_t g_harvest_sound_threshold = 0;
 /* Cut down on the number of times the harvest sound is played, using an
    adaptive scheme that keeps a running threshold going continuously.  If the
@@ -86,13 +94,25 @@ uint8_t g_harvest_sound_threshold = 0;
    play a sound. */
 
 
+#ifdef NABU_H
+static sound_type s_QueuedSounds[MAX_PLAYERS][2];
+/* The highest priority sound requested by each player during the current
+   frame, one for tonal sounds [0] and one for white noise sounds [1].  Channel
+   assignment is done once per frame by PlayQueuedSounds(), rather than for
+   every collision inside the physics loop. */
+#endif /* NABU_H */
+
+
 /* Play a sound effect.  Given a player so we can customise sounds per player
    (usually with a different frequency / tone for each player).  Plays with
    priority based on the sound_id if the system can't play multiple sounds
-   at once.
+   at once.  The sound is queued and actually started by PlayQueuedSounds().
 */
 void PlaySound(sound_type sound_id, player_pointer pPlayer)
 {
+  if (g_RollbackResimulating)
+    return; /* Already made the noise the first time this frame was run. */
+
   /* Skip harvest sound if it isn't as big as recent harvests. */
 
   if (sound_id == SOUND_HARVEST)
@@ -104,6 +124,19 @@ void PlaySound(sound_type sound_id, player_pointer pPlayer)
   }
 
 #ifdef NABU_H
+  sound_type *pQueued = &s_QueuedSounds[pPlayer->player_array_index]
+    [k_WhiteNoiseSound[sound_id]];
+  if (*pQueued < sound_id)
+    *pQueued = sound_id;
+#endif /* NABU_H */
+}
+
+
+#ifdef NABU_H
+/* Start playing a sound effect right now, if there is a channel for it.
+*/
+static void StartSound(sound_type sound_id, player_pointer pPlayer)
+{
 /* First see which channel should play the sound.  If it has white noise, it
    always goes in channel 2 (music is written with that rule too, due to a bug
    in the music player with white noise in channel 0 not restarting).  Else it
@@ -173,6 +206,27 @@ void PlaySound(sound_type sound_id, player_pointer pPlayer)
     CSFX_chan(channel, k_SoundTrackPointers[sound_id]);
     s_NowPlaying[channel] = sound_id;
   }
+}
+#endif /* NABU_H */
+
+
+/* Start the sounds queued up by PlaySound() during the frame, once per frame
+   before the sound gets updated.
+*/
+void PlayQueuedSounds(void)
+{
+#ifdef NABU_H
+  sound_type *pQueued = &s_QueuedSounds[0][0];
+  uint8_t i;
+
+  for (i = 0; i < MAX_PLAYERS * 2; i++, pQueued++)
+  {
+    if (*pQueued != SOUND_NULL)
+    {
+      StartSound(*pQueued, g_player_array + i / 2);
+      *pQueued = SOUND_NULL;
+    }
+  }
 #endif /* NABU_H */
 }
 
@@ -183,6 +237,7 @@ void PlaySound(sound_type sound_id, player_pointer pPlayer)
    messages about higher level errors while loading. */
 static const char *sSetUpFileNameBase;
 static const char *sSetUpExtension; /* NULL or empty string if no extension. */
+static bool sOpenLocalOnly; /* Set by OpenLocalDataFile() to skip web sites. */
 
 /* Utility function to set up the path name, returns length of the string. */
 static uint8_t SetUpPathInTempBuffer(const char *prefix)
@@ -210,6 +265,187 @@ static uint8_t SetUpPathInTempBuffer(const char *prefix)
 }
 
 
+#ifdef NABU_H
+/* Remembers where recently opened files were found, or that they weren't
+   found anywhere, so opening them again goes straight to the right place
+   rather than trying each place in turn, which takes a while for web sites.
+   Names too long for the cache don't get cached.  Entries are replaced round
+   robin.  Missing files are forgotten after OPEN_CACHE_MISSING_LEVELS level
+   loads, or sooner if a quick local search finds them, so a file added while
+   the game runs gets used eventually.  If a cached place doesn't work any
+   more, the other places are tried too. */
+#define OPEN_CACHE_ENTRIES 8
+#define OPEN_CACHE_NAME_LENGTH 24
+#define OPEN_CACHE_MISSING 0xFF /* Path index for files not found anywhere. */
+#define OPEN_CACHE_MISSING_LEVELS 16
+
+typedef struct OpenCacheStruct {
+  char name[OPEN_CACHE_NAME_LENGTH]; /* File name and extension, no path. */
+  uint8_t pathIndex; /* Index into sPathsToTry where the file was found. */
+  uint8_t missingLevels; /* Level loads left before looking again if missing. */
+} *OpenCachePointer;
+
+static struct OpenCacheStruct sOpenCache[OPEN_CACHE_ENTRIES];
+static uint8_t sOpenCacheNextEntry; /* The one to replace next. */
+
+
+/* Find the cache entry for the file in sSetUpFileNameBase and
+   sSetUpExtension, or NULL if it isn't cached.  Uses g_TempBuffer.
+*/
+static OpenCachePointer OpenCacheFind(void)
+{
+  OpenCachePointer pCache = sOpenCache;
+  uint8_t i;
+
+  SetUpPathInTempBuffer("");
+  for (i = 0; i < OPEN_CACHE_ENTRIES; i++, pCache++)
+  {
+    if (strcmp(pCache->name, g_TempBuffer) == 0)
+      return pCache;
+  }
+  return NULL;
+}
+
+
+/* Remember where the file in sSetUpFileNameBase and sSetUpExtension was
+   found, updating the given cache entry if it isn't NULL, otherwise using a
+   new entry.  Uses g_TempBuffer.
+*/
+static void OpenCacheRemember(OpenCachePointer pCache, uint8_t pathIndex)
+{
+  if (pCache == NULL)
+  {
+    if (SetUpPathInTempBuffer("") >= OPEN_CACHE_NAME_LENGTH)
+      return; /* Too long to cache. */
+    pCache = sOpenCache + sOpenCacheNextEntry;
+    if (++sOpenCacheNextEntry >= OPEN_CACHE_ENTRIES)
+      sOpenCacheNextEntry = 0;
+    strcpy(pCache->name, g_TempBuffer);
+  }
+  pCache->pathIndex = pathIndex;
+  pCache->missingLevels = OPEN_CACHE_MISSING_LEVELS;
+}
+#endif /* NABU_H */
+
+
+/* Count down how long missing files are remembered, called once per level
+   load.  Forgets the ones that have run out, so they get looked for again.
+*/
+void OpenCacheAgeMissing(void)
+{
+#ifdef NABU_H
+  OpenCachePointer pCache = sOpenCache;
+  uint8_t i;
+
+  for (i = 0; i < OPEN_CACHE_ENTRIES; i++, pCache++)
+  {
+    if (pCache->pathIndex == OPEN_CACHE_MISSING &&
+    --pCache->missingLevels == 0)
+      pCache->name[0] = 0;
+  }
+#endif /* NABU_H */
+}
+
+
+/* The currently open bundle (see OpenBundle()), and the members being read
+   from it.  A member gets a made up file handle, BUNDLE_HANDLE_FIRST plus the
+   index of its reader, and is read from the bundle file at a given position
+   rather than sequentially, so several can be open at once. */
+#ifdef NABU_H
+#define BUNDLE_HANDLE_FIRST ((FileHandleType) 0xF0) /* RetroNET counts up. */
+#else
+#define BUNDLE_HANDLE_FIRST ((FileHandleType) 0x40000000)
+#endif /* NABU_H */
+#define BUNDLE_READERS 4
+
+typedef struct BundleMemberStruct {
+  char name[BUNDLE_NAME_LENGTH]; /* Upper case, with extension, no path. */
+  uint32_t offset; /* Position in the bundle file. */
+  uint32_t size;
+} *BundleMemberPointer;
+
+typedef struct BundleReaderStruct {
+  bool inUse;
+  uint32_t position; /* Position of the next byte in the bundle file. */
+  uint32_t remaining; /* Bytes left in the member. */
+} *BundleReaderPointer;
+
+static FileHandleType sBundleFileHandle = BAD_FILE_HANDLE;
+static char sBundleName[BUNDLE_NAME_LENGTH];
+static uint8_t sBundleMemberCount;
+static struct BundleMemberStruct sBundleMembers[BUNDLE_MAX_MEMBERS];
+static struct BundleReaderStruct sBundleReaders[BUNDLE_READERS];
+
+static const char kBundleMagic[BUNDLE_MAGIC_LENGTH] =
+  {'N', 'B', 'D', BUNDLE_VERSION};
+
+
+/* Open the member of the current bundle named by sSetUpFileNameBase and
+   sSetUpExtension, if there is one.  Returns its made up file handle, or
+   BAD_FILE_HANDLE if it isn't in the bundle.  Uses g_TempBuffer.
+*/
+static FileHandleType BundleOpenMember(int32_t *pFileSize)
+{
+  BundleMemberPointer pMember = sBundleMembers;
+  BundleReaderPointer pReader;
+  uint8_t iMember;
+  uint8_t iReader;
+
+  if (sBundleMemberCount == 0)
+    return BAD_FILE_HANDLE;
+
+  SetUpPathInTempBuffer("");
+  for (iMember = sBundleMemberCount; iMember != 0; iMember--, pMember++)
+  {
+    if (strcasecmp(pMember->name, g_TempBuffer) != 0)
+      continue;
+
+    pReader = sBundleReaders;
+    for (iReader = 0; iReader < BUNDLE_READERS; iReader++, pReader++)
+    {
+      if (!pReader->inUse)
+      {
+        pReader->inUse = true;
+        pReader->position = pMember->offset;
+        pReader->remaining = pMember->size;
+        if (pFileSize != NULL)
+          *pFileSize = pMember->size;
+        return BUNDLE_HANDLE_FIRST + iReader;
+      }
+    }
+    break; /* All readers busy, open it as a separate file instead. */
+  }
+  return BAD_FILE_HANDLE;
+}
+
+
+/* Read the next bytes of a bundle member, same as ReadDataFile().
+*/
+static uint16_t BundleReadMember(BundleReaderPointer pReader, void *pBuffer,
+  uint16_t amountToRead)
+{
+  uint16_t amountRead;
+
+  if (amountToRead > pReader->remaining)
+    amountToRead = pReader->remaining;
+  if (amountToRead == 0 || sBundleFileHandle == BAD_FILE_HANDLE)
+    return 0;
+
+#ifdef NABU_H
+  amountRead = rn_fileHandleRead(sBundleFileHandle, pBuffer,
+    0 /* buffer offset */, pReader->position, amountToRead);
+#else
+  ssize_t hostAmountRead = pread(sBundleFileHandle, pBuffer, amountToRead,
+    pReader->position);
+  amountRead = (hostAmountRead > 0) ? (uint16_t) hostAmountRead : 0;
+#endif /* NABU_H */
+
+  pReader->position += amountRead;
+  pReader->remaining -= amountRead;
+  return amountRead;
+}
+
+
 /* Open a file for sequential reading, using the given file name.  If extension
    is specified (not NULL or empty), will append a period and the extension
    string to the file name.  Will look in various directories and online,
@@ -217,6 +453,9 @@ static uint8_t SetUpPathInTempBuffer(const char *prefix)
    anywhere and prints a debug message.  If it was found, it sets the optional
    file size argument if it isn't NULL.  You should close the file when you've
    finished using it.  Uses g_TempBuffer.  For NABU, use upper case names.
+   The NABU remembers where recently opened files were found (or that they
+   weren't found), so opening them again is quicker.  If a bundle is open and
+   has a member with that name, the member gets opened instead.
 */
 FileHandleType OpenDataFile(const char *fileNameBase, const char *extension,
   int32_t *pFileSize)
@@ -229,6 +468,10 @@ FileHandleType OpenDataFile(const char *fileNameBase, const char *extension,
   sSetUpFileNameBase = fileNameBase;
   sSetUpExtension = extension;
 
+  fileID = BundleOpenMember(pFileSize);
+  if (fileID != BAD_FILE_HANDLE)
+    return fileID;
+
 #ifdef NABU_H
   static const char * sPathsToTry[] = {
     /* First try the NTHPONG directory on the NABU Internet Adapter server.
@@ -258,18 +501,34 @@ FileHandleType OpenDataFile(const char *fileNameBase, const char *extension,
      files since opening also creates an empty file).  Avoids an extra web
      server request/response cycle. */
 
+  /* See if we already know where this file is, or that it's missing.  If
+     not, try the places in order, so a local copy wins over a web site. */
+
+  OpenCachePointer pCache = OpenCacheFind();
+  uint8_t firstPath = 0;
+  if (pCache != NULL)
+  {
+    if (pCache->pathIndex != OPEN_CACHE_MISSING)
+      firstPath = pCache->pathIndex;
+    else if (!sOpenLocalOnly) /* Local store is quick to check again. */
+      goto NotFound;
+  }
+
   const char *pPath;
-  uint8_t iPath = 0;
-  while ((pPath = sPathsToTry[iPath++]) != NULL)
+  uint8_t iPath = firstPath;
+  uint8_t iNextPath = 0;
+  while ((pPath = sPathsToTry[iPath]) != NULL)
   {
     int32_t fileSize = 0;
     nameLen = SetUpPathInTempBuffer(pPath);
-    if (iPath < SNDSCR_PATH_WWW_INDEX)
+    if (iPath + 1 < SNDSCR_PATH_WWW_INDEX)
     {
       fileSize = rn_fileSize(nameLen, g_TempBuffer);
       if (fileSize <= 0)
-        continue; /* File doesn't exist. */
+        goto NextPath; /* File doesn't exist. */
     }
+    else if (sOpenLocalOnly)
+      goto NextPath; /* Web sites can take seconds to answer. */
     fileID = rn_fileOpen(nameLen, g_TempBuffer, OPEN_FILE_FLAG_READONLY,
       0xff /* Use a new file handle */);
     SoundUpdateIfNeeded(); /* Each open attempt could take a while. */
@@ -277,32 +536,542 @@ FileHandleType OpenDataFile(const char *fileNameBase, const char *extension,
     {
       if (pFileSize != NULL)
       {
-        if (iPath >= SNDSCR_PATH_WWW_INDEX) /* Do need the file size, get it. */
+        if (iPath + 1 >= SNDSCR_PATH_WWW_INDEX) /* Do need the size, get it. */
           fileSize = rn_fileHandleSize(fileID);
         *pFileSize = fileSize;
       }
+      OpenCacheRemember(pCache, iPath);
+      return fileID;
+    }
+
+NextPath: /* Try the rest in order, skipping the one tried first. */
+    iPath = iNextPath++;
+    if (iPath == firstPath)
+      iPath = iNextPath++;
+  }
+  if (!sOpenLocalOnly) /* Might still be on a web site otherwise. */
+    OpenCacheRemember(pCache, OPEN_CACHE_MISSING);
+
+NotFound:
+#else /* Host computer, look in the data directory then the current one. */
+  const char *pPath;
+  uint8_t iPath;
+  for (iPath = 0; iPath < 2; iPath++)
+  {
+    pPath = (iPath == 0) ? g_HostDataPath : "";
+    SetUpPathInTempBuffer(pPath);
+    fileID = open(g_TempBuffer, O_RDONLY);
+    if (fileID != BAD_FILE_HANDLE)
+    {
+      if (pFileSize != NULL)
+      {
+        struct stat fileStatus;
+        *pFileSize = (fstat(fileID, &fileStatus) == 0) ?
+          (int32_t) fileStatus.st_size : 0;
+      }
       return fileID;
     }
   }
 #endif /* NABU_H */
 
-  SetUpPathInTempBuffer(
-    "Unable to load file from store directory or Alex's web sites, named \"");
-  strcat(g_TempBuffer, "\".\n");
-  DebugPrintString(g_TempBuffer);
+  if (!sOpenLocalOnly)
+  {
+    SetUpPathInTempBuffer(
+      "Unable to load file from store directory or Alex's web sites, named \"");
+    strcat(g_TempBuffer, "\".\n");
+    DebugPrintString(g_TempBuffer);
+  }
 
   return BAD_FILE_HANDLE;
 }
 
 
+/* Like OpenDataFile(), but only looks in the open bundle and the NABU
+   Internet Adapter's local store, skipping the web sites, so it doesn't take
+   long enough to disturb a game in progress.  Quietly returns BAD_FILE_HANDLE
+   if the file isn't there.
+*/
+FileHandleType OpenLocalDataFile(const char *fileNameBase,
+  const char *extension)
+{
+  FileHandleType fileID;
+
+  sOpenLocalOnly = true;
+  fileID = OpenDataFile(fileNameBase, extension, NULL /* No size. */);
+  sOpenLocalOnly = false;
+  return fileID;
+}
+
+
 /* Undoes OpenDataFile.  Does nothing when given BAD_FILE_HANDLE.
 */
 void CloseDataFile(FileHandleType fileHandle)
 {
+  if (fileHandle == BAD_FILE_HANDLE)
+    return;
+  if (fileHandle >= BUNDLE_HANDLE_FIRST &&
+  fileHandle < BUNDLE_HANDLE_FIRST + BUNDLE_READERS)
+  {
+    sBundleReaders[fileHandle - BUNDLE_HANDLE_FIRST].inUse = false;
+    return;
+  }
+#ifdef NABU_H
+  rn_fileHandleClose(fileHandle);
+#else
+  close(fileHandle);
+#endif /* NABU_H */
+}
+
+
+/* Read the next bytes from a file opened by OpenDataFile().  Returns the
+   number of bytes read, zero at end of file or on errors.
+*/
+uint16_t ReadDataFile(FileHandleType fileHandle, void *pBuffer,
+  uint16_t amountToRead)
+{
+  if (fileHandle >= BUNDLE_HANDLE_FIRST &&
+  fileHandle < BUNDLE_HANDLE_FIRST + BUNDLE_READERS)
+    return BundleReadMember(sBundleReaders + (fileHandle - BUNDLE_HANDLE_FIRST),
+      pBuffer, amountToRead);
+#ifdef NABU_H
+  return rn_fileHandleReadSeq(fileHandle, pBuffer, 0 /* buffer offset */,
+    amountToRead);
+#else
+  ssize_t amountRead = read(fileHandle, pBuffer, amountToRead);
+  return (amountRead > 0) ? (uint16_t) amountRead : 0;
+#endif /* NABU_H */
+}
+
+
+/* Read a little endian 32 bit number from a bundle index.
+*/
+static uint32_t BundleIndexUInt32(const uint8_t *pIndex)
+{
+  return pIndex[0] | ((uint16_t) pIndex[1] << 8) |
+    ((uint32_t) pIndex[2] << 16) | ((uint32_t) pIndex[3] << 24);
+}
+
+
+/* Open the given bundle file (extension BUNDLE gets added), closing the
+   previous one.  Does nothing if that bundle is already open.  While it is
+   open, OpenDataFile() opens members of the bundle rather than separate files
+   when the name matches.  Returns FALSE and prints a debug message if the
+   bundle couldn't be opened or is damaged.  Uses g_TempBuffer.
+*/
+bool OpenBundle(const char *fileName)
+{
+  FileHandleType fileID;
+  BundleMemberPointer pMember;
+  const uint8_t *pIndex;
+  const uint8_t *pIndexEnd;
+  uint16_t amountRead;
+  uint8_t memberCount;
+  uint8_t nameLength;
+
+  if (sBundleFileHandle != BAD_FILE_HANDLE &&
+  strcasecmp(sBundleName, fileName) == 0)
+    return true;
+
+  CloseBundle();
+  if (strlen(fileName) >= BUNDLE_NAME_LENGTH)
+    return false;
+  fileID = OpenDataFile(fileName, "BUNDLE", NULL /* No size. */);
+  if (fileID == BAD_FILE_HANDLE)
+    return false;
+
+  /* The whole index fits in g_TempBuffer, so read it in one go. */
+
+  amountRead = ReadDataFile(fileID, g_TempBuffer, TEMPBUFFER_LEN);
+  pIndex = (uint8_t *) g_TempBuffer;
+  pIndexEnd = pIndex + amountRead;
+  if (amountRead <= BUNDLE_MAGIC_LENGTH ||
+  memcmp(pIndex, kBundleMagic, BUNDLE_MAGIC_LENGTH) != 0)
+    goto ErrorExit;
+  pIndex += BUNDLE_MAGIC_LENGTH;
+  memberCount = *pIndex++;
+  if (memberCount > BUNDLE_MAX_MEMBERS)
+    goto ErrorExit;
+
+  for (pMember = sBundleMembers; pMember < sBundleMembers + memberCount;
+  pMember++)
+  {
+    if (pIndex >= pIndexEnd)
+      goto ErrorExit;
+    nameLength = *pIndex++;
+    if (nameLength >= BUNDLE_NAME_LENGTH || pIndex + nameLength + 8 > pIndexEnd)
+      goto ErrorExit;
+    memcpy(pMember->name, pIndex, nameLength);
+    pMember->name[nameLength] = 0;
+    pIndex += nameLength;
+    pMember->offset = BundleIndexUInt32(pIndex);
+    pMember->size = BundleIndexUInt32(pIndex + 4);
+    pIndex += 8;
+  }
+
+  sBundleFileHandle = fileID;
+  sBundleMemberCount = memberCount;
+  strcpy(sBundleName, fileName);
+  return true;
+
+ErrorExit:
+  CloseDataFile(fileID);
+  SetUpPathInTempBuffer("Bundle file is damaged, named \"");
+  strcat(g_TempBuffer, "\".\n");
+  DebugPrintString(g_TempBuffer);
+  return false;
+}
+
+
+/* Close the current bundle, if any.  Members still open read as end of file.
+*/
+void CloseBundle(void)
+{
+  BundleReaderPointer pReader;
+
+  for (pReader = sBundleReaders; pReader < sBundleReaders + BUNDLE_READERS;
+  pReader++)
+    pReader->remaining = 0;
+  CloseDataFile(sBundleFileHandle);
+  sBundleFileHandle = BAD_FILE_HANDLE;
+  sBundleMemberCount = 0;
+}
+
+
+#ifdef NABU_H
+/* Cache of recently loaded small screen files (usually .NCHR name tables),
+   kept in the unused gap in video memory after the sprite attribute table (see
+   the memory map in main.c).  Slide show levels reload the same screens over
+   and over, and copying them from VRAM is a lot faster than asking the NABU
+   Internet Adapter again.  The file's bytes (still packed if the file was
+   packed) are copied into the gap as LoadScreen() reads them, and later
+   replayed through the same unpacking code instead of reading the file.  Full
+   screen loads don't touch the gap so they don't need to evict anything, but
+   if something else (CP/M text output) does scribble on it, the checksum
+   catches it and we load from the file instead. */
+#define SCREEN_CACHE_VRAM_ADDRESS 0x1B80
+#define SCREEN_CACHE_VRAM_SIZE 1152
+#define SCREEN_CACHE_ENTRIES 4
+#define SCREEN_CACHE_NAME_LENGTH 24
+
+typedef struct ScreenCacheStruct {
+  char name[SCREEN_CACHE_NAME_LENGTH]; /* Name given to LoadScreen(). */
+  uint16_t size; /* Number of bytes of the file, and of VRAM used. */
+  uint16_t checksum; /* Sum of all the bytes, to spot damaged data. */
+  uint16_t lastUsed; /* sScreenCacheClock when last loaded, for LRU. */
+} ScreenCacheRecord, *ScreenCachePointer;
+
+/* The entries in use are the first sScreenCacheCount ones in the array, in the
+   same order as their data in VRAM, packed together with no gaps. */
+static ScreenCacheRecord sScreenCache[SCREEN_CACHE_ENTRIES];
+static uint8_t sScreenCacheCount;
+static uint16_t sScreenCacheUsed; /* Bytes of VRAM in use. */
+static uint16_t sScreenCacheClock;
+
+/* The screen file currently being loaded is either being saved into the cache
+   as it is read, or being read back from the cache, or neither. */
+static bool sScreenCacheSaving;
+static bool sScreenCacheLoading;
+static uint16_t sScreenCacheAddress; /* VRAM address of the next byte. */
+static uint16_t sScreenCacheRemaining; /* Bytes left to read or space left. */
+static uint16_t sScreenCacheChecksum; /* Sum of the bytes so far. */
+
+
+/* Find the cache entry for the given screen file name, NULL if none.
+*/
+static ScreenCachePointer ScreenCacheFind(const char *FileName)
+{
+  ScreenCachePointer pCache = sScreenCache;
+  uint8_t i;
+
+  for (i = sScreenCacheCount; i != 0; i--, pCache++)
+  {
+    if (strcmp(pCache->name, FileName) == 0)
+      return pCache;
+  }
+  return NULL;
+}
+
+
+/* Returns the VRAM address of the data for the given cache entry, just after
+   the data for all the entries before it.
+*/
+static uint16_t ScreenCacheDataAddress(ScreenCachePointer pCache)
+{
+  uint16_t address = SCREEN_CACHE_VRAM_ADDRESS;
+  ScreenCachePointer pEntry;
+
+  for (pEntry = sScreenCache; pEntry != pCache; pEntry++)
+    address += pEntry->size;
+  return address;
+}
+
+
+/* Remove an entry from the cache, sliding the data of the later entries down
+   in VRAM (through g_TempBuffer) to fill the hole.
+*/
+static void ScreenCacheRemove(ScreenCachePointer pCache)
+{
+  uint16_t destination = ScreenCacheDataAddress(pCache);
+  uint16_t source = destination + pCache->size;
+  uint16_t amountRemaining = SCREEN_CACHE_VRAM_ADDRESS + sScreenCacheUsed -
+    source;
+  uint16_t amount;
+  uint16_t i;
+
+  while (amountRemaining != 0)
+  {
+    amount = amountRemaining;
+    if (amount > TEMPBUFFER_LEN)
+      amount = TEMPBUFFER_LEN;
+    vdp_setReadAddress(source);
+    for (i = 0; i != amount; i++)
+      g_TempBuffer[i] = IO_VDPDATA;
+    vdp_setWriteAddress(destination);
+    for (i = 0; i != amount; i++)
+      IO_VDPDATA = g_TempBuffer[i];
+    source += amount;
+    destination += amount;
+    amountRemaining -= amount;
+  }
+
+  sScreenCacheUsed -= pCache->size;
+  sScreenCacheCount--;
+  memmove(pCache, pCache + 1,
+    (uint8_t *) (sScreenCache + sScreenCacheCount) - (uint8_t *) pCache);
+}
+
+
+/* Add an empty entry to the end of the cache for a file of the given size,
+   evicting the least recently used entries until there is room, and start
+   saving the file's bytes into it.  Returns NULL if the file doesn't fit.
+*/
+static ScreenCachePointer ScreenCacheStartSaving(const char *FileName,
+  int32_t fileSize)
+{
+  ScreenCachePointer pCache;
+  ScreenCachePointer pOldest;
+
+  if (fileSize <= 0 || fileSize > SCREEN_CACHE_VRAM_SIZE ||
+  strlen(FileName) >= SCREEN_CACHE_NAME_LENGTH)
+    return NULL;
+
+  while (sScreenCacheCount >= SCREEN_CACHE_ENTRIES ||
+  sScreenCacheUsed + (uint16_t) fileSize > SCREEN_CACHE_VRAM_SIZE)
+  {
+    pOldest = sScreenCache;
+    for (pCache = sScreenCache + 1; pCache < sScreenCache + sScreenCacheCount;
+    pCache++)
+    {
+      if ((int16_t) (pCache->lastUsed - pOldest->lastUsed) < 0)
+        pOldest = pCache;
+    }
+    ScreenCacheRemove(pOldest);
+  }
+
+  pCache = sScreenCache + sScreenCacheCount++;
+  strcpy(pCache->name, FileName);
+  pCache->size = fileSize;
+  pCache->checksum = 0;
+  pCache->lastUsed = ++sScreenCacheClock;
+  sScreenCacheUsed += pCache->size;
+
+  sScreenCacheSaving = true;
+  sScreenCacheAddress = ScreenCacheDataAddress(pCache);
+  sScreenCacheRemaining = pCache->size;
+  sScreenCacheChecksum = 0;
+  return pCache;
+}
+
+
+/* Start reading a screen file's bytes from the cache rather than the file.
+*/
+static void ScreenCacheStartLoading(ScreenCachePointer pCache)
+{
+  pCache->lastUsed = ++sScreenCacheClock;
+  sScreenCacheLoading = true;
+  sScreenCacheAddress = ScreenCacheDataAddress(pCache);
+  sScreenCacheRemaining = pCache->size;
+  sScreenCacheChecksum = 0;
+}
+#endif /* NABU_H */
+
+
+/* Read the next raw bytes of a screen file, from the file or if it is cached,
+   from video memory.  If the file is being saved in the cache, copies the
+   bytes there too.  Returns the amount read, zero at the end of the file.
+*/
+static uint16_t ScreenDataReadSource(FileHandleType fileHandle,
+  uint8_t *pBuffer, uint16_t amountToRead)
+{
+  uint16_t amountRead;
+
 #ifdef NABU_H
-  if (fileHandle != BAD_FILE_HANDLE)
-    rn_fileHandleClose(fileHandle);
+  uint8_t *pByte;
+  uint16_t i;
+
+  if (sScreenCacheLoading)
+  {
+    amountRead = amountToRead;
+    if (amountRead > sScreenCacheRemaining)
+      amountRead = sScreenCacheRemaining;
+    vdp_setReadAddress(sScreenCacheAddress);
+    for (pByte = pBuffer, i = amountRead; i != 0; i--, pByte++)
+    {
+      *pByte = IO_VDPDATA;
+      sScreenCacheChecksum += *pByte;
+    }
+    sScreenCacheAddress += amountRead;
+    sScreenCacheRemaining -= amountRead;
+    return amountRead;
+  }
 #endif /* NABU_H */
+
+  amountRead = ReadDataFile(fileHandle, pBuffer, amountToRead);
+
+#ifdef NABU_H
+  if (sScreenCacheSaving)
+  {
+    if (amountRead > sScreenCacheRemaining)
+      sScreenCacheSaving = false; /* File bigger than it said, give up. */
+    else
+    {
+      vdp_setWriteAddress(sScreenCacheAddress);
+      for (pByte = pBuffer, i = amountRead; i != 0; i--, pByte++)
+      {
+        IO_VDPDATA = *pByte;
+        sScreenCacheChecksum += *pByte;
+      }
+      sScreenCacheAddress += amountRead;
+      sScreenCacheRemaining -= amountRead;
+    }
+  }
+#endif /* NABU_H */
+
+  return amountRead;
+}
+
+
+/* State for reading screen data, packed or not.  The input buffer is the
+   first SCREEN_PACKED_INPUT_SIZE bytes of g_TempBuffer. */
+static bool sScreenPacked;
+static uint16_t sScreenInputPosition;
+static uint16_t sScreenInputLength;
+static uint8_t sScreenRunRemaining; /* Bytes left in the current run. */
+static bool sScreenRunRepeating; /* TRUE if repeating, FALSE if literal. */
+static uint8_t sScreenRunValue; /* The byte being repeated. */
+COMPILER_VERIFY(SCREEN_PACKED_INPUT_SIZE <= TEMPBUFFER_LEN / 2);
+
+static const char kScreenPackedMagic[SCREEN_PACKED_MAGIC_LENGTH - 1] =
+  {'N', 'P', 'K'};
+
+
+/* Refill the screen data input buffer from the file.  Returns FALSE at the
+   end of the file.
+*/
+static bool ScreenDataRefill(FileHandleType fileHandle)
+{
+  sScreenInputPosition = 0;
+  sScreenInputLength = ScreenDataReadSource(fileHandle,
+    (uint8_t *) g_TempBuffer, SCREEN_PACKED_INPUT_SIZE);
+  SoundUpdateIfNeeded();
+  return sScreenInputLength != 0;
+}
+
+
+/* Start reading screen data from a just opened file, checking for the packed
+   file header.  Returns the type letter ('F', 'S' or 'C') if it is a packed
+   file, NUL if it is a raw one.  Reads the first part of the file into the
+   start of g_TempBuffer, which needs to stay intact until all the screen data
+   has been read with ScreenDataRead().
+*/
+char ScreenDataStart(FileHandleType fileHandle)
+{
+  char packedType;
+
+  sScreenPacked = false;
+  sScreenRunRemaining = 0;
+  ScreenDataRefill(fileHandle);
+  if (sScreenInputLength < SCREEN_PACKED_MAGIC_LENGTH ||
+  memcmp(g_TempBuffer, kScreenPackedMagic, sizeof(kScreenPackedMagic)) != 0)
+    return 0;
+
+  packedType = g_TempBuffer[SCREEN_PACKED_MAGIC_LENGTH - 1];
+  if (packedType != 'F' && packedType != 'S' && packedType != 'C')
+    return 0;
+
+  sScreenPacked = true;
+  sScreenInputPosition = SCREEN_PACKED_MAGIC_LENGTH;
+  return packedType;
+}
+
+
+/* Read the next bytes of screen data, unpacking them if needed.  Returns the
+   amount read, less than asked for at the end of the file or on errors.
+*/
+uint16_t ScreenDataRead(FileHandleType fileHandle, uint8_t *pBuffer,
+  uint16_t amountToRead)
+{
+  uint16_t amountDone = 0;
+  uint16_t amount;
+  uint8_t control;
+
+  if (!sScreenPacked)
+  {
+    /* Use up what ScreenDataStart() read first, then read directly from the
+       file.  memmove() since the buffer can overlap the input. */
+    if (sScreenInputPosition < sScreenInputLength)
+    {
+      amount = sScreenInputLength - sScreenInputPosition;
+      if (amount > amountToRead)
+        amount = amountToRead;
+      memmove(pBuffer, g_TempBuffer + sScreenInputPosition, amount);
+      sScreenInputPosition += amount;
+      return amount;
+    }
+    return ScreenDataReadSource(fileHandle, pBuffer, amountToRead);
+  }
+
+  while (amountDone < amountToRead)
+  {
+    if (sScreenRunRemaining == 0) /* Start a new run. */
+    {
+      if (sScreenInputPosition >= sScreenInputLength &&
+      !ScreenDataRefill(fileHandle))
+        break;
+      control = g_TempBuffer[sScreenInputPosition++];
+      sScreenRunRepeating = (control >= 128);
+      if (sScreenRunRepeating)
+      {
+        if (sScreenInputPosition >= sScreenInputLength &&
+        !ScreenDataRefill(fileHandle))
+          break;
+        sScreenRunValue = g_TempBuffer[sScreenInputPosition++];
+        sScreenRunRemaining = control - 125;
+      }
+      else
+        sScreenRunRemaining = control + 1;
+    }
+
+    amount = amountToRead - amountDone;
+    if (amount > sScreenRunRemaining)
+      amount = sScreenRunRemaining;
+
+    if (sScreenRunRepeating)
+      memset(pBuffer + amountDone, sScreenRunValue, amount);
+    else
+    {
+      if (sScreenInputPosition >= sScreenInputLength &&
+      !ScreenDataRefill(fileHandle))
+        break;
+      if (amount > sScreenInputLength - sScreenInputPosition)
+        amount = sScreenInputLength - sScreenInputPosition;
+      memcpy(pBuffer + amountDone, g_TempBuffer + sScreenInputPosition, amount);
+      sScreenInputPosition += amount;
+    }
+    amountDone += amount;
+    sScreenRunRemaining -= amount;
+  }
+  return amountDone;
 }
 
 
@@ -317,6 +1086,10 @@ void CloseDataFile(FileHandleType fileHandle)
 #ifdef NABU_H
 #define MAX_MUSIC_BUFFER_SIZE 1500 /* Bigest ChipsNSfx song we can play, +1. */
 uint8_t gLoadedMusic[MAX_MUSIC_BUFFER_SIZE];
+
+static bool sLoadedMusicPlaying;
+/* TRUE if the background music is playing from gLoadedMusic, so we need to
+   stop it before loading a new song over it. */
 #endif /* NABU_H */
 
 bool PlayMusic(const char *FileName)
@@ -325,6 +1098,7 @@ bool PlayMusic(const char *FileName)
   {
 #ifdef NABU_H
     CSFX_stop();
+    sLoadedMusicPlaying = false;
 #endif /* NABU_H */
     return true;
   }
@@ -333,6 +1107,7 @@ bool PlayMusic(const char *FileName)
   {
 #ifdef NABU_H
     CSFX_start(NthMusic_a_z, false /* IsEffects */); /* Background music. */
+    sLoadedMusicPlaying = false;
 #endif /* NABU_H */
     return true;
   }
@@ -342,19 +1117,31 @@ bool PlayMusic(const char *FileName)
 #ifdef NABU_H
   uint16_t amountRead;
   uint8_t fileID;
+  uint8_t channel;
 
   fileID = OpenDataFile(FileName, "CHIPNSFX", NULL /* No size. */);
   if (fileID == BAD_FILE_HANDLE)
     goto ErrorExit;
 
+  /* With SOUND_INTERRUPT_TICK, the frame interrupt keeps playing while we
+     overwrite the old song, so point the background music channels at
+     silence until the new one is loaded. */
+
+  if (sLoadedMusicPlaying)
+  {
+    for (channel = 3; channel < 6; channel++)
+      CSFX_chan(channel, NthEffectsSilence);
+    sLoadedMusicPlaying = false;
+  }
+
   bzero(gLoadedMusic, MAX_MUSIC_BUFFER_SIZE); /* For easier debugging. */
-  amountRead = rn_fileHandleReadSeq(fileID, gLoadedMusic,
-    0 /* buffer offset */, MAX_MUSIC_BUFFER_SIZE);
+  amountRead = ReadDataFile(fileID, gLoadedMusic, MAX_MUSIC_BUFFER_SIZE);
   CloseDataFile(fileID);
   if (amountRead == 0 || amountRead >= MAX_MUSIC_BUFFER_SIZE)
     goto ErrorExit;
 
   CSFX_start(gLoadedMusic, false /* IsEffects */); /* Background music. */
+  sLoadedMusicPlaying = true;
   returnCode = true;
 
 ErrorExit:
@@ -365,8 +1152,10 @@ ErrorExit:
 
 
 /* This is best called after every lengthy operation, like opening a file.
-   We could do music updates in an interrupt, but that can be a bit tricky.
+   We could do music updates in an interrupt, but that can be a bit tricky,
+   see SOUND_INTERRUPT_TICK.
 */
+#if !SOUND_INTERRUPT_TICK
 void SoundUpdateIfNeeded(void)
 {
 #ifdef NABU_H
@@ -377,16 +1166,19 @@ void SoundUpdateIfNeeded(void)
   }
 #endif /* NABU_H */
 }
+#endif /* SOUND_INTERRUPT_TICK */
 
 
 #ifdef NABU_H
-/* Utility function to read AmountToCopy bytes from a file and write to the
-   given VRAM address.  If Triplicate is TRUE then data is also written to
-   VRAM address + 2K and VRAM address + 4K.  Uses g_TempBuffer, which can be
-   smaller than the AmountToCopy.  Updates sound tick as needed so you can have
-   music playing during loading (assuming the frame counter interrupt is
-   working).  Returns FALSE if there wasn't enough data in the file.  TRUE if
-   it succeeded.
+/* Utility function to read AmountToCopy bytes of screen data from a file and
+   write to the given VRAM address.  If Triplicate is TRUE then data is also
+   written to VRAM address + 2K and VRAM address + 4K.  Reads with
+   ScreenDataRead() so packed files get unpacked on the way, in chunks the size
+   of the unused half of g_TempBuffer.  Raw files use all of g_TempBuffer,
+   which can be smaller than the AmountToCopy.  Updates sound tick as needed
+   so you can have music playing during loading (assuming the frame counter
+   interrupt is working).  Returns FALSE if there wasn't enough data in the
+   file.  TRUE if it succeeded.
 */
 /* Optionally read less in each chunk for smoother sound, but slower load. */
 /* #define MAX_COPY_TO_VRAM_READ_SIZE (TEMPBUFFER_LEN / 2) */
@@ -398,20 +1190,27 @@ static bool CopyFileToVRAM(uint16_t AmountToCopy, FileHandleType FileID,
 {
   uint16_t amountRemaining = AmountToCopy;
   uint16_t currentVRAM = VRAMAddress;
+  uint8_t *pChunk = (uint8_t *) g_TempBuffer;
+  uint16_t chunkSize = MAX_COPY_TO_VRAM_READ_SIZE;
+
+  if (sScreenPacked)
+  {
+    pChunk += SCREEN_PACKED_INPUT_SIZE;
+    chunkSize = TEMPBUFFER_LEN - SCREEN_PACKED_INPUT_SIZE;
+  }
 
   while (amountRemaining != 0)
   {
     uint16_t amountToRead = amountRemaining;
     uint16_t amountRead;
-    if (amountToRead > MAX_COPY_TO_VRAM_READ_SIZE)
-      amountToRead = MAX_COPY_TO_VRAM_READ_SIZE;
-    amountRead = rn_fileHandleReadSeq(FileID, g_TempBuffer,
-      0 /* buffer offset */, amountToRead);
+    if (amountToRead > chunkSize)
+      amountToRead = chunkSize;
+    amountRead = ScreenDataRead(FileID, pChunk, amountToRead);
     SoundUpdateIfNeeded();
     if (amountRead == 0) /* End of file or a read error. */
       break;
 
-    const char *bufferPntr = g_TempBuffer;
+    const uint8_t *bufferPntr = pChunk;
     uint16_t amountToWrite = amountRead;
     vdp_setWriteAddress(currentVRAM);
     while (amountToWrite-- != 0)
@@ -420,14 +1219,14 @@ static bool CopyFileToVRAM(uint16_t AmountToCopy, FileHandleType FileID,
 
     if (Triplicate)
     {
-      bufferPntr = g_TempBuffer;
+      bufferPntr = pChunk;
       amountToWrite = amountRead;
       vdp_setWriteAddress(currentVRAM + 2048);
       while (amountToWrite-- != 0)
         IO_VDPDATA = *bufferPntr++;
       SoundUpdateIfNeeded();
 
-      bufferPntr = g_TempBuffer;
+      bufferPntr = pChunk;
       amountToWrite = amountRead;
       vdp_setWriteAddress(currentVRAM + 4096);
       while (amountToWrite-- != 0)
@@ -465,12 +1264,14 @@ static void SetColoursToBlackAndWhite(void)
 #endif
 
 
+#ifdef NABU_H
 static void PrintMissingDataError(void)
 {
   SetUpPathInTempBuffer("File is too small, named \"");
   strcat(g_TempBuffer, "\".\n");
   DebugPrintString(g_TempBuffer);
 }
+#endif /* NABU_H */
 
 
 /* Read a character mapped screen picture from a file with that name, and stores
@@ -493,19 +1294,42 @@ static void PrintMissingDataError(void)
    work) into video RAM.  Usually a *.NFUL file created by the Dithertron
    online tool.  https://8bitworkshop.com/dithertron/#sys=msx
 
+   Any of them can also be packed, in which case the type in the packed
+   header is used rather than the extension or size.
+
+   On the NABU, small files (usually .NCHR) are cached in spare video memory,
+   so loading the same screen again doesn't need to read the file.
+
    Uses g_TempBuffer.  Returns TRUE if successful, FALSE (and prints a debug
    message) if it couldn't open the file or there isn't enough data in the
    file.
 */
 bool LoadScreen(const char *FileName)
 {
-  uint8_t fileID = BAD_FILE_HANDLE;
+  FileHandleType fileID = BAD_FILE_HANDLE;
   bool returnCode = false;
   int32_t fileSize = 0;
 
-  fileID = OpenDataFile(FileName, NULL /* No extension */, &fileSize);
-  if (fileID == BAD_FILE_HANDLE)
-    goto ErrorExit;
+#ifdef NABU_H
+  ScreenCachePointer pCache;
+
+TryAgain:
+  pCache = ScreenCacheFind(FileName);
+  if (pCache != NULL)
+  {
+    ScreenCacheStartLoading(pCache);
+    fileSize = pCache->size;
+  }
+  else
+#endif /* NABU_H */
+  {
+    fileID = OpenDataFile(FileName, NULL /* No extension */, &fileSize);
+    if (fileID == BAD_FILE_HANDLE)
+      goto ErrorExit;
+#ifdef NABU_H
+    pCache = ScreenCacheStartSaving(FileName, fileSize);
+#endif /* NABU_H */
+  }
 
 #ifdef NABU_H
   /* Figure out which kind of file it is.  Extension is the first clue, file
@@ -536,6 +1360,16 @@ bool LoadScreen(const char *FileName)
 
   /* If no known extension, use file size to determine the kind of picture. */
 
+  /* A packed file says what it is in the header, and is smaller than usual. */
+
+  switch (ScreenDataStart(fileID))
+  {
+    case 'F': fileType = FT_NFUL; break;
+    case 'S': fileType = FT_NSCR; break;
+    case 'C': fileType = FT_NCHR; break;
+    default: break;
+  }
+
   if (fileType == FT_NONE)
   {
     if (fileSize < 6976)
@@ -617,10 +1451,43 @@ bool LoadScreen(const char *FileName)
 
 ErrorMissingData:
   PrintMissingDataError();
+#else /* No video memory to load into on host builds, just check it exists. */
+  returnCode = true;
 #endif /* NABU_H */
 
 ErrorExit:
   CloseDataFile(fileID);
+
+#ifdef NABU_H
+  /* Finish off cache loading or saving.  If the cached copy was damaged, drop
+     it and load the file instead.  Entries which didn't load successfully or
+     gave up saving get dropped, otherwise trim off any unread end of file. */
+
+  if (sScreenCacheLoading)
+  {
+    sScreenCacheLoading = false;
+    if (!returnCode || sScreenCacheChecksum != pCache->checksum)
+    {
+      ScreenCacheRemove(pCache);
+      fileID = BAD_FILE_HANDLE;
+      returnCode = false;
+      goto TryAgain;
+    }
+  }
+  else if (pCache != NULL)
+  {
+    if (returnCode && sScreenCacheSaving)
+    {
+      pCache->size -= sScreenCacheRemaining;
+      sScreenCacheUsed -= sScreenCacheRemaining;
+      pCache->checksum = sScreenCacheChecksum;
+    }
+    else
+      ScreenCacheRemove(pCache);
+    sScreenCacheSaving = false;
+  }
+#endif /* NABU_H */
+
   return returnCode;
 }
 
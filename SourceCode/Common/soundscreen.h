@@ -65,7 +65,12 @@ extern void PlaySound(sound_type sound_id, player_pointer pPlayer);
 /* Play a sound effect.  Given a player so we can customise sounds per player
    (usually with a different frequency / tone for each player).  Plays with
    priority based on the sound_id if the system can't play multiple sounds
-   at once. */
+   at once.  The sound is queued and actually started by PlayQueuedSounds(). */
+
+extern void PlayQueuedSounds(void);
+/* Start the sounds queued up by PlaySound() during the frame, once per frame
+   before the sound gets updated.  Only the highest priority tonal and white
+   noise sound from each player gets a chance at a channel. */
 
 extern FileHandleType OpenDataFile(const char *fileNameBase,
   const char *extension, int32_t *pFileSize);
@@ -75,11 +80,95 @@ extern FileHandleType OpenDataFile(const char *fileNameBase,
    returning the first one found.  Returns BAD_FILE_HANDLE if it wasn't found
    anywhere and prints a debug message.  If it was found, it sets the optional
    file size argument if it isn't NULL.  You should close the file when you've
-   finished using it.  Uses g_TempBuffer.  For NABU, use upper case names. */
+   finished using it.  Uses g_TempBuffer.  For NABU, use upper case names.
+   The NABU remembers where recently opened files were found (or that they
+   weren't found), so opening them again is quicker.  If a bundle is open and
+   has a member with that name, the member gets opened instead. */
+
+extern FileHandleType OpenLocalDataFile(const char *fileNameBase,
+  const char *extension);
+/* Like OpenDataFile(), but only looks in the open bundle and the NABU
+   Internet Adapter's local store, skipping the web sites, so it is quick
+   enough to use while a game is running.  Quietly returns BAD_FILE_HANDLE if
+   the file isn't there, without remembering it as missing. */
+
+extern void OpenCacheAgeMissing(void);
+/* Called once per level load, so that OpenDataFile() looks again for files it
+   didn't find a while ago, in case they have since been added.  Recently
+   missed files stay remembered as missing.  Does nothing on host computers. */
 
 extern void CloseDataFile(FileHandleType fileHandle);
 /* Undoes OpenDataFile.  Does nothing when given BAD_FILE_HANDLE. */
 
+extern uint16_t ReadDataFile(FileHandleType fileHandle, void *pBuffer,
+  uint16_t amountToRead);
+/* Read the next bytes from a file opened by OpenDataFile().  Returns the
+   number of bytes read, zero at end of file or on errors. */
+
+/* A bundle is a single file holding several data files (levels, screens,
+   music), so a sequence of levels can be loaded with one open through the
+   NABU Internet Adapter rather than one for each file.  It starts with 'N',
+   'B', 'D' and a version number, then a count of members, then for each
+   member the length of its name, the name (upper case, with the extension,
+   no directory), and the member's offset in the bundle and size, both 32 bit
+   little endian.  That index has to fit in g_TempBuffer.  The member data
+   comes after the index, and can be packed screens.  See Unix/BundleMaker.c
+   for the program that makes them. */
+#define BUNDLE_MAGIC_LENGTH 4
+#define BUNDLE_VERSION 1
+#define BUNDLE_MAX_MEMBERS 16
+#define BUNDLE_NAME_LENGTH 20 /* Including the NUL at the end. */
+
+extern bool OpenBundle(const char *fileName);
+/* Open the given bundle file (extension BUNDLE gets added), closing the
+   previous one.  Does nothing if that bundle is already open.  While it is
+   open, OpenDataFile() opens members of the bundle rather than separate files
+   when the name matches.  Returns FALSE and prints a debug message if the
+   bundle couldn't be opened or is damaged.  Uses g_TempBuffer. */
+
+extern void CloseBundle(void);
+/* Close the current bundle, if any.  Members still open read as end of file. */
+
+/* Screen files can optionally be packed to make them load faster, since the
+   NABU Internet Adapter is slow and most screens are mostly black.  A packed
+   file starts with the magic bytes 'N', 'P', 'K' and then 'F', 'S' or 'C' for
+   a packed NFUL, NSCR or NCHR file.  That's followed by the original file's
+   bytes, run length encoded.  Each run starts with a control byte; 0 to 127
+   means control + 1 literal bytes follow, 128 to 255 means the following
+   single byte is repeated control - 125 times (3 to 130 times).  Runs can
+   cross from one part of the screen (name table, patterns etc) to the next.
+   A packed file keeps the same name as the original, see Unix/ScreenPacker.c
+   for the program that makes them. */
+#define SCREEN_PACKED_MAGIC_LENGTH 4
+#define SCREEN_PACKED_MIN_REPEAT 3
+#define SCREEN_PACKED_MAX_REPEAT (255 - 125)
+#define SCREEN_PACKED_MAX_LITERAL 128
+#define SCREEN_PACKED_INPUT_SIZE (TEMPBUFFER_LEN / 2)
+/* Packed data is read from the file into the first half of g_TempBuffer, and
+   unpacked into the other half. */
+
+extern char ScreenDataStart(FileHandleType fileHandle);
+/* Start reading screen data from a just opened file, checking for the packed
+   file header.  Returns the type letter ('F', 'S' or 'C') if it is a packed
+   file, NUL if it is a raw one.  Reads the first part of the file into the
+   start of g_TempBuffer, which needs to stay intact until all the screen data
+   has been read with ScreenDataRead(). */
+
+extern uint16_t ScreenDataRead(FileHandleType fileHandle, uint8_t *pBuffer,
+  uint16_t amountToRead);
+/* Read the next bytes of screen data, unpacking them if needed.  Returns the
+   amount read, less than asked for at the end of the file or on errors.  If
+   the file is packed, the buffer has to be outside the first
+   SCREEN_PACKED_INPUT_SIZE bytes of g_TempBuffer, otherwise it can be at the
+   start of g_TempBuffer but not elsewhere in g_TempBuffer. */
+
+#ifndef NABU_H
+extern const char *g_HostDataPath;
+/* On host computers, OpenDataFile() looks in this directory first, then in the
+   current directory.  Needs a trailing slash.  Usually the Nabu/Art directory
+   or a copy of the NABU Internet Adapter's NTHPONG store directory. */
+#endif /* NABU_H */
+
 extern bool PlayMusic(const char *FileName);
 /* Starts the given piece of external music playing.  Assumes the sound library
    is initialised and a game loop (or screen loader) will update sound ticks.
@@ -87,11 +176,25 @@ extern bool PlayMusic(const char *FileName);
    extension if you don't specify one.  "Silence" turns off background music
    and "Default" plays the built-in music designed for when the game is running
    (quieter, not too complex).  Returns true if successful.  If it returns
-   false, it leaves whatever music was playing still playing. */
-
+   false, it leaves whatever music was playing still playing, except that a
+   previously loaded song is silenced once the new one has started loading
+   over it. */
+
+#ifndef SOUND_INTERRUPT_TICK
+#define SOUND_INTERRUPT_TICK 0
+#endif
+/* Set to 1 to have the NABU update the music from the VDP frame interrupt
+   (see CSFX_interrupt()), rather than from the main loop and the polling done
+   while loading files.  Keeps the tempo steady when a frame takes too long. */
+
+#if SOUND_INTERRUPT_TICK
+#define SoundUpdateIfNeeded() /* Music is updated by the frame interrupt. */
+#else
 extern void SoundUpdateIfNeeded(void);
 /* This is best called after every lengthy operation, like opening a file.
-   We could do music updates in an interrupt, but that can be a bit tricky. */
+   We could do music updates in an interrupt, but that can be a bit tricky,
+   see SOUND_INTERRUPT_TICK. */
+#endif /* SOUND_INTERRUPT_TICK */
 
 extern bool LoadScreen(const char *FileName);
 /* Read a character mapped screen picture from a file with that name, and stores
@@ -114,6 +217,12 @@ extern bool LoadScreen(const char *FileName);
    work) into video RAM.  Usually a *.NFUL file created by the Dithertron
    online tool.  https://8bitworkshop.com/dithertron/#sys=msx
 
+   Any of them can also be packed, in which case the type in the packed
+   header is used rather than the extension or size.
+
+   On the NABU, small files (usually .NCHR) are cached in spare video memory,
+   so loading the same screen again doesn't need to read the file.
+
    Uses g_TempBuffer.  Returns TRUE if successful, FALSE (and prints a debug
    message) if it couldn't open the file or there isn't enough data in the
    file. */
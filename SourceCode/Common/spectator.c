@@ -0,0 +1,348 @@
+/******************************************************************************
+ * Nth Pong Wars, spectator.c for broadcasting a game to extra displays.
+ * Definitive comments are in spectator.h, rather than copied here.
+ *
+ * AGMS20261018 - Started this code file.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "spectator.h"
+
+#if SPECTATOR_STREAM
+
+#define DEBUG_PRINT_SPECTATOR 0 /* Turn on debug output. */
+
+/* Bytes are collected here and sent when it fills up or the update is done.
+   Records can be split across sends, it's a TCP stream after all. */
+#define SPECTATOR_BUFFER_SIZE 128
+
+/* Try to connect to the relay again after this many frames.  Power of two. */
+#define SPECTATOR_RETRY_FRAMES 512
+
+uint16_t g_SpectatorBytesSent;
+
+static uint8_t sBuffer[SPECTATOR_BUFFER_SIZE];
+static uint8_t sBufferUsed;
+static uint8_t sTCPHandle = 0xFF; /* 0xFF if not connected. */
+static bool sKeyframeNeeded = true;
+
+/* Tiles changed since the last update.  If the count goes past the maximum,
+   it's left at SPECTATOR_MAX_CHANGED_TILES + 1 and a keyframe gets sent. */
+static tile_pointer sChangedTiles[SPECTATOR_MAX_CHANGED_TILES];
+static uint8_t sChangedTilesCount;
+
+/* The sprite attributes as last sent, 4 bytes per slot, for finding changes.
+   Same order of bytes as the VDP: Y, X, name, early clock and colour. */
+static uint8_t sSentSprites[SPECTATOR_SPRITE_SLOTS][4];
+
+
+/* Send whatever is in the buffer to the relay.  If the relay has gone away,
+   forget the connection; SpectatorSendFrame() will try again later.
+*/
+static void SpectatorFlush(void)
+{
+  if (sBufferUsed == 0)
+    return;
+  if (sTCPHandle != 0xFF)
+  {
+    if (rn_TCPHandleWrite(sTCPHandle, 0 /* dataOffset */,
+    sBufferUsed /* dataLen */, sBuffer) < 0)
+    {
+      rn_fileHandleClose(sTCPHandle);
+      sTCPHandle = 0xFF;
+    }
+  }
+  g_SpectatorBytesSent += sBufferUsed;
+  sBufferUsed = 0;
+}
+
+
+static void SpectatorPutByte(uint8_t value)
+{
+  sBuffer[sBufferUsed++] = value;
+  if (sBufferUsed >= SPECTATOR_BUFFER_SIZE)
+    SpectatorFlush();
+}
+
+
+static void SpectatorPutWord(uint16_t value)
+{
+  SpectatorPutByte(value & 0xFF);
+  SpectatorPutByte(value >> 8);
+}
+
+
+/* Tile value as sent, owner in the low 5 bits, age in the top 3. */
+static uint8_t SpectatorTileValue(tile_pointer pTile)
+{
+  return pTile->owner | (pTile->age << 5);
+}
+
+
+/* Open the TCP connection to the relay, through the Internet Adapter.  Leaves
+   sTCPHandle as 0xFF if it didn't work.
+*/
+static void SpectatorConnect(void)
+{
+  static const char kRelayHost[] = SPECTATOR_RELAY_HOST;
+
+  sTCPHandle = rn_TCPOpen(sizeof(kRelayHost) - 1, (char *) kRelayHost,
+    SPECTATOR_RELAY_PORT, 0xFF /* Any free handle */);
+  sKeyframeNeeded = true;
+
+#if DEBUG_PRINT_SPECTATOR
+  strcpy(g_TempBuffer, "Spectator relay connection ");
+  strcat(g_TempBuffer, (sTCPHandle == 0xFF) ? "failed" : "opened");
+  strcat(g_TempBuffer, ".\n");
+  DebugPrintString(g_TempBuffer);
+#endif
+}
+
+
+void SpectatorReset(void)
+{
+  COMPILER_VERIFY(OWNER_MAX <= 32); /* Has to fit in 5 bits. */
+  COMPILER_VERIFY(SPECTATOR_SPRITE_SLOTS <= 16); /* Has to fit in the mask. */
+
+  if (sTCPHandle == 0xFF)
+    SpectatorConnect();
+  sKeyframeNeeded = true;
+}
+
+
+void SpectatorNoteTile(tile_pointer pTile)
+{
+  if (sChangedTilesCount < SPECTATOR_MAX_CHANGED_TILES)
+    sChangedTiles[sChangedTilesCount++] = pTile;
+  else
+    sChangedTilesCount = SPECTATOR_MAX_CHANGED_TILES + 1;
+}
+
+
+/* Send the whole play area, run length encoded.  Clears all the dirty_remote
+   flags along the way.
+*/
+static void SpectatorSendKeyframe(void)
+{
+  tile_pointer pTile;
+  uint8_t runCount = 0;
+  uint8_t runLength = 0;
+  uint8_t runValue = 0;
+  uint8_t tileValue;
+  uint8_t runs[2 * 32]; /* Up to 32 runs per 'R' record. */
+
+  SpectatorPutByte('K');
+  SpectatorPutWord(g_FrameCounter);
+  SpectatorPutByte(g_play_area_width_tiles);
+  SpectatorPutByte(g_play_area_height_tiles);
+  SpectatorPutByte(g_play_area_col_for_screen);
+  SpectatorPutByte(g_play_area_row_for_screen);
+
+  for (pTile = g_tile_array; pTile != g_play_area_end_tile; pTile++)
+  {
+    pTile->dirty_remote = false;
+    tileValue = SpectatorTileValue(pTile);
+    if (runLength != 0 && (tileValue != runValue || runLength == 255))
+    {
+      runs[runCount * 2] = runLength;
+      runs[runCount * 2 + 1] = runValue;
+      runLength = 0;
+      if (++runCount >= sizeof(runs) / 2)
+      {
+        SpectatorPutByte('R');
+        SpectatorPutByte(runCount);
+        for (runCount = 0; runCount < sizeof(runs); runCount++)
+          SpectatorPutByte(runs[runCount]);
+        runCount = 0;
+      }
+    }
+    runValue = tileValue;
+    runLength++;
+  }
+  if (runLength != 0)
+  {
+    runs[runCount * 2] = runLength;
+    runs[runCount * 2 + 1] = runValue;
+    runCount++;
+  }
+  if (runCount != 0)
+  {
+    SpectatorPutByte('R');
+    SpectatorPutByte(runCount);
+    for (runLength = 0; runLength < runCount * 2; runLength++)
+      SpectatorPutByte(runs[runLength]);
+  }
+
+  /* Viewer forgets sprites at a keyframe, so we do too, and all the visible
+     ones get sent in the 'S' record after this. */
+  memset(sSentSprites, SPRITE_NOT_DRAWABLE, sizeof(sSentSprites));
+
+  sChangedTilesCount = 0;
+  sKeyframeNeeded = false;
+  g_SpectatorBytesSent = 0;
+}
+
+
+/* Work out the current sprite attributes for each slot, the same way that
+   CopyPlayersToSprites() does, except that hidden ones keep their slot.
+*/
+static void SpectatorGetSprites(uint8_t pSprites[SPECTATOR_SPRITE_SLOTS][4])
+{
+  uint8_t iPlayer;
+  player_pointer pPlayer;
+  uint8_t *pBall;
+  uint8_t *pSparkle;
+  uint8_t *pShadow;
+
+  memset(pSprites, SPRITE_NOT_DRAWABLE, SPECTATOR_SPRITE_SLOTS * 4);
+
+  pPlayer = g_player_array;
+  for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++, pPlayer++)
+  {
+    if (pPlayer->brain == ((player_brain) BRAIN_INACTIVE))
+      continue;
+
+    pBall = pSprites[iPlayer];
+    pSparkle = pSprites[MAX_PLAYERS + iPlayer];
+    pShadow = pSprites[MAX_PLAYERS * 2 + iPlayer];
+
+    if (pPlayer->vdpSpriteY != SPRITE_NOT_DRAWABLE)
+    {
+      pBall[0] = pPlayer->vdpSpriteY;
+      pBall[1] = pPlayer->vdpSpriteX;
+      pBall[2] = pPlayer->main_anim.current_name;
+      pBall[3] = pPlayer->vdpEarlyClock32Left | pPlayer->main_colour;
+
+      if (pPlayer->sparkle_anim.type !=
+      ((SpriteAnimationType) SPRITE_ANIM_NONE))
+      {
+        pSparkle[0] = pPlayer->vdpSpriteY;
+        pSparkle[1] = pPlayer->vdpSpriteX;
+        pSparkle[2] = pPlayer->sparkle_anim.current_name;
+        pSparkle[3] = pPlayer->vdpEarlyClock32Left | pPlayer->sparkle_colour;
+      }
+    }
+
+    if (pPlayer->vdpShadowSpriteY != SPRITE_NOT_DRAWABLE)
+    {
+      pShadow[0] = pPlayer->vdpShadowSpriteY;
+      pShadow[1] = pPlayer->vdpShadowSpriteX;
+      pShadow[2] = pPlayer->main_anim.current_name;
+      pShadow[3] = pPlayer->vdpShadowEarlyClock32Left | VDP_BLACK;
+    }
+  }
+}
+
+
+void SpectatorSendFrame(void)
+{
+  uint8_t newSprites[SPECTATOR_SPRITE_SLOTS][4];
+  uint16_t slotMask;
+  uint8_t byteMask;
+  uint8_t iSlot;
+  uint8_t iByte;
+  tile_pointer pTile;
+
+  if (sTCPHandle == 0xFF)
+  {
+    if ((g_FrameCounter & (SPECTATOR_RETRY_FRAMES - 1)) == 0)
+      SpectatorConnect();
+    if (sTCPHandle == 0xFF)
+    {
+      sChangedTilesCount = 0; /* Keyframe on connect will cover them. */
+      return;
+    }
+  }
+
+  if ((g_FrameCounter & (SPECTATOR_FRAMES_PER_UPDATE - 1)) != 0)
+    return;
+
+  if ((g_FrameCounter & (SPECTATOR_KEYFRAME_FRAMES - 1)) == 0 ||
+  sChangedTilesCount > SPECTATOR_MAX_CHANGED_TILES)
+    sKeyframeNeeded = true;
+
+  if (sKeyframeNeeded)
+    SpectatorSendKeyframe();
+
+  /* Find the changed sprite slots. */
+
+  SpectatorGetSprites(newSprites);
+  slotMask = 0;
+  for (iSlot = 0; iSlot < SPECTATOR_SPRITE_SLOTS; iSlot++)
+  {
+    if (memcmp(newSprites[iSlot], sSentSprites[iSlot], 4) != 0)
+      slotMask |= 1 << iSlot;
+  }
+
+  if (slotMask == 0 && sChangedTilesCount == 0)
+  {
+    SpectatorFlush(); /* Could be a keyframe of a level without players. */
+    return; /* Nothing changed, not even worth a 'D' record. */
+  }
+
+  SpectatorPutByte('D');
+  SpectatorPutWord(g_FrameCounter);
+  SpectatorPutByte(g_play_area_col_for_screen);
+  SpectatorPutByte(g_play_area_row_for_screen);
+
+  if (sChangedTilesCount != 0)
+  {
+    SpectatorPutByte('T');
+    SpectatorPutByte(sChangedTilesCount);
+    for (iSlot = 0; iSlot < sChangedTilesCount; iSlot++)
+    {
+      pTile = sChangedTiles[iSlot];
+      pTile->dirty_remote = false;
+      SpectatorPutWord(pTile - g_tile_array);
+      SpectatorPutByte(SpectatorTileValue(pTile));
+    }
+    sChangedTilesCount = 0;
+  }
+
+  if (slotMask != 0)
+  {
+    SpectatorPutByte('S');
+    SpectatorPutWord(slotMask);
+    for (iSlot = 0; iSlot < SPECTATOR_SPRITE_SLOTS; iSlot++)
+    {
+      if (!(slotMask & (1 << iSlot)))
+        continue;
+      byteMask = 0;
+      for (iByte = 0; iByte < 4; iByte++)
+      {
+        if (newSprites[iSlot][iByte] != sSentSprites[iSlot][iByte])
+          byteMask |= 1 << iByte;
+      }
+      SpectatorPutByte(byteMask);
+      for (iByte = 0; iByte < 4; iByte++)
+      {
+        if (byteMask & (1 << iByte))
+          SpectatorPutByte(newSprites[iSlot][iByte]);
+      }
+    }
+    memcpy(sSentSprites, newSprites, sizeof(sSentSprites));
+  }
+
+  SpectatorFlush();
+
+#if DEBUG_PRINT_SPECTATOR
+  strcpy(g_TempBuffer, "Spectator bytes since keyframe ");
+  AppendDecimalUInt16(g_SpectatorBytesSent);
+  strcat(g_TempBuffer, ".\n");
+  DebugPrintString(g_TempBuffer);
+#endif
+}
+
+#endif /* SPECTATOR_STREAM */
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * Nth Pong Wars, spectator.h for broadcasting a game to extra displays.
+ *
+ * Each frame the changes to the game board (tiles whose owner or age changed,
+ * found with the dirty_remote flag) and the sprite attributes that
+ * CopyPlayersToSprites() sends to the VDP are encoded into a compact stream of
+ * records and sent over a TCP connection opened through the NABU Internet
+ * Adapter.  Every so often a keyframe with the whole board is sent, so a
+ * viewer can start watching part way through.  See Unix/SpectatorRelay.c for
+ * the Linux program that receives the stream and fans it out to viewers.
+ *
+ * The stream is a sequence of records, each starting with a letter.  16 bit
+ * numbers are little endian.  A tile value is the owner in the low 5 bits and
+ * the age in the top 3 bits.
+ *
+ * 'K' Keyframe: frame (16 bits), play area width, play area height, screen
+ *     column, screen row.  All sprites are forgotten (treated as hidden), and
+ *     tile runs follow until the whole play area is covered.
+ * 'R' Tile runs: run count, then run count times: length, tile value.  Runs
+ *     continue on from where the previous 'R' record left off.
+ * 'D' Delta frame: frame (16 bits), screen column, screen row.  Only sent if
+ *     something changed.
+ * 'T' Changed tiles: count, then count times: tile index in the play area (16
+ *     bits), tile value.
+ * 'S' Sprites: slot mask (16 bits), then for each changed slot (lowest bit
+ *     first) a byte mask with bit N set if byte N of the slot's 4 byte VDP
+ *     sprite attribute changed, followed by those changed bytes.  Slots are
+ *     player balls, then sparkles, then shadows, MAX_PLAYERS of each.  A slot
+ *     with a vertical position of SPRITE_NOT_DRAWABLE is hidden.  The viewer
+ *     gets the VDP sprite attribute table by listing the visible slots in
+ *     order, same as CopyPlayersToSprites() does.
+ *
+ * With four players moving around, sending every other frame, it works out to
+ * a few hundred bytes per second, more when lots of tiles are changing.
+ *
+ * AGMS20261018 - Start this header file.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _SPECTATOR_H
+#define _SPECTATOR_H 1
+
+/* Compile time option to include the spectator broadcasting code.  Only works
+   on the NABU, since it uses the hardware sprite data.  Use
+   -DSPECTATOR_STREAM=1 on the compiler command line to turn it on. */
+#ifndef SPECTATOR_STREAM
+#define SPECTATOR_STREAM 0
+#endif
+
+/* Where the relay program is running, as seen by the NABU Internet Adapter.
+   Override on the compiler command line if it's not on the same computer. */
+#ifndef SPECTATOR_RELAY_HOST
+#define SPECTATOR_RELAY_HOST "127.0.0.1"
+#endif
+#ifndef SPECTATOR_RELAY_PORT
+#define SPECTATOR_RELAY_PORT 7200
+#endif
+
+/* Send an update every this many frames.  2 is plenty smooth for watching,
+   and halves the bandwidth.  Power of two for masking. */
+#define SPECTATOR_FRAMES_PER_UPDATE 2
+
+/* Send a whole board keyframe every this many frames, so new viewers don't
+   wait long.  Power of two for masking. */
+#define SPECTATOR_KEYFRAME_FRAMES 256
+
+/* Number of changed tiles remembered between updates.  If more change, a
+   keyframe is sent instead, which is usually smaller anyway due to the run
+   length encoding.  Needs to be less than 255. */
+#define SPECTATOR_MAX_CHANGED_TILES 48
+
+/* Number of sprite slots, balls, sparkles and shadows for each player. */
+#define SPECTATOR_SPRITE_SLOTS (MAX_PLAYERS * 3)
+
+#if SPECTATOR_STREAM
+
+extern uint16_t g_SpectatorBytesSent;
+/* Statistics, number of bytes sent since the last keyframe.  For tuning. */
+
+extern void SpectatorReset(void);
+/* Start afresh with a keyframe on the next update.  Call after loading a
+   level.  Also tries to connect to the relay if not already connected. */
+
+extern void SpectatorNoteTile(tile_pointer pTile);
+/* Remember that a tile has changed owner or age, so it can be sent in the
+   next update.  Called when the tile's dirty_remote flag gets set. */
+
+extern void SpectatorSendFrame(void);
+/* Encode and send the changes since the last update, if it's time for an
+   update.  Call once per frame, after the screen has been updated. */
+
+#define SPECTATOR_NOTE_TILE(pTile) SpectatorNoteTile(pTile)
+
+#else /* No spectator code, make the hooks do nothing. */
+
+#define SpectatorReset()
+#define SpectatorSendFrame()
+#define SPECTATOR_NOTE_TILE(pTile)
+
+#endif /* SPECTATOR_STREAM */
+
+#endif /* _SPECTATOR_H */
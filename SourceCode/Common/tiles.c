@@ -17,6 +17,8 @@
  */
 
 #include "tiles.h"
+#include "rollback.h"
+#include "spectator.h"
 
 /******************************************************************************/
 
@@ -30,6 +32,9 @@ const char * g_TileOwnerNames[OWNER_MAX] = {
   "P2", /* OWNER_PLAYER_2 */
   "P3", /* OWNER_PLAYER_3 */
   "P4", /* OWNER_PLAYER_4 */
+#if MAX_PLAYERS > 4 /* Host only, GNU C range designator. */
+  [OWNER_PLAYER_4 + 1 ... OWNER_PLAYER_LAST] = "PX",
+#endif
   "Wall", /* OWNER_WALL_INDESTRUCTIBLE */
   "WallP1", /* OWNER_WALL_DESTRUCTIBLE_P1 */
   "WallP2", /* OWNER_WALL_DESTRUCTIBLE_P2 */
@@ -49,6 +54,9 @@ const char g_TileOwnerLetters[OWNER_MAX] = {
   '2', /* OWNER_PLAYER_2 */
   '3', /* OWNER_PLAYER_3 */
   '4', /* OWNER_PLAYER_4 */
+#if MAX_PLAYERS > 4 /* Extra players can't be placed by level files. */
+  [OWNER_WALL_INDESTRUCTIBLE] =
+#endif
   '+', /* OWNER_WALL_INDESTRUCTIBLE */
   '(', /* OWNER_WALL_DESTRUCTIBLE_P1 */
   ')', /* OWNER_WALL_DESTRUCTIBLE_P2 */
@@ -87,6 +95,9 @@ const char *g_TileAnimData[OWNER_MAX] =
   "2", /* OWNER_PLAYER_2 */
   "3", /* OWNER_PLAYER_3 */
   "4", /* OWNER_PLAYER_4 */
+#if MAX_PLAYERS > 4 /* One character for each tile age. */
+  [OWNER_PLAYER_4 + 1 ... OWNER_PLAYER_LAST] = "XXXXXXXX",
+#endif
   "Wall", /* OWNER_WALL_INDESTRUCTIBLE */
   "WallP1", /* OWNER_WALL_DESTRUCTIBLE_P1 */
   "WallP2", /* OWNER_WALL_DESTRUCTIBLE_P2 */
@@ -107,6 +118,9 @@ uint8_t g_TileOwnerQuotas[OWNER_MAX] = {
   0, /* OWNER_PLAYER_2 */
   0, /* OWNER_PLAYER_3 */
   0, /* OWNER_PLAYER_4 */
+#if MAX_PLAYERS > 4
+  [OWNER_WALL_INDESTRUCTIBLE] =
+#endif
   0, /* OWNER_WALL_INDESTRUCTIBLE  Up to this are ignored for quotas. */
   0, /* OWNER_WALL_DESTRUCTIBLE_P1 */
   0, /* OWNER_WALL_DESTRUCTIBLE_P2 */
@@ -495,6 +509,12 @@ void MakeAllTilesDirty(void)
 */
 void RequestTileRedraw(tile_pointer pTile)
 {
+  if (!pTile->dirty_remote) /* Owner or age changed, tell remote players. */
+  {
+    pTile->dirty_remote = true;
+    SPECTATOR_NOTE_TILE(pTile);
+  }
+
   if (!pTile->animated)
   {
     pTile->animated = true;
@@ -524,6 +544,7 @@ tile_owner SetTileOwner(tile_pointer pTile, tile_owner newOwner)
   if (previousOwner == newOwner)
     return previousOwner; /* Ran into our own tile again, do nothing. */
 
+  ROLLBACK_JOURNAL_TILE(pTile); /* So a network rollback can undo it. */
   pTile->owner = newOwner;
   pTile->animationIndex = 0;
   pTile->animDelayCount = MAX_ANIM_DELAY_COUNT;
@@ -711,7 +732,7 @@ static void UpdateOneTileAnimation(tile_pointer pTile)
   pAnimString = g_TileAnimData[pTile->owner];
 
   if (pTile->owner >= (tile_owner) OWNER_PLAYER_1 &&
-  pTile->owner <= (tile_owner) OWNER_PLAYER_4)
+  pTile->owner <= (tile_owner) OWNER_PLAYER_LAST)
   { /* Just show a static character based on player owned tile's age. */
     animIndex = pTile->age;
     pTile->animated = false;
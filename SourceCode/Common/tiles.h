@@ -41,8 +41,25 @@
 /* The maximum value for animDelayCount, which has a limited number of bits. */
 #define MAX_ANIM_DELAY_COUNT 2
 
+#ifndef MAX_PLAYERS
+#define MAX_PLAYERS 4
+#endif
+/* The maximum number of players allowed.  On the NABU, it's limited to 4 due to
+   colour palette limits and the maximum number of visible sprites (4 visible,
+   more per scan line don't get drawn, and we use sprites for balls).  Host
+   builds can have more (compile with -DMAX_PLAYERS=16 for example, up to 64)
+   for stress testing and big screen party games.  Level files, sprites and
+   colourful score digits only know about the first 4, so the extra players
+   borrow the level settings of one of those (see PLAYER_GROUP_MASK). */
+#ifdef NABU_H
+#undef MAX_PLAYERS
+#define MAX_PLAYERS 4
+#endif
+
 /* The various things that a tile can be.  Empty space, or coloured to show
-   the player who owns it, or a power up.
+   the player who owns it, or a power up.  Host builds with more than 4
+   players have the extra player owners after OWNER_PLAYER_4, up to
+   OWNER_PLAYER_LAST, which moves the rest along.
 */
 typedef enum tile_owner_enum {
   OWNER_EMPTY = 0,
@@ -50,6 +67,7 @@ typedef enum tile_owner_enum {
   OWNER_PLAYER_2,
   OWNER_PLAYER_3,
   OWNER_PLAYER_4,
+  OWNER_PLAYER_LAST = OWNER_PLAYER_1 + MAX_PLAYERS - 1, /* Extra players. */
   OWNER_WALL_INDESTRUCTIBLE,
   OWNER_TRACKED_FOR_QUOTA, /* Marks the first tile type we do quotas for. */
   OWNER_WALL_DESTRUCTIBLE_P1 = OWNER_TRACKED_FOR_QUOTA,
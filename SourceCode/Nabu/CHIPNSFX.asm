@@ -45,18 +45,25 @@ PUBLIC chip_play
 writepsg: ; A=VALUE,C=INDEX; -  Access sound hardware on Nabu PC, AGMS20250316.
   PUSH BC
   LD B,A
+  LD A,I  ; P/V flag is the interrupt enable state, AGMS20261018.
+  PUSH AF
   LD A,C
+  DI  ; Other interrupt handlers (HCCA) select AY registers too.
   OUT ($41),A  ; Select register to access, out IO_AYLATCH.
   CP 7  ; Register 7 high bits are special on the Nabu, controls AY's IO ports.
   LD A,B
   JR Z,PatchReg7
   OUT ($40),A ; Write data to register, IO_AYDATA.
-  POP BC
-  RET
+  JR WritePSGDone
 PatchReg7: ; Make sure high two bits of value going into register 7 are 01.
   AND A,0b00111111
   OR  A,0b01000000
   OUT ($40),A ; Write patched data to register 7, IO_AYDATA.
+WritePSGDone:
+  POP AF
+  JP PO,WritePSGExit ; Interrupts were off when called, leave them off.
+  EI
+WritePSGExit:
   LD A,B ; Restore unpatched register value, it is sometimes used by caller.
   POP BC
   RET
@@ -1142,10 +1149,24 @@ chip_last:
 
 ; Glue code for C, copying arguments off stack and into registers.
 
+; When the player is being updated from the frame interrupt (see
+; CSFX_interrupt), the glue functions set CSFX_Lock while they change the
+; player's data, and the interrupt skips its update until the lock is
+; released.  The skipped tick isn't lost, it gets done on the next frame.
+; AGMS20261018
+
+CSFX_Lock: defb 0 ; Non-zero while C code is calling the player.
+
+
 ; void CSFX_stop(void);
 PUBLIC _CSFX_stop
 _CSFX_stop:
-  jp    chip_stop ; -; AFBCDEHL!
+  ld    a,1
+  ld    (CSFX_Lock),a
+  call  chip_stop ; -; AFBCDEHL!
+  xor   a,a
+  ld    (CSFX_Lock),a
+  ret
 
 
 ; void CSFX_start(void *SongPntr, bool IsEffects);
@@ -1157,10 +1178,15 @@ _CSFX_start:
   inc   hl
   ld    d,(hl)
   inc   hl
+  ld    a,1
+  ld    (CSFX_Lock),a
   xor   a,a    ; Zero A register.
   sub   a,(hl) ; Carry set if IsEffects is TRUE, clear otherwise.
   ex    de,hl
-  jp    chip_song ; HL=^HEADER,[CF?SFX:BGM]; HL+++,AFBCDE!
+  call  chip_song ; HL=^HEADER,[CF?SFX:BGM]; HL+++,AFBCDE!
+  xor   a,a
+  ld    (CSFX_Lock),a
+  ret
 
 
 ; void CSFX_chan(uint8_t Channel, void *TrackPntr);
@@ -1168,23 +1194,102 @@ PUBLIC _CSFX_chan
 _CSFX_chan:
   ld    hl,2    ; Skip over return address.
   add   hl,sp
+  ld    a,1
+  ld    (CSFX_Lock),a
   ld    a,(hl)  ; Get Channel.
   inc   hl
   ld    e,(hl)  ; Get TrackPntr.
   inc   hl
   ld    d,(hl)
-  jp    chip_chan ; A=CHANNEL[0-2/0-5],DE=^TRACK; AFBC!
+  call  chip_chan ; A=CHANNEL[0-2/0-5],DE=^TRACK; AFBC!
+  xor   a,a
+  ld    (CSFX_Lock),a
+  ret
 
 
 ; void CSFX_play(void);
 PUBLIC _CSFX_play
 _CSFX_play:
   push  ix ; Save stack frame pointer from C world.
+  ld    a,1
+  ld    (CSFX_Lock),a
   call  chip_play ; -; AFBCDEHLIX!
+  xor   a,a
+  ld    (CSFX_Lock),a
   pop   ix
   ret
 
 
+; void CSFX_interrupt(void);
+; Hooks the player update into the VDP frame interrupt, chaining to the
+; existing NABU-LIB handler (which counts frames in vdpIsReady).  The NABU
+; interrupt controller puts the interrupt number times 2 on the bus, and the
+; VDP is interrupt 3, so its vector is at I * 256 + 6.  AGMS20261018
+
+CSFX_VDP_VECTOR = 6
+CSFX_TICK_FRAMES = 2 ; Update every second frame, 30hz.
+
+CSFX_OriginalISR: defw 0 ; NABU-LIB's VDP interrupt handler.
+CSFX_TickFrames: defb 0 ; Frames since the last update.
+
+PUBLIC _CSFX_interrupt
+_CSFX_interrupt:
+  ld    hl,(CSFX_OriginalISR)
+  ld    a,h
+  or    a,l
+  ret   nz      ; Already hooked in, don't chain to ourselves.
+  ld    a,i     ; High byte of the interrupt vector table address.
+  ld    h,a
+  ld    l,CSFX_VDP_VECTOR
+  di
+  ld    e,(hl)
+  inc   hl
+  ld    d,(hl)
+  ld    (CSFX_OriginalISR),de
+  ld    de,CSFX_InterruptHandler
+  ld    (hl),d
+  dec   hl
+  ld    (hl),e
+  ei
+  ret
+
+CSFX_InterruptHandler:
+  push  af
+  push  bc
+  push  de
+  push  hl
+  push  ix
+  call  CSFX_CallOriginalISR ; Acknowledges the VDP, returns with RETI.
+  ei    ; Let the HCCA interrupts in while the music plays, so no lost bytes.
+  ld    hl,CSFX_TickFrames
+  inc   (hl)
+  ld    a,(hl)
+  cp    CSFX_TICK_FRAMES
+  jr    c,InterruptExit
+  ld    a,(CSFX_Lock)
+  or    a,a
+  jr    nz,InterruptExit ; C code is using the player, try again next frame.
+  inc   a
+  ld    (CSFX_Lock),a
+  ld    a,(hl)
+  sub   CSFX_TICK_FRAMES
+  ld    (hl),a
+  call  chip_play ; -; AFBCDEHLIX!
+  xor   a,a
+  ld    (CSFX_Lock),a
+InterruptExit:
+  pop   ix
+  pop   hl
+  pop   de
+  pop   bc
+  pop   af
+  ret   ; Already did the RETI in the original handler.
+
+CSFX_CallOriginalISR:
+  ld    hl,(CSFX_OriginalISR)
+  jp    (hl)
+
+
 ; bool CSFX_busy(uint8_t Channel);
 PUBLIC _CSFX_busy
 _CSFX_busy:
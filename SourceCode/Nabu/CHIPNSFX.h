@@ -41,6 +41,14 @@ extern void CSFX_play(void);
    setting in the editor for it so you can hear what you're editing at the
    right speed). */
 
+extern void CSFX_interrupt(void);
+/* Hooks CSFX_play() into the VDP frame interrupt, updating the sound every
+   second frame (30hz) no matter how long the game takes to draw a frame.
+   Call it after the frame interrupt has been enabled, then stop calling
+   CSFX_play().  The other functions are safe to call while it is running, the
+   interrupt waits a frame if it catches them in the middle of changing the
+   player's data. */
+
 extern bool CSFX_busy(uint8_t Channel);
 /* Returns TRUE if the given channel (0 to 2 for effects) is busy playing
    something.  FALSE if it has finished its track instructions. */
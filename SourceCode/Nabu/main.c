@@ -27,7 +27,7 @@
  * To prepare to run, create the data files in the server store directory,
  * usually somewhere like Documents/NABU Internet Adapter/Store/NTHPONG/
  * The Art/*.PC2 files are copied as is, the *.DAT text files edited by ICVGM
- * are copied and renamed *.ICV (TODO: convert them to binary for speed).
+ * are converted to binary *.NSCR (or *.NCHR) files by Unix/ICVGMConvert.c.
  *
  * This program is free software: you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -125,9 +125,19 @@ char g_TempBuffer[TEMPBUFFER_LEN] =
 #include "../Common/scores.c"
 #include "../Common/soundscreen.c"
 #include "../Common/levels.c"
+#include "../Common/rollback.c"
+#include "../Common/spectator.c"
 
 
 static bool s_KeepRunning;
+
+#if FIXED_TIMESTEP
+static int8_t s_TickBalance;
+/* Vertical blanks that have gone by, minus VBLANKS_PER_TICK for each tick
+   done.  Positive when running behind real time, negative when ahead. */
+
+static uint8_t s_SkippedDraws; /* Number of ticks in a row not drawn. */
+#endif /* FIXED_TIMESTEP */
 static char s_OriginalLocationZeroMemory[16]; /* Detects memory trashing. */
 static const char *k_CorruptedLowMemText =
   "Corrupted location zero (NULL) Memory!";
@@ -147,7 +157,9 @@ static char HitAnyKey(const char *MessageText)
   {
     vdp_waitVDPReadyInt();
     vdp_waitVDPReadyInt();
+#if !SOUND_INTERRUPT_TICK
     CSFX_play(); /* Update music every 1/30 of a second. */
+#endif
   }
 
   return getChar();
@@ -219,6 +231,58 @@ static void ProcessKeyboard(void)
 }
 
 
+#if FIXED_TIMESTEP
+/*******************************************************************************
+ * Wait until it is time for the next game tick, VBLANKS_PER_TICK vertical
+ * blanks after the previous one.  Returns FALSE without waiting if the game
+ * has fallen a tick or more behind real time, so the caller can skip drawing
+ * to catch up, though only MAX_SKIPPED_DRAWS in a row so the screen still
+ * changes.  Otherwise waits for the vertical blank, so drawing can be done
+ * without glitches, and returns TRUE.
+ */
+static bool WaitForNextTick(void)
+{
+  int16_t tickBalance;
+  uint8_t missedVBlanks;
+
+  /* vdpIsReady counts the vertical blank starts missed since the last wait,
+     which can be hundreds after a long delay, like loading music.  Don't try
+     to catch up on those, but count enough to cover the most ticks we can
+     skip drawing, so a game that is really behind doesn't come out ahead. */
+
+  missedVBlanks = vdpIsReady;
+  if (missedVBlanks > VBLANKS_PER_TICK * (MAX_SKIPPED_DRAWS + 1))
+    missedVBlanks = VBLANKS_PER_TICK * (MAX_SKIPPED_DRAWS + 1);
+
+  tickBalance = s_TickBalance - VBLANKS_PER_TICK;
+  if (tickBalance + missedVBlanks >= VBLANKS_PER_TICK &&
+  s_SkippedDraws < MAX_SKIPPED_DRAWS)
+  {
+    s_TickBalance = tickBalance;
+    s_SkippedDraws++;
+    return false;
+  }
+
+  g_ScoreFramesPerUpdate = missedVBlanks + 1;
+  tickBalance += g_ScoreFramesPerUpdate;
+  vdp_waitVDPReadyInt(); /* Fixed version now sets vdpIsReady to zero. */
+  while (tickBalance < 0) /* Ahead of real time, show this frame longer. */
+  {
+    vdp_waitVDPReadyInt();
+    tickBalance++;
+  }
+
+  /* Only catch up on a couple of ticks, more would look like fast forward. */
+
+  if (tickBalance > VBLANKS_PER_TICK * 2)
+    tickBalance = VBLANKS_PER_TICK * 2;
+  s_TickBalance = tickBalance;
+  s_SkippedDraws = 0;
+  return true;
+}
+#endif /* FIXED_TIMESTEP */
+
+
 /*******************************************************************************
  * Main program and main game loop.
  */
@@ -280,6 +344,9 @@ void main(void)
 
   /* Start the frame interrupt, to count frames and do sound tick timing. */
   vdp_enableVDPReadyInt();
+#if SOUND_INTERRUPT_TICK
+  CSFX_interrupt(); /* Music now updates itself, 30 times a second. */
+#endif
 
 #if 0
   /* Print some text on screen which we can screen grab and put into the fully
@@ -360,10 +427,20 @@ void main(void)
        activity due to players moving too fast. */
 
     s_KeepRunning = true;
+#if FIXED_TIMESTEP
+    s_TickBalance = 0; /* Level loading time doesn't need catching up. */
+    vdpIsReady = 0;
+    s_SkippedDraws = 0;
+#endif
+    RollbackReset(); /* Old history refers to the previous level. */
+    SpectatorReset(); /* Viewers need a keyframe of the new level. */
     while (true)
     {
       ProcessKeyboard();
+      RollbackResimulateIfNeeded(); /* Correct wrong guesses of remote input. */
+      RollbackStartFrame();
       UpdatePlayerInputs();
+      RollbackEndInputs();
       if (gVictoryModeHighestTileCount) /* If running the Pong Wars game. */
       {
         Simulate();
@@ -382,30 +459,58 @@ void main(void)
       if (!s_KeepRunning)
         break;
 
+#if FIXED_TIMESTEP
+      if (WaitForNextTick()) /* FALSE to skip drawing when running behind. */
+#else
       /* Wait for the next vertical blank.  Check if our update took longer than
          a frame.  vdpIsReady counts number of vertical blank starts missed. */
 
       g_ScoreFramesPerUpdate = vdpIsReady + 1;
       vdp_waitVDPReadyInt(); /* Fixed version now sets vdpIsReady to zero. */
-
-      /* Do the sprites first, since they're time critical to avoid glitches. */
-      if (gVictoryModeHighestTileCount) /* If running the Pong Wars game. */
+#endif /* FIXED_TIMESTEP */
       {
-        CopyPlayersToSprites();
-        CopyTilesToScreen();
-        CopyScoresToScreen();
-      }
-      else /* Game not running, turn off sprites, slow down to 30hz updates. */
-      {
-        if (g_ScoreFramesPerUpdate < 2)
-          vdp_waitVDPReadyInt();
-        vdp_setWriteAddress(_vdpSpriteAttributeTableAddr);
-        IO_VDPDATA = 0xD0;
+        /* Do the sprites first, since they're time critical to avoid
+           glitches. */
+        if (gVictoryModeHighestTileCount) /* If running the Pong Wars game. */
+        {
+          CopyPlayersToSprites();
+          CopyTilesToScreen();
+          CopyScoresToScreen();
+          PhysicsGovernorUpdate(g_ScoreFramesPerUpdate);
+        }
+        else /* Game not running, turn off sprites, slow down to 30hz. */
+        {
+#if !FIXED_TIMESTEP /* Ticks are already slower than that. */
+          if (g_ScoreFramesPerUpdate < 2)
+            vdp_waitVDPReadyInt();
+#endif
+          vdp_setWriteAddress(_vdpSpriteAttributeTableAddr);
+          IO_VDPDATA = 0xD0;
+        }
       }
 
+      /* Start the sound effects requested during the frame's simulation. */
+      PlayQueuedSounds();
+
       /* Update the audio hardware with the music being played.  Can debug which
          channels are busy, look in scores.c. */
+#if !SOUND_INTERRUPT_TICK
       CSFX_play();
+#endif
+
+      /* Send changes to the spectator relay, if any, now that the time
+         critical screen updates are done. */
+      SpectatorSendFrame();
+
+      /* Read ahead a bit of the likely next level file, if the last update
+         didn't overflow its time.  Bounded to one small chunk per frame. */
+
+#if FIXED_TIMESTEP
+      if (g_ScoreFramesPerUpdate <= VBLANKS_PER_TICK)
+#else
+      if (g_ScoreFramesPerUpdate <= 1)
+#endif /* FIXED_TIMESTEP */
+        LevelPrefetchUpdate();
 
       /* Check for victory conditions, but after the screen update, so the
          player can see themselves hitting the desired number of points etc. */
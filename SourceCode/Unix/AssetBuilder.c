@@ -0,0 +1,715 @@
+/******************************************************************************
+ * Nth Pong Wars, builds all the game's data files for the NABU server.
+ *
+ * Runs the other Unix tools over the art directories to make the files the
+ * NABU Internet Adapter serves up: ICVGM .dat files get converted to .NSCR
+ * (and .NCHR, if there's one already in the art directory, since some screens
+ * only use the name table) by ICVGMConvert and then packed by ScreenPacker,
+ * existing .NFUL, .NSCR and .NCHR files get packed, .CHIPNSFX music files get
+ * copied as they are, and .LEVEL files get compiled by LevelCompiler.  The PNG to .NFUL (Dithertron) and .CHP
+ * to .CHIPNSFX (CHIPNSFX tracker) steps still have to be done by hand, see
+ * Nabu/Art/NthPongWarsBuildingDataNotes.txt, this starts from their output.
+ *
+ * Conversions run in parallel, one per processor core by default.  A hash of
+ * each input file and of the tools is remembered in AssetCache.txt in the
+ * output directory, and an asset is skipped if its hash hasn't changed and
+ * the output file is still there.  At the end it lists each output file's size
+ * and roughly how long the NABU will take to load it.
+ *
+ * AGMS20261018 - Start the asset builder.
+ *
+ * Compile with: gcc -g -O2 -Wall -o AssetBuilder AssetBuilder.c
+ * Also compile ICVGMConvert.c, ScreenPacker.c and LevelCompiler.c the same way.
+ * Run with: ./AssetBuilder [-j Jobs] [-t ToolDirectory/] [-v]
+ *   -o OutputDirectory/ ../Nabu/Art/ "../Nabu/Art/3rd Party Music/" ...
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* The NABU's HCCA link to the Internet Adapter runs at 111,860 bits per
+   second, 10 bits per byte with start and stop bits.  RetroNET requests add a
+   bit of overhead on top, so real loads are a bit slower than this. */
+#define ADAPTER_BYTES_PER_SECOND 11186
+
+#define CACHE_FILE_NAME "AssetCache.txt"
+#define MAX_PATH_LENGTH 1024
+#define MAX_NAME_LENGTH 256
+
+typedef enum JobTypeEnum {
+  JOB_PACK = 0, /* Pack an existing screen file. */
+  JOB_ICVGM_NSCR, /* Convert an ICVGM file to .NSCR and pack it. */
+  JOB_ICVGM_NCHR, /* Convert an ICVGM file to .NCHR and pack it. */
+  JOB_LEVEL, /* Compile a level file. */
+  JOB_COPY, /* Copy a file unchanged, for music. */
+  JOB_MAX
+} JobType;
+
+static const char *kJobTypeNames[JOB_MAX] = {
+  "pack", "ICVGM", "ICVGM -c", "level", "copy"
+};
+
+typedef enum JobStateEnum {
+  STATE_WAITING = 0,
+  STATE_RUNNING,
+  STATE_BUILT,
+  STATE_CACHED,
+  STATE_FAILED
+} JobState;
+
+typedef struct JobStruct {
+  JobType type;
+  JobState state;
+  char inputPath[MAX_PATH_LENGTH];
+  char dataDirectory[MAX_PATH_LENGTH]; /* Directory of the input, with slash. */
+  char outputName[MAX_NAME_LENGTH];
+  uint64_t hash; /* Of the inputs and the tools. */
+  long inputSize;
+  long outputSize;
+  pid_t pid;
+} JobRecord, *JobPointer;
+
+static JobPointer s_Jobs;
+static int s_JobCount;
+static int s_JobsAllocated;
+
+static const char *s_OutputDirectory;
+static const char *s_ToolDirectory = "./";
+static bool s_Verbose;
+static uint64_t s_ToolsHash;
+
+/* Previous contents of the cache file, hash and output name pairs. */
+typedef struct CacheStruct {
+  uint64_t hash;
+  char outputName[MAX_NAME_LENGTH];
+} CacheRecord;
+
+static CacheRecord *s_Cache;
+static int s_CacheCount;
+
+static const char *kToolNames[] = {"ICVGMConvert", "ScreenPacker",
+  "LevelCompiler"};
+#define TOOL_COUNT ((int) (sizeof(kToolNames) / sizeof(kToolNames[0])))
+
+
+/*******************************************************************************
+ * Add the contents of a file to a 64 bit FNV-1a hash.  Returns the file size,
+ * or -1 if it can't be read.
+ */
+static long HashFile(const char *path, uint64_t *pHash)
+{
+  uint8_t buffer[4096];
+  ssize_t amountRead;
+  ssize_t i;
+  long fileSize = 0;
+  int fileID;
+
+  fileID = open(path, O_RDONLY);
+  if (fileID < 0)
+    return -1;
+  while ((amountRead = read(fileID, buffer, sizeof(buffer))) > 0)
+  {
+    for (i = 0; i < amountRead; i++)
+    {
+      *pHash ^= buffer[i];
+      *pHash *= 0x100000001B3ULL;
+    }
+    fileSize += amountRead;
+  }
+  close(fileID);
+  return (amountRead < 0) ? -1 : fileSize;
+}
+
+
+/*******************************************************************************
+ * Returns the size of a file, -1 if it doesn't exist.
+ */
+static long FileSize(const char *path)
+{
+  struct stat fileStatus;
+
+  if (stat(path, &fileStatus) != 0)
+    return -1;
+  return (long) fileStatus.st_size;
+}
+
+
+/*******************************************************************************
+ * Returns the file name without the directory and without the extension, in
+ * upper case like the NABU Internet Adapter wants.
+ */
+static void UpperCaseBaseName(const char *path, char *baseName)
+{
+  const char *pChar;
+  char *pDot;
+
+  pChar = strrchr(path, '/');
+  pChar = (pChar == NULL) ? path : pChar + 1;
+  snprintf(baseName, MAX_NAME_LENGTH, "%s", pChar);
+  pDot = strrchr(baseName, '.');
+  if (pDot != NULL)
+    *pDot = 0;
+  for (pDot = baseName; *pDot != 0; pDot++)
+    *pDot = toupper(*pDot);
+}
+
+
+/*******************************************************************************
+ * Add a job to the list.  Returns FALSE if out of memory.
+ */
+static bool AddJob(JobType type, const char *directory, const char *fileName,
+  const char *outputName)
+{
+  JobPointer pJob;
+
+  if (s_JobCount >= s_JobsAllocated)
+  {
+    s_JobsAllocated = s_JobsAllocated * 2 + 16;
+    s_Jobs = realloc(s_Jobs, s_JobsAllocated * sizeof(JobRecord));
+    if (s_Jobs == NULL)
+      return false;
+  }
+  pJob = s_Jobs + s_JobCount++;
+  memset(pJob, 0, sizeof(JobRecord));
+  pJob->type = type;
+  snprintf(pJob->dataDirectory, sizeof(pJob->dataDirectory), "%s%s",
+    directory, (directory[strlen(directory) - 1] == '/') ? "" : "/");
+  snprintf(pJob->inputPath, sizeof(pJob->inputPath), "%s%s",
+    pJob->dataDirectory, fileName);
+  snprintf(pJob->outputName, sizeof(pJob->outputName), "%s", outputName);
+  return true;
+}
+
+
+/*******************************************************************************
+ * Returns TRUE if the file name has the given extension (including the
+ * period), ignoring case.
+ */
+static bool HasExtension(const char *fileName, const char *extension)
+{
+  const char *pDot = strrchr(fileName, '.');
+
+  return pDot != NULL && strcasecmp(pDot, extension) == 0;
+}
+
+
+/*******************************************************************************
+ * Look for an ICVGM file in the directory listing which generates the given
+ * screen file (same name, ignoring case, with a .dat extension).
+ */
+static bool HasICVGMSource(struct dirent **pNames, int nameCount,
+  const char *screenName)
+{
+  char baseName[MAX_NAME_LENGTH];
+  char screenBaseName[MAX_NAME_LENGTH];
+  int i;
+
+  UpperCaseBaseName(screenName, screenBaseName);
+  for (i = 0; i < nameCount; i++)
+  {
+    if (!HasExtension(pNames[i]->d_name, ".dat"))
+      continue;
+    UpperCaseBaseName(pNames[i]->d_name, baseName);
+    if (strcmp(baseName, screenBaseName) == 0)
+      return true;
+  }
+  return false;
+}
+
+
+/*******************************************************************************
+ * Make jobs for all the assets in a directory.  Returns FALSE on failure,
+ * after printing why.
+ */
+static bool ScanDirectory(const char *directory)
+{
+  struct dirent **pNames;
+  char baseName[MAX_NAME_LENGTH];
+  char outputName[MAX_NAME_LENGTH + 8];
+  char path[MAX_PATH_LENGTH + MAX_NAME_LENGTH];
+  bool madeOne;
+  bool success = true;
+  int nameCount;
+  int i;
+
+  nameCount = scandir(directory, &pNames, NULL, alphasort);
+  if (nameCount < 0)
+  {
+    fprintf(stderr, "Unable to read directory \"%s\": %s\n", directory,
+      strerror(errno));
+    return false;
+  }
+
+  for (i = 0; success && i < nameCount; i++)
+  {
+    const char *fileName = pNames[i]->d_name;
+
+    if (HasExtension(fileName, ".dat"))
+    {
+      /* Make the .NSCR and/or .NCHR versions, whichever ones are in the art
+         directory already, defaulting to .NSCR. */
+      UpperCaseBaseName(fileName, baseName);
+      madeOne = false;
+      snprintf(outputName, sizeof(outputName), "%s.NCHR", baseName);
+      snprintf(path, sizeof(path), "%s/%s", directory, outputName);
+      if (FileSize(path) >= 0)
+      {
+        success = AddJob(JOB_ICVGM_NCHR, directory, fileName, outputName);
+        madeOne = true;
+      }
+      snprintf(outputName, sizeof(outputName), "%s.NSCR", baseName);
+      snprintf(path, sizeof(path), "%s/%s", directory, outputName);
+      if (success && (FileSize(path) >= 0 || !madeOne))
+        success = AddJob(JOB_ICVGM_NSCR, directory, fileName, outputName);
+    }
+    else if (HasExtension(fileName, ".NFUL") ||
+    HasExtension(fileName, ".NSCR") || HasExtension(fileName, ".NCHR"))
+    {
+      if (!HasICVGMSource(pNames, nameCount, fileName))
+        success = AddJob(JOB_PACK, directory, fileName, fileName);
+    }
+    else if (HasExtension(fileName, ".CHIPNSFX"))
+      success = AddJob(JOB_COPY, directory, fileName, fileName);
+    else if (HasExtension(fileName, ".LEVEL"))
+      success = AddJob(JOB_LEVEL, directory, fileName, fileName);
+  }
+
+  for (i = 0; i < nameCount; i++)
+    free(pNames[i]);
+  free(pNames);
+
+  if (!success)
+    fprintf(stderr, "Out of memory.\n");
+  return success;
+}
+
+
+/*******************************************************************************
+ * Read the cache file from the output directory, if there is one.
+ */
+static void ReadCache(void)
+{
+  char path[MAX_PATH_LENGTH];
+  char line[MAX_NAME_LENGTH + 32];
+  unsigned long long hash;
+  char name[MAX_NAME_LENGTH];
+  FILE *cacheFile;
+  int allocated = 0;
+
+  snprintf(path, sizeof(path), "%s%s", s_OutputDirectory, CACHE_FILE_NAME);
+  cacheFile = fopen(path, "r");
+  if (cacheFile == NULL)
+    return;
+
+  while (fgets(line, sizeof(line), cacheFile) != NULL)
+  {
+    if (sscanf(line, "%llx %255[^\n]", &hash, name) != 2)
+      continue;
+    if (s_CacheCount >= allocated)
+    {
+      allocated = allocated * 2 + 16;
+      s_Cache = realloc(s_Cache, allocated * sizeof(CacheRecord));
+      if (s_Cache == NULL)
+      {
+        s_CacheCount = 0;
+        break;
+      }
+    }
+    s_Cache[s_CacheCount].hash = hash;
+    strcpy(s_Cache[s_CacheCount].outputName, name);
+    s_CacheCount++;
+  }
+  fclose(cacheFile);
+}
+
+
+/*******************************************************************************
+ * Write out the cache file, with all the successfully built assets.  Returns
+ * FALSE on failure, after printing why.
+ */
+static bool WriteCache(void)
+{
+  char path[MAX_PATH_LENGTH];
+  FILE *cacheFile;
+  int i;
+
+  snprintf(path, sizeof(path), "%s%s", s_OutputDirectory, CACHE_FILE_NAME);
+  cacheFile = fopen(path, "w");
+  if (cacheFile == NULL)
+    goto ErrorExit;
+  for (i = 0; i < s_JobCount; i++)
+  {
+    if (s_Jobs[i].state == STATE_BUILT || s_Jobs[i].state == STATE_CACHED)
+      fprintf(cacheFile, "%016llx %s\n", (unsigned long long) s_Jobs[i].hash,
+        s_Jobs[i].outputName);
+  }
+  if (fclose(cacheFile) == 0)
+    return true;
+
+ErrorExit:
+  fprintf(stderr, "Unable to write \"%s\": %s\n", path, strerror(errno));
+  return false;
+}
+
+
+/*******************************************************************************
+ * Work out the job's hash and see if the cache says it is already built.
+ * Returns FALSE if the input can't be read.
+ */
+static bool CheckCache(JobPointer pJob)
+{
+  char path[MAX_PATH_LENGTH];
+  int i;
+
+  pJob->hash = s_ToolsHash ^ (pJob->type + 1);
+  pJob->hash *= 0x100000001B3ULL;
+  pJob->inputSize = HashFile(pJob->inputPath, &pJob->hash);
+  if (pJob->inputSize < 0)
+  {
+    fprintf(stderr, "Unable to read \"%s\": %s\n", pJob->inputPath,
+      strerror(errno));
+    return false;
+  }
+
+  snprintf(path, sizeof(path), "%s%s", s_OutputDirectory, pJob->outputName);
+  pJob->outputSize = FileSize(path);
+  if (pJob->outputSize < 0)
+    return true;
+
+  for (i = 0; i < s_CacheCount; i++)
+  {
+    if (s_Cache[i].hash == pJob->hash &&
+    strcmp(s_Cache[i].outputName, pJob->outputName) == 0)
+    {
+      pJob->state = STATE_CACHED;
+      break;
+    }
+  }
+  return true;
+}
+
+
+/*******************************************************************************
+ * Copy a file to the output directory, keeping the name.  Returns TRUE if it
+ * worked.
+ */
+static bool CopyFile(const char *inputPath, const char *outputName)
+{
+  char outputPath[MAX_PATH_LENGTH];
+  uint8_t buffer[4096];
+  ssize_t amountRead;
+  int inputID;
+  int outputID;
+  bool success = true;
+
+  snprintf(outputPath, sizeof(outputPath), "%s%s", s_OutputDirectory,
+    outputName);
+  inputID = open(inputPath, O_RDONLY);
+  if (inputID < 0)
+    return false;
+  outputID = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (outputID < 0)
+  {
+    close(inputID);
+    return false;
+  }
+  while ((amountRead = read(inputID, buffer, sizeof(buffer))) > 0)
+  {
+    if (write(outputID, buffer, amountRead) != amountRead)
+    {
+      success = false;
+      break;
+    }
+  }
+  if (amountRead < 0)
+    success = false;
+  close(inputID);
+  if (close(outputID) != 0)
+    success = false;
+  if (!success)
+    fprintf(stderr, "Unable to copy \"%s\" to \"%s\".\n", inputPath,
+      outputPath);
+  return success;
+}
+
+
+/*******************************************************************************
+ * Run one of the tools with the given NULL terminated argument list and wait
+ * for it to finish.  Returns TRUE if it succeeded.
+ */
+static bool RunTool(const char *toolName, const char **arguments)
+{
+  char toolPath[MAX_PATH_LENGTH];
+  const char *argv[16];
+  int argc = 0;
+  int status;
+  int nullFile;
+  pid_t pid;
+
+  snprintf(toolPath, sizeof(toolPath), "%s%s", s_ToolDirectory, toolName);
+  argv[argc++] = toolPath;
+  while (*arguments != NULL && argc < 15)
+    argv[argc++] = *arguments++;
+  argv[argc] = NULL;
+
+  pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0)
+  {
+    if (!s_Verbose) /* Only show errors, the report has the sizes. */
+    {
+      nullFile = open("/dev/null", O_WRONLY);
+      if (nullFile >= 0)
+        dup2(nullFile, STDOUT_FILENO);
+    }
+    execv(toolPath, (char * const *) argv);
+    fprintf(stderr, "Unable to run \"%s\": %s\n", toolPath, strerror(errno));
+    _exit(127);
+  }
+  if (waitpid(pid, &status, 0) != pid)
+    return false;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+/*******************************************************************************
+ * Do the work for one job, in a child process.  Returns the exit code.
+ */
+static int RunJob(JobPointer pJob)
+{
+  char tempDirectory[] = "/tmp/AssetBuilderXXXXXX";
+  char tempOutput[MAX_PATH_LENGTH];
+  bool success = false;
+
+  switch (pJob->type)
+  {
+    case JOB_PACK:
+      success = RunTool("ScreenPacker", (const char *[]) {"-o",
+        s_OutputDirectory, pJob->inputPath, NULL});
+      break;
+
+    case JOB_COPY:
+      success = CopyFile(pJob->inputPath, pJob->outputName);
+      break;
+
+    case JOB_LEVEL:
+      success = RunTool("LevelCompiler", (const char *[]) {"-d",
+        pJob->dataDirectory, "-o", s_OutputDirectory, pJob->inputPath, NULL});
+      break;
+
+    case JOB_ICVGM_NSCR:
+    case JOB_ICVGM_NCHR:
+      if (mkdtemp(tempDirectory) == NULL)
+        break;
+      strcat(tempDirectory, "/");
+      success = RunTool("ICVGMConvert", (pJob->type == JOB_ICVGM_NCHR) ?
+        (const char *[]) {"-c", "-o", tempDirectory, pJob->inputPath, NULL} :
+        (const char *[]) {"-o", tempDirectory, pJob->inputPath, NULL});
+      snprintf(tempOutput, sizeof(tempOutput), "%s%s", tempDirectory,
+        pJob->outputName);
+      if (success)
+        success = RunTool("ScreenPacker", (const char *[]) {"-o",
+          s_OutputDirectory, tempOutput, NULL});
+      unlink(tempOutput);
+      rmdir(tempDirectory);
+      break;
+
+    default:
+      break;
+  }
+  return success ? 0 : 1;
+}
+
+
+/*******************************************************************************
+ * Run all the waiting jobs, up to maxRunning at a time.
+ */
+static void RunJobs(int maxRunning)
+{
+  char path[MAX_PATH_LENGTH];
+  int nextJob = 0;
+  int running = 0;
+  int status;
+  int i;
+  pid_t pid;
+
+  while (true)
+  {
+    while (running < maxRunning && nextJob < s_JobCount)
+    {
+      JobPointer pJob = s_Jobs + nextJob++;
+      if (pJob->state != STATE_WAITING)
+        continue;
+      fflush(stdout); /* Don't want the child to print our buffered output. */
+      fflush(stderr);
+      pid = fork();
+      if (pid == 0)
+        _exit(RunJob(pJob));
+      if (pid < 0)
+      {
+        fprintf(stderr, "Unable to start a process: %s\n", strerror(errno));
+        pJob->state = STATE_FAILED;
+        continue;
+      }
+      pJob->pid = pid;
+      pJob->state = STATE_RUNNING;
+      running++;
+    }
+
+    if (running == 0)
+      break;
+
+    pid = wait(&status);
+    if (pid < 0)
+      break;
+    for (i = 0; i < s_JobCount; i++)
+    {
+      JobPointer pJob = s_Jobs + i;
+      if (pJob->state != STATE_RUNNING || pJob->pid != pid)
+        continue;
+      running--;
+      snprintf(path, sizeof(path), "%s%s", s_OutputDirectory,
+        pJob->outputName);
+      pJob->outputSize = FileSize(path);
+      pJob->state = (WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+        pJob->outputSize >= 0) ? STATE_BUILT : STATE_FAILED;
+      break;
+    }
+  }
+}
+
+
+/*******************************************************************************
+ * List each asset with its size and estimated loading time, and the totals.
+ * Returns the number of failures.
+ */
+static int PrintReport(void)
+{
+  long totalInput = 0;
+  long totalOutput = 0;
+  int builtCount = 0;
+  int cachedCount = 0;
+  int failureCount = 0;
+  int i;
+
+  printf("%-24s %-8s %-6s %8s %8s %8s\n", "Asset", "Tool", "State",
+    "Input", "Output", "Load ms");
+  for (i = 0; i < s_JobCount; i++)
+  {
+    JobPointer pJob = s_Jobs + i;
+    const char *stateName;
+
+    switch (pJob->state)
+    {
+      case STATE_BUILT: stateName = "built"; builtCount++; break;
+      case STATE_CACHED: stateName = "cached"; cachedCount++; break;
+      default: stateName = "FAILED"; failureCount++; break;
+    }
+    if (pJob->state == STATE_FAILED)
+    {
+      printf("%-24s %-8s %-6s %8ld %8s %8s\n", pJob->outputName,
+        kJobTypeNames[pJob->type], stateName, pJob->inputSize, "-", "-");
+      continue;
+    }
+    printf("%-24s %-8s %-6s %8ld %8ld %8ld\n", pJob->outputName,
+      kJobTypeNames[pJob->type], stateName, pJob->inputSize,
+      pJob->outputSize, pJob->outputSize * 1000 / ADAPTER_BYTES_PER_SECOND);
+    totalInput += pJob->inputSize;
+    totalOutput += pJob->outputSize;
+  }
+  printf("%-24s %-8s %-6s %8ld %8ld %8ld\n", "Total", "", "", totalInput,
+    totalOutput, totalOutput * 1000 / ADAPTER_BYTES_PER_SECOND);
+  printf("%d assets built, %d unchanged, %d failed.\n", builtCount,
+    cachedCount, failureCount);
+  return failureCount;
+}
+
+
+int main(int argc, char **argv)
+{
+  char toolPath[MAX_PATH_LENGTH];
+  int maxRunning;
+  int option;
+  int i;
+
+  maxRunning = sysconf(_SC_NPROCESSORS_ONLN);
+  while ((option = getopt(argc, argv, "j:o:t:v")) != -1)
+  {
+    switch (option)
+    {
+      case 'j': maxRunning = atoi(optarg); break;
+      case 'o': s_OutputDirectory = optarg; break;
+      case 't': s_ToolDirectory = optarg; break;
+      case 'v': s_Verbose = true; break;
+      default: s_OutputDirectory = NULL; optind = argc; break;
+    }
+  }
+  if (s_OutputDirectory == NULL || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-j Jobs] [-t ToolDirectory/] [-v] "
+      "-o OutputDirectory/ ArtDirectory/ ...\n"
+      "  -j sets how many conversions run at once, default one per core.\n"
+      "  -t is where the compiled ICVGMConvert, ScreenPacker and "
+      "LevelCompiler are.\n"
+      "  -v shows the output of those tools.\n", argv[0]);
+    return 1;
+  }
+  if (maxRunning < 1)
+    maxRunning = 1;
+
+  /* Changing a tool means everything needs rebuilding. */
+  s_ToolsHash = 0xCBF29CE484222325ULL;
+  for (i = 0; i < TOOL_COUNT; i++)
+  {
+    snprintf(toolPath, sizeof(toolPath), "%s%s", s_ToolDirectory,
+      kToolNames[i]);
+    if (HashFile(toolPath, &s_ToolsHash) < 0)
+    {
+      fprintf(stderr, "Unable to read tool \"%s\", compile it first: %s\n",
+        toolPath, strerror(errno));
+      return 1;
+    }
+  }
+
+  for (; optind < argc; optind++)
+  {
+    if (!ScanDirectory(argv[optind]))
+      return 1;
+  }
+
+  ReadCache();
+  for (i = 0; i < s_JobCount; i++)
+  {
+    if (!CheckCache(s_Jobs + i))
+      s_Jobs[i].state = STATE_FAILED;
+  }
+
+  RunJobs(maxRunning);
+  WriteCache();
+  return PrintReport() != 0;
+}
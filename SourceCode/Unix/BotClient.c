@@ -0,0 +1,295 @@
+/******************************************************************************
+ * Nth Pong Wars, a scripted bot client for testing GameServer.c.
+ *
+ * Connects to a game room, then steers its player with a script of joystick
+ * moves, one step every 250 milliseconds.  The script is a string of:
+ * u d l r for up, down, left and right, upper case for the same with the fire
+ * button held, . for nothing and ? for a random move.  The script repeats.
+ * The joystick state is sent every 50 milliseconds, like a human fiddling
+ * with the stick, and the server's messages are counted so you can see how
+ * much bandwidth a room uses.
+ *
+ * Run a few of them at once to load up a server:
+ *   for i in 1 2 3 ; do ./BotClient localhost 7100 30 '?' & done
+ *
+ * AGMS20261018 - Start this test tool.
+ *
+ * Compile with: gcc -g -O2 -Wall -o BotClient BotClient.c
+ * Run with: ./BotClient [Host [Port [Seconds [Script]]]]
+ * Defaults are localhost, 7100, 10, "rrddllUU".
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Joystick bits, same as joystick_enum in Common/players.h. */
+#define JOY_LEFT 1
+#define JOY_DOWN 2
+#define JOY_RIGHT 4
+#define JOY_UP 8
+#define JOY_BUTTON 16
+
+#define RECEIVE_BUFFER_SIZE 65536
+
+static uint8_t s_Received[RECEIVE_BUFFER_SIZE];
+static size_t s_ReceivedLength = 0;
+
+/* Statistics about what the server sent. */
+static uint64_t s_TotalBytes = 0;
+static uint32_t s_TileMessages = 0;
+static uint32_t s_TilesChanged = 0;
+static uint32_t s_PlayerMessages = 0;
+static uint32_t s_LevelMessages = 0;
+static int s_PlayerIndex = -1;
+static uint16_t s_LastFrame = 0;
+
+
+/*******************************************************************************
+ * Current time in milliseconds, from a clock that doesn't jump.
+ */
+static int64_t NowMs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/*******************************************************************************
+ * Connect to the server with TCP.  Returns -1 on failure, after printing why.
+ */
+static int ConnectToServer(const char *hostName, const char *portName)
+{
+  struct addrinfo hints;
+  struct addrinfo *pResults;
+  struct addrinfo *pAddress;
+  int sock = -1;
+  int errorCode;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  errorCode = getaddrinfo(hostName, portName, &hints, &pResults);
+  if (errorCode != 0)
+  {
+    fprintf(stderr, "Unable to find %s: %s\n", hostName,
+      gai_strerror(errorCode));
+    return -1;
+  }
+
+  for (pAddress = pResults; pAddress != NULL; pAddress = pAddress->ai_next)
+  {
+    sock = socket(pAddress->ai_family, pAddress->ai_socktype,
+      pAddress->ai_protocol);
+    if (sock < 0)
+      continue;
+    if (connect(sock, pAddress->ai_addr, pAddress->ai_addrlen) == 0)
+      break;
+    close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(pResults);
+
+  if (sock < 0)
+    fprintf(stderr, "Unable to connect to %s port %s.\n", hostName, portName);
+  return sock;
+}
+
+
+/*******************************************************************************
+ * Convert a script character into joystick bits.
+ */
+static uint8_t ScriptToJoystick(char letter)
+{
+  static const char kRandomMoves[] = "udlrUDLR.";
+
+  if (letter == '?')
+    letter = kRandomMoves[rand() % (sizeof(kRandomMoves) - 1)];
+
+  switch (letter)
+  {
+    case 'u': return JOY_UP;
+    case 'd': return JOY_DOWN;
+    case 'l': return JOY_LEFT;
+    case 'r': return JOY_RIGHT;
+    case 'U': return JOY_UP | JOY_BUTTON;
+    case 'D': return JOY_DOWN | JOY_BUTTON;
+    case 'L': return JOY_LEFT | JOY_BUTTON;
+    case 'R': return JOY_RIGHT | JOY_BUTTON;
+    default: return 0;
+  }
+}
+
+
+/*******************************************************************************
+ * Pick apart the complete messages in the receive buffer, leaving any partial
+ * one at the start of the buffer for next time.  Returns FALSE if the data
+ * doesn't make sense.
+ */
+static bool ParseMessages(void)
+{
+  size_t offset = 0;
+
+  while (offset < s_ReceivedLength)
+  {
+    uint8_t *pData = s_Received + offset;
+    size_t available = s_ReceivedLength - offset;
+    size_t needed;
+
+    switch (pData[0])
+    {
+      case 'W':
+        needed = 4;
+        if (available < needed)
+          goto NeedMoreData;
+        s_PlayerIndex = (pData[1] == 255) ? -1 : pData[1];
+        printf("Welcome, player %d on a %d by %d board.\n", s_PlayerIndex,
+          pData[2], pData[3]);
+        break;
+
+      case 'L':
+        if (available < 2)
+          goto NeedMoreData;
+        needed = 2 + pData[1];
+        if (available < needed)
+          goto NeedMoreData;
+        printf("Level %.*s started.\n", pData[1], pData + 2);
+        s_LevelMessages++;
+        break;
+
+      case 'T':
+        if (available < 3)
+          goto NeedMoreData;
+        needed = 3 + 4 * (pData[1] + 256 * pData[2]);
+        if (available < needed)
+          goto NeedMoreData;
+        s_TileMessages++;
+        s_TilesChanged += pData[1] + 256 * pData[2];
+        break;
+
+      case 'P':
+        if (available < 2)
+          goto NeedMoreData;
+        needed = 6 + 8 * pData[1];
+        if (available < needed)
+          goto NeedMoreData;
+        s_PlayerMessages++;
+        s_LastFrame = pData[2] + 256 * pData[3];
+        break;
+
+      default:
+        fprintf(stderr, "Unknown message type %d from server.\n", pData[0]);
+        return false;
+    }
+    offset += needed;
+  }
+
+NeedMoreData:
+  memmove(s_Received, s_Received + offset, s_ReceivedLength - offset);
+  s_ReceivedLength -= offset;
+  return true;
+}
+
+
+int main(int argc, const char **argv)
+{
+  const char *hostName = (argc > 1) ? argv[1] : "localhost";
+  const char *portName = (argc > 2) ? argv[2] : "7100";
+  int seconds = (argc > 3) ? atoi(argv[3]) : 10;
+  const char *script = (argc > 4) ? argv[4] : "rrddllUU";
+  size_t scriptLength = strlen(script);
+  size_t scriptIndex = 0;
+  int64_t startMs, endMs, nextStepMs, nextSendMs, nowMs;
+  uint8_t joystick = 0;
+  struct pollfd pollEntry;
+  int sock;
+
+  if (scriptLength == 0)
+    script = ".", scriptLength = 1;
+  srand(time(NULL) ^ getpid());
+
+  sock = ConnectToServer(hostName, portName);
+  if (sock < 0)
+    return 1;
+
+  startMs = NowMs();
+  endMs = startMs + seconds * 1000;
+  nextStepMs = startMs;
+  nextSendMs = startMs;
+
+  while ((nowMs = NowMs()) < endMs)
+  {
+    if (nowMs >= nextStepMs)
+    {
+      joystick = ScriptToJoystick(script[scriptIndex]);
+      scriptIndex = (scriptIndex + 1) % scriptLength;
+      nextStepMs += 250;
+    }
+    if (nowMs >= nextSendMs)
+    {
+      if (send(sock, &joystick, 1, MSG_NOSIGNAL) != 1)
+      {
+        fprintf(stderr, "Server hung up.\n");
+        break;
+      }
+      nextSendMs += 50;
+    }
+
+    pollEntry.fd = sock;
+    pollEntry.events = POLLIN;
+    pollEntry.revents = 0;
+    nowMs = NowMs();
+    if (poll(&pollEntry, 1, (int) ((nextSendMs > nowMs) ?
+    nextSendMs - nowMs : 0)) <= 0)
+      continue;
+
+    ssize_t amountRead = recv(sock, s_Received + s_ReceivedLength,
+      sizeof(s_Received) - s_ReceivedLength, 0);
+    if (amountRead <= 0)
+    {
+      if (amountRead < 0 && errno == EINTR)
+        continue;
+      fprintf(stderr, "Server hung up.\n");
+      break;
+    }
+    s_ReceivedLength += amountRead;
+    s_TotalBytes += amountRead;
+    if (!ParseMessages())
+      break;
+  }
+
+  close(sock);
+
+  nowMs = NowMs();
+  if (nowMs <= startMs)
+    nowMs = startMs + 1;
+  printf("Player %d got %llu bytes in %.1f seconds, %.0f bytes per second.\n"
+    "%u player updates (last frame %u), %u tile updates with %u tiles, "
+    "%u levels.\n", s_PlayerIndex, (unsigned long long) s_TotalBytes,
+    (nowMs - startMs) / 1000.0, s_TotalBytes * 1000.0 / (nowMs - startMs),
+    s_PlayerMessages, s_LastFrame, s_TileMessages, s_TilesChanged,
+    s_LevelMessages);
+  return 0;
+}
@@ -0,0 +1,352 @@
+/******************************************************************************
+ * Nth Pong Wars, combines level, screen and music files into a bundle file.
+ *
+ * Each file opened through the NABU Internet Adapter costs a round trip or
+ * two before any data arrives, and a level transition usually opens several
+ * (the next LEVEL file, a screen or two, some music).  This writes them all
+ * into one .BUNDLE file, in the format described in Common/soundscreen.h, so
+ * the game opens that once (with the Bundle keyword in a level file) and then
+ * reads the members out of it.  The files are stored as they are, so pack
+ * screens with ScreenPacker.c first if you want them smaller.
+ * Member names are the upper case file names without the directory, same as
+ * the game asks for them.  Afterwards each member is read back through the
+ * game's own bundle code (soundscreen.c, included directly) and compared with
+ * the original file.
+ *
+ * AGMS20261018 - Start the bundle maker.
+ *
+ * Compile with: gcc -g -O2 -Wall -o BundleMaker BundleMaker.c
+ * Run with: ./BundleMaker -o OutputDirectory/NAME.BUNDLE File.LEVEL ...
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code, for the bundle reading functions. */
+#include "../Common/cverify.h"
+#include "../Common/fixed_point.c"
+#include "../Common/debug_print.c"
+#include "../Common/tiles.c"
+#include "../Common/players.c"
+#include "../Common/simulate.c"
+#include "../Common/scores.c"
+#include "../Common/soundscreen.c"
+#include "../Common/levels.c"
+
+/* Biggest member is a .NFUL screen, 12K, allow a bit extra. */
+#define MAX_MEMBER_SIZE 16384
+
+static struct MemberFileStruct {
+  const char *path;
+  char name[BUNDLE_NAME_LENGTH];
+  uint32_t size;
+} s_Members[BUNDLE_MAX_MEMBERS];
+static int s_MemberCount;
+
+static uint8_t s_Index[TEMPBUFFER_LEN];
+static size_t s_IndexLength;
+static uint8_t s_Data[MAX_MEMBER_SIZE];
+static uint8_t s_ReadBack[MAX_MEMBER_SIZE];
+
+
+/*******************************************************************************
+ * Append a 32 bit little endian number to the index.
+ */
+static void PutIndexUInt32(uint32_t number)
+{
+  s_Index[s_IndexLength++] = number;
+  s_Index[s_IndexLength++] = number >> 8;
+  s_Index[s_IndexLength++] = number >> 16;
+  s_Index[s_IndexLength++] = number >> 24;
+}
+
+
+/*******************************************************************************
+ * Read a whole member file into s_Data.  Returns its size, or -1 on failure
+ * after printing why.
+ */
+static long ReadMemberFile(const char *inputPath)
+{
+  FILE *inputFile;
+  size_t inputLength;
+
+  inputFile = fopen(inputPath, "rb");
+  if (inputFile == NULL)
+  {
+    fprintf(stderr, "Unable to open \"%s\": %s\n", inputPath, strerror(errno));
+    return -1;
+  }
+  inputLength = fread(s_Data, 1, sizeof(s_Data), inputFile);
+  fclose(inputFile);
+  if (inputLength >= sizeof(s_Data))
+  {
+    fprintf(stderr, "\"%s\" is too big to go in a bundle.\n", inputPath);
+    return -1;
+  }
+  return inputLength;
+}
+
+
+/*******************************************************************************
+ * Work out the member names and sizes, and build the index.  Returns FALSE on
+ * failure, after printing why.
+ */
+static bool BuildIndex(void)
+{
+  struct MemberFileStruct *pMember;
+  const char *baseName;
+  char *pChar;
+  uint32_t offset;
+  long size;
+  int i;
+  int j;
+
+  for (i = 0, pMember = s_Members; i < s_MemberCount; i++, pMember++)
+  {
+    baseName = strrchr(pMember->path, '/');
+    baseName = (baseName == NULL) ? pMember->path : baseName + 1;
+    if (strlen(baseName) >= BUNDLE_NAME_LENGTH)
+    {
+      fprintf(stderr, "\"%s\" has a name longer than %d letters.\n",
+        pMember->path, BUNDLE_NAME_LENGTH - 1);
+      return false;
+    }
+    strcpy(pMember->name, baseName);
+    for (pChar = pMember->name; *pChar != NUL; pChar++)
+      *pChar = toupper(*pChar);
+    for (j = 0; j < i; j++)
+    {
+      if (strcmp(pMember->name, s_Members[j].name) == 0)
+      {
+        fprintf(stderr, "\"%s\" is in the bundle twice.\n", pMember->name);
+        return false;
+      }
+    }
+
+    size = ReadMemberFile(pMember->path);
+    if (size < 0)
+      return false;
+    pMember->size = size;
+  }
+
+  /* Index size is known now, so the member offsets can be filled in. */
+
+  s_IndexLength = BUNDLE_MAGIC_LENGTH + 1;
+  for (i = 0; i < s_MemberCount; i++)
+    s_IndexLength += 1 + strlen(s_Members[i].name) + 8;
+  if (s_IndexLength > sizeof(s_Index))
+  {
+    fprintf(stderr, "Index is %d bytes, more than the %d that fit in "
+      "g_TempBuffer.  Use fewer or shorter named files.\n",
+      (int) s_IndexLength, (int) sizeof(s_Index));
+    return false;
+  }
+  offset = s_IndexLength;
+
+  memcpy(s_Index, kBundleMagic, BUNDLE_MAGIC_LENGTH);
+  s_IndexLength = BUNDLE_MAGIC_LENGTH;
+  s_Index[s_IndexLength++] = s_MemberCount;
+  for (i = 0, pMember = s_Members; i < s_MemberCount; i++, pMember++)
+  {
+    s_Index[s_IndexLength++] = strlen(pMember->name);
+    memcpy(s_Index + s_IndexLength, pMember->name, strlen(pMember->name));
+    s_IndexLength += strlen(pMember->name);
+    PutIndexUInt32(offset);
+    PutIndexUInt32(pMember->size);
+    offset += pMember->size;
+  }
+  return true;
+}
+
+
+/*******************************************************************************
+ * Write the index and all the members to the bundle file.  Returns FALSE on
+ * failure, after printing why.
+ */
+static bool WriteBundle(const char *outputPath)
+{
+  FILE *outputFile;
+  long size;
+  int i;
+
+  outputFile = fopen(outputPath, "wb");
+  if (outputFile == NULL ||
+  fwrite(s_Index, 1, s_IndexLength, outputFile) != s_IndexLength)
+    goto WriteError;
+
+  for (i = 0; i < s_MemberCount; i++)
+  {
+    size = ReadMemberFile(s_Members[i].path);
+    if (size != s_Members[i].size)
+    {
+      fprintf(stderr, "\"%s\" changed while making the bundle.\n",
+        s_Members[i].path);
+      fclose(outputFile);
+      return false;
+    }
+    if (fwrite(s_Data, 1, size, outputFile) != size)
+      goto WriteError;
+  }
+
+  if (fclose(outputFile) != 0)
+  {
+    outputFile = NULL;
+    goto WriteError;
+  }
+  return true;
+
+WriteError:
+  fprintf(stderr, "Unable to write \"%s\": %s\n", outputPath,
+    strerror(errno));
+  if (outputFile != NULL)
+    fclose(outputFile);
+  return false;
+}
+
+
+/*******************************************************************************
+ * Open the bundle with the game's code and read back every member, comparing
+ * it with the original file.  Returns FALSE if something doesn't match, after
+ * printing why.
+ */
+static bool VerifyBundle(const char *outputPath)
+{
+  char directory[1024];
+  char bundleName[BUNDLE_NAME_LENGTH];
+  const char *baseName;
+  char *pDot;
+  FileHandleType fileID;
+  int32_t fileSize;
+  size_t readLength;
+  uint16_t amountRead;
+  int i;
+
+  /* Split the output path into the directory for OpenDataFile() to look in
+     and the bundle name without the extension. */
+
+  baseName = strrchr(outputPath, '/');
+  baseName = (baseName == NULL) ? outputPath : baseName + 1;
+  snprintf(directory, sizeof(directory), "%.*s", (int) (baseName - outputPath),
+    outputPath);
+  snprintf(bundleName, sizeof(bundleName), "%s", baseName);
+  pDot = strrchr(bundleName, '.');
+  if (pDot == NULL || strcasecmp(pDot, ".BUNDLE") != 0)
+  {
+    fprintf(stderr, "Output \"%s\" needs to end with .BUNDLE so the game can "
+      "find it.\n", outputPath);
+    return false;
+  }
+  *pDot = NUL;
+  g_HostDataPath = directory;
+
+  if (!OpenBundle(bundleName))
+  {
+    fprintf(stderr, "Game can't open bundle \"%s\".\n", outputPath);
+    return false;
+  }
+
+  for (i = 0; i < s_MemberCount; i++)
+  {
+    if (ReadMemberFile(s_Members[i].path) != s_Members[i].size)
+      goto VerifyError;
+    fileSize = -1;
+    fileID = OpenDataFile(s_Members[i].name, NULL, &fileSize);
+    if (fileID < BUNDLE_HANDLE_FIRST)
+    { /* Not found, or opened the original file rather than the member. */
+      CloseDataFile(fileID);
+      goto VerifyError;
+    }
+    readLength = 0;
+    do {
+      /* Odd sized reads to check the position gets tracked across reads. */
+      amountRead = ReadDataFile(fileID, s_ReadBack + readLength,
+        (sizeof(s_ReadBack) - readLength < 251) ?
+        sizeof(s_ReadBack) - readLength : 251);
+      readLength += amountRead;
+    } while (amountRead != 0 && readLength < sizeof(s_ReadBack));
+    CloseDataFile(fileID);
+    if (fileSize != s_Members[i].size || readLength != s_Members[i].size ||
+    memcmp(s_ReadBack, s_Data, readLength) != 0)
+      goto VerifyError;
+  }
+  CloseBundle();
+  return true;
+
+VerifyError:
+  fprintf(stderr, "Member \"%s\" doesn't read back the same as \"%s\".\n",
+    s_Members[i].name, s_Members[i].path);
+  CloseBundle();
+  return false;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *outputPath = NULL;
+  int option;
+  uint32_t totalSize = 0;
+  int i;
+
+  while ((option = getopt(argc, argv, "o:")) != -1)
+  {
+    switch (option)
+    {
+      case 'o': outputPath = optarg; break;
+      default: outputPath = NULL; optind = argc; break;
+    }
+  }
+  if (outputPath == NULL || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s -o OutputDirectory/NAME.BUNDLE "
+      "File.LEVEL File.NSCR File.CHIPNSFX ...\n", argv[0]);
+    return 1;
+  }
+  if (argc - optind > BUNDLE_MAX_MEMBERS)
+  {
+    fprintf(stderr, "Too many files, a bundle holds at most %d.\n",
+      BUNDLE_MAX_MEMBERS);
+    return 1;
+  }
+
+  for (s_MemberCount = 0; optind < argc; optind++)
+    s_Members[s_MemberCount++].path = argv[optind];
+
+  if (!BuildIndex() || !WriteBundle(outputPath) || !VerifyBundle(outputPath))
+    return 1;
+
+  for (i = 0; i < s_MemberCount; i++)
+  {
+    printf("  %-*s %6d bytes\n", BUNDLE_NAME_LENGTH, s_Members[i].name,
+      (int) s_Members[i].size);
+    totalSize += s_Members[i].size;
+  }
+  printf("Bundled %d files into %s, %d bytes of data plus %d bytes of index.\n",
+    s_MemberCount, outputPath, (int) totalSize, (int) s_IndexLength);
+  return 0;
+}
@@ -0,0 +1,646 @@
+/******************************************************************************
+ * Nth Pong Wars, a headless authoritative game server for Linux.
+ *
+ * Runs the same game code as the NABU (SourceCode/Common, included directly
+ * like Nabu/main.c does), at a fixed tick rate, with no screen or sound.
+ * Clients connect over TCP and send their joystick bits, one byte per change
+ * (see joystick_enum: Left=1, Down=2, Right=4, Up=8, Button=16).  They get
+ * assigned a player slot (taking over an AI player if needed), and receive
+ * messages about the game state each tick:
+ *
+ * 'W' Welcome: 'W', player index (255 if no free slot, a spectator), board
+ *     width in tiles, board height in tiles.  4 bytes.
+ * 'L' Level loaded: 'L', name length, name bytes.  Followed by a 'T' message
+ *     with all tiles, since the board has changed.
+ * 'T' Tiles changed: 'T', count (16 bits), then count times: column, row,
+ *     owner, age.  Only tiles which changed since the last tick are sent.
+ * 'P' Players: 'P', player count, frame number (16 bits), score goal (16
+ *     bits), then for each player: brain, X and Y pixel coordinates (16 bits
+ *     signed each), flying height, score (16 bits).  8 bytes per player.
+ *
+ * All 16 bit numbers are little endian.
+ *
+ * The game code keeps all its state in global variables (it was written for a
+ * 64K Z80 where that's the efficient way), so each game room is a separate
+ * forked process rather than a thread, giving each room its own copy of the
+ * globals.  Room N listens on port BasePort + N.
+ *
+ * AGMS20261018 - Start the server.
+ *
+ * Compile with: gcc -g -O2 -Wall -o GameServer GameServer.c
+ * Run with: ./GameServer [-p BasePort] [-r Rooms] [-t TicksPerSecond]
+ *   [-d DataDirectory/] [-l FirstLevel]
+ * Defaults are port 7100, 1 room, 20 ticks, ../Nabu/Art/ and TITLE.  Then try
+ * some bots, see BotClient.c.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code. */
+#include "../Common/cverify.h"
+#include "../Common/fixed_point.c"
+#include "../Common/debug_print.c"
+#include "../Common/tiles.c"
+#include "../Common/players.c"
+#include "../Common/simulate.c"
+#include "../Common/scores.c"
+#include "../Common/soundscreen.c"
+#include "../Common/levels.c"
+#include "../Common/rollback.c"
+
+
+/*******************************************************************************
+ * Constants, types and globals.
+ */
+
+#define MAX_CLIENTS 16 /* Players and spectators. */
+#define MAX_SERVER_TILES 16384 /* Up to 128x128 boards. */
+#define MAX_MESSAGE_SIZE (3 + 4 * 1024) /* Tile messages are split up. */
+#define ROOM_SETUP_FAILED 3 /* Exit status of a room which couldn't start. */
+
+typedef struct client_struct {
+  int socket; /* -1 if this slot is unused. */
+  uint8_t player_index; /* MAX_PLAYERS if a spectator. */
+  player_brain previous_brain; /* What ran the player before this client. */
+  bool needs_full_update; /* Send all tiles next tick. */
+} client_record, *client_pointer;
+
+static client_record s_Clients[MAX_CLIENTS];
+static int s_ListenSocket = -1;
+static uint8_t s_Message[MAX_MESSAGE_SIZE];
+
+static const char *s_FirstLevelName = "TITLE";
+static int s_TicksPerSecond = FIXED_TICKS_PER_SECOND;
+
+
+/*******************************************************************************
+ * Current time in nanoseconds, from a clock that doesn't jump.
+ */
+static int64_t NowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Send a message to one client.  Disconnects them if the send fails, which
+ * includes them not keeping up and filling their socket buffer.
+ */
+static void DisconnectClient(client_pointer pClient);
+
+static void SendToClient(client_pointer pClient, const uint8_t *pData,
+  size_t length)
+{
+  if (pClient->socket < 0)
+    return;
+  if (send(pClient->socket, pData, length, MSG_NOSIGNAL | MSG_DONTWAIT) !=
+  (ssize_t) length)
+    DisconnectClient(pClient);
+}
+
+
+/*******************************************************************************
+ * Remove a client, and give their player back to whatever ran it before they
+ * took it over, an AI or nobody.
+ */
+static void DisconnectClient(client_pointer pClient)
+{
+  if (pClient->socket < 0)
+    return;
+  close(pClient->socket);
+  pClient->socket = -1;
+
+  if (pClient->player_index < MAX_PLAYERS)
+  {
+    player_pointer pPlayer = g_player_array + pClient->player_index;
+    if (pClient->previous_brain == (player_brain) BRAIN_ALGORITHM)
+      ReinitialisePlayer(pPlayer); /* AI starts fresh from where it is. */
+    pPlayer->brain = pClient->previous_brain;
+    pPlayer->joystick_inputs = 0;
+    DebugPrintPlayerAssignment(pPlayer);
+  }
+  pClient->player_index = MAX_PLAYERS;
+}
+
+
+/*******************************************************************************
+ * Accept a new client and assign them an inactive player, or one being run by
+ * an AI.  If none are available, they just watch.
+ */
+static void AcceptClient(void)
+{
+  client_pointer pClient = NULL;
+  player_pointer pPlayer;
+  uint8_t iClient;
+  uint8_t iPlayer;
+  int newSocket;
+  int flag = 1;
+
+  newSocket = accept(s_ListenSocket, NULL, NULL);
+  if (newSocket < 0)
+    return;
+
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+  {
+    if (s_Clients[iClient].socket < 0)
+    {
+      pClient = s_Clients + iClient;
+      break;
+    }
+  }
+  if (pClient == NULL)
+  {
+    close(newSocket); /* Server is full. */
+    return;
+  }
+
+  setsockopt(newSocket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  fcntl(newSocket, F_SETFL, fcntl(newSocket, F_GETFL) | O_NONBLOCK);
+  pClient->socket = newSocket;
+  pClient->player_index = MAX_PLAYERS;
+  pClient->needs_full_update = true;
+
+  for (iPlayer = 0, pPlayer = g_player_array; iPlayer < MAX_PLAYERS;
+  iPlayer++, pPlayer++)
+  {
+    if (pPlayer->brain == (player_brain) BRAIN_INACTIVE)
+      break;
+  }
+  if (iPlayer >= MAX_PLAYERS)
+  {
+    for (iPlayer = 0, pPlayer = g_player_array; iPlayer < MAX_PLAYERS;
+    iPlayer++, pPlayer++)
+    {
+      if (pPlayer->brain == (player_brain) BRAIN_ALGORITHM)
+        break;
+    }
+  }
+  if (iPlayer < MAX_PLAYERS)
+  {
+    ReinitialisePlayer(pPlayer);
+    pClient->previous_brain = pPlayer->brain;
+    pPlayer->brain = (player_brain) BRAIN_NETWORK;
+    pPlayer->win_count = 0;
+    pClient->player_index = iPlayer;
+    DebugPrintPlayerAssignment(pPlayer);
+  }
+
+  s_Message[0] = 'W';
+  s_Message[1] = (pClient->player_index < MAX_PLAYERS) ?
+    pClient->player_index : 255;
+  s_Message[2] = g_play_area_width_tiles;
+  s_Message[3] = g_play_area_height_tiles;
+  SendToClient(pClient, s_Message, 4);
+}
+
+
+/*******************************************************************************
+ * Read joystick bytes from a client.  Only the latest one matters.
+ */
+static void ReadFromClient(client_pointer pClient)
+{
+  uint8_t buffer[64];
+  ssize_t amountRead;
+
+  amountRead = recv(pClient->socket, buffer, sizeof(buffer), 0);
+  if (amountRead == 0 || (amountRead < 0 && errno != EAGAIN &&
+  errno != EWOULDBLOCK && errno != EINTR))
+  {
+    DisconnectClient(pClient);
+    return;
+  }
+  if (amountRead > 0 && pClient->player_index < MAX_PLAYERS)
+  {
+    player_pointer pPlayer = g_player_array + pClient->player_index;
+    if (pPlayer->brain == (player_brain) BRAIN_NETWORK)
+      pPlayer->joystick_inputs = buffer[amountRead - 1] & 0x1F;
+  }
+}
+
+
+/*******************************************************************************
+ * Wait for network activity until the given time, handling it as it comes in.
+ */
+static void ServiceNetworkUntil(int64_t deadlineNs)
+{
+  struct pollfd pollList[MAX_CLIENTS + 1];
+  client_pointer pollClients[MAX_CLIENTS + 1];
+  int pollCount;
+  int iPoll;
+  uint8_t iClient;
+  int64_t nowNs;
+
+  while ((nowNs = NowNs()) < deadlineNs)
+  {
+    pollCount = 0;
+    pollList[pollCount].fd = s_ListenSocket;
+    pollList[pollCount].events = POLLIN;
+    pollClients[pollCount++] = NULL;
+    for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+    {
+      if (s_Clients[iClient].socket < 0)
+        continue;
+      pollList[pollCount].fd = s_Clients[iClient].socket;
+      pollList[pollCount].events = POLLIN;
+      pollClients[pollCount++] = s_Clients + iClient;
+    }
+
+    if (poll(pollList, pollCount,
+    (int) ((deadlineNs - nowNs + 999999) / 1000000)) <= 0)
+      continue;
+
+    for (iPoll = 0; iPoll < pollCount; iPoll++)
+    {
+      if (!(pollList[iPoll].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      if (pollClients[iPoll] == NULL)
+        AcceptClient();
+      else
+        ReadFromClient(pollClients[iPoll]);
+    }
+  }
+}
+
+
+/*******************************************************************************
+ * Send one tile to the clients, batching them up into a 'T' message.  Call
+ * with NULL to flush the batch.
+ */
+static void SendTileToClients(tile_pointer pTile, bool fullUpdateOnly)
+{
+  static uint16_t sTileCount = 0;
+  uint8_t iClient;
+  size_t length;
+  uint8_t *pData;
+
+  if (pTile != NULL)
+  {
+    uint16_t tileIndex = pTile - g_tile_array;
+    pData = s_Message + 3 + 4 * sTileCount;
+    pData[0] = tileIndex % g_play_area_width_tiles;
+    pData[1] = tileIndex / g_play_area_width_tiles;
+    pData[2] = pTile->owner;
+    pData[3] = pTile->age;
+    sTileCount++;
+    if (3 + 4 * (sTileCount + 1) <= MAX_MESSAGE_SIZE)
+      return; /* Still room in the batch. */
+  }
+
+  if (sTileCount == 0)
+    return;
+
+  s_Message[0] = 'T';
+  s_Message[1] = sTileCount & 0xFF;
+  s_Message[2] = sTileCount >> 8;
+  length = 3 + 4 * sTileCount;
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+  {
+    client_pointer pClient = s_Clients + iClient;
+    if (pClient->socket < 0)
+      continue;
+    if (pClient->needs_full_update == fullUpdateOnly)
+      SendToClient(pClient, s_Message, length);
+  }
+  sTileCount = 0;
+}
+
+
+/*******************************************************************************
+ * Send the changed tiles and the player positions to all clients.  New
+ * clients and everybody after a level change get all the tiles.
+ */
+static void BroadcastGameState(void)
+{
+  tile_pointer pTile;
+  player_pointer pPlayer;
+  uint8_t iClient;
+  uint8_t iPlayer;
+  uint8_t *pData;
+  bool anyFullUpdates = false;
+
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+  {
+    if (s_Clients[iClient].socket >= 0 && s_Clients[iClient].needs_full_update)
+      anyFullUpdates = true;
+  }
+
+  /* Changed tiles for clients which are up to date, all tiles for new ones. */
+
+  for (pTile = g_tile_array; pTile != g_play_area_end_tile; pTile++)
+  {
+    if (pTile->dirty_remote)
+    {
+      pTile->dirty_remote = false;
+      SendTileToClients(pTile, false);
+    }
+  }
+  SendTileToClients(NULL, false);
+
+  if (anyFullUpdates)
+  {
+    for (pTile = g_tile_array; pTile != g_play_area_end_tile; pTile++)
+      SendTileToClients(pTile, true);
+    SendTileToClients(NULL, true);
+    for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+      s_Clients[iClient].needs_full_update = false;
+  }
+
+  /* Player positions, everybody gets them every tick. */
+
+  s_Message[0] = 'P';
+  s_Message[1] = MAX_PLAYERS;
+  s_Message[2] = g_FrameCounter & 0xFF;
+  s_Message[3] = g_FrameCounter >> 8;
+  s_Message[4] = g_ScoreGoal & 0xFF;
+  s_Message[5] = g_ScoreGoal >> 8;
+  pData = s_Message + 6;
+  for (iPlayer = 0, pPlayer = g_player_array; iPlayer < MAX_PLAYERS;
+  iPlayer++, pPlayer++, pData += 8)
+  {
+    int16_t x = GET_FX_INTEGER(pPlayer->pixel_center_x);
+    int16_t y = GET_FX_INTEGER(pPlayer->pixel_center_y);
+    uint16_t score = GetPlayerScore(iPlayer);
+    pData[0] = pPlayer->brain;
+    pData[1] = x & 0xFF;
+    pData[2] = (uint16_t) x >> 8;
+    pData[3] = y & 0xFF;
+    pData[4] = (uint16_t) y >> 8;
+    pData[5] = pPlayer->pixel_flying_height;
+    pData[6] = score & 0xFF;
+    pData[7] = score >> 8;
+  }
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+    SendToClient(s_Clients + iClient, s_Message, pData - s_Message);
+}
+
+
+/*******************************************************************************
+ * Tell everybody a new level has started, they'll need all the tiles.
+ */
+static void BroadcastLevelChange(void)
+{
+  uint8_t iClient;
+  uint8_t nameLength = strlen(gLevelName);
+
+  s_Message[0] = 'L';
+  s_Message[1] = nameLength;
+  memcpy(s_Message + 2, gLevelName, nameLength);
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+  {
+    SendToClient(s_Clients + iClient, s_Message, 2 + nameLength);
+    s_Clients[iClient].needs_full_update = true;
+  }
+}
+
+
+/*******************************************************************************
+ * Keep network players attached to their player slots across level changes,
+ * since loading a level may change the player brains.
+ */
+static void ReattachNetworkPlayers(void)
+{
+  uint8_t iClient;
+
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+  {
+    client_pointer pClient = s_Clients + iClient;
+    if (pClient->socket >= 0 && pClient->player_index < MAX_PLAYERS)
+      g_player_array[pClient->player_index].brain =
+        (player_brain) BRAIN_NETWORK;
+  }
+}
+
+
+/*******************************************************************************
+ * Run one game room, forever.  Same game loop as the NABU, minus the drawing,
+ * and paced by the clock rather than the video frame interrupt.
+ */
+static int RunRoom(uint16_t port)
+{
+  struct sockaddr_in address;
+  uint8_t iClient;
+  int64_t tickNs = 1000000000 / s_TicksPerSecond;
+  int64_t nextTickNs;
+  int flag = 1;
+
+  for (iClient = 0; iClient < MAX_CLIENTS; iClient++)
+  {
+    s_Clients[iClient].socket = -1;
+    s_Clients[iClient].player_index = MAX_PLAYERS;
+  }
+
+  s_ListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(s_ListenSocket, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(s_ListenSocket, (struct sockaddr *) &address, sizeof(address)) != 0
+  || listen(s_ListenSocket, 8) != 0)
+  {
+    fprintf(stderr, "Room on port %d unable to listen: %s\n", port,
+      strerror(errno));
+    return ROOM_SETUP_FAILED;
+  }
+
+  g_tile_array = malloc(MAX_SERVER_TILES * sizeof(tile_record));
+  gTileArraySize = MAX_SERVER_TILES;
+  g_play_area_height_tiles = 23;
+  g_play_area_width_tiles = 32;
+  if (g_tile_array == NULL || !InitTileArray())
+  {
+    fprintf(stderr, "Failed to set up play area tiles.\n");
+    return ROOM_SETUP_FAILED;
+  }
+  InitialisePlayers();
+
+  strcpy(gLevelName, s_FirstLevelName);
+  nextTickNs = NowNs();
+
+  while (true) /* Restart at the first level if the levels say Quit. */
+  {
+    if (!LoadLevelFile())
+    {
+      strcpy(gLevelName, s_FirstLevelName);
+      ServiceNetworkUntil(NowNs() + 1000000000); /* Don't spin on errors. */
+      continue;
+    }
+    ReattachNetworkPlayers();
+    RollbackReset();
+    BroadcastLevelChange();
+
+    while (true)
+    {
+      ServiceNetworkUntil(nextTickNs);
+      nextTickNs += tickNs;
+      if (NowNs() > nextTickNs + tickNs * 10)
+        nextTickNs = NowNs(); /* Fell way behind, don't try to catch up. */
+
+      UpdatePlayerInputs();
+      if (gVictoryModeHighestTileCount)
+      {
+        Simulate();
+        if ((g_FrameCounter & 0x3F) == 0)
+          AddNextPowerUpTile();
+        UpdateScores();
+      }
+      g_ScoreFramesPerUpdate = 1;
+
+      BroadcastGameState();
+
+      if (VictoryConditionTest())
+        break;
+
+      g_FrameCounter++;
+      if ((g_FrameCounter & 0x1F) == 0)
+      {
+        if (g_ScoreGoal-- == 0)
+          g_ScoreGoal = 5;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  int basePort = 7100;
+  int numberOfRooms = 1;
+  int iRoom;
+  int option;
+  int roomStatus;
+  bool forkFailed;
+  pid_t *roomPids;
+  pid_t deadPid;
+
+  g_HostDataPath = "../Nabu/Art/";
+
+  while ((option = getopt(argc, argv, "p:r:t:d:l:")) != -1)
+  {
+    switch (option)
+    {
+      case 'p': basePort = atoi(optarg); break;
+      case 'r': numberOfRooms = atoi(optarg); break;
+      case 't': s_TicksPerSecond = atoi(optarg); break;
+      case 'd': g_HostDataPath = optarg; break;
+      case 'l': s_FirstLevelName = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-p BasePort] [-r Rooms] "
+          "[-t TicksPerSecond] [-d DataDirectory/] [-l FirstLevel]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (numberOfRooms < 1 || s_TicksPerSecond < 1 ||
+  strlen(s_FirstLevelName) >= MAX_LEVEL_NAME_LENGTH)
+    return 1;
+
+  /* Initialise some fixed point number constants, like the NABU does. */
+  ZERO_FX(gfx_Constant_Zero);
+  INT_TO_FX(1, gfx_Constant_One);
+  COPY_NEGATE_FX(gfx_Constant_One, gfx_Constant_MinusOne);
+  INT_FRACTION_TO_FX(0 /* int */, MAX_FX_FRACTION / 8 + 1 /* fraction */,
+    gfx_Constant_Eighth);
+  COPY_NEGATE_FX(gfx_Constant_Eighth, gfx_Constant_MinusEighth);
+
+  DebugPrintString(StockTextMessages(kMagicWordCopyright));
+
+  /* Start up the rooms, restarting any that die.  A room PID of zero means
+     it needs starting, -1 that it couldn't be set up and won't be retried. */
+
+  roomPids = calloc(numberOfRooms, sizeof(pid_t));
+  fflush(stdout); /* So children don't repeat buffered output. */
+  while (true)
+  {
+    forkFailed = false;
+    for (iRoom = 0; iRoom < numberOfRooms; iRoom++)
+    {
+      if (roomPids[iRoom] != 0)
+        continue;
+      roomPids[iRoom] = fork();
+      if (roomPids[iRoom] == 0)
+      {
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        return RunRoom(basePort + iRoom);
+      }
+      if (roomPids[iRoom] < 0)
+      {
+        fprintf(stderr, "Unable to start room %d: %s\n", iRoom,
+          strerror(errno));
+        roomPids[iRoom] = 0; /* Try again in a moment. */
+        forkFailed = true;
+        continue;
+      }
+      printf("Room %d started on port %d, process %d.\n", iRoom,
+        basePort + iRoom, (int) roomPids[iRoom]);
+      fflush(stdout);
+    }
+    if (forkFailed)
+    {
+      sleep(1);
+      continue;
+    }
+
+    deadPid = wait(&roomStatus);
+    if (deadPid < 0)
+      break; /* No rooms left running. */
+    for (iRoom = 0; iRoom < numberOfRooms; iRoom++)
+    {
+      if (roomPids[iRoom] != deadPid)
+        continue;
+      if (WIFEXITED(roomStatus) &&
+      WEXITSTATUS(roomStatus) == ROOM_SETUP_FAILED)
+      {
+        printf("Room %d couldn't be set up, not restarting it.\n", iRoom);
+        roomPids[iRoom] = -1;
+      }
+      else
+      {
+        printf("Room %d died, restarting it.\n", iRoom);
+        roomPids[iRoom] = 0;
+        sleep(1);
+      }
+      fflush(stdout);
+    }
+  }
+
+  fprintf(stderr, "No game rooms are running, exiting.\n");
+  return 1;
+}
@@ -0,0 +1,261 @@
+/******************************************************************************
+ * Nth Pong Wars, converts ICVGM .DAT text screens into binary .NSCR files.
+ *
+ * ICVGM (a Windows tool for drawing TMS9918A graphics mode 2 screens) saves
+ * its work as assembler text, a hex listing of video memory with a label at
+ * the start of each section:
+ *
+ * NAME    DB      $80,$80,$80,$20,$8B,$8B,$8B,$20,$96,$96,$96,$20,$A1,$A1,$A1,$20
+ *         DB      $47,$4F,$41,$4C,$20,$30,$30,$30,$20,$46,$52,$20,$20,$20,$20,$20
+ *
+ * The sections are NAME (768 byte name table), PATTERN (2048 bytes of font),
+ * MCOLOR (2048 bytes of font colours), SPATT (2048 bytes of sprite patterns)
+ * and SCOLOR (64 bytes of sprite colours).  Parsing that on the NABU took 81
+ * characters of text for every 16 bytes of data, so this does it ahead of time
+ * and writes the binary .NSCR file that LoadScreen() copies section by section
+ * straight into video memory: all the sections, one after the other, same as
+ * assembling the .DAT file would do (LoadScreen() ignores the sprite colours
+ * since the game does those itself).  With -c it writes a .NCHR file instead,
+ * just the name table, for screens that reuse an already loaded font.
+ * Replaces assembling the .DAT file with z80asm by hand.  The output is named
+ * after the input, in upper case since the NABU Internet Adapter wants that.
+ * Pack the result with ScreenPacker.c if you want it even smaller.
+ *
+ * AGMS20261018 - Start the ICVGM converter.
+ *
+ * Compile with: gcc -g -O2 -Wall -o ICVGMConvert ICVGMConvert.c
+ * Run with: ./ICVGMConvert [-c] -o OutputDirectory/ File.dat ...
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+/* The sections of an ICVGM file, in the order they appear. */
+typedef enum SectionEnum {
+  SECTION_NAME = 0,
+  SECTION_PATTERN,
+  SECTION_MCOLOR,
+  SECTION_SPATT,
+  SECTION_SCOLOR,
+  SECTION_MAX
+} SectionType;
+
+static const struct SectionStruct {
+  const char *label;
+  uint16_t size;
+} kSections[SECTION_MAX] = {
+  {"NAME", 768},
+  {"PATTERN", 2048},
+  {"MCOLOR", 2048},
+  {"SPATT", 2048},
+  {"SCOLOR", 64}
+};
+
+/* Sections written to the output file, .NSCR or .NCHR. */
+#define NSCR_SECTION_COUNT SECTION_MAX
+#define NCHR_SECTION_COUNT 1
+
+static uint8_t s_SectionData[SECTION_MAX][2048];
+static uint16_t s_SectionLength[SECTION_MAX];
+
+
+/*******************************************************************************
+ * Read an ICVGM file into the section buffers.  Returns FALSE on failure,
+ * after printing why.
+ */
+static bool ReadICVGMFile(const char *inputPath)
+{
+  char line[1024];
+  char label[32];
+  int lineNumber = 0;
+  int section = -1;
+  const char *pChar;
+  char *pEnd;
+  unsigned long number;
+  size_t labelLength;
+  FILE *inputFile;
+
+  inputFile = fopen(inputPath, "r");
+  if (inputFile == NULL)
+  {
+    fprintf(stderr, "Unable to open \"%s\": %s\n", inputPath, strerror(errno));
+    return false;
+  }
+  memset(s_SectionLength, 0, sizeof(s_SectionLength));
+
+  while (fgets(line, sizeof(line), inputFile) != NULL)
+  {
+    lineNumber++;
+
+    /* A label at the start of the line starts a new section. */
+    labelLength = strcspn(line, " \t\r\n:");
+    if (labelLength != 0 && labelLength < sizeof(label))
+    {
+      memcpy(label, line, labelLength);
+      label[labelLength] = 0;
+      for (section = 0; section < SECTION_MAX; section++)
+      {
+        if (strcasecmp(label, kSections[section].label) == 0)
+          break;
+      }
+      if (section >= SECTION_MAX)
+      {
+        fprintf(stderr, "%s:%d: Unknown section \"%s\".\n", inputPath,
+          lineNumber, label);
+        goto ErrorExit;
+      }
+    }
+
+    /* Pick out all the $xx hex numbers on the line. */
+    for (pChar = strchr(line, '$'); pChar != NULL; pChar = strchr(pEnd, '$'))
+    {
+      number = strtoul(pChar + 1, &pEnd, 16);
+      if (pEnd == pChar + 1 || number > 255)
+      {
+        fprintf(stderr, "%s:%d: Bad number.\n", inputPath, lineNumber);
+        goto ErrorExit;
+      }
+      if (section < 0 || s_SectionLength[section] >= kSections[section].size)
+      {
+        fprintf(stderr, "%s:%d: Data outside of a section or too much data.\n",
+          inputPath, lineNumber);
+        goto ErrorExit;
+      }
+      s_SectionData[section][s_SectionLength[section]++] = number;
+    }
+  }
+  fclose(inputFile);
+  return true;
+
+ErrorExit:
+  fclose(inputFile);
+  return false;
+}
+
+
+/*******************************************************************************
+ * Convert one ICVGM file.  Returns FALSE on failure, after printing why.
+ */
+static bool ConvertICVGMFile(const char *inputPath,
+  const char *outputDirectory, bool charactersOnly)
+{
+  char outputPath[1024];
+  char baseName[256];
+  const char *pChar;
+  char *pDot;
+  FILE *outputFile;
+  int sectionCount;
+  int section;
+  long outputSize = 0;
+
+  if (!ReadICVGMFile(inputPath))
+    return false;
+
+  sectionCount = charactersOnly ? NCHR_SECTION_COUNT : NSCR_SECTION_COUNT;
+  for (section = 0; section < sectionCount; section++)
+  {
+    if (s_SectionLength[section] != kSections[section].size)
+    {
+      fprintf(stderr, "\"%s\" has %d bytes of %s, should be %d.\n", inputPath,
+        s_SectionLength[section], kSections[section].label,
+        kSections[section].size);
+      return false;
+    }
+  }
+
+  /* Output name is the upper case input name with the new extension. */
+  pChar = strrchr(inputPath, '/');
+  pChar = (pChar == NULL) ? inputPath : pChar + 1;
+  snprintf(baseName, sizeof(baseName), "%s", pChar);
+  pDot = strrchr(baseName, '.');
+  if (pDot != NULL)
+    *pDot = 0;
+  for (pDot = baseName; *pDot != 0; pDot++)
+    *pDot = toupper(*pDot);
+  snprintf(outputPath, sizeof(outputPath), "%s%s.%s", outputDirectory,
+    baseName, charactersOnly ? "NCHR" : "NSCR");
+
+  outputFile = fopen(outputPath, "wb");
+  if (outputFile == NULL)
+    goto WriteError;
+  for (section = 0; section < sectionCount; section++)
+  {
+    if (fwrite(s_SectionData[section], 1, s_SectionLength[section],
+    outputFile) != s_SectionLength[section])
+      goto WriteError;
+    outputSize += s_SectionLength[section];
+  }
+  if (fclose(outputFile) != 0)
+  {
+    outputFile = NULL;
+    goto WriteError;
+  }
+
+  printf("Converted %s to %s, %ld bytes.\n", inputPath, outputPath,
+    outputSize);
+  return true;
+
+WriteError:
+  fprintf(stderr, "Unable to write \"%s\": %s\n", outputPath,
+    strerror(errno));
+  if (outputFile != NULL)
+    fclose(outputFile);
+  return false;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *outputDirectory = NULL;
+  bool charactersOnly = false;
+  int option;
+  int failureCount = 0;
+  int fileCount;
+
+  while ((option = getopt(argc, argv, "co:")) != -1)
+  {
+    switch (option)
+    {
+      case 'c': charactersOnly = true; break;
+      case 'o': outputDirectory = optarg; break;
+      default: outputDirectory = NULL; optind = argc; break;
+    }
+  }
+  if (outputDirectory == NULL || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-c] -o OutputDirectory/ File.dat ...\n"
+      "  -c writes just the name table to a .NCHR file, rather than a "
+      ".NSCR file.\n", argv[0]);
+    return 1;
+  }
+
+  for (fileCount = 0; optind < argc; optind++, fileCount++)
+  {
+    if (!ConvertICVGMFile(argv[optind], outputDirectory, charactersOnly))
+      failureCount++;
+  }
+
+  printf("%d files converted, %d failed.\n", fileCount - failureCount,
+    failureCount);
+  return failureCount != 0;
+}
@@ -0,0 +1,425 @@
+/******************************************************************************
+ * Nth Pong Wars, compiles text .LEVEL files into the binary level format.
+ *
+ * The NABU spends a fair bit of time parsing level files, converting numbers
+ * from text, searching the keyword table and looking up tile letters.  This
+ * does all that ahead of time on a bigger computer.  It uses the same text
+ * reading code as the game (levels.c, included directly), so it interprets
+ * the file exactly the same way, but rather than running each keyword it
+ * writes out the keyword number and the already decoded arguments.  The
+ * format is described in levels.c near kLevelBinaryMagic.  The game tells the
+ * two kinds of files apart by the leading NUL byte, so the compiled file keeps
+ * the same name and can just replace the text one on the server.
+ *
+ * Also checks that the files the level refers to (screens, music, next
+ * levels) exist, and if they only exist with an upper case name (the NABU
+ * Internet Adapter wants upper case), uses that name instead.
+ *
+ * Before compiling anything it checks that the perfect hash indices for the
+ * keyword tables in levels.c still match the tables.  Use -H to print out new
+ * seeds and indices to paste into levels.c after changing a table.
+ *
+ * AGMS20261018 - Start the level compiler.
+ *
+ * Compile with: gcc -g -O2 -Wall -o LevelCompiler LevelCompiler.c
+ * Run with: ./LevelCompiler [-d DataDirectory/] -o OutputDirectory/
+ *   File.LEVEL ...
+ * Or: ./LevelCompiler -H
+ * The data directory is where referenced files are looked for, defaults to
+ * ../Nabu/Art/.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code, for the level file reading functions. */
+#include "../Common/cverify.h"
+#include "../Common/fixed_point.c"
+#include "../Common/debug_print.c"
+#include "../Common/tiles.c"
+#include "../Common/players.c"
+#include "../Common/simulate.c"
+#include "../Common/scores.c"
+#include "../Common/soundscreen.c"
+#include "../Common/levels.c"
+
+#define MAX_COMPILED_SIZE 65536
+
+static uint8_t s_Output[MAX_COMPILED_SIZE];
+static size_t s_OutputLength;
+static int s_WarningCount;
+
+
+static void PutByte(uint8_t value)
+{
+  if (s_OutputLength < sizeof(s_Output))
+    s_Output[s_OutputLength++] = value;
+}
+
+
+static void PutString(const char *pString)
+{
+  size_t length = strlen(pString);
+  if (length > 255)
+    length = 255;
+  PutByte(length);
+  while (length-- != 0)
+    PutByte(*pString++);
+}
+
+
+/*******************************************************************************
+ * See if a data file exists, the same way OpenDataFile() would look for it.
+ */
+static bool DataFileExists(const char *fileNameBase, const char *extension)
+{
+  FileHandleType fileID;
+
+  fileID = OpenDataFile(fileNameBase, extension, NULL);
+  if (fileID == BAD_FILE_HANDLE)
+    return false;
+  CloseDataFile(fileID);
+  return true;
+}
+
+
+/*******************************************************************************
+ * Resolve a file name used by a keyword.  If it doesn't exist but the upper
+ * case version does, switch to that.  Warns if neither exists.  Names with a
+ * URL or special meaning are left alone.
+ */
+static void ResolveFileName(const char *keyword, char *fileName,
+  const char *extension)
+{
+  char upperName[MAX_FILE_NAME_LENGTH];
+  char *pChar;
+
+  if (strlen(fileName) >= MAX_FILE_NAME_LENGTH ||
+  strchr(fileName, ':') != NULL || DataFileExists(fileName, extension))
+    return;
+
+  strcpy(upperName, fileName);
+  for (pChar = upperName; *pChar != NUL; pChar++)
+    *pChar = toupper(*pChar);
+  if (DataFileExists(upperName, extension))
+  {
+    strcpy(fileName, upperName);
+    return;
+  }
+
+  fprintf(stderr, "Warning: %s refers to missing file \"%s%s%s\".\n", keyword,
+    fileName, (extension == NULL) ? "" : ".",
+    (extension == NULL) ? "" : extension);
+  s_WarningCount++;
+}
+
+
+/*******************************************************************************
+ * Compile the tile data lines, up to the END line, into rows of tile owners.
+ */
+static void CompileTileData(void)
+{
+  const char *pChar;
+  uint8_t rowData[256];
+  uint8_t column;
+  tile_owner tileType;
+
+  while (LevelReadAndTrimLine(g_TempBuffer, 255))
+  {
+    if (strcasecmp(g_TempBuffer, "END") == 0)
+      break;
+    if (g_TempBuffer[0] == '#')
+      continue;
+
+    column = 0;
+    for (pChar = g_TempBuffer; *pChar != NUL; pChar++)
+    {
+      if (isblank(*pChar))
+        continue;
+      tileType = LevelLetterToTileOwner(*pChar);
+      if (tileType >= OWNER_MAX)
+        tileType = OWNER_EMPTY;
+      if (column < 255)
+        rowData[column++] = tileType;
+    }
+
+    if (column > 0) /* Blank lines don't count as rows. */
+    {
+      PutByte(column);
+      for (tileType = 0; tileType < column; tileType++)
+        PutByte(rowData[tileType]);
+    }
+  }
+  PutByte(0); /* End of rows. */
+}
+
+
+/*******************************************************************************
+ * Compile one keyword's arguments, as described by its arguments string.
+ */
+static void CompileKeyword(KeyWordCallPointer pKeywordCall)
+{
+  const char *pArgument;
+  char text[256];
+  uint8_t count;
+  uint8_t i;
+
+  PutByte(pKeywordCall - kKeywordFunctionTable + 1);
+
+  for (pArgument = pKeywordCall->arguments; *pArgument != NUL; pArgument++)
+  {
+    switch (*pArgument)
+    {
+      case 'w':
+        LevelReadWord(text, MAX_FILE_NAME_LENGTH, ',');
+        PutString(text);
+        break;
+
+      case 'l':
+        LevelReadAndTrimLine(text, 255);
+        if (pKeywordCall->function == KeywordScreen)
+          ResolveFileName(pKeywordCall->keyword, text, NULL);
+        else if (pKeywordCall->function == KeywordBackgroundMusic &&
+        strcasecmp(text, "Silence") != 0 && strcasecmp(text, "Default") != 0)
+          ResolveFileName(pKeywordCall->keyword, text, "CHIPNSFX");
+        else if (pKeywordCall->function == KeywordLevelNext &&
+        strcasecmp(text, "Quit") != 0 && strcasecmp(text, "Bookmark") != 0)
+          ResolveFileName(pKeywordCall->keyword, text, "LEVEL");
+        else if (pKeywordCall->function == KeywordBundle && text[0] != NUL)
+          ResolveFileName(pKeywordCall->keyword, text, "BUNDLE");
+        PutString(text);
+        break;
+
+      case 't':
+        CompileTileData();
+        break;
+
+      default: /* A digit, read that many numbers. */
+        count = 0;
+        if (LevelReadNumericArguments(*pArgument - '0'))
+          count = *pArgument - '0';
+        PutByte(count);
+        for (i = 0; i < count; i++)
+        {
+          PutByte(sNumericArgumentsDecoded[i] & 0xFF);
+          PutByte((uint16_t) sNumericArgumentsDecoded[i] >> 8);
+        }
+        break;
+    }
+  }
+
+  /* Keywords without arguments ignore the rest of the line.  Otherwise
+     anything left over (like a comment after some numbers) gets skipped by
+     LevelReadNextKeyword(), same as when the game reads the text file. */
+  if (pKeywordCall->arguments[0] == NUL)
+    LevelReadToStartOfNextLine();
+}
+
+
+/*******************************************************************************
+ * Find a seed and the smallest power of two hash size that gives a perfect
+ * hash for a table of words, and print them out as C code for levels.c.
+ */
+static void GenerateWordHash(const char *tableName, const char *macroPrefix,
+  const char *indexName, const char **words, uint8_t wordCount)
+{
+  uint8_t hashIndex[256];
+  unsigned int hashSize;
+  unsigned int seed;
+  uint8_t slot;
+  uint8_t i;
+
+  for (hashSize = 1; hashSize < wordCount; hashSize *= 2)
+    ;
+  for (; hashSize <= 256; hashSize *= 2)
+  {
+    for (seed = 0; seed < 256; seed++)
+    {
+      memset(hashIndex, 0, sizeof(hashIndex));
+      for (i = 0; i < wordCount; i++)
+      {
+        slot = LevelWordHash(words[i], seed) & (hashSize - 1);
+        if (hashIndex[slot] != 0)
+          break; /* Collision, try the next seed. */
+        hashIndex[slot] = i + 1;
+      }
+      if (i < wordCount)
+        continue;
+
+      printf("/* %s */\n#define %s_HASH_SEED %u\n#define %s_HASH_SIZE %u\n"
+        "static const uint8_t %s[%s_HASH_SIZE] = {", tableName, macroPrefix,
+        seed, macroPrefix, hashSize, indexName, macroPrefix);
+      for (slot = 0; slot < hashSize; slot++)
+        printf("%s%s%d", (slot == 0) ? "" : ",", (slot % 16 == 0) ? "\n  " :
+          " ", hashIndex[slot]);
+      printf("\n};\n\n");
+      return;
+    }
+  }
+  fprintf(stderr, "Unable to find a perfect hash for %s.\n", tableName);
+}
+
+
+/*******************************************************************************
+ * Print new hash indices for all the tables in levels.c.
+ */
+static void GenerateWordHashes(void)
+{
+  const char *words[256];
+  uint8_t wordCount;
+
+  for (wordCount = 0; kKeywordFunctionTable[wordCount].keyword != NULL;
+  wordCount++)
+    words[wordCount] = kKeywordFunctionTable[wordCount].keyword;
+  GenerateWordHash("kKeywordFunctionTable", "KEYWORD", "kKeywordHash",
+    words, wordCount);
+
+  for (wordCount = 0; kLevelNextOptions[wordCount].optionWord != NULL;
+  wordCount++)
+    words[wordCount] = kLevelNextOptions[wordCount].optionWord;
+  GenerateWordHash("kLevelNextOptions", "LEVEL_NEXT_OPTIONS",
+    "kLevelNextOptionsHash", words, wordCount);
+}
+
+
+/*******************************************************************************
+ * Compile one level file.  Returns FALSE on failure, after printing why.
+ */
+static bool CompileLevelFile(const char *inputPath, const char *outputDirectory)
+{
+  char levelBuffer[LEVEL_READ_BUFFER_SIZE];
+  char outputPath[1024];
+  KeyWordCallPointer pKeywordCall;
+  const char *baseName;
+  FILE *outputFile;
+  size_t textSize;
+
+  sLevelFileHandle = open(inputPath, O_RDONLY);
+  if (sLevelFileHandle == BAD_FILE_HANDLE)
+  {
+    fprintf(stderr, "Unable to open \"%s\": %s\n", inputPath, strerror(errno));
+    return false;
+  }
+  textSize = lseek(sLevelFileHandle, 0, SEEK_END);
+  lseek(sLevelFileHandle, 0, SEEK_SET);
+
+  sLevelBuffer = levelBuffer;
+  sLevelReadPosition = 0;
+  sLevelWritePosition = 0;
+  sLevelEndOfFile = false;
+  sLevelBinary = false;
+
+  if (LevelReadByte() == NUL)
+  {
+    fprintf(stderr, "\"%s\" is empty or already compiled.\n", inputPath);
+    close(sLevelFileHandle);
+    return false;
+  }
+  LevelUndoReadByte();
+
+  s_OutputLength = 0;
+  PutByte(NUL);
+  for (size_t i = 0; i < sizeof(kLevelBinaryMagic); i++)
+    PutByte(kLevelBinaryMagic[i]);
+
+  while ((pKeywordCall = LevelReadNextKeyword()) != NULL)
+    CompileKeyword(pKeywordCall);
+  PutByte(0); /* End marker. */
+
+  close(sLevelFileHandle);
+  sLevelFileHandle = BAD_FILE_HANDLE;
+  sLevelBuffer = NULL;
+
+  if (s_OutputLength >= sizeof(s_Output))
+  {
+    fprintf(stderr, "\"%s\" is too big to compile.\n", inputPath);
+    return false;
+  }
+
+  baseName = strrchr(inputPath, '/');
+  baseName = (baseName == NULL) ? inputPath : baseName + 1;
+  snprintf(outputPath, sizeof(outputPath), "%s%s", outputDirectory, baseName);
+  outputFile = fopen(outputPath, "wb");
+  if (outputFile == NULL ||
+  fwrite(s_Output, 1, s_OutputLength, outputFile) != s_OutputLength)
+  {
+    fprintf(stderr, "Unable to write \"%s\": %s\n", outputPath,
+      strerror(errno));
+    if (outputFile != NULL)
+      fclose(outputFile);
+    return false;
+  }
+  fclose(outputFile);
+
+  printf("Compiled %s, %d bytes of text to %d bytes.\n", outputPath,
+    (int) textSize, (int) s_OutputLength);
+  return true;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *outputDirectory = NULL;
+  int option;
+  int failureCount = 0;
+  int fileCount;
+
+  g_HostDataPath = "../Nabu/Art/";
+
+  while ((option = getopt(argc, argv, "d:o:H")) != -1)
+  {
+    switch (option)
+    {
+      case 'H': GenerateWordHashes(); return 0;
+      case 'd': g_HostDataPath = optarg; break;
+      case 'o': outputDirectory = optarg; break;
+      default: outputDirectory = NULL; optind = argc; break;
+    }
+  }
+  if (outputDirectory == NULL || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-d DataDirectory/] -o OutputDirectory/ "
+      "File.LEVEL ...\n  or %s -H to print new keyword hash tables.\n",
+      argv[0], argv[0]);
+    return 1;
+  }
+
+  if (!LevelWordHashesValid())
+    return 1;
+
+  for (fileCount = 0; optind < argc; optind++, fileCount++)
+  {
+    if (!CompileLevelFile(argv[optind], outputDirectory))
+      failureCount++;
+  }
+
+  printf("%d files compiled, %d failed, %d warnings.\n",
+    fileCount - failureCount, failureCount, s_WarningCount);
+  return failureCount != 0;
+}
@@ -0,0 +1,227 @@
+/******************************************************************************
+ * Nth Pong Wars, a UDP relay for testing network play on one machine.
+ *
+ * Two game instances each send their input messages (see the
+ * rollback_input_message_record in Common/rollback.h) to one of the relay's
+ * ports, and the relay forwards them to whoever last sent to the other port,
+ * after holding them for the given latency.  Optionally some random jitter and
+ * packet loss are added, so you can see rollback doing its job.  See
+ * RollbackPeer.c for the game instances to run with it.
+ *
+ * AGMS20261018 - Start this test tool.
+ *
+ * Compile with: gcc -g -O2 -Wall -o LoopbackRelay LoopbackRelay.c
+ * Run with: ./LoopbackRelay [PortA [PortB [LatencyMs [JitterMs [LossPercent]]]]]
+ * Defaults are 7000, 7001, 100, 0, 0.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_QUEUED_PACKETS 1024
+#define MAX_PACKET_SIZE 256
+
+/* A packet waiting for its latency to expire. */
+typedef struct queued_packet_struct {
+  int64_t release_time_ms;
+  int to_side; /* 0 to send out port A, 1 for port B. */
+  size_t length;
+  uint8_t data[MAX_PACKET_SIZE];
+} queued_packet_record, *queued_packet_pointer;
+
+static queued_packet_record s_Queue[MAX_QUEUED_PACKETS];
+static int s_QueueCount = 0;
+
+static int s_Sockets[2] = {-1, -1};
+static struct sockaddr_in s_PeerAddresses[2];
+static bool s_PeerKnown[2] = {false, false};
+
+
+/*******************************************************************************
+ * Current time in milliseconds, from a clock that doesn't jump.
+ */
+static int64_t NowMs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/*******************************************************************************
+ * Make a UDP socket listening on the loopback interface at the given port.
+ * Returns -1 on failure, after printing why.
+ */
+static int OpenLoopbackSocket(uint16_t port)
+{
+  struct sockaddr_in address;
+  int sock;
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr *) &address, sizeof(address)) != 0)
+  {
+    fprintf(stderr, "Unable to bind to port %d: %s\n", port, strerror(errno));
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+
+/*******************************************************************************
+ * Read a packet from one side and queue it up for sending to the other side.
+ * Also remembers the sender's address, so we know where to send replies.
+ */
+static void ReceivePacket(int fromSide, int latencyMs, int jitterMs,
+  int lossPercent)
+{
+  struct sockaddr_in sender;
+  socklen_t senderLength = sizeof(sender);
+  queued_packet_pointer pPacket;
+  uint8_t buffer[MAX_PACKET_SIZE];
+  ssize_t length;
+
+  length = recvfrom(s_Sockets[fromSide], buffer, sizeof(buffer), 0,
+    (struct sockaddr *) &sender, &senderLength);
+  if (length <= 0)
+    return;
+
+  s_PeerAddresses[fromSide] = sender;
+  s_PeerKnown[fromSide] = true;
+
+  if (lossPercent > 0 && rand() % 100 < lossPercent)
+    return; /* Simulate a lost packet. */
+
+  if (s_QueueCount >= MAX_QUEUED_PACKETS)
+  {
+    fprintf(stderr, "Queue full, dropping packet.\n");
+    return;
+  }
+
+  pPacket = s_Queue + s_QueueCount++;
+  pPacket->release_time_ms = NowMs() + latencyMs;
+  if (jitterMs > 0)
+    pPacket->release_time_ms += rand() % (jitterMs + 1);
+  pPacket->to_side = 1 - fromSide;
+  pPacket->length = length;
+  memcpy(pPacket->data, buffer, length);
+}
+
+
+/*******************************************************************************
+ * Send all the packets which have waited long enough.  Jitter can reorder
+ * them, same as the real Internet.  Returns the time in milliseconds until the
+ * next packet is due, or -1 if the queue is empty.
+ */
+static int SendDuePackets(void)
+{
+  int64_t now = NowMs();
+  int64_t nextDue = -1;
+  int iPacket;
+
+  for (iPacket = 0; iPacket < s_QueueCount; )
+  {
+    queued_packet_pointer pPacket = s_Queue + iPacket;
+    if (pPacket->release_time_ms <= now)
+    {
+      int toSide = pPacket->to_side;
+      if (s_PeerKnown[toSide])
+        sendto(s_Sockets[toSide], pPacket->data, pPacket->length, 0,
+          (struct sockaddr *) &s_PeerAddresses[toSide],
+          sizeof(s_PeerAddresses[toSide]));
+      /* Else nobody to send it to yet, discard it. */
+
+      *pPacket = s_Queue[--s_QueueCount]; /* Fill hole with the last one. */
+      continue;
+    }
+    if (nextDue < 0 || pPacket->release_time_ms < nextDue)
+      nextDue = pPacket->release_time_ms;
+    iPacket++;
+  }
+
+  if (nextDue < 0)
+    return -1;
+  return (int) (nextDue - now);
+}
+
+
+int main(int argc, const char **argv)
+{
+  int portA = (argc > 1) ? atoi(argv[1]) : 7000;
+  int portB = (argc > 2) ? atoi(argv[2]) : 7001;
+  int latencyMs = (argc > 3) ? atoi(argv[3]) : 100;
+  int jitterMs = (argc > 4) ? atoi(argv[4]) : 0;
+  int lossPercent = (argc > 5) ? atoi(argv[5]) : 0;
+  struct pollfd pollList[2];
+  int side;
+
+  s_Sockets[0] = OpenLoopbackSocket(portA);
+  s_Sockets[1] = OpenLoopbackSocket(portB);
+  if (s_Sockets[0] < 0 || s_Sockets[1] < 0)
+    return 1;
+
+  printf("Relaying between UDP ports %d and %d on 127.0.0.1, latency %d ms, "
+    "jitter %d ms, loss %d%%.\n", portA, portB, latencyMs, jitterMs,
+    lossPercent);
+
+  while (true)
+  {
+    int timeoutMs = SendDuePackets();
+
+    for (side = 0; side < 2; side++)
+    {
+      pollList[side].fd = s_Sockets[side];
+      pollList[side].events = POLLIN;
+      pollList[side].revents = 0;
+    }
+
+    if (poll(pollList, 2, timeoutMs) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("poll");
+      return 1;
+    }
+
+    for (side = 0; side < 2; side++)
+    {
+      if (pollList[side].revents & POLLIN)
+        ReceivePacket(side, latencyMs, jitterMs, lossPercent);
+    }
+  }
+
+  return 0;
+}
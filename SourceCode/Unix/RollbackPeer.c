@@ -0,0 +1,507 @@
+/******************************************************************************
+ * Nth Pong Wars, a headless game instance for testing rollback over UDP.
+ *
+ * Runs the game code like the GameServer does, but as one of two peers in a
+ * networked game, with the rollback code (Common/rollback.c) hiding the
+ * latency.  Players 0 and 1 are the two peers' players and the rest are AI
+ * players.  Our own player follows a scripted sequence of joystick inputs
+ * (the same script the other peer uses for it), given to the game as if it
+ * came from joystick 0, and the other peer's player is a network player.
+ * Each tick we send the inputs for our player's last few frames (so a lost
+ * packet doesn't matter) to LoopbackRelay.c, which passes them to the other
+ * peer after some latency.  Messages are rollback_input_message_record, four
+ * bytes each, several to a packet.  A message for player 255 is a hello,
+ * sent until the other peer shows up so both start at about the same time.
+ *
+ * If we get ROLLBACK_MAX_FRAMES - 1 frames ahead of the inputs received from
+ * the other peer, we wait for them, since older guesses can't be corrected.
+ * After the given number of frames, we wait for the rest of the other peer's
+ * inputs, correct any wrong guesses and print a checksum of the tiles and
+ * players.  Both peers should print the same checksum, and it should match
+ * the one from a run with the -r option, which plays both players from the
+ * script locally so it never needs to guess or roll back.
+ *
+ * AGMS20261018 - Start this test tool.
+ *
+ * Compile with: gcc -g -O2 -Wall -DROLLBACK_NETCODE=1 -o RollbackPeer RollbackPeer.c
+ * Run with: ./LoopbackRelay 7000 7001 100 20 10 &
+ *   ./RollbackPeer -p 7000 -i 0 & ./RollbackPeer -p 7001 -i 1 ; ./RollbackPeer -r
+ * Other options are -n Frames (default 600), -t TicksPerSecond (default 20),
+ * -d DataDirectory/ (default ../Nabu/Art/) and -l Level (default GAMEDEMO).
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code. */
+#include "../Common/cverify.h"
+#include "../Common/fixed_point.c"
+#include "../Common/debug_print.c"
+#include "../Common/tiles.c"
+#include "../Common/players.c"
+#include "../Common/simulate.c"
+#include "../Common/scores.c"
+#include "../Common/soundscreen.c"
+#include "../Common/levels.c"
+#include "../Common/rollback.c"
+
+#if !ROLLBACK_NETCODE
+#error "Compile with -DROLLBACK_NETCODE=1, this tests the rollback code."
+#endif
+
+
+/*******************************************************************************
+ * Constants, types and globals.
+ */
+
+#define MAX_PEER_TILES 16384 /* Up to 128x128 boards. */
+#define HELLO_PLAYER_INDEX 255
+#define GIVE_UP_NS (10 * (int64_t) 1000000000) /* No progress for this long. */
+
+static int s_Socket = -1;
+static uint8_t s_LocalPlayer = 0;
+static uint8_t s_RemotePlayer = 1;
+static bool s_PeerHeard = false;
+
+static uint16_t s_StartFrame;
+/* g_FrameCounter at the start, frame numbers below are relative to it. */
+
+static long s_RemoteFramesKnown = 0;
+/* The other peer's inputs have arrived for all frames before this one. */
+
+static bool *s_RemoteFrameArrived;
+/* Which frames the other peer's inputs have arrived for, they can come out of
+   order with jitter.  One entry per frame run. */
+
+static long s_FrameCount = 600;
+
+
+/*******************************************************************************
+ * Current time in nanoseconds, from a clock that doesn't jump.
+ */
+static int64_t NowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * The scripted joystick inputs for a player, a new direction and maybe the
+ * fire button every 16 frames.  Same as in Common/rollback_test.c.
+ */
+static uint8_t ScriptedInput(uint16_t frame, uint8_t iPlayer)
+{
+  uint32_t hash;
+
+  hash = ((frame >> 4) + 1) * 2654435761u ^ (iPlayer + 1) * 40503u;
+  hash ^= hash >> 13;
+  hash *= 2246822519u;
+  hash ^= hash >> 16;
+  return hash & 0x1F;
+}
+
+
+/*******************************************************************************
+ * Make a UDP socket on the loopback interface, sending to the relay's port.
+ * Returns FALSE on failure, after printing why.
+ */
+static bool OpenRelaySocket(uint16_t relayPort)
+{
+  struct sockaddr_in address;
+
+  s_Socket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (s_Socket < 0)
+  {
+    perror("socket");
+    return false;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(relayPort);
+  if (connect(s_Socket, (struct sockaddr *) &address, sizeof(address)) != 0)
+  {
+    fprintf(stderr, "Unable to use relay port %d: %s\n", relayPort,
+      strerror(errno));
+    return false;
+  }
+  fcntl(s_Socket, F_SETFL, fcntl(s_Socket, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+
+/*******************************************************************************
+ * Send our player's inputs for the last few frames before frameEnd (relative
+ * frame number), or a hello if frameEnd is zero.  Send errors are ignored,
+ * the relay may not be up yet.
+ */
+static void SendInputs(long frameEnd)
+{
+  rollback_input_message_record messages[ROLLBACK_MAX_FRAMES];
+  long iFrame;
+  int count = 0;
+
+  if (frameEnd == 0)
+  {
+    messages[0].player_index = HELLO_PLAYER_INDEX;
+    messages[0].joystick_inputs = 0;
+    messages[0].frame = 0;
+    count = 1;
+  }
+  for (iFrame = frameEnd - ROLLBACK_MAX_FRAMES; iFrame < frameEnd; iFrame++)
+  {
+    if (iFrame < 0)
+      continue;
+    messages[count].player_index = s_LocalPlayer;
+    messages[count].frame = s_StartFrame + iFrame;
+    messages[count].joystick_inputs =
+      ScriptedInput(messages[count].frame, s_LocalPlayer);
+    count++;
+  }
+  send(s_Socket, messages, count * sizeof(rollback_input_message_record),
+    MSG_DONTWAIT);
+}
+
+
+/*******************************************************************************
+ * Read all the packets which have arrived and give the other peer's inputs to
+ * the rollback code, until the given time.
+ */
+static void ReceiveInputs(int64_t deadlineNs)
+{
+  rollback_input_message_record messages[64];
+  struct pollfd pollItem;
+  ssize_t length;
+  int64_t nowNs;
+  long iFrame;
+  int iMessage;
+
+  while (true)
+  {
+    length = recv(s_Socket, messages, sizeof(messages), MSG_DONTWAIT);
+    if (length < 0)
+    {
+      nowNs = NowNs();
+      if (nowNs >= deadlineNs)
+        return;
+      pollItem.fd = s_Socket;
+      pollItem.events = POLLIN;
+      poll(&pollItem, 1, (int) ((deadlineNs - nowNs + 999999) / 1000000));
+      continue;
+    }
+
+    s_PeerHeard = true;
+    for (iMessage = 0; iMessage < length /
+    (ssize_t) sizeof(rollback_input_message_record); iMessage++)
+    {
+      if (messages[iMessage].player_index != s_RemotePlayer)
+        continue; /* A hello, or garbage. */
+      iFrame = (uint16_t) (messages[iMessage].frame - s_StartFrame);
+      if (iFrame >= s_FrameCount || s_RemoteFrameArrived[iFrame])
+        continue;
+      s_RemoteFrameArrived[iFrame] = true;
+      RollbackReceiveRemoteInput(messages + iMessage);
+    }
+    while (s_RemoteFramesKnown < s_FrameCount &&
+    s_RemoteFrameArrived[s_RemoteFramesKnown])
+      s_RemoteFramesKnown++;
+  }
+}
+
+
+/*******************************************************************************
+ * Do one frame of the game, with the same rollback calls as the NABU main
+ * loop, minus the drawing and victory tests (so it stays on one level).
+ */
+static void RunOneFrame(void)
+{
+  RollbackResimulateIfNeeded();
+  RollbackStartFrame();
+  g_JoystickStatus[0] = ScriptedInput(g_FrameCounter, s_LocalPlayer);
+  UpdatePlayerInputs();
+  RollbackEndInputs();
+  if (gVictoryModeHighestTileCount)
+  {
+    Simulate();
+    if ((g_FrameCounter & 0x3F) == 0)
+      AddNextPowerUpTile();
+    UpdateScores();
+  }
+  g_ScoreFramesPerUpdate = 1;
+
+  g_FrameCounter++;
+  if ((g_FrameCounter & 0x1F) == 0)
+  {
+    if (g_ScoreGoal-- == 0)
+      g_ScoreGoal = 5;
+  }
+}
+
+
+/*******************************************************************************
+ * Add some bytes to an FNV-1a hash.
+ */
+static uint32_t HashBytes(uint32_t hash, const void *pData, size_t length)
+{
+  const uint8_t *pByte = pData;
+
+  while (length-- != 0)
+    hash = (hash ^ *pByte++) * 16777619u;
+  return hash;
+}
+
+
+/*******************************************************************************
+ * A checksum of the game parts which the simulation changes, not including
+ * display things like animation frames.
+ */
+static uint32_t StateChecksum(void)
+{
+  player_pointer pPlayer;
+  tile_pointer pTile;
+  uint32_t hash = 2166136261u;
+  uint8_t tileBytes[2];
+  uint8_t iPlayer;
+
+  hash = HashBytes(hash, &g_FrameCounter, sizeof(g_FrameCounter));
+  hash = HashBytes(hash, &g_ScoreGoal, sizeof(g_ScoreGoal));
+  for (iPlayer = 0, pPlayer = g_player_array; iPlayer < MAX_PLAYERS;
+  iPlayer++, pPlayer++)
+  {
+    hash = HashBytes(hash, &pPlayer->pixel_center_x, sizeof(fx));
+    hash = HashBytes(hash, &pPlayer->pixel_center_y, sizeof(fx));
+    hash = HashBytes(hash, &pPlayer->velocity_x, sizeof(fx));
+    hash = HashBytes(hash, &pPlayer->velocity_y, sizeof(fx));
+    hash = HashBytes(hash, &pPlayer->pixel_flying_height, 1);
+    hash = HashBytes(hash, pPlayer->power_up_timers,
+      sizeof(pPlayer->power_up_timers));
+  }
+  for (pTile = g_tile_array; pTile != g_play_area_end_tile; pTile++)
+  {
+    tileBytes[0] = pTile->owner;
+    tileBytes[1] = pTile->age;
+    hash = HashBytes(hash, tileBytes, sizeof(tileBytes));
+  }
+  return hash;
+}
+
+
+/*******************************************************************************
+ * Play the game against the other peer.  Returns zero if successful.
+ */
+static int RunPeer(int ticksPerSecond)
+{
+  int64_t tickNs = 1000000000 / ticksPerSecond;
+  int64_t nextTickNs;
+  int64_t lastProgressNs;
+  int64_t lingerUntilNs;
+  long framesDone = 0;
+
+  /* Say hello until the other peer answers. */
+
+  lastProgressNs = NowNs();
+  while (!s_PeerHeard)
+  {
+    SendInputs(0);
+    ReceiveInputs(NowNs() + tickNs);
+    if (NowNs() - lastProgressNs > GIVE_UP_NS)
+    {
+      fprintf(stderr, "Player %d never heard from the other peer.\n",
+        s_LocalPlayer);
+      return 1;
+    }
+  }
+
+  /* Play, waiting for the other peer if we get too far ahead. */
+
+  nextTickNs = NowNs();
+  while (framesDone < s_FrameCount)
+  {
+    ReceiveInputs(nextTickNs);
+    nextTickNs += tickNs;
+    if (framesDone - s_RemoteFramesKnown < ROLLBACK_MAX_FRAMES - 1)
+    {
+      RunOneFrame();
+      framesDone++;
+      lastProgressNs = NowNs();
+    }
+    else if (NowNs() - lastProgressNs > GIVE_UP_NS)
+    {
+      fprintf(stderr, "Player %d stuck at frame %ld waiting for inputs.\n",
+        s_LocalPlayer, framesDone);
+      return 1;
+    }
+    SendInputs(framesDone);
+  }
+
+  /* Wait for the rest of the other peer's inputs, and keep sending ours for
+     a while in case some of them got lost on the way. */
+
+  lingerUntilNs = 0;
+  while (lingerUntilNs == 0 || NowNs() < lingerUntilNs)
+  {
+    SendInputs(framesDone);
+    ReceiveInputs(NowNs() + tickNs);
+    if (lingerUntilNs == 0 && s_RemoteFramesKnown >= s_FrameCount)
+      lingerUntilNs = NowNs() + 1000000000;
+    if (lingerUntilNs == 0 && NowNs() - lastProgressNs > GIVE_UP_NS)
+    {
+      fprintf(stderr, "Player %d didn't get the last inputs.\n",
+        s_LocalPlayer);
+      return 1;
+    }
+  }
+  RollbackResimulateIfNeeded();
+
+  printf("Player %d did %ld frames, %d rollbacks redid %d frames with %d "
+    "failures.  Final state checksum %08X.\n", s_LocalPlayer, s_FrameCount,
+    g_RollbackCount, g_RollbackFramesResimulated, g_RollbackFailures,
+    StateChecksum());
+  return g_RollbackFailures != 0;
+}
+
+
+/*******************************************************************************
+ * Play both players from the script, with their inputs known before they are
+ * used, so there is never a guess to correct.  Returns zero if successful.
+ */
+static int RunReference(void)
+{
+  rollback_input_message_record message;
+  long iFrame;
+
+  for (iFrame = 0; iFrame < s_FrameCount; iFrame++)
+  {
+    message.player_index = s_RemotePlayer;
+    message.frame = g_FrameCounter;
+    message.joystick_inputs = ScriptedInput(message.frame, s_RemotePlayer);
+    RollbackReceiveRemoteInput(&message);
+    RunOneFrame();
+  }
+
+  printf("Reference did %ld frames, %d rollbacks.  Final state checksum "
+    "%08X.\n", s_FrameCount, g_RollbackCount, StateChecksum());
+  return g_RollbackCount != 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  int relayPort = 7000;
+  int ticksPerSecond = FIXED_TICKS_PER_SECOND;
+  bool isReference = false;
+  int option;
+  int localPlayer = 0;
+  uint8_t iPlayer;
+
+  g_HostDataPath = "../Nabu/Art/";
+  strcpy(gLevelName, "GAMEDEMO");
+  while ((option = getopt(argc, argv, "p:i:n:t:d:l:r")) != -1)
+  {
+    switch (option)
+    {
+      case 'p': relayPort = atoi(optarg); break;
+      case 'i': localPlayer = atoi(optarg); break;
+      case 'n': s_FrameCount = atol(optarg); break;
+      case 't': ticksPerSecond = atoi(optarg); break;
+      case 'd': g_HostDataPath = optarg; break;
+      case 'l':
+        snprintf(gLevelName, sizeof(gLevelName), "%s", optarg);
+        break;
+      case 'r': isReference = true; break;
+      default: s_FrameCount = 0; break;
+    }
+  }
+  if (s_FrameCount < 1 || ticksPerSecond < 1 ||
+  (localPlayer != 0 && localPlayer != 1))
+  {
+    fprintf(stderr, "Usage: %s [-p RelayPort] [-i LocalPlayer (0 or 1)] "
+      "[-n Frames] [-t TicksPerSecond] [-d DataDirectory/] [-l Level] "
+      "[-r]\n", argv[0]);
+    return 2;
+  }
+  s_LocalPlayer = localPlayer;
+  s_RemotePlayer = 1 - localPlayer;
+  s_RemoteFrameArrived = calloc(s_FrameCount, sizeof(bool));
+
+  /* Initialise some fixed point number constants, like the NABU does. */
+  ZERO_FX(gfx_Constant_Zero);
+  INT_TO_FX(1, gfx_Constant_One);
+  COPY_NEGATE_FX(gfx_Constant_One, gfx_Constant_MinusOne);
+  INT_FRACTION_TO_FX(0 /* int */, MAX_FX_FRACTION / 8 + 1 /* fraction */,
+    gfx_Constant_Eighth);
+  COPY_NEGATE_FX(gfx_Constant_Eighth, gfx_Constant_MinusEighth);
+
+  g_tile_array = calloc(MAX_PEER_TILES, sizeof(tile_record));
+  gTileArraySize = MAX_PEER_TILES;
+  g_play_area_height_tiles = 23;
+  g_play_area_width_tiles = 32;
+  if (s_RemoteFrameArrived == NULL || g_tile_array == NULL ||
+  !InitTileArray())
+  {
+    fprintf(stderr, "Failed to set up play area tiles.\n");
+    return 2;
+  }
+  InitialisePlayers();
+  if (!LoadLevelFile())
+  {
+    fprintf(stderr, "Unable to load level %s from %s.\n", gLevelName,
+      g_HostDataPath);
+    return 2;
+  }
+
+  /* Our player is on joystick 0, the other peer's is a network player and
+     everybody else is an AI. */
+
+  for (iPlayer = 0; iPlayer < MAX_PLAYERS; iPlayer++)
+  {
+    ReinitialisePlayer(g_player_array + iPlayer);
+    g_player_array[iPlayer].brain = BRAIN_ALGORITHM;
+  }
+  g_player_array[s_LocalPlayer].brain = BRAIN_JOYSTICK;
+  g_player_array[s_LocalPlayer].brain_info.iJoystick = 0;
+  g_player_array[s_RemotePlayer].brain = BRAIN_NETWORK;
+  RollbackReset();
+  s_StartFrame = g_FrameCounter;
+  fflush(stdout);
+
+  if (isReference)
+    return RunReference();
+  if (!OpenRelaySocket(relayPort))
+    return 2;
+  return RunPeer(ticksPerSecond);
+}
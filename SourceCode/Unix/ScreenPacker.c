@@ -0,0 +1,302 @@
+/******************************************************************************
+ * Nth Pong Wars, packs .NFUL, .NSCR and .NCHR screen files so they load faster.
+ *
+ * Loading a full screen bitmap through the NABU Internet Adapter takes about a
+ * second, and most screens are largely black or otherwise repetitive.  This
+ * run length encodes them into the packed screen format described in
+ * Common/soundscreen.h, which LoadScreen() unpacks on the fly as it copies to
+ * video memory.  The packed file keeps the same name so it can just replace
+ * the original on the server.  If packing doesn't make a file smaller, the
+ * original is copied unchanged.  Each packed file is read back with the same
+ * unpacking code as the game (soundscreen.c, included directly) to make sure
+ * it comes out the same as the original.
+ *
+ * AGMS20261018 - Start the screen packer.
+ *
+ * Compile with: gcc -g -O2 -Wall -o ScreenPacker ScreenPacker.c
+ * Run with: ./ScreenPacker -o OutputDirectory/ File.NFUL File.NSCR ...
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Temporary global buffer used for sprinting into, same as the NABU. */
+#define TEMPBUFFER_LEN 512
+char g_TempBuffer[TEMPBUFFER_LEN];
+
+/* The game itself, as source code, for the screen unpacking functions. */
+#include "../Common/cverify.h"
+#include "../Common/fixed_point.c"
+#include "../Common/debug_print.c"
+#include "../Common/tiles.c"
+#include "../Common/players.c"
+#include "../Common/simulate.c"
+#include "../Common/scores.c"
+#include "../Common/soundscreen.c"
+#include "../Common/levels.c"
+
+/* Biggest screen file is a .NFUL, 12K, allow a bit extra. */
+#define MAX_SCREEN_SIZE 16384
+
+static uint8_t s_Original[MAX_SCREEN_SIZE];
+static size_t s_OriginalLength;
+static uint8_t s_Packed[SCREEN_PACKED_MAGIC_LENGTH + MAX_SCREEN_SIZE * 2];
+static size_t s_PackedLength;
+static uint8_t s_Unpacked[MAX_SCREEN_SIZE];
+
+
+/*******************************************************************************
+ * Figure out the type letter for a screen file, from the extension or failing
+ * that the size, same way as LoadScreen() does.
+ */
+static char ScreenTypeLetter(const char *fileName, size_t fileSize)
+{
+  const char *pExtension = strrchr(fileName, '.');
+
+  if (pExtension != NULL && strchr(pExtension, '/') == NULL)
+  {
+    if (strcasecmp(pExtension, ".NFUL") == 0)
+      return 'F';
+    if (strcasecmp(pExtension, ".NSCR") == 0)
+      return 'S';
+    if (strcasecmp(pExtension, ".NCHR") == 0)
+      return 'C';
+  }
+  if (fileSize < 6976)
+    return 'C';
+  if (fileSize < 12288)
+    return 'S';
+  return 'F';
+}
+
+
+/*******************************************************************************
+ * Run length encode the original file into s_Packed, after the header.  Runs
+ * of SCREEN_PACKED_MIN_REPEAT or more identical bytes get repeated, the rest
+ * are gathered up into literal runs.
+ */
+static void PackScreen(char typeLetter)
+{
+  size_t position = 0;
+  size_t literalStart = 0;
+  size_t literalLength;
+  size_t repeatLength;
+
+  s_PackedLength = 0;
+  s_Packed[s_PackedLength++] = 'N';
+  s_Packed[s_PackedLength++] = 'P';
+  s_Packed[s_PackedLength++] = 'K';
+  s_Packed[s_PackedLength++] = typeLetter;
+
+  while (position <= s_OriginalLength)
+  {
+    /* See how long a run of identical bytes starts here. */
+    repeatLength = 0;
+    if (position < s_OriginalLength)
+    {
+      repeatLength = 1;
+      while (position + repeatLength < s_OriginalLength &&
+      repeatLength < SCREEN_PACKED_MAX_REPEAT &&
+      s_Original[position + repeatLength] == s_Original[position])
+        repeatLength++;
+    }
+
+    /* Flush the pending literals if a repeat is starting, at the end of the
+       data, or if there are too many literals for one run. */
+    literalLength = position - literalStart;
+    if (literalLength != 0 && (repeatLength >= SCREEN_PACKED_MIN_REPEAT ||
+    position == s_OriginalLength || literalLength == SCREEN_PACKED_MAX_LITERAL))
+    {
+      s_Packed[s_PackedLength++] = literalLength - 1;
+      memcpy(s_Packed + s_PackedLength, s_Original + literalStart,
+        literalLength);
+      s_PackedLength += literalLength;
+      literalStart = position;
+    }
+
+    if (position == s_OriginalLength)
+      break;
+
+    if (repeatLength >= SCREEN_PACKED_MIN_REPEAT)
+    {
+      s_Packed[s_PackedLength++] = repeatLength + 125;
+      s_Packed[s_PackedLength++] = s_Original[position];
+      position += repeatLength;
+      literalStart = position;
+    }
+    else
+      position++;
+  }
+}
+
+
+/*******************************************************************************
+ * Read back a packed file with the game's unpacking code and compare it with
+ * the original.  Returns FALSE if it doesn't match, after printing why.
+ */
+static bool VerifyPackedFile(const char *packedPath, char typeLetter)
+{
+  FileHandleType fileID;
+  size_t unpackedLength = 0;
+  uint16_t amountRead;
+  char packedType;
+
+  fileID = open(packedPath, O_RDONLY);
+  if (fileID == BAD_FILE_HANDLE)
+  {
+    fprintf(stderr, "Unable to reopen \"%s\": %s\n", packedPath,
+      strerror(errno));
+    return false;
+  }
+
+  packedType = ScreenDataStart(fileID);
+  do {
+    /* Odd sized reads to exercise runs crossing over between reads. */
+    amountRead = ScreenDataRead(fileID, s_Unpacked + unpackedLength,
+      (sizeof(s_Unpacked) - unpackedLength < 251) ?
+      sizeof(s_Unpacked) - unpackedLength : 251);
+    unpackedLength += amountRead;
+  } while (amountRead != 0 && unpackedLength < sizeof(s_Unpacked));
+  close(fileID);
+
+  if (packedType != typeLetter || unpackedLength != s_OriginalLength ||
+  memcmp(s_Unpacked, s_Original, s_OriginalLength) != 0)
+  {
+    fprintf(stderr, "Packed file \"%s\" doesn't unpack to the original.\n",
+      packedPath);
+    return false;
+  }
+  return true;
+}
+
+
+/*******************************************************************************
+ * Pack one screen file.  Returns FALSE on failure, after printing why.
+ */
+static bool PackScreenFile(const char *inputPath, const char *outputDirectory)
+{
+  char outputPath[1024];
+  const char *baseName;
+  FILE *inputFile;
+  FILE *outputFile;
+  const uint8_t *pOutput;
+  size_t outputLength;
+  char typeLetter;
+
+  inputFile = fopen(inputPath, "rb");
+  if (inputFile == NULL)
+  {
+    fprintf(stderr, "Unable to open \"%s\": %s\n", inputPath, strerror(errno));
+    return false;
+  }
+  s_OriginalLength = fread(s_Original, 1, sizeof(s_Original), inputFile);
+  fclose(inputFile);
+
+  if (s_OriginalLength == 0 || s_OriginalLength >= sizeof(s_Original))
+  {
+    fprintf(stderr, "\"%s\" is empty or too big to be a screen.\n", inputPath);
+    return false;
+  }
+  if (s_OriginalLength >= SCREEN_PACKED_MAGIC_LENGTH &&
+  memcmp(s_Original, kScreenPackedMagic, sizeof(kScreenPackedMagic)) == 0)
+  {
+    fprintf(stderr, "\"%s\" is already packed.\n", inputPath);
+    return false;
+  }
+
+  typeLetter = ScreenTypeLetter(inputPath, s_OriginalLength);
+  PackScreen(typeLetter);
+  pOutput = s_Packed;
+  outputLength = s_PackedLength;
+  if (outputLength >= s_OriginalLength)
+  {
+    pOutput = s_Original; /* Not worth packing, copy the original. */
+    outputLength = s_OriginalLength;
+  }
+
+  baseName = strrchr(inputPath, '/');
+  baseName = (baseName == NULL) ? inputPath : baseName + 1;
+  snprintf(outputPath, sizeof(outputPath), "%s%s", outputDirectory, baseName);
+  outputFile = fopen(outputPath, "wb");
+  if (outputFile == NULL ||
+  fwrite(pOutput, 1, outputLength, outputFile) != outputLength)
+  {
+    fprintf(stderr, "Unable to write \"%s\": %s\n", outputPath,
+      strerror(errno));
+    if (outputFile != NULL)
+      fclose(outputFile);
+    return false;
+  }
+  fclose(outputFile);
+
+  if (pOutput == s_Original)
+  {
+    printf("Copied %s, %d bytes, doesn't pack smaller.\n", outputPath,
+      (int) outputLength);
+    return true;
+  }
+
+  if (!VerifyPackedFile(outputPath, typeLetter))
+    return false;
+
+  printf("Packed %s, %d bytes to %d bytes (%d%%).\n", outputPath,
+    (int) s_OriginalLength, (int) outputLength,
+    (int) (outputLength * 100 / s_OriginalLength));
+  return true;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *outputDirectory = NULL;
+  int option;
+  int failureCount = 0;
+  int fileCount;
+
+  while ((option = getopt(argc, argv, "o:")) != -1)
+  {
+    switch (option)
+    {
+      case 'o': outputDirectory = optarg; break;
+      default: outputDirectory = NULL; optind = argc; break;
+    }
+  }
+  if (outputDirectory == NULL || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s -o OutputDirectory/ File.NFUL File.NSCR ...\n",
+      argv[0]);
+    return 1;
+  }
+
+  for (fileCount = 0; optind < argc; optind++, fileCount++)
+  {
+    if (!PackScreenFile(argv[optind], outputDirectory))
+      failureCount++;
+  }
+
+  printf("%d files packed, %d failed.\n", fileCount - failureCount,
+    failureCount);
+  return failureCount != 0;
+}
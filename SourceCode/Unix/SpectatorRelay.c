@@ -0,0 +1,394 @@
+/******************************************************************************
+ * Nth Pong Wars, a relay that fans a spectator stream out to many viewers.
+ *
+ * The NABU game (compiled with SPECTATOR_STREAM=1, see Common/spectator.h for
+ * the record format) connects to the game port through the Internet Adapter
+ * and sends its stream of keyframes and deltas.  Viewers connect to the viewer
+ * port and get a copy.  Everything since the latest keyframe is kept, so a
+ * new viewer is sent that first and then can follow along with the live
+ * deltas.  Viewers that can't keep up get disconnected, rather than slowing
+ * down everybody else.
+ *
+ * AGMS20261018 - Start this relay.
+ *
+ * Compile with: gcc -g -O2 -Wall -o SpectatorRelay SpectatorRelay.c
+ * Run with: ./SpectatorRelay [GamePort [ViewerPort]]
+ * Defaults are 7200 and 7201.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_VIEWERS 64
+#define MAX_KEYFRAME_CACHE 65536 /* Keyframe and deltas following it. */
+#define INPUT_BUFFER_SIZE 4096
+
+/* Number of bytes in a 4 byte sprite attribute slot update, given the mask of
+   which bytes changed. */
+#define BITS_IN_NIBBLE(x) (((x) & 1) + (((x) >> 1) & 1) + (((x) >> 2) & 1) + \
+  (((x) >> 3) & 1))
+
+static int s_GameListenSocket = -1;
+static int s_ViewerListenSocket = -1;
+static int s_GameSocket = -1;
+static int s_ViewerSockets[MAX_VIEWERS];
+static bool s_ViewerSynced[MAX_VIEWERS]; /* FALSE if waiting for a keyframe. */
+
+/* Game bytes received but not yet a complete record. */
+static uint8_t s_Input[INPUT_BUFFER_SIZE];
+static size_t s_InputLength = 0;
+
+/* Everything since the latest keyframe, empty if we haven't seen one yet (or
+   there was too much to keep, then viewers wait for the next keyframe). */
+static uint8_t s_Cache[MAX_KEYFRAME_CACHE];
+static size_t s_CacheLength = 0;
+static bool s_CacheValid = false;
+
+/* Statistics. */
+static uint64_t s_BytesIn = 0;
+static uint32_t s_Keyframes = 0;
+
+
+/*******************************************************************************
+ * Make a TCP socket listening on all interfaces at the given port.  Returns -1
+ * on failure, after printing why.
+ */
+static int OpenListenSocket(uint16_t port)
+{
+  struct sockaddr_in address;
+  int sock;
+  int flag = 1;
+
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+  listen(sock, 16) != 0)
+  {
+    fprintf(stderr, "Unable to listen on port %d: %s\n", port, strerror(errno));
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+
+/*******************************************************************************
+ * Send bytes to a viewer, disconnecting them if they aren't keeping up.
+ */
+static void SendToViewer(int iViewer, const uint8_t *pData, size_t length)
+{
+  if (s_ViewerSockets[iViewer] < 0 || length == 0)
+    return;
+  if (send(s_ViewerSockets[iViewer], pData, length,
+  MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t) length)
+  {
+    printf("Viewer %d disconnected or too slow.\n", iViewer);
+    close(s_ViewerSockets[iViewer]);
+    s_ViewerSockets[iViewer] = -1;
+  }
+}
+
+
+/*******************************************************************************
+ * Returns the length of the complete record at the start of the data, or zero
+ * if more data is needed, or -1 if it isn't a valid record.
+ */
+static ssize_t RecordLength(const uint8_t *pData, size_t available)
+{
+  size_t needed;
+  uint16_t slotMask;
+  int iSlot;
+
+  if (available < 1)
+    return 0;
+
+  switch (pData[0])
+  {
+    case 'K':
+      needed = 7;
+      break;
+
+    case 'D':
+      needed = 5;
+      break;
+
+    case 'R':
+      if (available < 2)
+        return 0;
+      needed = 2 + 2 * pData[1];
+      break;
+
+    case 'T':
+      if (available < 2)
+        return 0;
+      needed = 2 + 3 * pData[1];
+      break;
+
+    case 'S':
+      if (available < 3)
+        return 0;
+      slotMask = pData[1] | (pData[2] << 8);
+      needed = 3;
+      for (iSlot = 0; iSlot < 16; iSlot++)
+      {
+        if (!(slotMask & (1 << iSlot)))
+          continue;
+        if (available < needed + 1)
+          return 0;
+        needed += 1 + BITS_IN_NIBBLE(pData[needed]);
+      }
+      break;
+
+    default:
+      return -1;
+  }
+
+  return (available < needed) ? 0 : (ssize_t) needed;
+}
+
+
+/*******************************************************************************
+ * Handle the complete records in the input buffer: remember them in the
+ * keyframe cache and pass them on to the viewers.  Returns FALSE if the game
+ * is sending garbage.
+ */
+static bool ProcessGameRecords(void)
+{
+  size_t offset = 0;
+  size_t start;
+  ssize_t length;
+  int iViewer;
+
+  while (true)
+  {
+    start = offset;
+
+    /* Collect as many complete records as possible, but stop just before a
+       keyframe so the cache can be reset at the right place. */
+
+    while ((length = RecordLength(s_Input + offset, s_InputLength - offset)) > 0)
+    {
+      if (s_Input[offset] == 'K' && offset != start)
+        break;
+      offset += length;
+    }
+    if (length < 0)
+    {
+      fprintf(stderr, "Unknown record type %d from game.\n", s_Input[offset]);
+      return false;
+    }
+    if (offset == start)
+      break;
+
+    if (s_Input[start] == 'K')
+    {
+      s_CacheLength = 0;
+      s_CacheValid = true;
+      s_Keyframes++;
+      for (iViewer = 0; iViewer < MAX_VIEWERS; iViewer++)
+        s_ViewerSynced[iViewer] = true;
+    }
+    if (s_CacheValid && s_CacheLength + (offset - start) <= sizeof(s_Cache))
+    {
+      memcpy(s_Cache + s_CacheLength, s_Input + start, offset - start);
+      s_CacheLength += offset - start;
+    }
+    else /* Too much since the keyframe, new viewers wait for the next. */
+    {
+      s_CacheLength = 0;
+      s_CacheValid = false;
+    }
+
+    for (iViewer = 0; iViewer < MAX_VIEWERS; iViewer++)
+    {
+      if (s_ViewerSynced[iViewer])
+        SendToViewer(iViewer, s_Input + start, offset - start);
+    }
+  }
+
+  memmove(s_Input, s_Input + offset, s_InputLength - offset);
+  s_InputLength -= offset;
+  return true;
+}
+
+
+/*******************************************************************************
+ * Read what the game has sent.  Only one game at a time, a new connection
+ * replaces the old one (the NABU may have been rebooted).
+ */
+static void ReadFromGame(void)
+{
+  ssize_t amountRead;
+
+  amountRead = recv(s_GameSocket, s_Input + s_InputLength,
+    sizeof(s_Input) - s_InputLength, 0);
+  if (amountRead <= 0)
+  {
+    if (amountRead < 0 && (errno == EINTR || errno == EAGAIN))
+      return;
+    printf("Game disconnected after %llu bytes and %u keyframes.\n",
+      (unsigned long long) s_BytesIn, s_Keyframes);
+    close(s_GameSocket);
+    s_GameSocket = -1;
+    return;
+  }
+  s_InputLength += amountRead;
+  s_BytesIn += amountRead;
+
+  if (!ProcessGameRecords() || s_InputLength >= sizeof(s_Input))
+  {
+    close(s_GameSocket); /* Out of sync, start over. */
+    s_GameSocket = -1;
+  }
+}
+
+
+int main(int argc, const char **argv)
+{
+  int gamePort = (argc > 1) ? atoi(argv[1]) : 7200;
+  int viewerPort = (argc > 2) ? atoi(argv[2]) : 7201;
+  struct pollfd pollList[3 + MAX_VIEWERS];
+  int pollViewers[3 + MAX_VIEWERS];
+  int pollCount;
+  int iPoll;
+  int iViewer;
+  int newSocket;
+
+  for (iViewer = 0; iViewer < MAX_VIEWERS; iViewer++)
+    s_ViewerSockets[iViewer] = -1;
+
+  s_GameListenSocket = OpenListenSocket(gamePort);
+  s_ViewerListenSocket = OpenListenSocket(viewerPort);
+  if (s_GameListenSocket < 0 || s_ViewerListenSocket < 0)
+    return 1;
+
+  printf("Game connects to port %d, viewers to port %d.\n", gamePort,
+    viewerPort);
+  fflush(stdout);
+
+  while (true)
+  {
+    pollCount = 0;
+    pollList[pollCount].fd = s_GameListenSocket;
+    pollViewers[pollCount++] = -1;
+    pollList[pollCount].fd = s_ViewerListenSocket;
+    pollViewers[pollCount++] = -1;
+    if (s_GameSocket >= 0)
+    {
+      pollList[pollCount].fd = s_GameSocket;
+      pollViewers[pollCount++] = -1;
+    }
+    for (iViewer = 0; iViewer < MAX_VIEWERS; iViewer++)
+    {
+      if (s_ViewerSockets[iViewer] < 0)
+        continue;
+      pollList[pollCount].fd = s_ViewerSockets[iViewer];
+      pollViewers[pollCount++] = iViewer;
+    }
+    for (iPoll = 0; iPoll < pollCount; iPoll++)
+    {
+      pollList[iPoll].events = POLLIN;
+      pollList[iPoll].revents = 0;
+    }
+
+    if (poll(pollList, pollCount, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("poll");
+      return 1;
+    }
+
+    for (iPoll = 0; iPoll < pollCount; iPoll++)
+    {
+      if (!(pollList[iPoll].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+
+      if (pollList[iPoll].fd == s_GameListenSocket)
+      {
+        newSocket = accept(s_GameListenSocket, NULL, NULL);
+        if (newSocket < 0)
+          continue;
+        if (s_GameSocket >= 0)
+          close(s_GameSocket);
+        s_GameSocket = newSocket;
+        s_InputLength = 0;
+        s_CacheLength = 0;
+        s_CacheValid = false;
+        printf("Game connected.\n");
+      }
+      else if (pollList[iPoll].fd == s_ViewerListenSocket)
+      {
+        newSocket = accept(s_ViewerListenSocket, NULL, NULL);
+        if (newSocket < 0)
+          continue;
+        for (iViewer = 0; iViewer < MAX_VIEWERS; iViewer++)
+        {
+          if (s_ViewerSockets[iViewer] < 0)
+            break;
+        }
+        if (iViewer >= MAX_VIEWERS)
+        {
+          close(newSocket);
+          continue;
+        }
+        fcntl(newSocket, F_SETFL, fcntl(newSocket, F_GETFL) | O_NONBLOCK);
+        s_ViewerSockets[iViewer] = newSocket;
+        s_ViewerSynced[iViewer] = s_CacheValid;
+        printf("Viewer %d connected, sending %d cached bytes.\n", iViewer,
+          (int) s_CacheLength);
+        SendToViewer(iViewer, s_Cache, s_CacheLength);
+      }
+      else if (pollList[iPoll].fd == s_GameSocket)
+        ReadFromGame();
+      else /* Viewers don't send anything, just check for them leaving. */
+      {
+        uint8_t discard[256];
+        iViewer = pollViewers[iPoll];
+        if (s_ViewerSockets[iViewer] < 0)
+          continue; /* Already disconnected for being slow. */
+        if (recv(s_ViewerSockets[iViewer], discard, sizeof(discard), 0) <= 0)
+        {
+          printf("Viewer %d left.\n", iViewer);
+          close(s_ViewerSockets[iViewer]);
+          s_ViewerSockets[iViewer] = -1;
+        }
+      }
+      fflush(stdout);
+    }
+  }
+
+  return 0;
+}